@@ -1,21 +1,339 @@
 #include <Application.h>
 
 #include <Config.h>
+#include <FrameAnomalyDetector.h>
+#include <FrameCapture.h>
+#include <Input.h>
 #include <Renderer.h>
 #include <Window.h>
 #include <Stats.h>
+#include <Core/AssetArchive.h>
+#include <Core/JobSystem.h>
 #include <Core/Logger.h>
+#include <Core/MemoryStats.h>
+#include <Core/PerfCounters.h>
+#include <Core/Telemetry.h>
 #include <Core/Time.h>
 
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/GraphicsTypes.h>
 #include <ThirdParty/SDL2/include/SDL.h>
 #include <ThirdParty/sdl-imgui/imgui_impl_sdl.h>
 
 
+namespace
+{
+  struct LaunchOptions
+  {
+#if OS_WINDOWS
+    zv::eRenderDeviceType device_type{ Diligent::RENDER_DEVICE_TYPE_D3D12 };
+#else
+    zv::eRenderDeviceType device_type{ Diligent::RENDER_DEVICE_TYPE_VULKAN };
+#endif
+    bool offscreen{ false };
+    u32 width{ 1200 };
+    u32 height{ 800 };
+    // 0 runs until the window is closed
+    u32 frame_count{ 0 };
+    // 0 uses one per job system thread
+    u32 record_thread_count{ 0 };
+    bool draw_per_instance{ false };
+    bool bench_submission{ false };
+    bool pipeline_cache{ true };
+    // rebuilds the UI every frame instead of at the refresh rate of its panels
+    bool ui_cache{ true };
+    // directory whose assets are streamed in at startup
+    const char* stream_directory{ nullptr };
+    // archive that is mounted and streamed in at startup
+    const char* archive_path{ nullptr };
+    // frame capture that is written or replayed
+    const char* capture_path{ nullptr };
+    const char* replay_path{ nullptr };
+    bool replay_paced{ false };
+    // per-frame timing output
+    const char* frame_times_path{ nullptr };
+    // frame time spikes write a trace, 0 disables the detector
+    f32 hitch_threshold_mads{ 8.0f };
+    u32 hitch_history_frame_count{ 120 };
+    // address the telemetry server listens on, none without
+    const char* telemetry_address{ nullptr };
+  };
+
+  bool parse_launch_options(s32 argc, char* argv[], LaunchOptions& out_options)
+  {
+    for (s32 i = 1; i < argc; ++i)
+    {
+      const char* arg = argv[i];
+      if (std::strcmp(arg, "--device=vulkan") == 0)
+      {
+        out_options.device_type = Diligent::RENDER_DEVICE_TYPE_VULKAN;
+      }
+      else if (std::strcmp(arg, "--device=d3d11") == 0)
+      {
+        out_options.device_type = Diligent::RENDER_DEVICE_TYPE_D3D11;
+      }
+      else if (std::strcmp(arg, "--device=d3d12") == 0)
+      {
+        out_options.device_type = Diligent::RENDER_DEVICE_TYPE_D3D12;
+      }
+      else if (std::strcmp(arg, "--offscreen") == 0)
+      {
+        out_options.offscreen = true;
+      }
+      else if (std::sscanf(arg, "--size=%ux%u", &out_options.width, &out_options.height) == 2)
+      {
+      }
+      else if (std::sscanf(arg, "--frames=%u", &out_options.frame_count) == 1)
+      {
+      }
+      else if (std::sscanf(arg, "--record-threads=%u", &out_options.record_thread_count) == 1)
+      {
+      }
+      else if (std::strcmp(arg, "--draw-per-instance") == 0)
+      {
+        out_options.draw_per_instance = true;
+      }
+      else if (std::strcmp(arg, "--bench-submission") == 0)
+      {
+        out_options.bench_submission = true;
+      }
+      else if (std::strcmp(arg, "--no-pipeline-cache") == 0)
+      {
+        out_options.pipeline_cache = false;
+      }
+      else if (std::strcmp(arg, "--no-ui-cache") == 0)
+      {
+        out_options.ui_cache = false;
+      }
+      else if (std::strncmp(arg, "--stream=", 9) == 0)
+      {
+        out_options.stream_directory = arg + 9;
+      }
+      else if (std::strncmp(arg, "--archive=", 10) == 0)
+      {
+        out_options.archive_path = arg + 10;
+      }
+      else if (std::strncmp(arg, "--capture=", 10) == 0)
+      {
+        out_options.capture_path = arg + 10;
+      }
+      else if (std::strncmp(arg, "--replay=", 9) == 0)
+      {
+        out_options.replay_path = arg + 9;
+      }
+      else if (std::strcmp(arg, "--replay-paced") == 0)
+      {
+        out_options.replay_paced = true;
+      }
+      else if (std::strncmp(arg, "--frame-times=", 14) == 0)
+      {
+        out_options.frame_times_path = arg + 14;
+      }
+      else if (std::sscanf(arg, "--hitch-threshold=%f", &out_options.hitch_threshold_mads) == 1)
+      {
+      }
+      else if (std::sscanf(arg, "--hitch-history=%u", &out_options.hitch_history_frame_count) == 1)
+      {
+      }
+      else if (std::strncmp(arg, "--telemetry=", 12) == 0)
+      {
+        out_options.telemetry_address = arg + 12;
+      }
+      else
+      {
+        ZV_ERROR("Unknown command line option '{}'.", arg);
+        return false;
+      }
+    }
+
+    if (out_options.capture_path && out_options.replay_path)
+    {
+      ZV_ERROR("Frames cannot be captured and replayed at the same time.");
+      return false;
+    }
+
+    return out_options.width > 0 && out_options.height > 0;
+  }
+
+  // streamable asset type by file extension, false for anything else
+  bool get_stream_asset_type(const std::filesystem::path& path, zv::eStreamAssetType& out_type)
+  {
+    const std::string extension = path.extension().string();
+    if (extension == ".zvmesh")
+    {
+      out_type = zv::eStreamAssetType::Mesh;
+      return true;
+    }
+    if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".dds" || extension == ".ktx" || extension == ".tga")
+    {
+      out_type = zv::eStreamAssetType::Texture;
+      return true;
+    }
+    return false;
+  }
+
+  // requests every texture and mesh file below the directory
+  void request_stream_directory(zv::StreamingSystem& streaming, const char* directory, std::vector<zv::StreamHandle>& out_handles)
+  {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator{ directory, error })
+    {
+      zv::eStreamAssetType type;
+      if (entry.is_regular_file() && get_stream_asset_type(entry.path(), type))
+      {
+        out_handles.push_back(streaming.request(entry.path().string().c_str(), type));
+      }
+    }
+
+    if (error)
+    {
+      ZV_WARNING("Failed to list the stream directory '{}'.", directory);
+    }
+  }
+
+  struct FrameTime
+  {
+    // simulated, live or replayed
+    f32 delta_time_ms;
+    // measured, from the tick of the frame to the tick of the next one
+    f32 frame_time_ms;
+  };
+
+  // Writes one line per frame and logs the distribution, replays of the same capture produce comparable files
+  void write_frame_times(const char* path, const std::vector<FrameTime>& frame_times)
+  {
+    if (frame_times.empty())
+    {
+      return;
+    }
+
+    std::ofstream file{ path, std::ios::trunc };
+    file << "frame,delta_time_ms,frame_time_ms\n";
+    for (size_t i = 0; i < frame_times.size(); ++i)
+    {
+      file << i << ',' << frame_times[i].delta_time_ms << ',' << frame_times[i].frame_time_ms << '\n';
+    }
+    if (!file)
+    {
+      ZV_WARNING("Failed to write the frame times to '{}'.", path);
+    }
+
+    std::vector<f32> sorted(frame_times.size());
+    std::transform(frame_times.begin(), frame_times.end(), sorted.begin(), [](const FrameTime& frame_time) { return frame_time.frame_time_ms; });
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](f64 p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1) + 0.5)]; };
+    ZV_INFO("Frame times: median {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms.", percentile(0.5), percentile(0.9), percentile(0.99), sorted.back());
+  }
+
+  // Publishes the counters of a frame and its CPU scopes as spans; GPU scopes are counters, their timestamps are
+  // frames behind
+  class FrameTelemetry
+  {
+  private:
+    zv::TelemetryChannel m_frame_time_channel;
+    zv::TelemetryChannel m_gpu_frame_time_channel;
+    zv::TelemetryChannel m_draw_count_channel;
+    zv::TelemetryChannel m_allocation_count_channel;
+    zv::TelemetryChannel m_live_allocation_count_channel;
+    zv::TelemetryChannel m_resident_mb_channel;
+    zv::TelemetryChannel m_residency_budget_mb_channel;
+    zv::TelemetryChannel m_loading_count_channel;
+    // scope names are literals, so the pointer is the key
+    std::unordered_map<const char*, zv::TelemetryChannel> m_cpu_scope_channels;
+    std::unordered_map<const char*, zv::TelemetryChannel> m_gpu_scope_channels;
+    u64 m_previous_allocation_count{ 0 };
+
+  public:
+    FrameTelemetry()
+      : m_frame_time_channel(zv::Telemetry::register_channel("frame_time_ms"))
+      , m_gpu_frame_time_channel(zv::Telemetry::register_channel("gpu_frame_time_ms"))
+      , m_draw_count_channel(zv::Telemetry::register_channel("draw_calls"))
+      , m_allocation_count_channel(zv::Telemetry::register_channel("allocations"))
+      , m_live_allocation_count_channel(zv::Telemetry::register_channel("live_allocations"))
+      , m_resident_mb_channel(zv::Telemetry::register_channel("streaming_resident_mb"))
+      , m_residency_budget_mb_channel(zv::Telemetry::register_channel("streaming_budget_mb"))
+      , m_loading_count_channel(zv::Telemetry::register_channel("streaming_loading"))
+    {
+    }
+
+    void publish(u64 frame_start_ns, const zv::PerfFrameStats& cpu_stats, const zv::GpuFrameStats& gpu_stats,
+                 const zv::DrawStats& draw_stats, const zv::StreamingSystem::FrameStats& stream_stats, u64 residency_budget_bytes)
+    {
+      if (!zv::Telemetry::is_running())
+      {
+        return;
+      }
+
+      zv::Telemetry::publish_counter(m_frame_time_channel, cpu_stats.time_ms);
+      for (const zv::PerfScopeCounters& scope : cpu_stats.scopes)
+      {
+        const u64 start_ns = frame_start_ns + static_cast<u64>(scope.start_ms * 1.0e6f);
+        zv::Telemetry::publish_span(get_scope_channel(m_cpu_scope_channels, "cpu/", scope.name), start_ns, static_cast<u64>(scope.time_ms * 1.0e6f));
+      }
+
+      if (gpu_stats.valid)
+      {
+        zv::Telemetry::publish_counter(m_gpu_frame_time_channel, gpu_stats.frame_time_ms);
+        for (const zv::GpuScopeTiming& scope : gpu_stats.scopes)
+        {
+          zv::Telemetry::publish_counter(get_scope_channel(m_gpu_scope_channels, "gpu/", scope.name), scope.time_ms);
+        }
+      }
+
+      const zv::AllocationCounts allocation_counts = zv::MemoryStats::get_allocation_counts();
+      zv::Telemetry::publish_counter(m_allocation_count_channel, static_cast<f64>(allocation_counts.allocation_count - m_previous_allocation_count));
+      zv::Telemetry::publish_counter(m_live_allocation_count_channel, static_cast<f64>(allocation_counts.allocation_count - allocation_counts.free_count));
+      m_previous_allocation_count = allocation_counts.allocation_count;
+
+      zv::Telemetry::publish_counter(m_draw_count_channel, draw_stats.draw_count);
+      zv::Telemetry::publish_counter(m_resident_mb_channel, static_cast<f64>(stream_stats.resident_bytes) / (1 << 20));
+      zv::Telemetry::publish_counter(m_residency_budget_mb_channel, static_cast<f64>(residency_budget_bytes) / (1 << 20));
+      zv::Telemetry::publish_counter(m_loading_count_channel, stream_stats.loading_count);
+    }
+
+  private:
+    // registering takes a lock, so it happens once per scope
+    static zv::TelemetryChannel get_scope_channel(std::unordered_map<const char*, zv::TelemetryChannel>& channels, const char* prefix, const char* name)
+    {
+      auto it = channels.find(name);
+      if (it == channels.end())
+      {
+        it = channels.emplace(name, zv::Telemetry::register_channel((std::string{ prefix } + name).c_str())).first;
+      }
+      return it->second;
+    }
+  };
+
+  // requests every texture and mesh of the archive
+  void request_stream_archive(zv::StreamingSystem& streaming, const zv::AssetArchive& archive, std::vector<zv::StreamHandle>& out_handles)
+  {
+    for (u32 i = 0; i < archive.get_entry_count(); ++i)
+    {
+      const std::string path = archive.get_entry_path(archive.get_entry(i));
+      zv::eStreamAssetType type;
+      if (get_stream_asset_type(path, type))
+      {
+        out_handles.push_back(streaming.request(path.c_str(), type));
+      }
+    }
+  }
+}
+
+
 zv::Application::Application()
   : m_ptr_window(std::make_unique<Window>())
   , m_ptr_renderer(std::make_unique<Renderer>())
   , m_ptr_stats(std::make_unique<Stats>())
-  , m_event()
+  , m_ptr_input(std::make_unique<InputSystem>())
+  , m_ptr_perf_counters(std::make_unique<PerfCounters>())
 {
 }
 
@@ -23,7 +341,7 @@ zv::Application::~Application()
 {
 }
 
-s32 zv::Application::run()
+s32 zv::Application::run(s32 argc, char* argv[])
 {
   Time::Clock::create();
   if (!Logger::create(get_base_path()))
@@ -31,25 +349,43 @@ s32 zv::Application::run()
     return 1;
   }
 
-  Window::CreateParams window_params;
-  window_params.title = PROJECT_TITLE;
-  window_params.width = 1200;
-  window_params.height = 800;
-  // window_params.enable_fullscreen = true;
-
-  if (!m_ptr_window->create(window_params))
+  LaunchOptions options;
+  if (!parse_launch_options(argc, argv, options))
   {
-    ZV_ERROR("Failed to create window for '{}'.", PROJECT_TITLE);
     return 1;
   }
 
+  Jobs::create();
+
+  // offscreen runs have no window at all, so they work without a display server
+  if (!options.offscreen)
+  {
+    Window::CreateParams window_params;
+    window_params.title = PROJECT_TITLE;
+    window_params.width = static_cast<s32>(options.width);
+    window_params.height = static_cast<s32>(options.height);
+    // window_params.enable_fullscreen = true;
+
+    if (!m_ptr_window->create(window_params))
+    {
+      ZV_ERROR("Failed to create window for '{}'.", PROJECT_TITLE);
+      return 1;
+    }
+  }
+
   Renderer::CreateParams renderer_params;
-  renderer_params.ptr_window = m_ptr_window.get();
-  renderer_params.device_type = eRenderDeviceType::RENDER_DEVICE_TYPE_D3D12;
+  renderer_params.ptr_window = options.offscreen ? nullptr : m_ptr_window.get();
+  renderer_params.device_type = options.device_type;
   // renderer_params.enable_fullscreen = true;
   renderer_params.enable_vsynch = false;
-  renderer_params.init_imgui = true;
+  renderer_params.init_imgui = !options.offscreen;
   renderer_params.clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
+  renderer_params.offscreen = options.offscreen;
+  renderer_params.offscreen_width = options.width;
+  renderer_params.offscreen_height = options.height;
+  renderer_params.deferred_context_count = options.record_thread_count > 0 ? options.record_thread_count : Jobs::get_thread_count();
+  const std::string pipeline_cache_directory = std::string{ get_base_path() } + "Cache";
+  renderer_params.pipeline_cache_directory = options.pipeline_cache ? pipeline_cache_directory.c_str() : nullptr;
 
   if (!m_ptr_renderer->create(renderer_params))
   {
@@ -57,38 +393,227 @@ s32 zv::Application::run()
     return 1;
   }
 
+  if (!m_ptr_input->create())
+  {
+    return 1;
+  }
+
+  // a replay restores the seed of the recorded run, so it has to happen before anything draws random numbers
+  FrameCapture capture;
+  FrameCapture::CreateParams capture_params;
+  capture_params.mode = options.replay_path ? eCaptureMode::Replay : options.capture_path ? eCaptureMode::Record : eCaptureMode::None;
+  capture_params.ptr_path = options.replay_path ? options.replay_path : options.capture_path;
+  capture_params.paced = options.replay_paced;
+  if (!capture.create(capture_params))
+  {
+    return 1;
+  }
+
+  // imgui sees every event, the game only those imgui does not want
+  if (renderer_params.init_imgui)
+  {
+    m_ptr_input->set_event_filter([this](SDL_Event& event)
+    {
+      if (ImGui_ImplSDL2_ProcessEvent(&event))
+      {
+        m_ptr_renderer->invalidate_imgui();
+      }
+      const ImGuiIO& io = ImGui::GetIO();
+      const bool keyboard = event.type == SDL_KEYDOWN || event.type == SDL_KEYUP || event.type == SDL_TEXTINPUT;
+      return keyboard ? io.WantCaptureKeyboard : io.WantCaptureMouse;
+    });
+  }
+  const ActionId quit_action = m_ptr_input->add_action("Quit");
+  m_ptr_input->bind_key(quit_action, SDL_SCANCODE_ESCAPE);
+
+  // hardware counters of the main thread, per frame and per renderer phase
+  m_ptr_perf_counters->create();
+  m_ptr_renderer->set_perf_counters(m_ptr_perf_counters.get());
+
+  FrameAnomalyDetector anomaly_detector;
+  const std::string trace_directory = std::string{ get_base_path() } + "Traces";
+  if (options.hitch_threshold_mads > 0.0f)
+  {
+    FrameAnomalyDetector::CreateParams detector_params;
+    detector_params.ptr_trace_directory = trace_directory.c_str();
+    detector_params.threshold_mads = options.hitch_threshold_mads;
+    detector_params.history_frame_count = std::max(options.hitch_history_frame_count, 1u);
+    anomaly_detector.create(detector_params);
+  }
+
+  FrameTelemetry frame_telemetry;
+  if (options.telemetry_address && !Telemetry::create(options.telemetry_address))
+  {
+    ZV_WARNING("Running without telemetry.");
+  }
+
   m_ptr_renderer->register_imgui_renderable(m_ptr_stats.get());
+  m_ptr_renderer->set_imgui_caching(options.ui_cache);
+  m_ptr_renderer->set_draw_per_instance(options.draw_per_instance || options.bench_submission);
+
+  // The submission benchmark renders frame_count frames per record thread count, from one thread up to all of them
+  const u32 bench_frame_count = options.frame_count > 0 ? options.frame_count : 200;
+  u32 bench_thread_count = 1;
+  u32 bench_frame = 0;
+  f64 bench_record_time_ms = 0.0;
+  if (options.bench_submission)
+  {
+    options.frame_count = 0;
+    m_ptr_renderer->set_record_thread_count(bench_thread_count);
+  }
+
+  // The packed assets next to the executable are mounted if there are any; an archive given on the command line is
+  // streamed in completely
+  AssetArchive archive;
+  const std::string default_archive_path = std::string{ get_base_path() } + "Assets.zvpak";
+  if (archive.open(options.archive_path ? options.archive_path : default_archive_path.c_str()))
+  {
+    m_ptr_renderer->get_streaming().set_archive(&archive);
+  }
+  else if (options.archive_path)
+  {
+    ZV_WARNING("Failed to open the asset archive '{}'.", options.archive_path);
+  }
+
+  std::vector<StreamHandle> stream_handles;
+  if (options.archive_path && archive.is_open())
+  {
+    request_stream_archive(m_ptr_renderer->get_streaming(), archive, stream_handles);
+    ZV_INFO("Streaming {} assets from '{}'.", stream_handles.size(), options.archive_path);
+  }
+  if (options.stream_directory)
+  {
+    request_stream_directory(m_ptr_renderer->get_streaming(), options.stream_directory, stream_handles);
+    ZV_INFO("Streaming {} assets from '{}'.", stream_handles.size(), options.stream_directory);
+  }
+
+  const f64 start_time_s = Time::wall_time_s_64();
+  u32 frame_count = 0;
+  std::vector<FrameTime> frame_times;
+  f64 previous_delta_time_s = 0.0;
 
   while (!m_quit)
   {
-    while (SDL_PollEvent(&m_event) != 0)
+    const u64 frame_start_ns = Telemetry::now_ns();
+    m_ptr_perf_counters->begin_frame();
+    const bool input_scope = m_ptr_perf_counters->begin_scope("Input");
+
+    // offscreen runs have no window to take events from, they only replay
+    if (!options.offscreen)
+    {
+      m_ptr_input->pump_events();
+    }
+
+    // A replayed frame is ticked with the recorded delta and sees the recorded input; a captured one is stored as
+    // it was simulated
+    const InputSnapshot* ptr_input = nullptr;
+    if (capture.get_mode() == eCaptureMode::Replay)
+    {
+      f64 delta_time_s;
+      const InputEvent* ptr_events;
+      u32 event_count;
+      if (!capture.read_frame(delta_time_s, ptr_events, event_count))
+      {
+        break;
+      }
+      Time::Clock::tick(delta_time_s);
+      ptr_input = &m_ptr_input->update(ptr_events, event_count);
+    }
+    else
+    {
+      Time::Clock::tick();
+      ptr_input = &m_ptr_input->update();
+      if (capture.get_mode() == eCaptureMode::Record)
+      {
+        capture.write_frame(Time::delta_time_s_64(), m_ptr_input->get_frame_events());
+      }
+    }
+    if (ptr_input->quit_requested || ptr_input->was_pressed(quit_action))
+    {
+      m_quit = true;
+    }
+    if (input_scope)
     {
-      ImGui_ImplSDL2_ProcessEvent(&m_event);
- 
-      if (m_event.type == SDL_QUIT)
+      m_ptr_perf_counters->end_scope();
+    }
+
+    m_ptr_stats->update();
+
+    m_ptr_renderer->update();
+    m_ptr_perf_counters->end_frame();
+    m_ptr_stats->set_draw_stats(m_ptr_renderer->get_draw_stats());
+    m_ptr_stats->set_gpu_stats(m_ptr_renderer->get_gpu_frame_stats(), m_ptr_renderer->is_gpu_timing_supported());
+    m_ptr_stats->set_context_counters(m_ptr_renderer->get_context_counters());
+    m_ptr_stats->set_cpu_counters(m_ptr_perf_counters->get_frame_stats(), m_ptr_perf_counters->is_supported());
+    m_ptr_stats->set_imgui_frame_stats(m_ptr_renderer->get_imgui_frame_stats());
+    anomaly_detector.end_frame(m_ptr_perf_counters->get_frame_stats(), m_ptr_renderer->get_gpu_frame_stats());
+    frame_telemetry.publish(frame_start_ns, m_ptr_perf_counters->get_frame_stats(), m_ptr_renderer->get_gpu_frame_stats(), m_ptr_renderer->get_draw_stats(),
+                            m_ptr_renderer->get_streaming().get_frame_stats(), renderer_params.stream_residency_budget_bytes);
+
+    if (!stream_handles.empty())
+    {
+      const StreamingSystem& streaming = m_ptr_renderer->get_streaming();
+      const bool done = std::all_of(stream_handles.begin(), stream_handles.end(), [&streaming](StreamHandle handle)
       {
-        m_quit = true;
+        return streaming.get_state(handle) == eStreamState::Resident || streaming.get_state(handle) == eStreamState::Failed;
+      });
+      if (done)
+      {
+        ZV_INFO("Streamed {} assets in {} frames, {:.3f} s.", stream_handles.size(), frame_count + 1, Time::wall_time_s_64() - start_time_s);
+        stream_handles.clear();
       }
+    }
+
+    // a tick measures the frame before it, the first one the startup
+    if (options.frame_times_path && frame_count > 0)
+    {
+      frame_times.push_back(FrameTime{ static_cast<f32>(previous_delta_time_s * 1000.0), static_cast<f32>(Time::frame_time_s_64() * 1000.0) });
+    }
+    previous_delta_time_s = Time::delta_time_s_64();
 
-      if (m_event.type == SDL_KEYDOWN)
+    if (++frame_count == options.frame_count)
+    {
+      m_quit = true;
+    }
+
+    if (options.bench_submission)
+    {
+      bench_record_time_ms += m_ptr_renderer->get_record_time_ms();
+      if (++bench_frame == bench_frame_count)
       {
-        if (m_event.key.keysym.sym == SDLK_ESCAPE)
+        ZV_INFO("Draw submission with {} record threads: {:.3f} ms per frame.", bench_thread_count, bench_record_time_ms / bench_frame_count);
+
+        bench_frame = 0;
+        bench_record_time_ms = 0.0;
+        if (++bench_thread_count > m_ptr_renderer->get_max_record_thread_count())
         {
           m_quit = true;
         }
+        m_ptr_renderer->set_record_thread_count(bench_thread_count);
       }
     }
+  }
 
-    Time::Clock::tick();
-
-    m_ptr_stats->update();
-
-    m_ptr_renderer->update();
+  const f64 run_time_s = Time::wall_time_s_64() - start_time_s;
+  ZV_INFO("Rendered {} frames in {:.3f} s, {:.3f} ms per frame.", frame_count, run_time_s, run_time_s * 1000.0 / frame_count);
+  if (options.frame_times_path)
+  {
+    write_frame_times(options.frame_times_path, frame_times);
   }
 
+  Telemetry::destroy();
+  anomaly_detector.destroy();
+  capture.destroy();
+  m_ptr_renderer->set_perf_counters(nullptr);
+  m_ptr_perf_counters->destroy();
+  m_ptr_input->destroy();
   m_ptr_renderer->destroy();
-  m_ptr_window->destroy();
+  if (!options.offscreen)
+  {
+    m_ptr_window->destroy();
+  }
 
+  Jobs::destroy();
   Logger::destroy();
   Time::Clock::destroy();
 
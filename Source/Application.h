@@ -12,6 +12,8 @@ namespace zv
   class Window;
   class Renderer;
   class Stats;
+  class InputSystem;
+  class PerfCounters;
 }
 
 namespace zv
@@ -23,7 +25,29 @@ namespace zv
     ~Application();
 
   public:
-    s32 run();
+    // Command line options:
+    //   --device=vulkan|d3d11|d3d12   render device, defaults to D3D12 on Windows and Vulkan elsewhere
+    //   --offscreen                   render into a texture without window and swap chain
+    //   --size=<width>x<height>       window or offscreen target size
+    //   --frames=<count>              quit after count frames and log the average frame time
+    //   --record-threads=<count>      deferred contexts recording the scene draws, defaults to the job thread count
+    //   --draw-per-instance           one draw call per instance instead of one instanced draw
+    //   --bench-submission            measure draw recording with 1 to all record threads, --frames frames each
+    //   --no-pipeline-cache           compile all shaders and pipelines instead of loading them from <base path>/Cache
+    //   --no-ui-cache                 rebuild the UI every frame instead of on input and at the refresh rate of its panels
+    //   --stream=<directory>          stream all textures and .zvmesh meshes below the directory in the background
+    //   --archive=<file>              mount an asset archive built by zv_pack instead of <base path>/Assets.zvpak and
+    //                                 stream all of its textures and meshes
+    //   --capture=<file>              write the delta time and input events of every frame and the random seed to the file
+    //   --replay=<file>               replay a capture instead of live time and input, quit at its end
+    //   --replay-paced                replay at the recorded frame rate instead of as fast as possible
+    //   --frame-times=<file>          write the delta and measured time of every frame as CSV and log their distribution
+    //   --hitch-threshold=<MADs>      frames slower than the median by this many scaled MADs write a trace of the frames
+    //                                 before them to <base path>/Traces, defaults to 8, 0 disables the detector
+    //   --hitch-history=<frames>      frames in such a trace, defaults to 120
+    //   --telemetry=<address>         stream frame counters and profiler scopes to zv_telemetry clients on
+    //                                 unix:<path> or tcp:<port>
+    s32 run(s32 argc, char* argv[]);
 
     static const char* get_base_path() { return SDL_GetBasePath(); }
 
@@ -31,8 +55,9 @@ namespace zv
     std::unique_ptr<Window> m_ptr_window{ nullptr };
     std::unique_ptr<Renderer> m_ptr_renderer{ nullptr };
     std::unique_ptr<Stats> m_ptr_stats{ nullptr };
+    std::unique_ptr<InputSystem> m_ptr_input{ nullptr };
+    std::unique_ptr<PerfCounters> m_ptr_perf_counters{ nullptr };
 
     bool m_quit{ false };
-    SDL_Event m_event;
   };
 }
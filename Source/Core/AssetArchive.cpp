@@ -0,0 +1,156 @@
+/*
+ * AssetArchive.cpp - packed asset archive with a sorted hash index and zero-copy reads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/AssetArchive.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if ZV_ARCHIVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+u64 zv::hash_archive_path(const char* path)
+{
+  // "./a\b" and "a/b" are the same asset
+  while (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+  {
+    path += 2;
+  }
+
+  u64 hash = k_fnv1a_offset_basis;
+  for (; *path != '\0'; ++path)
+  {
+    const char c = *path == '\\' ? '/' : *path;
+    hash = (hash ^ static_cast<u8>(c)) * k_fnv1a_prime;
+  }
+  return hash;
+}
+
+bool zv::is_archive_compression_supported(eArchiveCompression compression)
+{
+  switch (compression)
+  {
+    case eArchiveCompression::None: return true;
+#if ZV_ARCHIVE_ZSTD
+    case eArchiveCompression::Zstd: return true;
+#endif
+    default:                        return false;
+  }
+}
+
+bool zv::AssetArchive::open(const char* path)
+{
+  close();
+
+  if (!m_file.open(path) || m_file.get_size() < sizeof(ArchiveHeader))
+  {
+    close();
+    return false;
+  }
+
+  ArchiveHeader header;
+  std::memcpy(&header, m_file.get_data(), sizeof(ArchiveHeader));
+  const u64 index_end = header.index_offset + u64(header.entry_count) * sizeof(ArchiveEntry);
+  if (header.magic != k_archive_magic || header.version != k_archive_version || index_end > m_file.get_size() ||
+      header.strings_offset > m_file.get_size() || header.index_offset % alignof(ArchiveEntry) != 0)
+  {
+    close();
+    return false;
+  }
+
+  m_ptr_entries = reinterpret_cast<const ArchiveEntry*>(m_file.get_data() + header.index_offset);
+  m_entry_count = header.entry_count;
+  m_ptr_strings = reinterpret_cast<const char*>(m_file.get_data() + header.strings_offset);
+
+  for (u32 i = 0; i < m_entry_count; ++i)
+  {
+    const ArchiveEntry& entry = m_ptr_entries[i];
+    if (entry.offset + entry.stored_size > m_file.get_size() || header.strings_offset + entry.path_offset + entry.path_length > m_file.get_size())
+    {
+      close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void zv::AssetArchive::close()
+{
+  m_file.close();
+  m_ptr_entries = nullptr;
+  m_entry_count = 0;
+  m_ptr_strings = nullptr;
+}
+
+const zv::ArchiveEntry* zv::AssetArchive::find(const char* path) const
+{
+  return find(hash_archive_path(path));
+}
+
+const zv::ArchiveEntry* zv::AssetArchive::find(u64 path_hash) const
+{
+  const ArchiveEntry* ptr_end = m_ptr_entries + m_entry_count;
+  const ArchiveEntry* ptr_entry = std::lower_bound(m_ptr_entries, ptr_end, path_hash, [](const ArchiveEntry& entry, u64 hash)
+  {
+    return entry.path_hash < hash;
+  });
+  return ptr_entry != ptr_end && ptr_entry->path_hash == path_hash ? ptr_entry : nullptr;
+}
+
+const u8* zv::AssetArchive::get_data(const ArchiveEntry& entry) const
+{
+  return entry.compression == eArchiveCompression::None ? m_file.get_data() + entry.offset : nullptr;
+}
+
+bool zv::AssetArchive::read(const ArchiveEntry& entry, std::vector<u8>& out_data) const
+{
+  const u8* ptr_stored = m_file.get_data() + entry.offset;
+  out_data.resize(entry.size);
+
+  if (entry.compression == eArchiveCompression::None)
+  {
+    std::memcpy(out_data.data(), ptr_stored, entry.size);
+    return true;
+  }
+
+#if ZV_ARCHIVE_ZSTD
+  if (entry.compression == eArchiveCompression::Zstd)
+  {
+    const u64 block_count = (entry.size + k_archive_block_size - 1) / k_archive_block_size;
+    if (block_count * sizeof(u32) > entry.stored_size)
+    {
+      return false;
+    }
+
+    const u8* ptr_block = ptr_stored + block_count * sizeof(u32);
+    const u8* ptr_stored_end = ptr_stored + entry.stored_size;
+    for (u64 block = 0; block < block_count; ++block)
+    {
+      u32 compressed_size;
+      std::memcpy(&compressed_size, ptr_stored + block * sizeof(u32), sizeof(u32));
+
+      const u64 dst_offset = block * k_archive_block_size;
+      const u64 dst_size = std::min(k_archive_block_size, entry.size - dst_offset);
+      if (ptr_block + compressed_size > ptr_stored_end ||
+          ZSTD_decompress(out_data.data() + dst_offset, dst_size, ptr_block, compressed_size) != dst_size)
+      {
+        return false;
+      }
+      ptr_block += compressed_size;
+    }
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+std::string zv::AssetArchive::get_entry_path(const ArchiveEntry& entry) const
+{
+  return std::string{ m_ptr_strings + entry.path_offset, entry.path_length };
+}
@@ -0,0 +1,98 @@
+/*
+ * AssetArchive.h - packed asset archive with a sorted hash index and zero-copy reads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Core/MappedFile.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  // Archive layout, all offsets from the start of the file:
+  //   ArchiveHeader
+  //   blobs, each aligned to k_archive_alignment
+  //   ArchiveEntry[entry_count], sorted by path hash
+  //   path strings, referenced by the entries
+  //
+  // Uncompressed blobs are the asset files as they are. Compressed blobs start with a u32 per block holding its
+  // compressed size, followed by the blocks; every block decompresses to k_archive_block_size bytes (the last one
+  // to the rest), so blocks can be decompressed independently.
+  constexpr u32 k_archive_magic = 0x4B50565A; // "ZVPK"
+  constexpr u32 k_archive_version = 1;
+  // page size, so mapped blobs can be handed to the GPU upload paths without realignment
+  constexpr u64 k_archive_alignment = 4096;
+  constexpr u64 k_archive_block_size = 64ull << 10;
+
+  enum class eArchiveCompression : u32
+  {
+    None,
+    Zstd,
+  };
+
+  struct ArchiveHeader
+  {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+    u64 index_offset;
+    u64 strings_offset;
+  };
+
+  struct ArchiveEntry
+  {
+    u64 path_hash;
+    u64 offset;
+    // bytes in the archive, including the block table of compressed blobs
+    u64 stored_size;
+    u64 size;
+    eArchiveCompression compression;
+    u32 path_offset;
+    u32 path_length;
+    u32 reserved;
+  };
+
+  // paths are stored relative to the packed directory with forward slashes; lookups normalize the same way
+  u64 hash_archive_path(const char* path);
+
+  // whether this build can decompress the given compression
+  bool is_archive_compression_supported(eArchiveCompression compression);
+
+  // Maps an archive and looks assets up by path through a binary search over the hash index. Uncompressed assets are
+  // returned as pointers into the mapping, without copies; they stay valid until the archive is closed.
+  class AssetArchive : public NonCopyable
+  {
+  public:
+    bool open(const char* path);
+    void close();
+    bool is_open() const { return m_file.is_open(); }
+
+    // null if the archive has no asset at path
+    const ArchiveEntry* find(const char* path) const;
+    const ArchiveEntry* find(u64 path_hash) const;
+
+    // mapped data of an uncompressed entry, null for compressed ones
+    const u8* get_data(const ArchiveEntry& entry) const;
+    // decompresses (or copies) the entry; may be called from any thread
+    bool read(const ArchiveEntry& entry, std::vector<u8>& out_data) const;
+
+    u32 get_entry_count() const { return m_entry_count; }
+    const ArchiveEntry& get_entry(u32 index) const { return m_ptr_entries[index]; }
+    std::string get_entry_path(const ArchiveEntry& entry) const;
+
+    // faults the entry's pages in, e.g. on an I/O thread before a worker reads it
+    void prefetch(const ArchiveEntry& entry) const { m_file.prefetch(entry.offset, entry.stored_size); }
+
+  private:
+    MappedFile m_file;
+    const ArchiveEntry* m_ptr_entries{ nullptr };
+    u32 m_entry_count{ 0 };
+    const char* m_ptr_strings{ nullptr };
+  };
+}
@@ -0,0 +1,100 @@
+/*
+ * Guid.cpp - 128-bit globally unique identifiers
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/Guid.h>
+
+#include <random>
+
+
+namespace
+{
+  s32 hex_digit_value(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+}
+
+zv::Guid zv::Guid::generate()
+{
+  // one engine per thread, seeded once from the OS entropy source
+  thread_local std::mt19937_64 engine{ (u64(std::random_device{}()) << 32) ^ std::random_device{}() };
+
+  Guid guid;
+  guid.high = engine();
+  guid.low = engine();
+  // version 4, variant 1
+  guid.high = (guid.high & ~0xF000ull) | 0x4000ull;
+  guid.low = (guid.low & ~(0xC000ull << 48)) | (0x8000ull << 48);
+  return guid;
+}
+
+bool zv::Guid::parse(const char* str, Guid& out_guid)
+{
+  if (str == nullptr)
+  {
+    return false;
+  }
+
+  const bool braced = *str == '{';
+  str += braced;
+
+  // 32 hex digits with dashes after the 8th, 12th, 16th and 20th
+  u64 halves[2] = { 0, 0 };
+  u32 digit_count = 0;
+  for (; digit_count < 32; ++str)
+  {
+    if (digit_count == 8 || digit_count == 12 || digit_count == 16 || digit_count == 20)
+    {
+      if (*str != '-')
+      {
+        return false;
+      }
+      ++str;
+    }
+
+    const s32 value = hex_digit_value(*str);
+    if (value < 0)
+    {
+      return false;
+    }
+    u64& half = halves[digit_count / 16];
+    half = (half << 4) | u64(value);
+    ++digit_count;
+  }
+
+  if (braced && *str++ != '}')
+  {
+    return false;
+  }
+  if (*str != '\0')
+  {
+    return false;
+  }
+
+  out_guid.high = halves[0];
+  out_guid.low = halves[1];
+  return true;
+}
+
+std::string zv::Guid::to_string() const
+{
+  static const char k_digits[] = "0123456789abcdef";
+
+  std::string str;
+  str.reserve(36);
+  for (u32 i = 0; i < 32; ++i)
+  {
+    if (i == 8 || i == 12 || i == 16 || i == 20)
+    {
+      str.push_back('-');
+    }
+    const u64 half = i < 16 ? high : low;
+    str.push_back(k_digits[(half >> (60 - (i % 16) * 4)) & 0xF]);
+  }
+  return str;
+}
@@ -0,0 +1,39 @@
+/*
+ * Guid.h - 128-bit globally unique identifiers
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  // Random (version 4) GUID, written as the usual 8-4-4-4-12 hex groups. The null GUID is invalid.
+  struct Guid
+  {
+    u64 high{ 0 };
+    u64 low{ 0 };
+
+    // thread-safe
+    static Guid generate();
+    // accepts upper and lower case hex digits, with or without braces; false leaves out_guid unchanged
+    static bool parse(const char* str, Guid& out_guid);
+
+    std::string to_string() const;
+    bool is_valid() const { return high != 0 || low != 0; }
+    // both halves are random already, so folding them is enough to key hash maps
+    u64 get_hash() const { return high ^ (low * 0x9E3779B97F4A7C15ull); }
+
+    bool operator==(const Guid& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const Guid& other) const { return !(*this == other); }
+    bool operator<(const Guid& other) const { return high != other.high ? high < other.high : low < other.low; }
+  };
+
+  struct GuidHash
+  {
+    size_t operator()(const Guid& guid) const { return static_cast<size_t>(guid.get_hash()); }
+  };
+}
@@ -0,0 +1,274 @@
+/*
+ * JobSystem.cpp - worker thread pool for parallel and background work
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/JobSystem.h>
+#include <Core/Logger.h>
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// JobSystem
+//------------------------------------------------------------------------------------------------------------------------------------
+
+// singleton
+namespace { class JobSystem; }
+static JobSystem* s_ptr_job_system = nullptr;
+
+namespace
+{
+class JobSystem
+{
+  struct Job
+  {
+    std::function<void()> fn;
+    zv::Jobs::Counter* ptr_counter;
+  };
+
+  std::vector<std::thread> m_workers;
+  std::deque<Job> m_queue;
+  std::deque<Job> m_background_queue;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cv;
+  u32 m_background_running{ 0 };
+  u32 m_max_background_running{ 1 };
+  bool m_quit{ false };
+
+public:
+  explicit JobSystem(u32 worker_count);
+  ~JobSystem();
+
+  u32 get_thread_count() const { return static_cast<u32>(m_workers.size()) + 1; }
+
+  void submit(std::function<void()> job, zv::Jobs::Counter* ptr_counter, bool background);
+  void wait(zv::Jobs::Counter& counter);
+
+private:
+  bool can_start_background() const { return !m_background_queue.empty() && m_background_running < m_max_background_running; }
+  void worker_main();
+  bool try_execute_one();
+  static void execute(Job& job);
+};
+
+JobSystem::JobSystem(u32 worker_count)
+{
+  m_max_background_running = std::max(worker_count, 2u) - 1;
+  m_workers.reserve(worker_count);
+  for (u32 i = 0; i < worker_count; ++i)
+  {
+    m_workers.emplace_back(&JobSystem::worker_main, this);
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    m_quit = true;
+  }
+  m_queue_cv.notify_all();
+
+  for (std::thread& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+void JobSystem::submit(std::function<void()> job, zv::Jobs::Counter* ptr_counter, bool background)
+{
+  if (ptr_counter)
+  {
+    ptr_counter->value.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    (background ? m_background_queue : m_queue).push_back(Job{ std::move(job), ptr_counter });
+  }
+  m_queue_cv.notify_one();
+}
+
+void JobSystem::wait(zv::Jobs::Counter& counter)
+{
+  while (!counter.is_done())
+  {
+    if (!try_execute_one())
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::worker_main()
+{
+  for (;;)
+  {
+    Job job;
+    bool background = false;
+    {
+      std::unique_lock<std::mutex> lock(m_queue_mutex);
+      m_queue_cv.wait(lock, [this]() { return m_quit || !m_queue.empty() || can_start_background(); });
+      if (!m_queue.empty())
+      {
+        job = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      else if (can_start_background())
+      {
+        job = std::move(m_background_queue.front());
+        m_background_queue.pop_front();
+        ++m_background_running;
+        background = true;
+      }
+      else
+      {
+        // quitting; background jobs that are left go to the workers that are still running them
+        return;
+      }
+    }
+    execute(job);
+
+    if (background)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        --m_background_running;
+      }
+      m_queue_cv.notify_one();
+    }
+  }
+}
+
+bool JobSystem::try_execute_one()
+{
+  Job job;
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    if (m_queue.empty())
+    {
+      return false;
+    }
+    job = std::move(m_queue.front());
+    m_queue.pop_front();
+  }
+  execute(job);
+  return true;
+}
+
+void JobSystem::execute(Job& job)
+{
+  job.fn();
+  if (job.ptr_counter)
+  {
+    job.ptr_counter->value.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Jobs interface
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void zv::Jobs::create(u32 worker_count)
+{
+  if (s_ptr_job_system)
+  {
+    return;
+  }
+
+  if (worker_count == 0)
+  {
+    const u32 hardware_threads = std::thread::hardware_concurrency();
+    worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+  }
+
+  s_ptr_job_system = new ::JobSystem(worker_count);
+}
+
+void zv::Jobs::destroy()
+{
+  delete s_ptr_job_system;
+  s_ptr_job_system = nullptr;
+}
+
+u32 zv::Jobs::get_thread_count()
+{
+  return s_ptr_job_system ? s_ptr_job_system->get_thread_count() : 1;
+}
+
+void zv::Jobs::submit(std::function<void()> job, Counter* ptr_counter)
+{
+  if (!s_ptr_job_system)
+  {
+    job();
+    return;
+  }
+
+  s_ptr_job_system->submit(std::move(job), ptr_counter, false);
+}
+
+void zv::Jobs::submit_background(std::function<void()> job, Counter* ptr_counter)
+{
+  if (!s_ptr_job_system)
+  {
+    job();
+    return;
+  }
+
+  s_ptr_job_system->submit(std::move(job), ptr_counter, true);
+}
+
+void zv::Jobs::wait(Counter& counter)
+{
+  if (s_ptr_job_system)
+  {
+    s_ptr_job_system->wait(counter);
+  }
+  ZV_ASSERT(counter.is_done());
+}
+
+void zv::Jobs::parallel_for(u32 count, u32 grain_size, const std::function<void(u32 begin, u32 end)>& fn)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  grain_size = std::max(grain_size, 1u);
+  const u32 chunk_count = (count + grain_size - 1) / grain_size;
+  const u32 thread_count = get_thread_count();
+
+  if (chunk_count == 1 || thread_count == 1)
+  {
+    fn(0, count);
+    return;
+  }
+
+  // every participating thread pulls chunks from a shared index until all are taken
+  std::atomic<u32> next_chunk{ 0 };
+  auto run_chunks = [&]()
+  {
+    for (u32 chunk = next_chunk.fetch_add(1, std::memory_order_relaxed); chunk < chunk_count;
+         chunk = next_chunk.fetch_add(1, std::memory_order_relaxed))
+    {
+      const u32 begin = chunk * grain_size;
+      fn(begin, std::min(begin + grain_size, count));
+    }
+  };
+
+  Counter counter;
+  const u32 helper_count = std::min(chunk_count, thread_count) - 1;
+  for (u32 i = 0; i < helper_count; ++i)
+  {
+    s_ptr_job_system->submit(run_chunks, &counter, false);
+  }
+
+  run_chunks();
+  s_ptr_job_system->wait(counter);
+}
@@ -0,0 +1,49 @@
+/*
+ * JobSystem.h - worker thread pool for parallel and background work
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  namespace Jobs
+  {
+    // Counts outstanding jobs; a job submitted with a counter decrements it when it finishes
+    struct Counter
+    {
+      std::atomic<u32> value{ 0 };
+
+      bool is_done() const { return value.load(std::memory_order_acquire) == 0; }
+    };
+
+    // construction; must be called at the beginning and end of the program
+    // worker_count 0 uses one worker per hardware thread minus the calling thread
+    void create(u32 worker_count = 0);
+    void destroy();
+
+    // number of threads that execute jobs, including the calling thread
+    u32 get_thread_count();
+
+    // queues a job for this frame's work; counter may be null for fire-and-forget work
+    void submit(std::function<void()> job, Counter* ptr_counter = nullptr);
+    // Queues long-running work like decoding or compiling. Workers take frame jobs first and at most all but one of them
+    // run background jobs at a time, so frame work always finds a free worker; wait() never executes background jobs.
+    void submit_background(std::function<void()> job, Counter* ptr_counter = nullptr);
+
+    // blocks until the counter reaches zero; the calling thread executes queued frame jobs while it waits, background
+    // jobs are left to the workers
+    void wait(Counter& counter);
+
+    // calls fn(begin, end) for chunks of [0, count) with at least grain_size items per chunk and returns when all chunks
+    // are done; the calling thread takes part in the work, so this may be called from within a job. The chunks are frame
+    // jobs, queued background work neither delays them nor runs on the calling thread.
+    // runs inline when the job system has not been created
+    void parallel_for(u32 count, u32 grain_size, const std::function<void(u32 begin, u32 end)>& fn);
+  }
+}
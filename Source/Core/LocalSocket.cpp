@@ -0,0 +1,321 @@
+/*
+ * LocalSocket.cpp - stream sockets on the local machine, Unix domain or loopback TCP
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/LocalSocket.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#if OS_WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  enum class eAddressKind : u8
+  {
+    Unix,
+    Tcp,
+  };
+
+  struct Address
+  {
+    eAddressKind kind;
+    const char* ptr_path;
+    u16 port;
+  };
+
+  bool parse_address(const char* address, Address& out_address)
+  {
+    u32 port = 0;
+    if (std::strncmp(address, "unix:", 5) == 0 && address[5] != '\0')
+    {
+      out_address = Address{ eAddressKind::Unix, address + 5, 0 };
+      return true;
+    }
+    if (std::sscanf(address, "tcp:%u", &port) == 1 && port > 0 && port <= 0xffff)
+    {
+      out_address = Address{ eAddressKind::Tcp, nullptr, static_cast<u16>(port) };
+      return true;
+    }
+    return false;
+  }
+
+#if OS_WINDOWS
+  bool startup()
+  {
+    // the reference count of WSAStartup is never released, it lives as long as the process
+    static const bool s_started = []()
+    {
+      WSADATA data;
+      return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return s_started;
+  }
+
+  bool would_block()
+  {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+  }
+#else
+  bool startup()
+  {
+    return true;
+  }
+
+  bool would_block()
+  {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+#endif
+
+  sockaddr_in make_loopback_address(u16 port)
+  {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+  }
+}
+
+zv::LocalSocket::~LocalSocket()
+{
+  close();
+}
+
+zv::LocalSocket::LocalSocket(LocalSocket&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+zv::LocalSocket& zv::LocalSocket::operator=(LocalSocket&& other) noexcept
+{
+  if (this != &other)
+  {
+    std::swap(m_handle, other.m_handle);
+    std::swap(m_unix_path, other.m_unix_path);
+  }
+  return *this;
+}
+
+bool zv::LocalSocket::listen(const char* address)
+{
+  close();
+
+  Address parsed;
+  if (!parse_address(address, parsed) || !startup())
+  {
+    return false;
+  }
+
+  if (parsed.kind == eAddressKind::Tcp)
+  {
+    m_handle = static_cast<Handle>(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (!is_open())
+    {
+      return false;
+    }
+
+    // a restarted server must not wait for the connections of the previous one to time out
+    const int reuse = 1;
+    setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    const sockaddr_in socket_address = make_loopback_address(parsed.port);
+    if (::bind(m_handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0 || ::listen(m_handle, 4) != 0)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+#if OS_WINDOWS
+  return false;
+#else
+  sockaddr_un socket_address{};
+  socket_address.sun_family = AF_UNIX;
+  if (std::strlen(parsed.ptr_path) >= sizeof(socket_address.sun_path))
+  {
+    return false;
+  }
+  std::strcpy(socket_address.sun_path, parsed.ptr_path);
+
+  m_handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (!is_open())
+  {
+    return false;
+  }
+
+  ::unlink(parsed.ptr_path);
+  if (::bind(m_handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0 || ::listen(m_handle, 4) != 0)
+  {
+    close();
+    return false;
+  }
+  std::strcpy(m_unix_path, parsed.ptr_path);
+  return true;
+#endif
+}
+
+bool zv::LocalSocket::connect(const char* address)
+{
+  close();
+
+  Address parsed;
+  if (!parse_address(address, parsed) || !startup())
+  {
+    return false;
+  }
+
+  if (parsed.kind == eAddressKind::Tcp)
+  {
+    m_handle = static_cast<Handle>(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    const sockaddr_in socket_address = make_loopback_address(parsed.port);
+    if (!is_open() || ::connect(m_handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+#if OS_WINDOWS
+  return false;
+#else
+  sockaddr_un socket_address{};
+  socket_address.sun_family = AF_UNIX;
+  if (std::strlen(parsed.ptr_path) >= sizeof(socket_address.sun_path))
+  {
+    return false;
+  }
+  std::strcpy(socket_address.sun_path, parsed.ptr_path);
+
+  m_handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (!is_open() || ::connect(m_handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0)
+  {
+    close();
+    return false;
+  }
+  return true;
+#endif
+}
+
+bool zv::LocalSocket::accept(LocalSocket& out_socket)
+{
+  out_socket.close();
+  if (!is_open())
+  {
+    return false;
+  }
+
+  const Handle handle = static_cast<Handle>(::accept(m_handle, nullptr, nullptr));
+  if (handle == k_invalid_handle)
+  {
+    return false;
+  }
+  out_socket.m_handle = handle;
+
+  // small writes go out right away; fails harmlessly on Unix domain sockets
+  const int no_delay = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+#if OS_MAC
+  // a client that goes away must not kill the server with SIGPIPE, Linux passes MSG_NOSIGNAL to send() instead
+  const int no_sigpipe = 1;
+  setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+  return true;
+}
+
+void zv::LocalSocket::close()
+{
+  if (!is_open())
+  {
+    return;
+  }
+
+#if OS_WINDOWS
+  ::closesocket(m_handle);
+#else
+  ::close(m_handle);
+  if (m_unix_path[0] != '\0')
+  {
+    ::unlink(m_unix_path);
+  }
+#endif
+  m_handle = k_invalid_handle;
+  m_unix_path[0] = '\0';
+}
+
+bool zv::LocalSocket::set_blocking(bool blocking)
+{
+  if (!is_open())
+  {
+    return false;
+  }
+
+#if OS_WINDOWS
+  u_long non_blocking = blocking ? 0 : 1;
+  return ioctlsocket(m_handle, FIONBIO, &non_blocking) == 0;
+#else
+  const int flags = fcntl(m_handle, F_GETFL, 0);
+  return flags >= 0 && fcntl(m_handle, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK) == 0;
+#endif
+}
+
+s64 zv::LocalSocket::send(const void* ptr_data, u64 size)
+{
+  if (!is_open())
+  {
+    return -1;
+  }
+
+#if OS_WINDOWS
+  const int result = ::send(m_handle, static_cast<const char*>(ptr_data), static_cast<int>(std::min<u64>(size, 1u << 30)), 0);
+#elif OS_LINUX
+  const ssize_t result = ::send(m_handle, ptr_data, size, MSG_NOSIGNAL);
+#else
+  const ssize_t result = ::send(m_handle, ptr_data, size, 0);
+#endif
+  if (result < 0)
+  {
+    return would_block() ? 0 : -1;
+  }
+  return static_cast<s64>(result);
+}
+
+s64 zv::LocalSocket::receive(void* ptr_data, u64 size)
+{
+  if (!is_open())
+  {
+    return -1;
+  }
+
+#if OS_WINDOWS
+  const int result = ::recv(m_handle, static_cast<char*>(ptr_data), static_cast<int>(std::min<u64>(size, 1u << 30)), 0);
+#else
+  const ssize_t result = ::recv(m_handle, ptr_data, size, 0);
+#endif
+  if (result < 0)
+  {
+    return would_block() ? 0 : -1;
+  }
+  // an orderly shutdown of the other side
+  if (result == 0)
+  {
+    return -1;
+  }
+  return static_cast<s64>(result);
+}
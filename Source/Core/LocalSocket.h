@@ -0,0 +1,54 @@
+/*
+ * LocalSocket.h - stream sockets on the local machine, Unix domain or loopback TCP
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PlatformContext.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  // Addresses are "unix:<path>" for a Unix domain socket, not available on Windows, or "tcp:<port>" for TCP on
+  // 127.0.0.1; other hosts cannot connect to either.
+  class LocalSocket : public NonCopyable
+  {
+  public:
+    LocalSocket() = default;
+    ~LocalSocket();
+
+    LocalSocket(LocalSocket&& other) noexcept;
+    LocalSocket& operator=(LocalSocket&& other) noexcept;
+
+  public:
+    // a stale Unix domain socket file of a previous run is replaced
+    bool listen(const char* address);
+    bool connect(const char* address);
+    // fails without a pending connection if the socket does not block
+    bool accept(LocalSocket& out_socket);
+    void close();
+
+    bool set_blocking(bool blocking);
+    bool is_open() const { return m_handle != k_invalid_handle; }
+
+    // Bytes sent or received, 0 if a non-blocking socket would block, -1 on errors and once the other side closed the
+    // connection
+    s64 send(const void* ptr_data, u64 size);
+    s64 receive(void* ptr_data, u64 size);
+
+  private:
+#if OS_WINDOWS
+    using Handle = u64;
+    static constexpr Handle k_invalid_handle = ~0ull;
+#else
+    using Handle = s32;
+    static constexpr Handle k_invalid_handle = -1;
+#endif
+
+    Handle m_handle{ k_invalid_handle };
+    // unlinked on close() by the listening side
+    char m_unix_path[108]{};
+  };
+}
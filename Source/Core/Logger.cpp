@@ -5,18 +5,26 @@
 
 #include <Core/Logger.h>
 #include <Core/PlatformContext.h>
+#include <Core/StringBuilder.h>
 #include <Core/Time.h>
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <unordered_map>
 #include <list>
 #include <chrono>
+#include <mutex>
 #include <filesystem>
+#include <fstream>
 
 #if OS_WINDOWS
 #include <windows.h>
 #elif OS_MAC
 #include <cstdio>
 #include <CoreFoundation/CoreFoundation.h>
+#elif OS_LINUX
+#include <csignal>
+#include <Core/Utility.h>
 #endif
 
 #include <ThirdParty/fmt/include/fmt/core.h>
@@ -31,19 +39,28 @@
 // the log filename
 static const char* k_log_filename = "stdout";
 
-// default display flags
+// messages kept for get_history()
+static constexpr u32 k_history_size = 256;
+
+// output of one message, lines up to its inline capacity are formatted without allocating
+using LogBuffer = zv::StringBuilder<512>;
+
+// default display flags; release builds keep errors and warnings for the frame traces and drop everything else
 #ifdef ZV_DEBUG_MODE
-	const unsigned char k_errorflag_default =		(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console);
-	const unsigned char k_warningflag_default =	(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console);
-	const unsigned char k_logflag_default =		  (zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console);
-	const unsigned char k_externflag_default =	(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console);
+	const unsigned char k_errorflag_default =		(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console | zv::k_logflag_keep_in_history);
+	const unsigned char k_warningflag_default =	(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console | zv::k_logflag_keep_in_history);
+	const unsigned char k_logflag_default =		  (zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console | zv::k_logflag_keep_in_history);
+	const unsigned char k_externflag_default =	(zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_console | zv::k_logflag_keep_in_history);
 #else
-	const unsigned char k_errorflag_default =		0;
-	const unsigned char k_warningflag_default =	0;
+	const unsigned char k_errorflag_default =		zv::k_logflag_keep_in_history;
+	const unsigned char k_warningflag_default =	zv::k_logflag_keep_in_history;
 	const unsigned char k_logflag_default =		  0;
 	const unsigned char k_externflag_default =  0;
 #endif
 
+// flags that write the message somewhere, anything else does not need it formatted
+static constexpr unsigned char k_output_flags = zv::k_logflag_write_to_log_file | zv::k_logflag_write_to_debugger | zv::k_logflag_write_to_console;
+
 //------------------------------------------------------------------------------------------------------------------------------------
 // LogMgr
 //------------------------------------------------------------------------------------------------------------------------------------
@@ -67,11 +84,21 @@ public:
 
   struct Tag
   {
-    unsigned char flags;
+    unsigned char flags{ 0 };
     zv::FormatColor color = zv::FormatColor::light_gray;
+    // interned, lives as long as the program
+    const char* name{ nullptr };
   };
 
-	typedef std::map<std::string, Tag> Tags;
+  // the tag is resolved to its name in get_history(), so recording a message copies no tag string
+  struct HistoryRecord
+  {
+    std::chrono::steady_clock::time_point time;
+    zv::StringId tag;
+    std::string message;
+  };
+
+	typedef std::unordered_map<zv::StringId, Tag, zv::StringIdHash> Tags;
 	typedef std::list<zv::internal::ErrorMessenger*> ErrorMessengerList;
 
 	Tags m_tags;
@@ -79,11 +106,21 @@ public:
 
   std::filesystem::path m_log_path{};
   mutable std::ofstream m_log_file;
-	
-  // TODO
-	// // thread safety
-	// CriticalSection m_tag_critical_section;
-	// CriticalSection m_messenger_critical_section;
+
+  // thread safety: the tags are read on every log call and changed rarely; the outputs and the messenger list are
+  // shared by all threads that log
+  std::mutex m_tag_mutex;
+  // one bit per configured tag, picked by the top six bits of the hash that FNV-1a mixes best: a tag whose bit is clear
+  // is not configured and is dropped without locking
+  std::atomic<u64> m_tag_filter{ 0 };
+  std::mutex m_output_mutex;
+  std::mutex m_messenger_mutex;
+
+  // ring of the latest messages; the strings keep their capacity, so it stops allocating once every slot was used
+  std::array<HistoryRecord, k_history_size> m_history;
+  u32 m_history_next_index = 0;
+  u32 m_history_count = 0;
+  std::mutex m_history_mutex;
 
 public:
 	// construction
@@ -94,18 +131,22 @@ public:
   bool create(const char* base_path);
 
 	// logs
-	void log(const std::string& tag, const std::string& message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
+	void log(zv::StringId tag, std::string_view message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
 	void set_tag_config(const std::string& tag, unsigned char flags, zv::FormatColor color = zv::FormatColor::light_gray);
 
 	// error messengers
 	void add_error_messenger(zv::internal::ErrorMessenger* ptr_messenger);
 	LogMgr::eErrorDialogResult error(const std::string& error_message, std::optional<zv::FormatArgs> args, bool is_fatal, const char* func_name, const char* src_file, u32 line_num);
 
+  // history
+  void get_history(std::vector<zv::Logger::LogRecord>& out_records);
+
 private:
+  void add_to_history(zv::StringId tag, std::string_view message);
 	// log helpers
-	void output_final_buffer_to_logs(const std::string& final_buffer, unsigned char flags, zv::FormatColor color);
-	void write_to_log_file(const std::string& data) const;
-	void get_output_buffer(std::string& out_output_buffer, const std::string& tag, const std::string& message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
+	void output_final_buffer_to_logs(LogBuffer& final_buffer, unsigned char flags, zv::FormatColor color);
+	void write_to_log_file(std::string_view data) const;
+	void get_output_buffer(LogBuffer& out_output_buffer, const char* tag, std::string_view message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
 #if OS_WINDOWS
   void enable_virtual_terminal_processing();
 #endif
@@ -126,7 +167,7 @@ LogMgr::LogMgr()
  */
 LogMgr::~LogMgr()
 {
-	// m_messenger_critical_section.lock();  // TODO
+  std::lock_guard<std::mutex> lock{ m_messenger_mutex };
   for (auto it = m_error_messengers.begin(); it != m_error_messengers.end(); ++it)
 	{
 		zv::internal::ErrorMessenger* ptr_messenger = (*it);
@@ -137,8 +178,6 @@ LogMgr::~LogMgr()
   if (m_log_file.is_open()) {
     m_log_file.close();
   }
-
-	// m_messenger_critical_section.unlock();  // TODO
 }
 
 /*
@@ -204,23 +243,37 @@ bool LogMgr::create(const char* base_path)
 /*
  * This function builds up the log string and outputs it to various places based on the display flags (m_displayFlags).
  */
-void LogMgr::log(const std::string& tag, const std::string& message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
+void LogMgr::log(zv::StringId tag, std::string_view message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
 {
-	// m_tag_critical_section.Lock();  // TODO
-	Tags::iterator find_it = m_tags.find(tag);
-	if (find_it != m_tags.end())
+	if ((m_tag_filter.load(std::memory_order_relaxed) & (1ull << (tag.get_hash() >> 58))) == 0)
+	{
+		return;
+	}
+
+	Tag tag_config;
 	{
-		// m_tag_critical_section.Unlock();  // TODO
-		
-		std::string buffer;
-		get_output_buffer(buffer, tag, message, args, func_name, src_file, line_num);
-		output_final_buffer_to_logs(buffer, find_it->second.flags, find_it->second.color);
+		std::lock_guard<std::mutex> lock{ m_tag_mutex };
+		Tags::iterator find_it = m_tags.find(tag);
+		if (find_it == m_tags.end())
+		{
+			return;
+		}
+		tag_config = find_it->second;
+	}
+
+	if ((tag_config.flags & k_output_flags) != 0)
+	{
+		LogBuffer buffer;
+		get_output_buffer(buffer, tag_config.name, message, args, func_name, src_file, line_num);
+		output_final_buffer_to_logs(buffer, tag_config.flags, tag_config.color);
+		if ((tag_config.flags & zv::k_logflag_keep_in_history) != 0)
+		{
+			add_to_history(tag, buffer.get_view());
+		}
 	}
 	else
 	{
-		// Critical section is exited in the if statement above, so we need to exit it here if that didn't 
-		// get executed.
-    // m_tag_critical_section.Unlock();  // TODO
+		add_to_history(tag, message);
 	}
 } 
 
@@ -229,24 +282,23 @@ void LogMgr::log(const std::string& tag, const std::string& message, std::option
  */
 void LogMgr::set_tag_config(const std::string& tag, unsigned char flags, zv::FormatColor color)
 {
-	// m_tag_critical_section.Lock();  // TODO
+	const zv::StringId id = zv::StringId::intern(tag);
+	std::lock_guard<std::mutex> lock{ m_tag_mutex };
 	if (flags != 0)
 	{
-		Tags::iterator find_it = m_tags.find(tag);
-		if (find_it == m_tags.end())
-    {
-			m_tags.insert(std::make_pair(tag, Tag{flags, color}));
-    }
-		else
-    {
-			find_it->second = Tag{flags, color};
-    }
+		m_tags[id] = Tag{flags, color, id.get_string()};
 	}
 	else
 	{
-		m_tags.erase(tag);
+		m_tags.erase(id);
+	}
+
+	u64 filter = 0;
+	for (const auto& [tag_id, tag_config] : m_tags)
+	{
+		filter |= 1ull << (tag_id.get_hash() >> 58);
 	}
-	// m_tag_critical_section.Unlock();  // TODO
+	m_tag_filter.store(filter, std::memory_order_relaxed);
 }
 
 /*
@@ -254,9 +306,8 @@ void LogMgr::set_tag_config(const std::string& tag, unsigned char flags, zv::For
  */
 void LogMgr::add_error_messenger(zv::internal::ErrorMessenger* ptr_messenger)
 {
-	// m_messenger_critical_section.Lock();  // TODO
+	std::lock_guard<std::mutex> lock{ m_messenger_mutex };
 	m_error_messengers.push_back(ptr_messenger);
-	// m_messenger_critical_section.Unlock();  // TODO
 }
 
 /*
@@ -264,24 +315,32 @@ void LogMgr::add_error_messenger(zv::internal::ErrorMessenger* ptr_messenger)
  */
 LogMgr::eErrorDialogResult LogMgr::error(const std::string& error_message, std::optional<zv::FormatArgs> args, bool is_fatal, const char* func_name, const char* src_file, u32 line_num)
 {
-	std::string tag = ((is_fatal) ? ("FATAL") : ("ERROR"));
+	const char* tag_name = ((is_fatal) ? ("FATAL") : ("ERROR"));
+	const zv::StringId tag = ((is_fatal) ? ZV_STRING_ID("FATAL") : ZV_STRING_ID("ERROR"));
 
 	// buffer for our final output string
-	std::string buffer;
-	get_output_buffer(buffer, tag, error_message, args, func_name, src_file, line_num);
+	LogBuffer buffer;
+	get_output_buffer(buffer, tag_name, error_message, args, func_name, src_file, line_num);
 
 	// write the final buffer to all the various logs
-	// m_tag_critical_section.Lock();  // TODO
-	Tags::iterator find_it = m_tags.find(tag);
-	if (find_it != m_tags.end())
+	std::optional<Tag> tag_config;
+	{
+		std::lock_guard<std::mutex> lock{ m_tag_mutex };
+		Tags::iterator find_it = m_tags.find(tag);
+		if (find_it != m_tags.end())
+		{
+			tag_config = find_it->second;
+		}
+	}
+	if (tag_config.has_value())
   {
-		output_final_buffer_to_logs(buffer, find_it->second.flags, find_it->second.color);
+		output_final_buffer_to_logs(buffer, tag_config->flags, tag_config->color);
   }
-	// m_tag_critical_section.Unlock();  // TODO
+  add_to_history(tag, buffer.get_view());
 
   // show the dialog box
 #if OS_WINDOWS
-  int result = ::MessageBoxA(NULL, buffer.c_str(), tag.c_str(), MB_ABORTRETRYIGNORE|MB_ICONERROR|MB_DEFBUTTON3);
+  int result = ::MessageBoxA(NULL, buffer.c_str(), tag_name, MB_ABORTRETRYIGNORE|MB_ICONERROR|MB_DEFBUTTON3);
 
 	// act upon the choice
 	switch (result)
@@ -291,7 +350,7 @@ LogMgr::eErrorDialogResult LogMgr::error(const std::string& error_message, std::
 		case IDRETRY :	return eErrorDialogResult::Retry;
 		default :       return eErrorDialogResult::Retry;
 	}
-#elif OS_MAC:
+#elif OS_MAC
   // TODO: ???
   CFStringRef cfTitle = CFStringCreateWithCString(NULL, title, kCFStringEncodingUTF8);
   CFStringRef cfMessage = CFStringCreateWithCString(NULL, message, kCFStringEncodingUTF8);
@@ -311,23 +370,63 @@ LogMgr::eErrorDialogResult LogMgr::error(const std::string& error_message, std::
   CFRelease(cfMessage);
 
   __builtin_debugtrap();
+#elif OS_LINUX
+  // no dialog, the message already went to the console and the log file; headless runs must not block here
+  if (zv::is_debugger_present())
+  {
+    std::raise(SIGTRAP);
+  }
+  return is_fatal ? eErrorDialogResult::Abort : eErrorDialogResult::Retry;
 #else
 # error "Other OS currently not supported."
 #endif
 }
 
 /*
- * This is a helper function that writes the data string to the log file.
- *
- * IMPORTANT: The two places this function is called from wrap the code in the tag critical section (m_pTagCriticalSection), 
- * so that makes this call thread safe.  If you call this from anywhere else, make sure you wrap it in that critical section.
+ * Copies the latest messages, oldest first.
+ */
+void LogMgr::get_history(std::vector<zv::Logger::LogRecord>& out_records)
+{
+  std::lock_guard<std::mutex> lock{ m_history_mutex };
+  out_records.resize(m_history_count);
+  const u32 first_index = (m_history_next_index + k_history_size - m_history_count) % k_history_size;
+  for (u32 i = 0; i < m_history_count; ++i)
+  {
+    const HistoryRecord& record = m_history[(first_index + i) % k_history_size];
+    // configured tags are interned, the hash is only a fallback
+    const char* tag = record.tag.get_string();
+    out_records[i].time = record.time;
+    out_records[i].tag = tag != nullptr ? tag : fmt::format("{:016x}", record.tag.get_hash());
+    out_records[i].message = record.message;
+  }
+}
+
+/*
+ * Overwrites the oldest message of the history; a trailing newline of output buffers is dropped.
+ */
+void LogMgr::add_to_history(zv::StringId tag, std::string_view message)
+{
+  const size_t length = !message.empty() && message.back() == '\n' ? message.size() - 1 : message.size();
+
+  std::lock_guard<std::mutex> lock{ m_history_mutex };
+  HistoryRecord& record = m_history[m_history_next_index];
+  record.time = std::chrono::steady_clock::now();
+  record.tag = tag;
+  record.message.assign(message.data(), length);
+  m_history_next_index = (m_history_next_index + 1) % k_history_size;
+  m_history_count = std::min(m_history_count + 1, k_history_size);
+}
+
+/*
+ * Writes the formatted message to the outputs in flags; messages of different threads do not interleave.
  */
-void LogMgr::output_final_buffer_to_logs(const std::string& final_buffer, unsigned char flags, zv::FormatColor color)
+void LogMgr::output_final_buffer_to_logs(LogBuffer& final_buffer, unsigned char flags, zv::FormatColor color)
 {
+  std::lock_guard<std::mutex> lock{ m_output_mutex };
 	// Write the log to each display based on the display flags
 	if ((flags & zv::k_logflag_write_to_log_file) > 0)  // log file
   {
-		write_to_log_file(final_buffer);
+		write_to_log_file(final_buffer.get_view());
   }
 	if ((flags & zv::k_logflag_write_to_debugger) > 0)  // debugger output window
   {
@@ -337,64 +436,61 @@ void LogMgr::output_final_buffer_to_logs(const std::string& final_buffer, unsign
   }
   if ((flags & zv::k_logflag_write_to_console) > 0) // console output
   {
-    fmt::print(fmt::fg(color), "{}", final_buffer);
+    fmt::print(fmt::fg(color), "{}", final_buffer.get_view());
   }
 }
 
 /*
  * This is a helper function that writes the data string to the log file.
  */
-void LogMgr::write_to_log_file(const std::string &data) const
+void LogMgr::write_to_log_file(std::string_view data) const
 {
   if (!m_log_file.is_open())
   {
     return; // can't write to the log file for some reason
   }
 
-  m_log_file << data;
+  m_log_file.write(data.data(), static_cast<std::streamsize>(data.size()));
 }
 
 /*
- * Fills out_output_buffer with the find error string.
+ * Formats the final output string into out_output_buffer; the prefix and the message are formatted in place.
  */
-void LogMgr::get_output_buffer(std::string& out_output_buffer, const std::string& tag, const std::string& message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
+void LogMgr::get_output_buffer(LogBuffer& out_output_buffer, const char* tag, std::string_view message, std::optional<zv::FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
 {
-  std::chrono::time_point now = std::chrono::system_clock::now();
-  auto now_in_seconds = std::chrono::time_point_cast<std::chrono::seconds>(now);
-  auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(now - now_in_seconds);
-  const std::string timestamp = fmt::format("{}.{:03}", now_in_seconds, msec.count());
+  if (tag[0] != '\0')
+  {
+    std::chrono::time_point now = std::chrono::system_clock::now();
+    auto now_in_seconds = std::chrono::time_point_cast<std::chrono::seconds>(now);
+    auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(now - now_in_seconds);
+    out_output_buffer.format("[{}][{}.{:03}] ", tag, now_in_seconds, msec.count());
+  }
 
   if (args.has_value())
   {
-    const std::string formatted = vformat(message, args.value());
-    out_output_buffer = tag.empty() ? formatted : "[" + tag + "][" + timestamp + "] " + formatted;
+    out_output_buffer.vformat(message, args.value());
   }
   else
   {
-		out_output_buffer = tag.empty() ? message : "[" + tag + "][" + timestamp + "] " + message;
+		out_output_buffer.append(message);
   }
 
 	if (func_name != NULL)
 	{
-		out_output_buffer += "\nFunction: ";
-		out_output_buffer += func_name;
+		out_output_buffer.append("\nFunction: ").append(func_name);
 	}
 
 	if (src_file != NULL)
 	{
-		out_output_buffer += "\n";
-		out_output_buffer += src_file;
+		out_output_buffer.append('\n').append(src_file);
 	}
 
 	if (line_num != 0)
 	{
-		out_output_buffer += "\nLine: ";
-    char line_numBuffer[11];
-    memset(line_numBuffer, 0, sizeof(char));
-    out_output_buffer += _itoa(line_num, line_numBuffer, 10);
+		out_output_buffer.format("\nLine: {}", line_num);
 	}
 
-  out_output_buffer += "\n";
+  out_output_buffer.append('\n');
 }
 
 #if OS_WINDOWS
@@ -465,7 +561,7 @@ void zv::Logger::destroy(void)
 // Logger
 //------------------------------------------------------------------------------------------------------------------------------------
 
-void zv::Logger::log(const std::string& tag, const std::string& message, std::optional<FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
+void zv::Logger::log(StringId tag, std::string_view message, std::optional<FormatArgs> args, const char* func_name, const char* src_file, u32 line_num)
 {
   ZV_ASSERT(s_ptr_log_mgr);
   s_ptr_log_mgr->log(tag, message, args, func_name, src_file, line_num);
@@ -476,3 +572,9 @@ void zv::Logger::set_tag_config(const std::string &tag, unsigned char flags, zv:
 	ZV_ASSERT(s_ptr_log_mgr);
 	s_ptr_log_mgr->set_tag_config(tag, flags, color);
 }
+
+void zv::Logger::get_history(std::vector<LogRecord>& out_records)
+{
+  ZV_ASSERT(s_ptr_log_mgr);
+  s_ptr_log_mgr->get_history(out_records);
+}
@@ -5,12 +5,17 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <vector>
 
 #include <Config.h>
 #include <Core/Format.h>
 #include <Core/PrimitiveTypes.h>
+#include <Core/StringId.h>
 
 namespace zv
 {
@@ -22,6 +27,8 @@ namespace zv
   const unsigned char k_logflag_write_to_log_file =		1 << 0;
   const unsigned char k_logflag_write_to_debugger =		1 << 1;
   const unsigned char k_logflag_write_to_console =		1 << 2;
+  // keeps the tag's messages for get_history(), also if they are not written anywhere
+  const unsigned char k_logflag_keep_in_history =		1 << 3;
 
   //---------------------------------------------------------------------------------------------------------------------
   // ErrorMessenger
@@ -32,7 +39,8 @@ namespace zv
     // This class is used by the debug macros and shouldn't be accessed externally.
     class ErrorMessenger
     {
-      bool m_enabled;
+      // the call site may be reached from several threads
+      std::atomic<bool> m_enabled;
 
     public:
       ErrorMessenger();
@@ -50,9 +58,22 @@ namespace zv
     bool create(const char* base_path);
     void destroy();
     
-    // logging functions
-    void log(const std::string& tag, const std::string& message, std::optional<FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
+    // logging functions; tags are looked up by id, only tags given to set_tag_config() are written or kept anywhere, a
+    // message of any other tag costs one lookup. All of them may be called from any thread, messages are formatted
+    // outside the locks and written out one at a time
+    void log(StringId tag, std::string_view message, std::optional<FormatArgs> args, const char* func_name, const char* src_file, u32 line_num);
     void set_tag_config(const std::string& tag, unsigned char flags, zv::FormatColor color);
+
+    // The latest messages of the tags with k_logflag_keep_in_history and of errors. Messages that are not written
+    // anywhere are kept unformatted, so only logs that are output anyway pay for formatting
+    struct LogRecord
+    {
+      std::chrono::steady_clock::time_point time;
+      std::string tag;
+      std::string message;
+    };
+    // oldest first
+    void get_history(std::vector<LogRecord>& out_records);
   }
 }
 
@@ -87,7 +108,7 @@ namespace zv
 #define ZV_WARNING(format, ...) \
 	do \
 	{ \
-		zv::Logger::log("WARNING", format, zv::make_format_args(__VA_ARGS__), __FUNCTION__, __FILE__, __LINE__); \
+		zv::Logger::log(ZV_STRING_ID("WARNING"), format, zv::make_format_args(__VA_ARGS__), __FUNCTION__, __FILE__, __LINE__); \
 	}\
 	while (0)\
 
@@ -97,16 +118,16 @@ namespace zv
 #define ZV_INFO(format, ...) \
 	do \
 	{ \
-		zv::Logger::log("INFO", format, zv::make_format_args(__VA_ARGS__), NULL, NULL, 0); \
+		zv::Logger::log(ZV_STRING_ID("INFO"), format, zv::make_format_args(__VA_ARGS__), NULL, NULL, 0); \
 	} \
 	while (0) \
 
 // This macro is used for logging and should be the preferred method of "printf debugging".  You can use any tag 
-// string you want, just make sure to enabled the ones you want somewhere in your initialization.
+// literal you want, just make sure to enabled the ones you want somewhere in your initialization.
 #define ZV_LOG(tag, format, ...) \
 	do \
 	{ \
-		zv::Logger::log(tag, format, zv::make_format_args(__VA_ARGS__), NULL, NULL, 0); \
+		zv::Logger::log(ZV_STRING_ID(tag), format, zv::make_format_args(__VA_ARGS__), NULL, NULL, 0); \
 	} \
 	while (0) \
 
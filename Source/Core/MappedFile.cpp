@@ -0,0 +1,174 @@
+/*
+ * MappedFile.cpp - read-only memory-mapped files
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/MappedFile.h>
+
+#include <algorithm>
+#include <utility>
+
+#if OS_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+  constexpr u64 k_page_size = 4096;
+}
+
+zv::MappedFile::~MappedFile()
+{
+  close();
+}
+
+zv::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+zv::MappedFile& zv::MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    close();
+    std::swap(m_ptr_data, other.m_ptr_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_open, other.m_open);
+#if OS_WINDOWS
+    std::swap(m_file_handle, other.m_file_handle);
+    std::swap(m_mapping_handle, other.m_mapping_handle);
+#endif
+  }
+  return *this;
+}
+
+bool zv::MappedFile::open(const char* path)
+{
+  close();
+
+#if OS_WINDOWS
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  m_file_handle = file;
+  m_size = static_cast<u64>(size.QuadPart);
+  m_open = true;
+
+  // empty files cannot be mapped, they are open without data
+  if (m_size > 0)
+  {
+    m_mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_ptr_data = m_mapping_handle ? MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (m_ptr_data == nullptr)
+    {
+      close();
+      return false;
+    }
+  }
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  m_size = static_cast<u64>(file_stat.st_size);
+  m_open = true;
+
+  // empty files cannot be mapped, they are open without data
+  if (m_size > 0)
+  {
+    void* ptr_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr_data == MAP_FAILED)
+    {
+      ::close(fd);
+      close();
+      return false;
+    }
+    m_ptr_data = ptr_data;
+  }
+
+  // the mapping keeps the file alive
+  ::close(fd);
+#endif
+
+  return true;
+}
+
+void zv::MappedFile::close()
+{
+#if OS_WINDOWS
+  if (m_ptr_data)
+  {
+    UnmapViewOfFile(m_ptr_data);
+  }
+  if (m_mapping_handle)
+  {
+    CloseHandle(m_mapping_handle);
+  }
+  if (m_file_handle)
+  {
+    CloseHandle(m_file_handle);
+  }
+  m_mapping_handle = nullptr;
+  m_file_handle = nullptr;
+#else
+  if (m_ptr_data)
+  {
+    munmap(m_ptr_data, m_size);
+  }
+#endif
+
+  m_ptr_data = nullptr;
+  m_size = 0;
+  m_open = false;
+}
+
+void zv::MappedFile::prefetch(u64 offset, u64 size) const
+{
+  if (m_ptr_data == nullptr || offset >= m_size)
+  {
+    return;
+  }
+
+  size = std::min(size, m_size - offset);
+
+#if OS_WINDOWS
+  WIN32_MEMORY_RANGE_ENTRY range{ const_cast<u8*>(get_data()) + offset, static_cast<SIZE_T>(size) };
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise wants page aligned addresses; the hint starts readahead, touching the pages waits for it
+  const u64 aligned_offset = offset & ~(k_page_size - 1);
+  madvise(const_cast<u8*>(get_data()) + aligned_offset, size + (offset - aligned_offset), MADV_WILLNEED);
+#endif
+
+  volatile u8 sink = 0;
+  for (u64 page = offset; page < offset + size; page += k_page_size)
+  {
+    sink = sink + get_data()[page];
+  }
+}
@@ -0,0 +1,45 @@
+/*
+ * MappedFile.h - read-only memory-mapped files
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PlatformContext.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  // Maps a whole file read-only. Pages are read on first access, prefetch() faults them in up front so that the thread
+  // calling it pays for the disk reads instead of the one consuming the data.
+  class MappedFile : public NonCopyable
+  {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+  public:
+    bool open(const char* path);
+    void close();
+
+    // touches every page of [offset, offset + size), clamped to the file
+    void prefetch(u64 offset, u64 size) const;
+
+    bool is_open() const { return m_open; }
+    const u8* get_data() const { return static_cast<const u8*>(m_ptr_data); }
+    u64 get_size() const { return m_size; }
+
+  private:
+    void* m_ptr_data{ nullptr };
+    u64 m_size{ 0 };
+    bool m_open{ false };
+#if OS_WINDOWS
+    void* m_file_handle{ nullptr };
+    void* m_mapping_handle{ nullptr };
+#endif
+  };
+}
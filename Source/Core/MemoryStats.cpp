@@ -0,0 +1,162 @@
+/*
+ * MemoryStats.cpp - process wide allocation counts through the replaced global operator new and delete
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/MemoryStats.h>
+#include <Core/PlatformContext.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if OS_WINDOWS
+#include <malloc.h>
+#endif
+
+// Replacing the global operators is a link time decision; only executables that list this file count their allocations,
+// the tools keep the standard ones. malloc and allocations of third party libraries with their own allocators are not seen.
+namespace
+{
+  std::atomic<u64> s_allocation_count{ 0 };
+  std::atomic<u64> s_free_count{ 0 };
+  std::atomic<u64> s_allocated_bytes{ 0 };
+
+  void count_allocation(size_t size)
+  {
+    s_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void count_free()
+  {
+    s_free_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void* allocate(size_t size)
+  {
+    // malloc(0) may return null, operator new must not
+    void* ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr)
+    {
+      count_allocation(size);
+    }
+    return ptr;
+  }
+
+  void* allocate_aligned(size_t size, std::align_val_t alignment)
+  {
+    const size_t align = static_cast<size_t>(alignment);
+#if OS_WINDOWS
+    void* ptr = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    const size_t padded_size = ((size > 0 ? size : 1) + align - 1) / align * align;
+    void* ptr = std::aligned_alloc(align, padded_size);
+#endif
+    if (ptr)
+    {
+      count_allocation(size);
+    }
+    return ptr;
+  }
+
+  void release(void* ptr)
+  {
+    if (ptr)
+    {
+      count_free();
+      std::free(ptr);
+    }
+  }
+
+  void release_aligned(void* ptr)
+  {
+    if (ptr)
+    {
+      count_free();
+#if OS_WINDOWS
+      _aligned_free(ptr);
+#else
+      std::free(ptr);
+#endif
+    }
+  }
+}
+
+zv::AllocationCounts zv::MemoryStats::get_allocation_counts()
+{
+  AllocationCounts counts;
+  counts.allocation_count = s_allocation_count.load(std::memory_order_relaxed);
+  counts.free_count = s_free_count.load(std::memory_order_relaxed);
+  counts.allocated_bytes = s_allocated_bytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Global operator new and delete
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(size_t size)
+{
+  void* ptr = allocate(size);
+  if (!ptr)
+  {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+  void* ptr = allocate_aligned(size, alignment);
+  if (!ptr)
+  {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+  return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate_aligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { release(ptr); }
+void operator delete[](void* ptr) noexcept { release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { release_aligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { release_aligned(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { release_aligned(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { release_aligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { release_aligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { release_aligned(ptr); }
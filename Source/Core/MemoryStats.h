@@ -0,0 +1,26 @@
+/*
+ * MemoryStats.h - process wide allocation counts through the replaced global operator new and delete
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  struct AllocationCounts
+  {
+    u64 allocation_count{ 0 };
+    u64 free_count{ 0 };
+    // requested sizes of all allocations; frees do not subtract, unsized delete does not know the size
+    u64 allocated_bytes{ 0 };
+  };
+
+  namespace MemoryStats
+  {
+    // Totals since the program started, across all threads. The counters are relaxed atomics, a frame needs to
+    // subtract two reads and may see allocations of other threads that finished on either side of a read.
+    AllocationCounts get_allocation_counts();
+  }
+}
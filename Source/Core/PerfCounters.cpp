@@ -0,0 +1,283 @@
+/*
+ * PerfCounters.cpp - hardware performance counters per thread and per scope through perf_event
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/PerfCounters.h>
+#include <Core/Logger.h>
+#include <Core/PlatformContext.h>
+#include <Core/Time.h>
+
+#if OS_LINUX
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if OS_LINUX
+  struct CounterDesc
+  {
+    u32 type;
+    u64 config;
+    // context switches happen in the kernel and are only seen when it is counted, which needs more privileges
+    bool count_kernel;
+  };
+
+  constexpr CounterDesc k_counter_descs[zv::k_perf_counter_count] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, false },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, true },
+  };
+
+  s32 open_counter(const CounterDesc& desc, s32 group_fd)
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = desc.type;
+    attr.config = desc.config;
+    // the group starts once it is complete
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.exclude_kernel = desc.count_kernel ? 0 : 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // calling thread, any CPU
+    return static_cast<s32>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// PerfCounterValues
+//------------------------------------------------------------------------------------------------------------------------------------
+
+f64 zv::PerfCounterValues::get_ipc() const
+{
+  if (!has(ePerfCounter::Cycles) || !has(ePerfCounter::Instructions) || get(ePerfCounter::Cycles) == 0)
+  {
+    return 0.0;
+  }
+  return static_cast<f64>(get(ePerfCounter::Instructions)) / get(ePerfCounter::Cycles);
+}
+
+zv::PerfCounterValues zv::subtract(const PerfCounterValues& end, const PerfCounterValues& start)
+{
+  PerfCounterValues result;
+  result.valid_mask = end.valid_mask & start.valid_mask;
+  for (u32 i = 0; i < k_perf_counter_count; ++i)
+  {
+    // scaled values of a multiplexed group are estimates and can step back slightly
+    result.values[i] = end.values[i] > start.values[i] ? end.values[i] - start.values[i] : 0;
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// PerfCounterGroup
+//------------------------------------------------------------------------------------------------------------------------------------
+
+zv::PerfCounterGroup::PerfCounterGroup()
+{
+  m_fds.fill(-1);
+}
+
+zv::PerfCounterGroup::~PerfCounterGroup()
+{
+  close();
+}
+
+bool zv::PerfCounterGroup::open()
+{
+  close();
+
+#if OS_LINUX
+  // the first counter that opens leads the group
+  for (u32 i = 0; i < k_perf_counter_count; ++i)
+  {
+    const s32 fd = open_counter(k_counter_descs[i], m_leader_fd);
+    if (fd < 0)
+    {
+      continue;
+    }
+
+    m_fds[i] = fd;
+    m_read_indices[i] = static_cast<u8>(m_open_count++);
+    m_valid_mask |= 1u << i;
+    if (m_leader_fd < 0)
+    {
+      m_leader_fd = fd;
+    }
+  }
+
+  if (m_leader_fd < 0)
+  {
+    return false;
+  }
+
+  ioctl(m_leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(m_leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void zv::PerfCounterGroup::close()
+{
+#if OS_LINUX
+  // members first, closing the leader would promote them to single counters
+  for (s32& fd : m_fds)
+  {
+    if (fd >= 0 && fd != m_leader_fd)
+    {
+      ::close(fd);
+    }
+    fd = -1;
+  }
+  if (m_leader_fd >= 0)
+  {
+    ::close(m_leader_fd);
+  }
+#endif
+
+  m_leader_fd = -1;
+  m_fds.fill(-1);
+  m_valid_mask = 0;
+  m_open_count = 0;
+}
+
+bool zv::PerfCounterGroup::read(PerfCounterValues& out_values) const
+{
+  out_values = PerfCounterValues{};
+  if (m_leader_fd < 0)
+  {
+    return false;
+  }
+
+#if OS_LINUX
+  // { nr, time_enabled, time_running, value per counter }
+  u64 buffer[3 + k_perf_counter_count];
+  const ssize_t size = ::read(m_leader_fd, buffer, sizeof(u64) * (3 + m_open_count));
+  if (size != static_cast<ssize_t>(sizeof(u64) * (3 + m_open_count)) || buffer[0] != m_open_count)
+  {
+    return false;
+  }
+
+  const u64 time_enabled = buffer[1];
+  const u64 time_running = buffer[2];
+  for (u32 i = 0; i < k_perf_counter_count; ++i)
+  {
+    if (m_valid_mask & (1u << i))
+    {
+      const u64 value = buffer[3 + m_read_indices[i]];
+      out_values.values[i] = time_running > 0 && time_running < time_enabled ? static_cast<u64>(static_cast<f64>(value) * time_enabled / time_running) : value;
+    }
+  }
+  out_values.valid_mask = m_valid_mask;
+  return true;
+#else
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// PerfCounters
+//------------------------------------------------------------------------------------------------------------------------------------
+
+bool zv::PerfCounters::create()
+{
+  destroy();
+
+  if (!m_group.open())
+  {
+    ZV_INFO("Performance counters are not available.");
+    return true;
+  }
+
+  m_scopes.reserve(k_max_scopes);
+  return true;
+}
+
+void zv::PerfCounters::destroy()
+{
+  m_group.close();
+  m_frame_index = 0;
+  m_in_frame = false;
+  m_scopes.clear();
+  m_open_scope_count = 0;
+  m_frame_stats = PerfFrameStats{};
+}
+
+void zv::PerfCounters::begin_frame()
+{
+  if (!m_group.is_open())
+  {
+    return;
+  }
+
+  ZV_ASSERT(!m_in_frame);
+  m_scopes.clear();
+  m_open_scope_count = 0;
+  m_in_frame = true;
+  m_frame_start_counter = Time::read_counter();
+  m_group.read(m_frame_start_values);
+}
+
+void zv::PerfCounters::end_frame()
+{
+  if (!m_in_frame)
+  {
+    return;
+  }
+
+  ZV_ASSERT(m_open_scope_count == 0);
+  PerfCounterValues end_values;
+  m_group.read(end_values);
+  const u64 end_counter = Time::read_counter();
+
+  m_frame_stats.frame_index = m_frame_index++;
+  m_frame_stats.valid = true;
+  m_frame_stats.time_ms = static_cast<f32>(static_cast<f64>(end_counter - m_frame_start_counter) * 1000.0 / Time::counter_frequency());
+  m_frame_stats.counters = subtract(end_values, m_frame_start_values);
+  m_frame_stats.scopes = m_scopes;
+  m_in_frame = false;
+}
+
+bool zv::PerfCounters::begin_scope(const char* name)
+{
+  if (!m_in_frame || m_scopes.size() == k_max_scopes || m_open_scope_count == k_max_depth)
+  {
+    return false;
+  }
+
+  OpenScope& scope = m_open_scopes[m_open_scope_count];
+  scope.index = static_cast<u32>(m_scopes.size());
+  m_scopes.push_back(PerfScopeCounters{ name, m_open_scope_count, 0.0f, 0.0f, PerfCounterValues{} });
+  ++m_open_scope_count;
+
+  // read last, so the scope counts as little of its own bookkeeping as possible
+  scope.start_counter = Time::read_counter();
+  m_group.read(scope.start_values);
+  m_scopes.back().start_ms = static_cast<f32>(static_cast<f64>(scope.start_counter - m_frame_start_counter) * 1000.0 / Time::counter_frequency());
+  return true;
+}
+
+void zv::PerfCounters::end_scope()
+{
+  PerfCounterValues end_values;
+  m_group.read(end_values);
+  const u64 end_counter = Time::read_counter();
+
+  ZV_ASSERT(m_open_scope_count > 0);
+  const OpenScope& scope = m_open_scopes[--m_open_scope_count];
+  PerfScopeCounters& result = m_scopes[scope.index];
+  result.time_ms = static_cast<f32>(static_cast<f64>(end_counter - scope.start_counter) * 1000.0 / Time::counter_frequency());
+  result.counters = subtract(end_values, scope.start_values);
+}
@@ -0,0 +1,157 @@
+/*
+ * PerfCounters.h - hardware performance counters per thread and per scope through perf_event
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  enum class ePerfCounter : u8
+  {
+    Cycles,
+    Instructions,
+    // last level cache misses
+    CacheMisses,
+    BranchMisses,
+    ContextSwitches,
+    Count,
+  };
+  constexpr u32 k_perf_counter_count = static_cast<u32>(ePerfCounter::Count);
+
+  struct PerfCounterValues
+  {
+    std::array<u64, k_perf_counter_count> values{};
+    // bit per counter the system provides, the others stay 0
+    u32 valid_mask{ 0 };
+
+    bool has(ePerfCounter counter) const { return (valid_mask & (1u << static_cast<u32>(counter))) != 0; }
+    u64 get(ePerfCounter counter) const { return values[static_cast<u32>(counter)]; }
+    // instructions per cycle, 0 without both counters
+    f64 get_ipc() const;
+  };
+
+  // counts between two reads of the same group
+  PerfCounterValues subtract(const PerfCounterValues& end, const PerfCounterValues& start);
+
+  // One perf_event group counting user space on the thread that opened it; the counters are scheduled together, so
+  // ratios like IPC are computed from the same time window. Linux only, open() fails elsewhere and when
+  // perf_event_paranoid does not allow self-profiling.
+  class PerfCounterGroup : public NonCopyable
+  {
+  public:
+    PerfCounterGroup();
+    ~PerfCounterGroup();
+
+  public:
+    // counters the system does not provide are left out, fails if none of them can be opened
+    bool open();
+    void close();
+    bool is_open() const { return m_leader_fd >= 0; }
+
+    // totals since open(), extrapolated if the kernel had to multiplex the group with other users of the counters
+    bool read(PerfCounterValues& out_values) const;
+
+  private:
+    s32 m_leader_fd{ -1 };
+    std::array<s32, k_perf_counter_count> m_fds;
+    // position of each counter in the group read, in the order they were opened
+    std::array<u8, k_perf_counter_count> m_read_indices{};
+    u32 m_valid_mask{ 0 };
+    u32 m_open_count{ 0 };
+  };
+
+  struct PerfScopeCounters
+  {
+    const char* name;
+    // nesting level, 0 for scopes directly in the frame
+    u32 depth;
+    // begin relative to the begin of the frame
+    f32 start_ms;
+    f32 time_ms;
+    PerfCounterValues counters;
+  };
+
+  struct PerfFrameStats
+  {
+    u64 frame_index{ 0 };
+    bool valid{ false };
+    f32 time_ms{ 0.0f };
+    PerfCounterValues counters;
+    // in the order they began
+    std::vector<PerfScopeCounters> scopes;
+  };
+
+  // Counters of the frame and named, possibly nested scopes on the thread that created it; other threads create their
+  // own instance. Unlike GPU queries the results are final at end_frame(), so get_frame_stats() is the last frame.
+  class PerfCounters : public NonCopyable
+  {
+  public:
+    static constexpr u32 k_max_scopes = 32;
+    static constexpr u32 k_max_depth = 8;
+
+  public:
+    // succeeds without counter support, nothing is recorded then
+    bool create();
+    void destroy();
+
+    bool is_supported() const { return m_group.is_open(); }
+
+    void begin_frame();
+    void end_frame();
+
+    // returns false once k_max_scopes are used this frame or k_max_depth scopes are open; end_scope() must only follow
+    // a successful begin_scope()
+    bool begin_scope(const char* name);
+    void end_scope();
+
+    const PerfFrameStats& get_frame_stats() const { return m_frame_stats; }
+
+  private:
+    struct OpenScope
+    {
+      u32 index;
+      u64 start_counter;
+      PerfCounterValues start_values;
+    };
+
+    PerfCounterGroup m_group;
+    u64 m_frame_index{ 0 };
+    bool m_in_frame{ false };
+    u64 m_frame_start_counter{ 0 };
+    PerfCounterValues m_frame_start_values;
+
+    std::vector<PerfScopeCounters> m_scopes;
+    std::array<OpenScope, k_max_depth> m_open_scopes;
+    u32 m_open_scope_count{ 0 };
+
+    PerfFrameStats m_frame_stats;
+  };
+
+  // RAII scope; a null pointer records nothing, so callers do not need to check whether counters are enabled
+  class PerfScope : public NonCopyable
+  {
+  public:
+    PerfScope(PerfCounters* ptr_counters, const char* name)
+      : m_ptr_counters(ptr_counters != nullptr && ptr_counters->begin_scope(name) ? ptr_counters : nullptr)
+    {
+    }
+
+    ~PerfScope()
+    {
+      if (m_ptr_counters)
+      {
+        m_ptr_counters->end_scope();
+      }
+    }
+
+  private:
+    PerfCounters* m_ptr_counters;
+  };
+}
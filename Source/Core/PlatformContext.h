@@ -91,3 +91,33 @@
 #if !defined(ARCH_ARM)
 #  define ARCH_ARM 0
 #endif
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// SIMD instruction set macros
+//------------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(ZV_SIMD_FORCE_SCALAR) && ZV_SIMD_FORCE_SCALAR
+#  define SIMD_SCALAR 1
+#elif (ARCH_X64 || ARCH_X86) && defined(__AVX2__)
+#  define SIMD_AVX2 1
+#  define SIMD_SSE 1
+#elif ARCH_X64 || (ARCH_X86 && (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#  define SIMD_SSE 1
+#elif ARCH_ARM64 || (ARCH_ARM && (defined(__ARM_NEON) || defined(__ARM_NEON__)))
+#  define SIMD_NEON 1
+#else
+#  define SIMD_SCALAR 1
+#endif
+
+#if !defined(SIMD_AVX2)
+#  define SIMD_AVX2 0
+#endif
+#if !defined(SIMD_SSE)
+#  define SIMD_SSE 0
+#endif
+#if !defined(SIMD_NEON)
+#  define SIMD_NEON 0
+#endif
+#if !defined(SIMD_SCALAR)
+#  define SIMD_SCALAR 0
+#endif
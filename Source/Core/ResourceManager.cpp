@@ -0,0 +1,258 @@
+/*
+ * ResourceManager.cpp - reference-counted GPU resources behind generational handles with deduplicated loads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/ResourceManager.h>
+
+#include <Core/AssetArchive.h>
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Primitives/interface/Object.h>
+
+
+zv::ResourceId zv::make_resource_id(const Guid& guid)
+{
+  return guid.get_hash();
+}
+
+zv::ResourceId zv::make_resource_id(const char* path)
+{
+  return hash_archive_path(path);
+}
+
+zv::ResourceManager::~ResourceManager()
+{
+  destroy();
+}
+
+bool zv::ResourceManager::create(const CreateParams& params)
+{
+  destroy();
+
+  m_params = params;
+  return true;
+}
+
+void zv::ResourceManager::destroy()
+{
+  Jobs::wait(m_load_counter);
+  Jobs::wait(m_sweep_counter);
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  for (const Slot& slot : m_slots)
+  {
+    if (slot.ref_count > 0)
+    {
+      ZV_WARNING("Resource '{}' is still referenced {} times on destruction.", slot.name.get_string(), slot.ref_count);
+    }
+  }
+
+  m_slots.clear();
+  m_free_slots.clear();
+  m_slot_of_id.clear();
+  m_frame_index = 0;
+  m_stats = ResourceStats{};
+}
+
+zv::ResourceHandle zv::ResourceManager::load(ResourceId id, const char* name, CreateFn fn)
+{
+  ResourceHandle handle;
+  if (acquire(id, name, handle))
+  {
+    // loads take milliseconds, on the frame queue they would hold up the frame's parallel_for
+    Jobs::submit_background([this, handle, fn = std::move(fn)]()
+    {
+      finish(handle, fn());
+    }, &m_load_counter);
+  }
+  return handle;
+}
+
+zv::ResourceHandle zv::ResourceManager::create(ResourceId id, const char* name, const CreateFn& fn)
+{
+  ResourceHandle handle;
+  if (acquire(id, name, handle))
+  {
+    finish(handle, fn());
+  }
+  return handle;
+}
+
+zv::ResourceHandle zv::ResourceManager::begin_load(ResourceId id, const char* name, bool& out_started)
+{
+  ResourceHandle handle;
+  out_started = acquire(id, name, handle);
+  return handle;
+}
+
+void zv::ResourceManager::finish_load(ResourceHandle handle, RefCntAutoPtr<IObject> ptr_object)
+{
+  finish(handle, std::move(ptr_object));
+}
+
+bool zv::ResourceManager::acquire(ResourceId id, const char* name, ResourceHandle& out_handle)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_slot_of_id.find(id);
+  if (it != m_slot_of_id.end())
+  {
+    Slot& slot = m_slots[it->second];
+    ++slot.ref_count;
+    ++m_stats.shared_requests;
+    out_handle = ResourceHandle{ it->second, slot.generation };
+    return false;
+  }
+
+  u32 index;
+  if (!m_free_slots.empty())
+  {
+    index = m_free_slots.back();
+    m_free_slots.pop_back();
+  }
+  else
+  {
+    index = static_cast<u32>(m_slots.size());
+    m_slots.emplace_back();
+  }
+
+  Slot& slot = m_slots[index];
+  slot.id = id;
+  // a resource that is loaded again after its release finds its name interned already
+  slot.name = StringId::intern(name);
+  slot.state = eResourceState::Loading;
+  slot.ref_count = 1;
+  m_slot_of_id.emplace(id, index);
+
+  out_handle = ResourceHandle{ index, slot.generation };
+  return true;
+}
+
+void zv::ResourceManager::finish(ResourceHandle handle, RefCntAutoPtr<IObject> ptr_object)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  // the slot cannot have been swept, loading resources are skipped
+  Slot& slot = m_slots[handle.index];
+  ZV_ASSERT(slot.generation == handle.generation && slot.state == eResourceState::Loading);
+  if (ptr_object == nullptr)
+  {
+    ZV_WARNING("Failed to create resource '{}'.", slot.name.get_string());
+    slot.state = eResourceState::Failed;
+    return;
+  }
+
+  slot.ptr_object = std::move(ptr_object);
+  slot.state = eResourceState::Ready;
+}
+
+zv::ResourceManager::Slot* zv::ResourceManager::resolve(ResourceHandle handle)
+{
+  if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation ||
+      m_slots[handle.index].state == eResourceState::Invalid)
+  {
+    return nullptr;
+  }
+  return &m_slots[handle.index];
+}
+
+const zv::ResourceManager::Slot* zv::ResourceManager::resolve(ResourceHandle handle) const
+{
+  return const_cast<ResourceManager*>(this)->resolve(handle);
+}
+
+void zv::ResourceManager::add_ref(ResourceHandle handle)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  Slot* ptr_slot = resolve(handle);
+  ZV_ASSERT(ptr_slot != nullptr);
+  ++ptr_slot->ref_count;
+}
+
+void zv::ResourceManager::release(ResourceHandle handle)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  Slot* ptr_slot = resolve(handle);
+  ZV_ASSERT(ptr_slot != nullptr && ptr_slot->ref_count > 0);
+  if (--ptr_slot->ref_count == 0)
+  {
+    ptr_slot->unused_frame = m_frame_index;
+  }
+}
+
+zv::eResourceState zv::ResourceManager::get_state(ResourceHandle handle) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  const Slot* ptr_slot = resolve(handle);
+  return ptr_slot ? ptr_slot->state : eResourceState::Invalid;
+}
+
+zv::IObject* zv::ResourceManager::get(ResourceHandle handle) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  const Slot* ptr_slot = resolve(handle);
+  return ptr_slot ? ptr_slot->ptr_object.RawPtr() : nullptr;
+}
+
+void zv::ResourceManager::wait_for_loads()
+{
+  Jobs::wait(m_load_counter);
+}
+
+void zv::ResourceManager::update()
+{
+  std::vector<RefCntAutoPtr<IObject>> released;
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    ++m_frame_index;
+
+    // Slots are visited in index order, at most sweep_budget are freed per frame; the rest follow in later frames
+    for (u32 index = 0; index < m_slots.size() && released.size() < m_params.sweep_budget; ++index)
+    {
+      Slot& slot = m_slots[index];
+      if (slot.state == eResourceState::Invalid || slot.state == eResourceState::Loading || slot.ref_count > 0 ||
+          slot.unused_frame + m_params.release_delay_frames > m_frame_index)
+      {
+        continue;
+      }
+
+      released.push_back(std::move(slot.ptr_object));
+      m_slot_of_id.erase(slot.id);
+      slot.name = StringId{};
+      slot.state = eResourceState::Invalid;
+      // outstanding handles of the released resource become stale
+      ++slot.generation;
+      m_free_slots.push_back(index);
+      ++m_stats.released_count;
+    }
+  }
+
+  // Destroying objects can take a while (the device defers the GPU side until it is done with them), so the last
+  // references are dropped in the background
+  if (!released.empty())
+  {
+    Jobs::submit_background([released = std::move(released)]() mutable
+    {
+      released.clear();
+    }, &m_sweep_counter);
+  }
+}
+
+zv::ResourceManager::ResourceStats zv::ResourceManager::get_stats() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  ResourceStats stats = m_stats;
+  for (const Slot& slot : m_slots)
+  {
+    stats.resource_count += slot.state != eResourceState::Invalid;
+    stats.loading_count += slot.state == eResourceState::Loading;
+    stats.unused_count += slot.state != eResourceState::Invalid && slot.ref_count == 0;
+  }
+  return stats;
+}
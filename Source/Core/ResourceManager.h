@@ -0,0 +1,153 @@
+/*
+ * ResourceManager.h - reference-counted GPU resources behind generational handles with deduplicated loads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Core/Guid.h>
+#include <Core/JobSystem.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/StringId.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace zv
+{
+  // Identifies a resource independently of its handle: a GUID or a path hash. Paths are hashed like archive paths,
+  // so "./a\b" and "a/b" are the same resource.
+  using ResourceId = u64;
+  ResourceId make_resource_id(const Guid& guid);
+  ResourceId make_resource_id(const char* path);
+
+  // Index of a slot and the generation it was handed out in; a handle whose resource was released (and whose slot may
+  // hold a different resource by now) resolves to null instead of the wrong object
+  struct ResourceHandle
+  {
+    u32 index{ ~0u };
+    u32 generation{ 0 };
+
+    bool is_valid() const { return index != ~0u; }
+    bool operator==(const ResourceHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+  };
+
+  enum class eResourceState : u8
+  {
+    // the handle is stale or was never valid
+    Invalid,
+    Loading,
+    Ready,
+    Failed,
+  };
+
+  // Owns device objects (buffers, textures, pipelines, shader resource bindings) by ResourceId and hands out
+  // reference-counted handles to them:
+  //  - load(), create() and begin_load() return the existing resource if the id is known, including one that is still
+  //    loading, so concurrent requests for the same asset share one load job and one object
+  //  - every returned handle holds a reference that is given back with release(); resources without references stay
+  //    cached for release_delay_frames, then update() releases at most sweep_budget of them per frame and drops the
+  //    objects on the job system's background queue
+  //
+  // All functions are thread-safe. get() locks, so resolve handles once per frame rather than per draw.
+  class ResourceManager : public NonCopyable
+  {
+  public:
+    // runs on a background worker for load(), inline for create(); null fails the resource
+    using CreateFn = std::function<RefCntAutoPtr<IObject>()>;
+
+    struct CreateParams
+    {
+      u32 sweep_budget{ 16 };
+      u32 release_delay_frames{ 3 };
+    };
+
+    struct ResourceStats
+    {
+      u32 resource_count{ 0 };
+      u32 loading_count{ 0 };
+      // resources without references that wait for the sweep
+      u32 unused_count{ 0 };
+      // requests that were served by a resource that was loaded or loading already
+      u64 shared_requests{ 0 };
+      u64 released_count{ 0 };
+    };
+
+  public:
+    ResourceManager() = default;
+    ~ResourceManager();
+
+  public:
+    bool create(const CreateParams& params);
+    // waits for loads in flight and releases every resource, referenced or not
+    void destroy();
+
+    // Loads the resource on the job system unless it exists already; name is for logging only
+    ResourceHandle load(ResourceId id, const char* name, CreateFn fn);
+    // Same as load() but creates the resource on the calling thread
+    ResourceHandle create(ResourceId id, const char* name, const CreateFn& fn);
+    // Same as load() for loads that run in several stages, like streaming: out_started is true if the resource did
+    // not exist, then the caller loads it and completes it with finish_load()
+    ResourceHandle begin_load(ResourceId id, const char* name, bool& out_started);
+    // completes a resource of begin_load() from any thread; null fails the resource
+    void finish_load(ResourceHandle handle, RefCntAutoPtr<IObject> ptr_object);
+
+    void add_ref(ResourceHandle handle);
+    // the handle must not be used after its last reference is released
+    void release(ResourceHandle handle);
+
+    eResourceState get_state(ResourceHandle handle) const;
+    // null until the resource is ready and for stale handles
+    IObject* get(ResourceHandle handle) const;
+    template <typename T>
+    T* get(ResourceHandle handle) const { return static_cast<T*>(get(handle)); }
+
+    // blocks until all loads submitted so far are done
+    void wait_for_loads();
+
+    // advances the frame and sweeps unused resources; call once per frame
+    void update();
+
+    ResourceStats get_stats() const;
+
+  private:
+    struct Slot
+    {
+      ResourceId id{ 0 };
+      // interned, for logging
+      StringId name;
+      RefCntAutoPtr<IObject> ptr_object;
+      eResourceState state{ eResourceState::Invalid };
+      u32 generation{ 0 };
+      u32 ref_count{ 0 };
+      // frame the last reference was released in
+      u64 unused_frame{ 0 };
+    };
+
+    // finds or allocates the slot of id and adds a reference; returns true if the caller has to create the object
+    bool acquire(ResourceId id, const char* name, ResourceHandle& out_handle);
+    void finish(ResourceHandle handle, RefCntAutoPtr<IObject> ptr_object);
+    Slot* resolve(ResourceHandle handle);
+    const Slot* resolve(ResourceHandle handle) const;
+
+  private:
+    CreateParams m_params;
+
+    mutable std::mutex m_mutex;
+    std::vector<Slot> m_slots;
+    std::vector<u32> m_free_slots;
+    std::unordered_map<ResourceId, u32> m_slot_of_id;
+    u64 m_frame_index{ 0 };
+    ResourceStats m_stats;
+
+    Jobs::Counter m_load_counter;
+    // released objects of the last sweep, dropped on a worker
+    Jobs::Counter m_sweep_counter;
+  };
+}
@@ -0,0 +1,66 @@
+/*
+ * SpscQueue.h - bounded lock-free single-producer single-consumer queue
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <type_traits>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  // Ring buffer of CAPACITY - 1 usable slots. Only one thread may push and only one thread may pop; neither side ever
+  // blocks or allocates. The indices live on separate cache lines so the two threads do not share one.
+  template<typename T, u32 CAPACITY>
+  class SpscQueue : public NonCopyable
+  {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "elements are copied into and out of the ring");
+
+  public:
+    SpscQueue() = default;
+
+  public:
+    // producer; false if the queue is full
+    bool push(const T& value)
+    {
+      const u32 tail = m_tail.load(std::memory_order_relaxed);
+      const u32 next = (tail + 1) & (CAPACITY - 1);
+      if (next == m_head.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+
+      m_slots[tail] = value;
+      m_tail.store(next, std::memory_order_release);
+      return true;
+    }
+
+    // consumer; false if the queue is empty
+    bool pop(T& out_value)
+    {
+      const u32 head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+
+      out_value = m_slots[head];
+      m_head.store((head + 1) & (CAPACITY - 1), std::memory_order_release);
+      return true;
+    }
+
+    // approximate when called while the other side is active
+    bool is_empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+
+  private:
+    alignas(64) std::atomic<u32> m_head{ 0 };
+    alignas(64) std::atomic<u32> m_tail{ 0 };
+    alignas(64) std::array<T, CAPACITY> m_slots;
+  };
+}
@@ -0,0 +1,74 @@
+/*
+ * StringBuilder.h - formats into an inline buffer that only allocates for long text
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include <Core/Format.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+#include <ThirdParty/fmt/include/fmt/format.h>
+
+namespace zv
+{
+  // Text is formatted straight into INLINE_CAPACITY bytes inside the builder, so a builder on the stack formats
+  // without allocating. Longer text moves to the heap; a builder that is cleared and reused keeps that capacity.
+  // Views point into the builder and are valid until it changes.
+  template<u32 INLINE_CAPACITY = 256>
+  class StringBuilder : public NonCopyable
+  {
+  public:
+    StringBuilder() = default;
+
+  public:
+    template<typename ...Args>
+    StringBuilder& format(fmt::format_string<Args...> format_str, Args&&... args)
+    {
+      fmt::format_to(std::back_inserter(m_buffer), format_str, std::forward<Args>(args)...);
+      return *this;
+    }
+
+    StringBuilder& vformat(std::string_view format_str, FormatArgs args)
+    {
+      fmt::vformat_to(std::back_inserter(m_buffer), format_str, args);
+      return *this;
+    }
+
+    StringBuilder& append(std::string_view str)
+    {
+      m_buffer.append(str.data(), str.data() + str.size());
+      return *this;
+    }
+
+    StringBuilder& append(char c)
+    {
+      m_buffer.push_back(c);
+      return *this;
+    }
+
+    void clear() { m_buffer.clear(); }
+
+    std::string_view get_view() const { return std::string_view{ m_buffer.data(), m_buffer.size() }; }
+    // for C APIs; the terminator is written behind the text and not part of it
+    const char* c_str()
+    {
+      m_buffer.push_back('\0');
+      m_buffer.resize(m_buffer.size() - 1);
+      return m_buffer.data();
+    }
+
+    u64 get_size() const { return m_buffer.size(); }
+    bool is_empty() const { return m_buffer.size() == 0; }
+    // false once the text outgrew the inline buffer
+    bool is_inline() const { return m_buffer.capacity() <= INLINE_CAPACITY; }
+
+  private:
+    fmt::basic_memory_buffer<char, INLINE_CAPACITY> m_buffer;
+  };
+}
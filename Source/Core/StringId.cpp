@@ -0,0 +1,115 @@
+/*
+ * StringId.cpp - hashed string identifiers with compile-time hashing of literals and a global interning table
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/StringId.h>
+#include <Core/Logger.h>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  // Copies strings into large blocks that are never freed, so the text of an id stays where it is
+  class StringArena
+  {
+  private:
+    static constexpr u64 k_block_size = 16 << 10;
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* m_ptr_next{ nullptr };
+    u64 m_remaining{ 0 };
+
+  public:
+    const char* store(std::string_view str)
+    {
+      const u64 size = str.size() + 1;
+      char* ptr_str = nullptr;
+      if (size > k_block_size / 4)
+      {
+        // long strings get a block of their own, the current block keeps its space
+        m_blocks.emplace_back(std::make_unique<char[]>(size));
+        ptr_str = m_blocks.back().get();
+      }
+      else
+      {
+        if (size > m_remaining)
+        {
+          m_blocks.emplace_back(std::make_unique<char[]>(k_block_size));
+          m_ptr_next = m_blocks.back().get();
+          m_remaining = k_block_size;
+        }
+        ptr_str = m_ptr_next;
+        m_ptr_next += size;
+        m_remaining -= size;
+      }
+
+      std::memcpy(ptr_str, str.data(), str.size());
+      ptr_str[str.size()] = '\0';
+      return ptr_str;
+    }
+  };
+
+  struct StringTable
+  {
+    std::mutex mutex;
+    StringArena arena;
+    std::unordered_map<u64, const char*> strings;
+  };
+
+  StringTable& get_string_table()
+  {
+    // never destroyed, ids are interned and resolved until the very end of the program
+    static StringTable* s_ptr_table = new StringTable;
+    return *s_ptr_table;
+  }
+}
+
+zv::StringId zv::StringId::intern(std::string_view str)
+{
+  StringId id;
+  id.m_hash = hash_string(str);
+
+  StringTable& table = get_string_table();
+#if ZV_DEBUG_MODE
+  bool collided = false;
+  std::string collision;
+#endif
+  {
+    std::lock_guard<std::mutex> lock{ table.mutex };
+    auto it = table.strings.find(id.m_hash);
+    if (it == table.strings.end())
+    {
+      table.strings.emplace(id.m_hash, table.arena.store(str));
+    }
+#if ZV_DEBUG_MODE
+    else if (str != it->second)
+    {
+      collided = true;
+      collision = it->second;
+    }
+#endif
+  }
+
+#if ZV_DEBUG_MODE
+  // logged outside the lock, the logger interns its tags
+  if (collided)
+  {
+    ZV_ERROR("The string ids of '{}' and '{}' collide.", std::string{ str }, collision);
+  }
+#endif
+  return id;
+}
+
+const char* zv::StringId::get_string() const
+{
+  StringTable& table = get_string_table();
+  std::lock_guard<std::mutex> lock{ table.mutex };
+  auto it = table.strings.find(m_hash);
+  return it != table.strings.end() ? it->second : nullptr;
+}
@@ -0,0 +1,53 @@
+/*
+ * StringId.h - hashed string identifiers with compile-time hashing of literals and a global interning table
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string_view>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  // A string reduced to its 64-bit FNV-1a hash (hash_string()), so comparing and hashing is an integer operation.
+  // Literals convert implicitly and are hashed at compile time in constant expressions; runtime strings go through
+  // intern(), which also keeps a copy of the text for get_string(). The default id is no string at all.
+  class StringId
+  {
+  public:
+    constexpr StringId() = default;
+    // arrays are hashed up to their terminator, so character buffers work as well
+    template<size_t N>
+    constexpr StringId(const char (&str)[N]) : m_hash(hash_string(static_cast<const char*>(str))) {}
+
+    // Thread-safe; the text is stored once per id and lives until the program exits. Debug builds report strings
+    // whose hashes collide.
+    static StringId intern(std::string_view str);
+
+    // the text of an interned id, null for ids that were only hashed; meant for logging and debugging, it locks
+    const char* get_string() const;
+
+    constexpr u64 get_hash() const { return m_hash; }
+    constexpr bool is_valid() const { return m_hash != 0; }
+
+    constexpr bool operator==(const StringId& other) const { return m_hash == other.m_hash; }
+    constexpr bool operator!=(const StringId& other) const { return m_hash != other.m_hash; }
+    constexpr bool operator<(const StringId& other) const { return m_hash < other.m_hash; }
+
+  private:
+    u64 m_hash{ 0 };
+  };
+
+  struct StringIdHash
+  {
+    // FNV-1a spreads its bits already
+    size_t operator()(const StringId& id) const { return static_cast<size_t>(id.get_hash()); }
+  };
+}
+
+// A literal as StringId that get_string() can resolve; each call site interns its literal once, later calls only
+// check a function-local static
+#define ZV_STRING_ID(str) ([]() { static const zv::StringId s_id = zv::StringId::intern(str); return s_id; }())
@@ -0,0 +1,404 @@
+/*
+ * Telemetry.cpp - live counters and profiler spans streamed to local clients
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/Telemetry.h>
+#include <Core/LocalSocket.h>
+#include <Core/Logger.h>
+#include <Core/SpscQueue.h>
+#include <Core/StringId.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  // records a thread can publish between two drains, 4 ms apart
+  constexpr u32 k_queue_capacity = 4096;
+  constexpr u32 k_max_thread_count = 64;
+  constexpr auto k_drain_interval = std::chrono::milliseconds(4);
+  // a client that falls further behind is disconnected instead of holding records back
+  constexpr u64 k_max_pending_bytes = 8ull << 20;
+
+  // Channel names outlive the server, so ids handed out before create() stay valid
+  struct ChannelRegistry
+  {
+    std::mutex mutex;
+    // interned
+    std::vector<const char*> names;
+    std::unordered_map<zv::StringId, zv::TelemetryChannel, zv::StringIdHash> ids;
+    std::atomic<u32> count{ 0 };
+  };
+
+  ChannelRegistry& get_channel_registry()
+  {
+    static ChannelRegistry s_registry;
+    return s_registry;
+  }
+
+  std::chrono::steady_clock::time_point s_start_time = std::chrono::steady_clock::now();
+
+  void append(std::vector<u8>& buffer, const void* ptr_data, u64 size)
+  {
+    const u8* ptr_bytes = static_cast<const u8*>(ptr_data);
+    buffer.insert(buffer.end(), ptr_bytes, ptr_bytes + size);
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// TelemetryServer
+//------------------------------------------------------------------------------------------------------------------------------------
+
+// singleton
+namespace { class TelemetryServer; }
+static std::atomic<TelemetryServer*> s_ptr_telemetry_server{ nullptr };
+// tells the queues of threads that published to an earlier server apart
+static std::atomic<u32> s_telemetry_generation{ 0 };
+// publish() calls that may hold the server, destroy() deletes it once they are done
+static std::atomic<u32> s_telemetry_publish_count{ 0 };
+
+namespace
+{
+class TelemetryServer
+{
+public:
+  struct ThreadQueue
+  {
+    zv::SpscQueue<zv::TelemetryRecord, k_queue_capacity> records;
+    // written by the producer only, read by the server
+    std::atomic<u64> dropped_count{ 0 };
+    u64 reported_dropped_count{ 0 };
+    u8 thread_index{ 0 };
+  };
+
+private:
+  struct Client
+  {
+    zv::LocalSocket socket;
+    std::vector<u8> pending;
+  };
+
+  zv::LocalSocket m_listen_socket;
+  std::thread m_thread;
+  std::atomic<bool> m_running{ false };
+
+  // filled up front, threads get the next free slot on their first publish
+  std::array<std::unique_ptr<ThreadQueue>, k_max_thread_count> m_queues;
+  std::atomic<u32> m_queue_count{ 0 };
+  std::mutex m_queue_mutex;
+
+  // server thread only
+  std::vector<Client> m_clients;
+  std::vector<u8> m_buffer;
+  std::vector<u8> m_record_buffer;
+  u32 m_sent_channel_count{ 0 };
+  u64 m_client_count{ 0 };
+  u64 m_dropped_client_count{ 0 };
+
+public:
+  ~TelemetryServer();
+
+  bool create(const char* address);
+  ThreadQueue* register_thread();
+
+private:
+  void server_main();
+  void accept_clients();
+  void append_channels(std::vector<u8>& buffer, u32 begin, u32 end);
+  void drain_queues();
+  void flush_clients();
+};
+
+TelemetryServer::~TelemetryServer()
+{
+  if (m_thread.joinable())
+  {
+    m_running.store(false, std::memory_order_release);
+    m_thread.join();
+  }
+
+  if (m_client_count > 0)
+  {
+    ZV_INFO("Telemetry served {} clients, {} of them were disconnected for falling behind.", m_client_count, m_dropped_client_count);
+  }
+}
+
+bool TelemetryServer::create(const char* address)
+{
+  if (!m_listen_socket.listen(address) || !m_listen_socket.set_blocking(false))
+  {
+    ZV_ERROR("Failed to listen for telemetry clients on '{}'.", address);
+    return false;
+  }
+
+  for (std::unique_ptr<ThreadQueue>& ptr_queue : m_queues)
+  {
+    ptr_queue = std::make_unique<ThreadQueue>();
+  }
+
+  m_running.store(true, std::memory_order_release);
+  m_thread = std::thread{ &TelemetryServer::server_main, this };
+  ZV_INFO("Telemetry is served on '{}'.", address);
+  return true;
+}
+
+TelemetryServer::ThreadQueue* TelemetryServer::register_thread()
+{
+  std::lock_guard<std::mutex> lock{ m_queue_mutex };
+  const u32 index = m_queue_count.load(std::memory_order_relaxed);
+  if (index == k_max_thread_count)
+  {
+    return nullptr;
+  }
+
+  ThreadQueue* ptr_queue = m_queues[index].get();
+  ptr_queue->thread_index = static_cast<u8>(index);
+  m_queue_count.store(index + 1, std::memory_order_release);
+  return ptr_queue;
+}
+
+void TelemetryServer::server_main()
+{
+  while (m_running.load(std::memory_order_acquire))
+  {
+    accept_clients();
+    drain_queues();
+    flush_clients();
+    std::this_thread::sleep_for(k_drain_interval);
+  }
+
+  // what was published until destroy() still goes out
+  drain_queues();
+  flush_clients();
+}
+
+void TelemetryServer::accept_clients()
+{
+  Client client;
+  while (m_listen_socket.accept(client.socket))
+  {
+    client.pending.clear();
+    if (!client.socket.set_blocking(false))
+    {
+      continue;
+    }
+
+    // the channels so far, the ones registered later go out with the next drain
+    const zv::TelemetryHello hello{ zv::k_telemetry_magic, zv::k_telemetry_version, static_cast<u16>(sizeof(zv::TelemetryRecord)) };
+    append(client.pending, &hello, sizeof(hello));
+    append_channels(client.pending, 0, m_sent_channel_count);
+
+    m_clients.push_back(std::move(client));
+    ++m_client_count;
+  }
+}
+
+void TelemetryServer::append_channels(std::vector<u8>& buffer, u32 begin, u32 end)
+{
+  ChannelRegistry& registry = get_channel_registry();
+  std::lock_guard<std::mutex> lock{ registry.mutex };
+  for (u32 channel = begin; channel < end; ++channel)
+  {
+    const char* name = registry.names[channel];
+    const u16 name_size = static_cast<u16>(std::min<size_t>(std::strlen(name), 0xffff));
+    const zv::TelemetryRecord record{ 0, 0.0, channel, zv::eTelemetryRecord::Channel, 0, name_size };
+    append(buffer, &record, sizeof(record));
+    append(buffer, name, name_size);
+  }
+}
+
+void TelemetryServer::drain_queues()
+{
+  m_buffer.clear();
+  m_record_buffer.clear();
+
+  const u32 queue_count = m_queue_count.load(std::memory_order_acquire);
+  for (u32 i = 0; i < queue_count; ++i)
+  {
+    ThreadQueue& queue = *m_queues[i];
+    zv::TelemetryRecord record;
+    while (queue.records.pop(record))
+    {
+      append(m_record_buffer, &record, sizeof(record));
+    }
+
+    const u64 dropped_count = queue.dropped_count.load(std::memory_order_relaxed);
+    if (dropped_count != queue.reported_dropped_count)
+    {
+      const zv::TelemetryRecord dropped{ zv::Telemetry::now_ns(), static_cast<f64>(dropped_count - queue.reported_dropped_count), 0,
+                                         zv::eTelemetryRecord::Dropped, queue.thread_index, 0 };
+      append(m_record_buffer, &dropped, sizeof(dropped));
+      queue.reported_dropped_count = dropped_count;
+    }
+  }
+
+  // The channels go out ahead of the records. A channel is registered before its first record is published, so the
+  // count loaded after popping covers every popped record; loaded before, a channel registered in between was missing.
+  const u32 channel_count = get_channel_registry().count.load(std::memory_order_acquire);
+  if (channel_count > m_sent_channel_count)
+  {
+    append_channels(m_buffer, m_sent_channel_count, channel_count);
+    m_sent_channel_count = channel_count;
+  }
+  m_buffer.insert(m_buffer.end(), m_record_buffer.begin(), m_record_buffer.end());
+}
+
+void TelemetryServer::flush_clients()
+{
+  for (size_t i = 0; i < m_clients.size();)
+  {
+    Client& client = m_clients[i];
+    client.pending.insert(client.pending.end(), m_buffer.begin(), m_buffer.end());
+
+    s64 sent = 0;
+    while (!client.pending.empty() && (sent = client.socket.send(client.pending.data(), client.pending.size())) > 0)
+    {
+      client.pending.erase(client.pending.begin(), client.pending.begin() + sent);
+    }
+
+    // gone, or too slow to keep up
+    const bool behind = client.pending.size() > k_max_pending_bytes;
+    if (sent < 0 || behind)
+    {
+      m_dropped_client_count += behind;
+      m_clients.erase(m_clients.begin() + i);
+      continue;
+    }
+    ++i;
+  }
+}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Telemetry
+//------------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+  struct ThreadSlot
+  {
+    TelemetryServer::ThreadQueue* ptr_queue{ nullptr };
+    // generation of the server the queue belongs to
+    u32 generation{ ~0u };
+  };
+  thread_local ThreadSlot t_thread_slot;
+
+  void publish_to(TelemetryServer* ptr_server, zv::TelemetryRecord record)
+  {
+    // the only time a thread takes a lock; threads beyond k_max_thread_count are not heard
+    const u32 generation = s_telemetry_generation.load(std::memory_order_relaxed);
+    if (t_thread_slot.generation != generation)
+    {
+      t_thread_slot.ptr_queue = ptr_server->register_thread();
+      t_thread_slot.generation = generation;
+    }
+
+    TelemetryServer::ThreadQueue* ptr_queue = t_thread_slot.ptr_queue;
+    if (ptr_queue == nullptr)
+    {
+      return;
+    }
+
+    record.thread = ptr_queue->thread_index;
+    if (!ptr_queue->records.push(record))
+    {
+      ptr_queue->dropped_count.store(ptr_queue->dropped_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+  }
+
+  void publish(zv::TelemetryRecord record)
+  {
+    // Counted before the server is loaded and both sequentially consistent, paired with destroy(): either this call
+    // sees no server or destroy() sees the count
+    s_telemetry_publish_count.fetch_add(1, std::memory_order_seq_cst);
+    TelemetryServer* ptr_server = s_ptr_telemetry_server.load(std::memory_order_seq_cst);
+    if (ptr_server != nullptr)
+    {
+      publish_to(ptr_server, record);
+    }
+    s_telemetry_publish_count.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+bool zv::Telemetry::create(const char* address)
+{
+  if (s_ptr_telemetry_server.load(std::memory_order_relaxed))
+  {
+    return false;
+  }
+
+  s_start_time = std::chrono::steady_clock::now();
+  TelemetryServer* ptr_server = new TelemetryServer;
+  if (!ptr_server->create(address))
+  {
+    delete ptr_server;
+    return false;
+  }
+
+  s_telemetry_generation.fetch_add(1, std::memory_order_relaxed);
+  s_ptr_telemetry_server.store(ptr_server, std::memory_order_release);
+  return true;
+}
+
+void zv::Telemetry::destroy()
+{
+  TelemetryServer* ptr_server = s_ptr_telemetry_server.exchange(nullptr, std::memory_order_seq_cst);
+  if (ptr_server == nullptr)
+  {
+    return;
+  }
+
+  // publishes that started from now on find no server, the ones that found it may still push into its queues
+  while (s_telemetry_publish_count.load(std::memory_order_seq_cst) != 0)
+  {
+    std::this_thread::yield();
+  }
+  delete ptr_server;
+}
+
+bool zv::Telemetry::is_running()
+{
+  return s_ptr_telemetry_server.load(std::memory_order_acquire) != nullptr;
+}
+
+zv::TelemetryChannel zv::Telemetry::register_channel(const char* name)
+{
+  const StringId id = StringId::intern(name);
+  ChannelRegistry& registry = get_channel_registry();
+  std::lock_guard<std::mutex> lock{ registry.mutex };
+  const auto it = registry.ids.find(id);
+  if (it != registry.ids.end())
+  {
+    return it->second;
+  }
+
+  const TelemetryChannel channel = static_cast<TelemetryChannel>(registry.names.size());
+  registry.names.push_back(id.get_string());
+  registry.ids.emplace(id, channel);
+  registry.count.store(channel + 1, std::memory_order_release);
+  return channel;
+}
+
+u64 zv::Telemetry::now_ns()
+{
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_start_time).count());
+}
+
+void zv::Telemetry::publish_counter(TelemetryChannel channel, f64 value)
+{
+  publish(TelemetryRecord{ now_ns(), value, channel, eTelemetryRecord::Counter, 0, 0 });
+}
+
+void zv::Telemetry::publish_span(TelemetryChannel channel, u64 start_ns, u64 duration_ns)
+{
+  publish(TelemetryRecord{ start_ns, static_cast<f64>(duration_ns), channel, eTelemetryRecord::Span, 0, 0 });
+}
@@ -0,0 +1,83 @@
+/*
+ * Telemetry.h - live counters and profiler spans streamed to local clients
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  //------------------------------------------------------------------------------------------------------------------------------------
+  // Protocol
+  //------------------------------------------------------------------------------------------------------------------------------------
+
+  // A connection starts with a TelemetryHello, followed by TelemetryRecords in the order the server drained them: per
+  // producing thread in publish order, threads interleaved. A Channel record is followed by name_size bytes of the
+  // channel name without terminator and precedes every record of that channel. All values are little-endian, which
+  // is every platform the engine runs on.
+  constexpr u32 k_telemetry_magic = 0x4d54565a; // "ZVTM"
+  constexpr u16 k_telemetry_version = 1;
+
+  struct TelemetryHello
+  {
+    u32 magic;
+    u16 version;
+    u16 record_size;
+  };
+
+  enum class eTelemetryRecord : u8
+  {
+    // channel names a new channel id
+    Channel,
+    // value is the sample of a counter at timestamp_ns
+    Counter,
+    // a profiler scope from timestamp_ns that took value nanoseconds
+    Span,
+    // value records of the thread were dropped because its queue was full
+    Dropped,
+  };
+
+  struct TelemetryRecord
+  {
+    // nanoseconds since the server started
+    u64 timestamp_ns;
+    f64 value;
+    u32 channel;
+    eTelemetryRecord type;
+    // index of the producing thread in the order the threads first published
+    u8 thread;
+    u16 name_size;
+  };
+  static_assert(sizeof(TelemetryRecord) == 24, "the record layout is part of the protocol");
+
+  //------------------------------------------------------------------------------------------------------------------------------------
+  // Public telemetry interface
+  //------------------------------------------------------------------------------------------------------------------------------------
+
+  using TelemetryChannel = u32;
+
+  // Publishing pushes a record into a queue of the calling thread and never blocks, locks or allocates, except on the
+  // first publish of a thread; a full queue drops the record. A server thread drains the queues a few hundred times a
+  // second and sends the records to every connected client. Without a server all of it returns right away.
+  namespace Telemetry
+  {
+    // construction; the address is one of zv::LocalSocket, e.g. "unix:/tmp/zv.sock" or "tcp:7777". create() must not
+    // be called while other threads publish, it resets the clock. destroy() may be: it waits for the publishes that
+    // already found the server, later ones find none.
+    bool create(const char* address);
+    void destroy();
+    bool is_running();
+
+    // The same name always returns the same channel, also across create() and destroy(); channels can be registered
+    // before the server exists
+    TelemetryChannel register_channel(const char* name);
+
+    // nanoseconds since create(), the clock of all records
+    u64 now_ns();
+
+    void publish_counter(TelemetryChannel channel, f64 value);
+    void publish_span(TelemetryChannel channel, u64 start_ns, u64 duration_ns);
+  }
+}
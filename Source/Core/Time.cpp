@@ -5,6 +5,15 @@
 
 #include <Core/Time.h>
 #include <Core/Logger.h>
+#include <Core/PlatformContext.h>
+
+#include <random>
+
+#if (ARCH_X64 || ARCH_X86) && COMPILER_CL
+#include <intrin.h>
+#elif ARCH_X64 || ARCH_X86
+#include <x86intrin.h>
+#endif
 
 #include <ThirdParty/SDL2/include/SDL.h>
 
@@ -27,24 +36,42 @@ class Clock
   u64 m_elapsed_time{ 0 };
   u64 m_count_per_second{ 1 };
   u64 m_start_time{ 0 };
+  u64 m_frame_time{ 0 };
+  u64 m_frame_index{ 0 };
+  u64 m_seed{ 0 };
 
 public:
   Clock();
 
   void reset();
   void tick();
+  void tick(f64 delta_time_s);
 
   constexpr f32 elapsed_time_s() const { return static_cast<f32>(m_elapsed_time) / m_count_per_second; }
   constexpr f64 elapsed_time_s_64() const { return static_cast<f64>(m_elapsed_time) / m_count_per_second; }
 
   constexpr f32 delta_time_s() const { return static_cast<f32>(m_delta_time) / m_count_per_second; }
   constexpr f32 delta_time_s_32() const { return static_cast<f64>(m_delta_time) / m_count_per_second; }
+  constexpr f64 delta_time_s_64() const { return static_cast<f64>(m_delta_time) / m_count_per_second; }
+
+  constexpr f32 frame_time_s() const { return static_cast<f32>(m_frame_time) / m_count_per_second; }
+  constexpr f64 frame_time_s_64() const { return static_cast<f64>(m_frame_time) / m_count_per_second; }
+  constexpr f64 wall_time_s_64() const { return static_cast<f64>(m_current_time - m_start_time) / m_count_per_second; }
+  constexpr u64 frame_index() const { return m_frame_index; }
 
   void set_time_scale(f64 time_scale) { m_time_scale = time_scale; }
+
+  constexpr u64 seed() const { return m_seed; }
+  void set_seed(u64 seed) { m_seed = seed; }
+  u64 frame_seed() const;
+
+private:
+  void advance_wall_clock();
 };
 
 Clock::Clock()
   : m_count_per_second(SDL_GetPerformanceFrequency())
+  , m_seed((u64(std::random_device{}()) << 32) ^ std::random_device{}())
 {
 }
 
@@ -53,15 +80,42 @@ void Clock::reset()
   m_start_time = SDL_GetPerformanceCounter();
   m_current_time = m_start_time;
   m_delta_time = 0;
+  m_frame_time = 0;
+  m_frame_index = 0;
 }
 
 void Clock::tick()
+{
+  advance_wall_clock();
+
+  m_delta_time = m_frame_time * m_time_scale;
+  m_elapsed_time += m_delta_time;
+}
+
+void Clock::tick(f64 delta_time_s)
+{
+  advance_wall_clock();
+
+  // rounds back to the same count a recording on this machine converted to seconds, as long as it fits 53 bits
+  m_delta_time = static_cast<u64>(delta_time_s * m_count_per_second + 0.5);
+  m_elapsed_time += m_delta_time;
+}
+
+void Clock::advance_wall_clock()
 {
   m_previous_time = m_current_time;
   m_current_time = SDL_GetPerformanceCounter();
+  m_frame_time = m_current_time - m_previous_time;
+  ++m_frame_index;
+}
 
-  m_delta_time = ( m_current_time - m_previous_time ) * m_time_scale;
-  m_elapsed_time += m_delta_time;
+u64 Clock::frame_seed() const
+{
+  // splitmix64 finalizer, neighbouring frames get unrelated seeds
+  u64 x = m_seed + m_frame_index * 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
 }
 }
 
@@ -96,6 +150,12 @@ void zv::Time::Clock::tick()
   s_ptr_clock->tick();
 }
 
+void zv::Time::Clock::tick(f64 delta_time_s)
+{
+  ZV_ASSERT(s_ptr_clock);
+  s_ptr_clock->tick(delta_time_s);
+}
+
 f32 zv::Time::elapsed_time_s()
 { 
   return s_ptr_clock->elapsed_time_s();
@@ -116,7 +176,66 @@ f32 zv::Time::delta_time_s_32()
   return s_ptr_clock->delta_time_s_32();
 }
 
+f64 zv::Time::delta_time_s_64()
+{
+  return s_ptr_clock->delta_time_s_64();
+}
+
 void zv::Time::set_time_scale(f64 time_scale)
 {
   s_ptr_clock->set_time_scale(time_scale);
 }
+
+f32 zv::Time::frame_time_s()
+{
+  return s_ptr_clock->frame_time_s();
+}
+
+f64 zv::Time::frame_time_s_64()
+{
+  return s_ptr_clock->frame_time_s_64();
+}
+
+f64 zv::Time::wall_time_s_64()
+{
+  return s_ptr_clock->wall_time_s_64();
+}
+
+u64 zv::Time::frame_index()
+{
+  return s_ptr_clock->frame_index();
+}
+
+u64 zv::Time::seed()
+{
+  return s_ptr_clock->seed();
+}
+
+void zv::Time::set_seed(u64 seed)
+{
+  s_ptr_clock->set_seed(seed);
+}
+
+u64 zv::Time::frame_seed()
+{
+  return s_ptr_clock->frame_seed();
+}
+
+u64 zv::Time::read_counter()
+{
+  return SDL_GetPerformanceCounter();
+}
+
+u64 zv::Time::counter_frequency()
+{
+  return SDL_GetPerformanceFrequency();
+}
+
+u64 zv::Time::read_cycle_counter()
+{
+#if ARCH_X64 || ARCH_X86
+  return __rdtsc();
+#else
+  return SDL_GetPerformanceCounter();
+#endif
+}
@@ -19,7 +19,10 @@ namespace zv
       void destroy();
 
       void reset();
+      // advances by the wall-clock time since the previous tick, scaled by the time scale
       void tick();
+      // advances by a given delta instead, e.g. a recorded one; the time scale is not applied again
+      void tick(f64 delta_time_s);
     }
 
     // Public interface for timing information
@@ -27,6 +30,27 @@ namespace zv
     f64 elapsed_time_s_64();
     f32 delta_time_s();
     f32 delta_time_s_32();
+    f64 delta_time_s_64();
     void set_time_scale(f64 time_scale);
+
+    // Wall-clock duration of the last frame, unscaled; equal to the delta time unless it is scaled or replayed
+    f32 frame_time_s();
+    f64 frame_time_s_64();
+    // wall-clock time since the clock was reset
+    f64 wall_time_s_64();
+    // ticks since the clock was reset
+    u64 frame_index();
+
+    // Random seeds: every run draws a seed that recordings store and replays restore, anything random in a frame is
+    // seeded from frame_seed() so a replayed frame sees the same numbers as the recorded one
+    u64 seed();
+    void set_seed(u64 seed);
+    u64 frame_seed();
+
+    // Raw counters for measuring short intervals, they do not need a clock
+    u64 read_counter();
+    u64 counter_frequency();
+    // time stamp counter where the CPU has one, read_counter() elsewhere; counts at a constant rate, not in core cycles
+    u64 read_cycle_counter();
   }
 }
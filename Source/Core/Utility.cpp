@@ -8,12 +8,31 @@
 
 #if OS_WINDOWS
 #include <windows.h>
+#elif OS_LINUX
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#elif OS_MAC
+#include <sys/sysctl.h>
+#include <unistd.h>
 #endif
 
 bool zv::is_debugger_present()
 {
 #if OS_WINDOWS
   return IsDebuggerPresent();
+#elif OS_LINUX
+  // a traced process reports the pid of its tracer in /proc/self/status
+  std::ifstream status{ "/proc/self/status" };
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 10, "TracerPid:") == 0)
+    {
+      return std::atoi(line.c_str() + 10) != 0;
+    }
+  }
+  return false;
 #else
   int mib[4];
   struct kinfo_proc info;
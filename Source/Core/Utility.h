@@ -8,6 +8,7 @@
 #include <array>
 #include <algorithm>
 #include <numeric>
+#include <string_view>
 
 #include <Core/PrimitiveTypes.h>
 
@@ -36,6 +37,53 @@ namespace zv
   // check whether a debugger is attached
   bool is_debugger_present();
 
+  // 64-bit FNV-1a; passing the result of a previous call as seed hashes several ranges as one
+  constexpr u64 k_fnv1a_offset_basis = 0xcbf29ce484222325ull;
+  constexpr u64 k_fnv1a_prime = 0x100000001b3ull;
+
+  inline u64 hash_bytes(const void* ptr_data, u64 size, u64 seed = k_fnv1a_offset_basis)
+  {
+    const u8* ptr_bytes = static_cast<const u8*>(ptr_data);
+    u64 hash = seed;
+    for (u64 i = 0; i < size; ++i)
+    {
+      hash = (hash ^ ptr_bytes[i]) * k_fnv1a_prime;
+    }
+    return hash;
+  }
+
+  // null hashes like the empty string; the terminator is included, so consecutive strings cannot alias
+  constexpr u64 hash_string(const char* str, u64 seed = k_fnv1a_offset_basis)
+  {
+    u64 hash = seed;
+    if (str != nullptr)
+    {
+      for (; *str != '\0'; ++str)
+      {
+        hash = (hash ^ static_cast<u8>(*str)) * k_fnv1a_prime;
+      }
+    }
+    return hash * k_fnv1a_prime;
+  }
+
+  // same hash as the terminated string
+  constexpr u64 hash_string(std::string_view str, u64 seed = k_fnv1a_offset_basis)
+  {
+    u64 hash = seed;
+    for (const char c : str)
+    {
+      hash = (hash ^ static_cast<u8>(c)) * k_fnv1a_prime;
+    }
+    return hash * k_fnv1a_prime;
+  }
+
+  // for values without padding bytes, e.g. integers and enums
+  template<typename T>
+  u64 hash_value(const T& value, u64 seed)
+  {
+    return hash_bytes(&value, sizeof(T), seed);
+  }
+
   // Helper class for calculating moving averages
   template<typename T, u32 SAMPLE_SIZE>
   class MovingAverage
@@ -46,6 +94,7 @@ namespace zv
     T m_sample_rate_s;
     std::array<T, SAMPLE_SIZE> m_samples;
     u32 m_next_sample_index;
+    u32 m_sample_count;
     T m_samples_avg;
 
   public:
@@ -55,6 +104,7 @@ namespace zv
       , m_current_sample_accumulator(0)
       , m_sample_rate_s(sample_rate_s)
       , m_next_sample_index(0)
+      , m_sample_count(0)
       , m_samples_avg(0)
     {
         m_samples.fill(0.0);
@@ -88,6 +138,7 @@ namespace zv
         m_samples[m_next_sample_index] = m_current_sample_accumulator / m_current_sample_count;
 
         m_next_sample_index = (m_next_sample_index + 1) % static_cast<u32>(m_samples.size());
+        m_sample_count = std::min(m_sample_count + 1, static_cast<u32>(m_samples.size()));
 
         // calculate the average
         m_samples_avg = std::accumulate(m_samples.begin(), m_samples.end(), 0.0) / m_samples.size();
@@ -99,5 +150,9 @@ namespace zv
     }
 
     [[nodiscard]] T get_average() const { return m_samples_avg; }
+
+    // The ring of window averages; the first get_sample_count() entries are written, in no particular order
+    [[nodiscard]] const std::array<T, SAMPLE_SIZE>& get_samples() const { return m_samples; }
+    [[nodiscard]] u32 get_sample_count() const { return m_sample_count; }
   };
 }
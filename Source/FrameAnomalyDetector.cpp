@@ -0,0 +1,308 @@
+/*
+ * FrameAnomalyDetector.cpp - frame time spike detection against a rolling baseline with automatic trace capture
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <FrameAnomalyDetector.h>
+#include <Core/MemoryStats.h>
+#include <Core/PerfCounters.h>
+#include <Renderer/GpuProfiler.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <string_view>
+
+
+struct zv::FrameAnomalyDetector::FrameRecord
+{
+  u64 frame_index{ 0 };
+  std::chrono::steady_clock::time_point start_time;
+  f32 frame_time_ms{ 0.0f };
+  // allocations during the frame, on all threads
+  u64 allocation_count{ 0 };
+  u64 allocated_bytes{ 0 };
+  PerfFrameStats cpu_stats;
+  GpuFrameStats gpu_stats;
+};
+
+namespace
+{
+  // trace threads
+  constexpr u32 k_frame_thread_id = 1;
+  constexpr u32 k_log_thread_id = 2;
+
+  void write_json_string(std::ofstream& file, std::string_view text)
+  {
+    file << '"';
+    for (const char c : text)
+    {
+      switch (c)
+      {
+        case '"':  file << "\\\""; break;
+        case '\\': file << "\\\\"; break;
+        case '\n': file << "\\n"; break;
+        case '\r': file << "\\r"; break;
+        case '\t': file << "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20)
+          {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned char>(c));
+            file << buffer;
+          }
+          else
+          {
+            file << c;
+          }
+      }
+    }
+    file << '"';
+  }
+
+  // microseconds since the detector was created, the unit of trace timestamps
+  f64 to_trace_time_us(std::chrono::steady_clock::time_point time, std::chrono::steady_clock::time_point start_time)
+  {
+    return std::chrono::duration<f64, std::micro>(time - start_time).count();
+  }
+
+  void write_counter_args(std::ofstream& file, const zv::PerfCounterValues& counters)
+  {
+    if (counters.has(zv::ePerfCounter::Cycles))
+    {
+      file << ",\"cycles\":" << counters.get(zv::ePerfCounter::Cycles);
+    }
+    if (counters.has(zv::ePerfCounter::Instructions))
+    {
+      file << ",\"instructions\":" << counters.get(zv::ePerfCounter::Instructions);
+    }
+    if (counters.has(zv::ePerfCounter::Cycles) && counters.has(zv::ePerfCounter::Instructions))
+    {
+      file << ",\"ipc\":" << counters.get_ipc();
+    }
+    if (counters.has(zv::ePerfCounter::CacheMisses))
+    {
+      file << ",\"llc_misses\":" << counters.get(zv::ePerfCounter::CacheMisses);
+    }
+    if (counters.has(zv::ePerfCounter::BranchMisses))
+    {
+      file << ",\"branch_misses\":" << counters.get(zv::ePerfCounter::BranchMisses);
+    }
+    if (counters.has(zv::ePerfCounter::ContextSwitches))
+    {
+      file << ",\"context_switches\":" << counters.get(zv::ePerfCounter::ContextSwitches);
+    }
+  }
+}
+
+zv::FrameAnomalyDetector::FrameAnomalyDetector()
+{
+}
+
+zv::FrameAnomalyDetector::~FrameAnomalyDetector()
+{
+}
+
+bool zv::FrameAnomalyDetector::create(const CreateParams& params)
+{
+  destroy();
+
+  if (params.ptr_trace_directory == nullptr || params.history_frame_count == 0 || params.threshold_mads <= 0.0f)
+  {
+    ZV_ERROR("Invalid frame anomaly detector parameters.");
+    return false;
+  }
+
+  m_params = params;
+  m_trace_directory = params.ptr_trace_directory;
+  m_params.ptr_trace_directory = m_trace_directory.c_str();
+  m_history.resize(params.history_frame_count);
+  m_start_time = std::chrono::steady_clock::now();
+  m_frame_start_time = m_start_time;
+
+  const AllocationCounts allocations = MemoryStats::get_allocation_counts();
+  m_frame_start_allocation_count = allocations.allocation_count;
+  m_frame_start_allocated_bytes = allocations.allocated_bytes;
+
+  m_created = true;
+  return true;
+}
+
+void zv::FrameAnomalyDetector::destroy()
+{
+  if (m_created && m_anomaly_count > 0)
+  {
+    ZV_INFO("{} frame time anomalies, {} traces written.", m_anomaly_count, m_trace_count);
+  }
+
+  m_created = false;
+  m_baseline.reset();
+  m_history.clear();
+  m_frame_index = 0;
+  m_anomaly_count = 0;
+  m_trace_count = 0;
+  m_next_trace_frame_index = 0;
+  m_log_records.clear();
+}
+
+bool zv::FrameAnomalyDetector::end_frame(const PerfFrameStats& cpu_stats, const GpuFrameStats& gpu_stats)
+{
+  if (!m_created)
+  {
+    return false;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  const AllocationCounts allocations = MemoryStats::get_allocation_counts();
+
+  // assignments reuse the scope vectors of the slot, the ring does not allocate once it went around
+  FrameRecord& record = m_history[m_frame_index % m_history.size()];
+  record.frame_index = m_frame_index;
+  record.start_time = m_frame_start_time;
+  record.frame_time_ms = std::chrono::duration<f32, std::milli>(now - m_frame_start_time).count();
+  record.allocation_count = allocations.allocation_count - m_frame_start_allocation_count;
+  record.allocated_bytes = allocations.allocated_bytes - m_frame_start_allocated_bytes;
+  record.cpu_stats = cpu_stats;
+  record.gpu_stats = gpu_stats;
+
+  // compared against the baseline before the frame becomes part of it
+  bool anomaly = false;
+  bool traced = false;
+  if (m_baseline.is_ready())
+  {
+    const f32 threshold_ms = m_baseline.get_threshold_ms(m_params.threshold_mads, m_params.min_excess_ms);
+    if (record.frame_time_ms > threshold_ms)
+    {
+      anomaly = true;
+      ++m_anomaly_count;
+      ZV_WARNING("Frame {} took {:.3f} ms, the baseline is {:.3f} ms with a MAD of {:.3f} ms.", m_frame_index, record.frame_time_ms,
+                 m_baseline.get_median_ms(), m_baseline.get_mad_ms());
+
+      if (m_trace_count < m_params.max_trace_count && m_frame_index >= m_next_trace_frame_index)
+      {
+        write_trace(m_frame_index, threshold_ms);
+        traced = true;
+        ++m_trace_count;
+        m_next_trace_frame_index = m_frame_index + m_history.size();
+      }
+    }
+  }
+
+  m_baseline.add(record.frame_time_ms);
+
+  // writing a trace is not blamed on the next frame
+  const AllocationCounts next_allocations = traced ? MemoryStats::get_allocation_counts() : allocations;
+  ++m_frame_index;
+  m_frame_start_time = traced ? std::chrono::steady_clock::now() : now;
+  m_frame_start_allocation_count = next_allocations.allocation_count;
+  m_frame_start_allocated_bytes = next_allocations.allocated_bytes;
+  return anomaly;
+}
+
+bool zv::FrameAnomalyDetector::write_trace(u64 anomaly_frame_index, f32 threshold_ms)
+{
+  std::error_code error;
+  std::filesystem::create_directories(m_trace_directory, error);
+
+  char timestamp[32];
+  const std::time_t time = std::time(nullptr);
+  std::strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", std::localtime(&time));
+  const std::filesystem::path path = std::filesystem::path{ m_trace_directory } / (std::string{ "hitch_" } + timestamp + "_frame" + std::to_string(anomaly_frame_index) + ".json");
+
+  std::ofstream file{ path, std::ios::trunc };
+  if (!file)
+  {
+    ZV_WARNING("Failed to write the frame trace '{}'.", path.string());
+    return false;
+  }
+
+  // timestamps in microseconds of a long run need more than the default 6 digits
+  file << std::fixed << std::setprecision(3);
+
+  // oldest frame first; the anomaly is the latest one
+  const u64 frame_count = std::min<u64>(anomaly_frame_index + 1, m_history.size());
+  const u64 first_frame_index = anomaly_frame_index + 1 - frame_count;
+  const FrameRecord& first_record = m_history[first_frame_index % m_history.size()];
+  const FrameRecord& anomaly_record = m_history[anomaly_frame_index % m_history.size()];
+
+  file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{";
+  file << "\"anomaly_frame\":" << anomaly_frame_index << ",\"frame_time_ms\":" << anomaly_record.frame_time_ms;
+  file << ",\"baseline_median_ms\":" << m_baseline.get_median_ms() << ",\"baseline_mad_ms\":" << m_baseline.get_mad_ms() << ",\"threshold_ms\":" << threshold_ms;
+  file << "},\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << k_frame_thread_id << ",\"args\":{\"name\":\"Main\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << k_log_thread_id << ",\"args\":{\"name\":\"Log\"}}";
+
+  for (u64 frame_index = first_frame_index; frame_index <= anomaly_frame_index; ++frame_index)
+  {
+    const FrameRecord& record = m_history[frame_index % m_history.size()];
+    const f64 start_us = to_trace_time_us(record.start_time, m_start_time);
+
+    file << ",\n{\"name\":\"Frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << k_frame_thread_id << ",\"ts\":" << start_us
+         << ",\"dur\":" << record.frame_time_ms * 1000.0 << ",\"args\":{\"frame\":" << record.frame_index;
+    if (frame_index == anomaly_frame_index)
+    {
+      file << ",\"anomaly\":true";
+    }
+    file << ",\"allocations\":" << record.allocation_count << ",\"allocated_bytes\":" << record.allocated_bytes;
+    if (record.cpu_stats.valid)
+    {
+      write_counter_args(file, record.cpu_stats.counters);
+    }
+    // GPU results arrive a few frames late, they are attached to the frame they arrived in
+    if (record.gpu_stats.valid)
+    {
+      file << ",\"gpu_frame\":" << record.gpu_stats.frame_index << ",\"gpu_frame_time_ms\":" << record.gpu_stats.frame_time_ms;
+      for (const GpuScopeTiming& scope : record.gpu_stats.scopes)
+      {
+        file << ",";
+        write_json_string(file, std::string{ "gpu " } + scope.name + " ms");
+        file << ":" << scope.time_ms;
+      }
+    }
+    file << "}}";
+
+    if (record.cpu_stats.valid)
+    {
+      for (const PerfScopeCounters& scope : record.cpu_stats.scopes)
+      {
+        file << ",\n{\"name\":";
+        write_json_string(file, scope.name);
+        file << ",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":1,\"tid\":" << k_frame_thread_id << ",\"ts\":" << start_us + scope.start_ms * 1000.0
+             << ",\"dur\":" << scope.time_ms * 1000.0 << ",\"args\":{\"depth\":" << scope.depth;
+        write_counter_args(file, scope.counters);
+        file << "}}";
+      }
+    }
+
+    file << ",\n{\"name\":\"Allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":" << start_us << ",\"args\":{\"allocations\":" << record.allocation_count << "}}";
+  }
+
+  // messages of the tags kept in the log history since the first recorded frame, also of those that are not written to any log
+  Logger::get_history(m_log_records);
+  for (const Logger::LogRecord& log_record : m_log_records)
+  {
+    if (log_record.time < first_record.start_time)
+    {
+      continue;
+    }
+    file << ",\n{\"name\":";
+    write_json_string(file, log_record.tag);
+    file << ",\"cat\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << k_log_thread_id << ",\"ts\":" << to_trace_time_us(log_record.time, m_start_time)
+         << ",\"args\":{\"message\":";
+    write_json_string(file, log_record.message);
+    file << "}}";
+  }
+  file << "\n]}\n";
+
+  if (!file)
+  {
+    ZV_WARNING("Failed to write the frame trace '{}'.", path.string());
+    return false;
+  }
+
+  ZV_WARNING("Wrote the last {} frames before the anomaly to '{}'.", frame_count, path.string());
+  return true;
+}
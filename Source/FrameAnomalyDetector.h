@@ -0,0 +1,82 @@
+/*
+ * FrameAnomalyDetector.h - frame time spike detection against a rolling baseline with automatic trace capture
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <Core/Logger.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <FrameTimeBaseline.h>
+
+namespace zv
+{
+  struct PerfFrameStats;
+  struct GpuFrameStats;
+
+  // The baseline is the median of the latest frame times, its spread their median absolute deviation (FrameTimeBaseline),
+  // so neither moves with the spikes it is looking for. A frame slower than the median by threshold_mads scaled MADs,
+  // and by at least min_excess_ms, is an anomaly: the last history_frame_count frames with their CPU scopes
+  // and counters, GPU timings, allocation counts and the log messages in between are written to a trace file that
+  // chrome://tracing and Perfetto open.
+  class FrameAnomalyDetector : public NonCopyable
+  {
+  public:
+    struct CreateParams
+    {
+      // traces are written into it, it is created with the first one
+      const char* ptr_trace_directory{ nullptr };
+      f32 threshold_mads{ 8.0f };
+      f32 min_excess_ms{ 4.0f };
+      u32 history_frame_count{ 120 };
+      // later anomalies are only logged, so a run that keeps hitching does not fill the disk
+      u32 max_trace_count{ 16 };
+    };
+
+  public:
+    FrameAnomalyDetector();
+    ~FrameAnomalyDetector();
+
+  public:
+    bool create(const CreateParams& params);
+    void destroy();
+
+    // Once per frame after its counters are final; the frame lasted from the previous call to this one. Returns true
+    // if it was an anomaly.
+    bool end_frame(const PerfFrameStats& cpu_stats, const GpuFrameStats& gpu_stats);
+
+    f32 get_baseline_median_ms() const { return m_baseline.get_median_ms(); }
+    f32 get_baseline_mad_ms() const { return m_baseline.get_mad_ms(); }
+    u32 get_anomaly_count() const { return m_anomaly_count; }
+
+  private:
+    struct FrameRecord;
+
+    bool write_trace(u64 anomaly_frame_index, f32 threshold_ms);
+
+    CreateParams m_params;
+    std::string m_trace_directory;
+    bool m_created{ false };
+
+    FrameTimeBaseline m_baseline;
+
+    // ring of the latest frames, m_frame_index % size is the slot of the next one
+    std::vector<FrameRecord> m_history;
+    u64 m_frame_index{ 0 };
+    std::chrono::steady_clock::time_point m_start_time;
+    std::chrono::steady_clock::time_point m_frame_start_time;
+    u64 m_frame_start_allocation_count{ 0 };
+    u64 m_frame_start_allocated_bytes{ 0 };
+
+    u32 m_anomaly_count{ 0 };
+    u32 m_trace_count{ 0 };
+    // the history of a trace is not written again by the next one
+    u64 m_next_trace_frame_index{ 0 };
+    std::vector<Logger::LogRecord> m_log_records;
+  };
+}
@@ -0,0 +1,172 @@
+/*
+ * FrameCapture.cpp - recording and deterministic replay of frame times, input events and random seeds
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <FrameCapture.h>
+#include <Core/Logger.h>
+#include <Core/Time.h>
+
+#include <cstddef>
+#include <thread>
+
+namespace
+{
+  constexpr u32 k_capture_magic = 0x43465a56; // "ZVFC"
+  constexpr u32 k_capture_version = 1;
+  // larger counts can only come from a damaged file
+  constexpr u32 k_max_frame_events = 1 << 16;
+
+  struct CaptureHeader
+  {
+    u32 magic;
+    u32 version;
+    // frames the capture covers, written when it is closed; 0 if it was not closed properly
+    u64 frame_count;
+    // Time::seed() of the recorded run
+    u64 seed;
+  };
+}
+
+zv::FrameCapture::~FrameCapture()
+{
+  destroy();
+}
+
+bool zv::FrameCapture::create(const CreateParams& params)
+{
+  destroy();
+
+  if (params.mode == eCaptureMode::Record)
+  {
+    ZV_ASSERT(params.ptr_path != nullptr);
+    m_file = std::ofstream{ params.ptr_path, std::ios::binary | std::ios::trunc };
+    const CaptureHeader header{ k_capture_magic, k_capture_version, 0, Time::seed() };
+    if (!m_file || !m_file.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+    {
+      ZV_ERROR("Failed to create the frame capture '{}'.", params.ptr_path);
+      m_file = std::ofstream{};
+      return false;
+    }
+  }
+  else if (params.mode == eCaptureMode::Replay)
+  {
+    ZV_ASSERT(params.ptr_path != nullptr);
+    if (!read_capture(params.ptr_path))
+    {
+      ZV_ERROR("Failed to read the frame capture '{}'.", params.ptr_path);
+      m_frames.clear();
+      m_events.clear();
+      return false;
+    }
+    ZV_INFO("Replaying {} frames with {} input events from '{}'{}.", m_frame_count, m_events.size(), params.ptr_path, params.paced ? ", paced" : "");
+  }
+
+  m_mode = params.mode;
+  m_paced = params.paced;
+  return true;
+}
+
+void zv::FrameCapture::destroy()
+{
+  if (m_file.is_open())
+  {
+    m_file.seekp(offsetof(CaptureHeader, frame_count));
+    m_file.write(reinterpret_cast<const char*>(&m_frame_count), sizeof(m_frame_count));
+    m_file.close();
+    ZV_INFO("Captured {} frames.", m_frame_count);
+  }
+
+  m_mode = eCaptureMode::None;
+  m_frame_count = 0;
+  m_frames.clear();
+  m_events.clear();
+  m_next_frame = 0;
+  m_next_event = 0;
+  m_paced = false;
+}
+
+void zv::FrameCapture::write_frame(f64 delta_time_s, const std::vector<InputEvent>& events)
+{
+  ZV_ASSERT(m_mode == eCaptureMode::Record);
+  if (!m_file.is_open())
+  {
+    return;
+  }
+
+  const FrameRecord record{ delta_time_s, static_cast<u32>(events.size()), 0 };
+  m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+  m_file.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(InputEvent));
+  ++m_frame_count;
+}
+
+bool zv::FrameCapture::read_frame(f64& out_delta_time_s, const InputEvent*& out_ptr_events, u32& out_event_count)
+{
+  ZV_ASSERT(m_mode == eCaptureMode::Replay);
+  if (m_next_frame >= m_frames.size())
+  {
+    return false;
+  }
+
+  const FrameRecord& record = m_frames[m_next_frame++];
+  out_delta_time_s = record.delta_time_s;
+  out_ptr_events = m_events.data() + m_next_event;
+  out_event_count = record.event_count;
+  m_next_event += record.event_count;
+
+  // the deadlines add up the recorded deltas, so a late frame does not delay all following ones
+  if (m_paced)
+  {
+    const auto now = std::chrono::steady_clock::now();
+    if (m_next_frame == 1)
+    {
+      m_frame_deadline = now;
+    }
+    m_frame_deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>(record.delta_time_s));
+    if (m_frame_deadline > now)
+    {
+      std::this_thread::sleep_until(m_frame_deadline);
+    }
+  }
+
+  return true;
+}
+
+bool zv::FrameCapture::read_capture(const char* path)
+{
+  std::ifstream file{ path, std::ios::binary };
+  CaptureHeader header;
+  if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != k_capture_magic || header.version != k_capture_version)
+  {
+    return false;
+  }
+
+  // a capture that was not closed properly ends with its last complete frame
+  FrameRecord record;
+  while ((header.frame_count == 0 || m_frames.size() < header.frame_count) && file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+  {
+    if (record.event_count > k_max_frame_events)
+    {
+      break;
+    }
+    const size_t first_event = m_events.size();
+    m_events.resize(first_event + record.event_count);
+    if (!file.read(reinterpret_cast<char*>(m_events.data() + first_event), record.event_count * sizeof(InputEvent)))
+    {
+      m_events.resize(first_event);
+      break;
+    }
+    m_frames.push_back(record);
+  }
+
+  if (header.frame_count != 0 && m_frames.size() != header.frame_count)
+  {
+    return false;
+  }
+
+  m_frame_count = m_frames.size();
+  m_next_frame = 0;
+  m_next_event = 0;
+  Time::set_seed(header.seed);
+  return true;
+}
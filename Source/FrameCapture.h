@@ -0,0 +1,85 @@
+/*
+ * FrameCapture.h - recording and deterministic replay of frame times, input events and random seeds
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <Input.h>
+
+namespace zv
+{
+  enum class eCaptureMode : u8
+  {
+    None,
+    Record,
+    Replay,
+  };
+
+  // A capture stores the run seed and, per frame, the delta time and the input events the frame consumed. Replaying it
+  // ticks Time with the recorded deltas and feeds the recorded events to the input system, so every frame simulates
+  // the same state as in the recorded run and only the measured frame times differ between builds.
+  //
+  // File layout: header, then per frame a FrameRecord followed by its event_count InputEvents.
+  class FrameCapture : public NonCopyable
+  {
+  public:
+    struct CreateParams
+    {
+      eCaptureMode mode{ eCaptureMode::None };
+      const char* ptr_path{ nullptr };
+      // replays wait until the recorded time of each frame has passed instead of running as fast as possible
+      bool paced{ false };
+    };
+
+  public:
+    FrameCapture() = default;
+    ~FrameCapture();
+
+  public:
+    // Record writes the header with Time::seed(), Replay reads the whole capture and sets Time::seed()
+    bool create(const CreateParams& params);
+    void destroy();
+
+    eCaptureMode get_mode() const { return m_mode; }
+
+    // record; called after the frame was ticked and its input updated
+    void write_frame(f64 delta_time_s, const std::vector<InputEvent>& events);
+
+    // replay; false once all frames were replayed
+    bool read_frame(f64& out_delta_time_s, const InputEvent*& out_ptr_events, u32& out_event_count);
+    u64 get_frame_count() const { return m_frame_count; }
+
+  private:
+    struct FrameRecord
+    {
+      // scaled delta time the frame was simulated with
+      f64 delta_time_s;
+      u32 event_count;
+      u32 padding;
+    };
+    static_assert(sizeof(FrameRecord) == 16, "captures depend on the record layout");
+
+    bool read_capture(const char* path);
+
+  private:
+    eCaptureMode m_mode{ eCaptureMode::None };
+    u64 m_frame_count{ 0 };
+
+    std::ofstream m_file;
+
+    std::vector<FrameRecord> m_frames;
+    std::vector<InputEvent> m_events;
+    u64 m_next_frame{ 0 };
+    size_t m_next_event{ 0 };
+
+    bool m_paced{ false };
+    std::chrono::steady_clock::time_point m_frame_deadline;
+  };
+}
@@ -0,0 +1,58 @@
+/*
+ * FrameTimeBaseline.cpp - rolling median and median absolute deviation of single frame times
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <FrameTimeBaseline.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // scales the MAD to the standard deviation of normally distributed samples
+  constexpr f32 k_mad_to_sigma = 1.4826f;
+
+  f32 compute_median(f32* ptr_values, u32 count)
+  {
+    const u32 middle = count / 2;
+    std::nth_element(ptr_values, ptr_values + middle, ptr_values + count);
+    const f32 upper = ptr_values[middle];
+    if (count % 2 != 0)
+    {
+      return upper;
+    }
+    return (*std::max_element(ptr_values, ptr_values + middle) + upper) * 0.5f;
+  }
+}
+
+void zv::FrameTimeBaseline::reset()
+{
+  m_next_index = 0;
+  m_count = 0;
+  m_median_ms = 0.0f;
+  m_mad_ms = 0.0f;
+}
+
+void zv::FrameTimeBaseline::add(f32 frame_time_ms)
+{
+  m_frame_times_ms[m_next_index] = frame_time_ms;
+  m_next_index = (m_next_index + 1) % k_frame_count;
+  m_count = std::min(m_count + 1, k_frame_count);
+
+  // a few microseconds for the whole ring, cheap enough to do every frame
+  std::array<f32, k_frame_count> values;
+  std::copy_n(m_frame_times_ms.begin(), m_count, values.begin());
+  m_median_ms = compute_median(values.data(), m_count);
+
+  for (u32 i = 0; i < m_count; ++i)
+  {
+    values[i] = std::abs(values[i] - m_median_ms);
+  }
+  m_mad_ms = compute_median(values.data(), m_count);
+}
+
+f32 zv::FrameTimeBaseline::get_threshold_ms(f32 threshold_mads, f32 min_excess_ms) const
+{
+  return m_median_ms + std::max(threshold_mads * k_mad_to_sigma * m_mad_ms, min_excess_ms);
+}
@@ -0,0 +1,44 @@
+/*
+ * FrameTimeBaseline.h - rolling median and median absolute deviation of single frame times
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <array>
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  // Median and MAD of the last k_frame_count frame times. They are taken over single frames, the same population a
+  // frame is compared with: means over windows of frames spread less by about the square root of the frames per window,
+  // a threshold in MADs of those would be far too tight.
+  class FrameTimeBaseline
+  {
+  public:
+    // about 4 s at 60 fps, the baseline adapts to a new scene within a few seconds
+    static constexpr u32 k_frame_count = 256;
+    // frames that must have been added before the baseline is used
+    static constexpr u32 k_min_frame_count = 60;
+
+  public:
+    void reset();
+    // adds a frame and updates the median and MAD
+    void add(f32 frame_time_ms);
+
+    bool is_ready() const { return m_count >= k_min_frame_count; }
+    // median plus threshold_mads MADs scaled to the standard deviation, at least min_excess_ms above the median
+    f32 get_threshold_ms(f32 threshold_mads, f32 min_excess_ms) const;
+
+    f32 get_median_ms() const { return m_median_ms; }
+    f32 get_mad_ms() const { return m_mad_ms; }
+
+  private:
+    std::array<f32, k_frame_count> m_frame_times_ms{};
+    u32 m_next_index{ 0 };
+    u32 m_count{ 0 };
+    f32 m_median_ms{ 0.0f };
+    f32 m_mad_ms{ 0.0f };
+  };
+}
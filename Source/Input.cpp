@@ -0,0 +1,257 @@
+/*
+ * Input.cpp - event-driven input with action mapping and per-frame snapshots
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Input.h>
+#include <Core/Logger.h>
+
+#include <ThirdParty/SDL2/include/SDL.h>
+
+zv::InputSystem::~InputSystem()
+{
+  destroy();
+}
+
+bool zv::InputSystem::create()
+{
+  destroy();
+
+  m_start_counter = SDL_GetPerformanceCounter();
+  m_counter_frequency = SDL_GetPerformanceFrequency();
+  return true;
+}
+
+void zv::InputSystem::destroy()
+{
+  InputEvent event;
+  while (m_queue.pop(event))
+  {
+  }
+
+  m_dropped_event_count = 0;
+  m_snapshot = InputSnapshot{};
+  m_next_frame_index = 0;
+  m_frame_events.clear();
+}
+
+zv::ActionId zv::InputSystem::add_action(const char* name)
+{
+  ZV_ASSERT(m_action_names.size() < k_max_input_actions);
+  m_action_names.emplace_back(name);
+  return static_cast<ActionId>(m_action_names.size() - 1);
+}
+
+void zv::InputSystem::bind_key(ActionId action, u32 scancode)
+{
+  ZV_ASSERT(action < m_action_names.size() && scancode < k_max_scancodes);
+  m_bindings.push_back(Binding{ action, false, scancode });
+}
+
+void zv::InputSystem::bind_mouse_button(ActionId action, u8 button)
+{
+  ZV_ASSERT(action < m_action_names.size() && button < 32);
+  m_bindings.push_back(Binding{ action, true, button });
+}
+
+void zv::InputSystem::pump_events()
+{
+  SDL_Event sdl_event;
+  while (SDL_PollEvent(&sdl_event) != 0)
+  {
+    const bool consumed = m_event_filter && m_event_filter(sdl_event);
+
+    // split so the product cannot overflow with nanosecond counters
+    const u64 ticks = SDL_GetPerformanceCounter() - m_start_counter;
+    InputEvent event{};
+    event.timestamp_us = ticks / m_counter_frequency * 1000000 + ticks % m_counter_frequency * 1000000 / m_counter_frequency;
+
+    // releases always pass, otherwise a key pressed before the UI took focus would stay down
+    bool queue = !consumed;
+    switch (sdl_event.type)
+    {
+      case SDL_QUIT:
+      {
+        event.type = eInputEventType::Quit;
+        queue = true;
+        break;
+      }
+      case SDL_KEYDOWN:
+      {
+        event.type = eInputEventType::KeyDown;
+        event.code = static_cast<u32>(sdl_event.key.keysym.scancode);
+        queue &= sdl_event.key.repeat == 0;
+        break;
+      }
+      case SDL_KEYUP:
+      {
+        event.type = eInputEventType::KeyUp;
+        event.code = static_cast<u32>(sdl_event.key.keysym.scancode);
+        queue = true;
+        break;
+      }
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      {
+        const bool down = sdl_event.type == SDL_MOUSEBUTTONDOWN;
+        event.type = down ? eInputEventType::MouseButtonDown : eInputEventType::MouseButtonUp;
+        event.code = sdl_event.button.button;
+        event.x = static_cast<f32>(sdl_event.button.x);
+        event.y = static_cast<f32>(sdl_event.button.y);
+        queue |= !down;
+        break;
+      }
+      case SDL_MOUSEMOTION:
+      {
+        event.type = eInputEventType::MouseMotion;
+        event.x = static_cast<f32>(sdl_event.motion.x);
+        event.y = static_cast<f32>(sdl_event.motion.y);
+        event.dx = static_cast<f32>(sdl_event.motion.xrel);
+        event.dy = static_cast<f32>(sdl_event.motion.yrel);
+        break;
+      }
+      case SDL_MOUSEWHEEL:
+      {
+        event.type = eInputEventType::MouseWheel;
+        event.x = static_cast<f32>(sdl_event.wheel.x);
+        event.y = static_cast<f32>(sdl_event.wheel.y);
+        break;
+      }
+      default:
+      {
+        queue = false;
+        break;
+      }
+    }
+
+    if (queue && !m_queue.push(event))
+    {
+      m_dropped_event_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+const zv::InputSnapshot& zv::InputSystem::update()
+{
+  begin_snapshot();
+
+  InputEvent event;
+  while (m_queue.pop(event))
+  {
+    apply_event(event, m_snapshot);
+    m_frame_events.push_back(event);
+  }
+
+  end_snapshot();
+  return m_snapshot;
+}
+
+const zv::InputSnapshot& zv::InputSystem::update(const InputEvent* ptr_events, u32 count)
+{
+  begin_snapshot();
+
+  // live input is not part of the frame, but a replay can still be ended by closing the window
+  InputEvent event;
+  while (m_queue.pop(event))
+  {
+    m_snapshot.quit_requested |= event.type == eInputEventType::Quit;
+  }
+
+  for (u32 i = 0; i < count; ++i)
+  {
+    apply_event(ptr_events[i], m_snapshot);
+    m_frame_events.push_back(ptr_events[i]);
+  }
+
+  end_snapshot();
+  return m_snapshot;
+}
+
+void zv::InputSystem::begin_snapshot()
+{
+  m_snapshot.frame_index = m_next_frame_index++;
+  m_snapshot.actions_pressed = 0;
+  m_snapshot.actions_released = 0;
+  m_snapshot.mouse_dx = 0.0f;
+  m_snapshot.mouse_dy = 0.0f;
+  m_snapshot.wheel = 0.0f;
+  m_frame_events.clear();
+}
+
+void zv::InputSystem::end_snapshot()
+{
+  m_snapshot.actions_down = 0;
+  for (const Binding& binding : m_bindings)
+  {
+    const bool down = binding.mouse ? (m_snapshot.mouse_buttons_down & (1u << binding.code)) != 0 : m_snapshot.keys_down[binding.code];
+    if (down)
+    {
+      m_snapshot.actions_down |= u64{ 1 } << binding.action;
+    }
+  }
+}
+
+void zv::InputSystem::apply_event(const InputEvent& event, InputSnapshot& snapshot) const
+{
+  auto get_actions = [this](bool mouse, u32 code)
+  {
+    u64 actions = 0;
+    for (const Binding& binding : m_bindings)
+    {
+      if (binding.mouse == mouse && binding.code == code)
+      {
+        actions |= u64{ 1 } << binding.action;
+      }
+    }
+    return actions;
+  };
+
+  snapshot.timestamp_us = event.timestamp_us;
+  switch (event.type)
+  {
+    case eInputEventType::Quit:
+    {
+      snapshot.quit_requested = true;
+      break;
+    }
+    case eInputEventType::KeyDown:
+    case eInputEventType::KeyUp:
+    {
+      if (event.code >= k_max_scancodes)
+      {
+        break;
+      }
+      const bool down = event.type == eInputEventType::KeyDown;
+      snapshot.keys_down[event.code] = down;
+      (down ? snapshot.actions_pressed : snapshot.actions_released) |= get_actions(false, event.code);
+      break;
+    }
+    case eInputEventType::MouseButtonDown:
+    case eInputEventType::MouseButtonUp:
+    {
+      if (event.code >= 32)
+      {
+        break;
+      }
+      const bool down = event.type == eInputEventType::MouseButtonDown;
+      snapshot.mouse_buttons_down = down ? snapshot.mouse_buttons_down | (1u << event.code) : snapshot.mouse_buttons_down & ~(1u << event.code);
+      snapshot.mouse_x = event.x;
+      snapshot.mouse_y = event.y;
+      (down ? snapshot.actions_pressed : snapshot.actions_released) |= get_actions(true, event.code);
+      break;
+    }
+    case eInputEventType::MouseMotion:
+    {
+      snapshot.mouse_x = event.x;
+      snapshot.mouse_y = event.y;
+      snapshot.mouse_dx += event.dx;
+      snapshot.mouse_dy += event.dy;
+      break;
+    }
+    case eInputEventType::MouseWheel:
+    {
+      snapshot.wheel += event.y;
+      break;
+    }
+  }
+}
@@ -0,0 +1,151 @@
+/*
+ * Input.h - event-driven input with action mapping and per-frame snapshots
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/SpscQueue.h>
+#include <Core/Utility.h>
+
+union SDL_Event;
+
+namespace zv
+{
+  enum class eInputEventType : u8
+  {
+    Quit,
+    KeyDown,
+    KeyUp,
+    MouseButtonDown,
+    MouseButtonUp,
+    MouseMotion,
+    MouseWheel,
+  };
+
+  // Fixed layout, frame captures store it as is
+  struct InputEvent
+  {
+    // since the input system was created
+    u64 timestamp_us;
+    eInputEventType type;
+    u8 padding[3];
+    // SDL scancode for keys, SDL button index for mouse buttons
+    u32 code;
+    // mouse position for motion and buttons, wheel delta for the wheel
+    f32 x;
+    f32 y;
+    // relative mouse motion
+    f32 dx;
+    f32 dy;
+  };
+  static_assert(sizeof(InputEvent) == 32, "recordings depend on the event layout");
+
+  using ActionId = u32;
+  constexpr u32 k_max_input_actions = 64;
+  constexpr u32 k_max_scancodes = 512;
+
+  // State of one frame, a plain value that can be copied to the threads that simulate the frame
+  struct InputSnapshot
+  {
+    u64 frame_index{ 0 };
+    // time of the latest event of the frame
+    u64 timestamp_us{ 0 };
+
+    // bit per action
+    u64 actions_down{ 0 };
+    u64 actions_pressed{ 0 };
+    u64 actions_released{ 0 };
+
+    std::bitset<k_max_scancodes> keys_down;
+    // bit per SDL button index
+    u32 mouse_buttons_down{ 0 };
+    f32 mouse_x{ 0.0f };
+    f32 mouse_y{ 0.0f };
+    f32 mouse_dx{ 0.0f };
+    f32 mouse_dy{ 0.0f };
+    f32 wheel{ 0.0f };
+
+    bool quit_requested{ false };
+
+    bool is_down(ActionId action) const { return (actions_down & (u64{ 1 } << action)) != 0; }
+    // pressed or released at least once during the frame, also if it was released / pressed again before its end
+    bool was_pressed(ActionId action) const { return (actions_pressed & (u64{ 1 } << action)) != 0; }
+    bool was_released(ActionId action) const { return (actions_released & (u64{ 1 } << action)) != 0; }
+    bool is_key_down(u32 scancode) const { return scancode < k_max_scancodes && keys_down[scancode]; }
+  };
+
+  // pump_events() runs on the thread that owns the window and moves SDL events into a lock-free queue, update() may run
+  // on another thread and turns the queued events into the next snapshot. A replay passes the events of the recorded
+  // frame to update() instead, so it sees exactly the events of the recorded one, regardless of timing.
+  class InputSystem : public NonCopyable
+  {
+  public:
+    // returns true if the event was consumed, e.g. by the UI, and must not reach the game; releases and quit always do
+    using EventFilterFn = std::function<bool(SDL_Event& event)>;
+
+    static constexpr u32 k_queue_capacity = 1024;
+
+  public:
+    InputSystem() = default;
+    ~InputSystem();
+
+  public:
+    bool create();
+    void destroy();
+
+    // actions are referenced by the returned id, at most k_max_input_actions
+    ActionId add_action(const char* name);
+    const char* get_action_name(ActionId action) const { return m_action_names[action].c_str(); }
+    void bind_key(ActionId action, u32 scancode);
+    void bind_mouse_button(ActionId action, u8 button);
+
+    void set_event_filter(EventFilterFn fn) { m_event_filter = std::move(fn); }
+
+    // producer; polls SDL
+    void pump_events();
+    // consumer; builds the snapshot of the next frame from the queued events
+    const InputSnapshot& update();
+    // consumer; builds the snapshot of the next frame from recorded events, queued events are dropped except quit
+    const InputSnapshot& update(const InputEvent* ptr_events, u32 count);
+    const InputSnapshot& get_snapshot() const { return m_snapshot; }
+    // events the last update() applied, in order
+    const std::vector<InputEvent>& get_frame_events() const { return m_frame_events; }
+
+    // events lost because the queue was full
+    u32 get_dropped_event_count() const { return m_dropped_event_count.load(std::memory_order_relaxed); }
+
+  private:
+    struct Binding
+    {
+      ActionId action;
+      bool mouse;
+      u32 code;
+    };
+
+    void begin_snapshot();
+    void end_snapshot();
+    void apply_event(const InputEvent& event, InputSnapshot& snapshot) const;
+
+  private:
+    u64 m_start_counter{ 0 };
+    u64 m_counter_frequency{ 1 };
+
+    SpscQueue<InputEvent, k_queue_capacity> m_queue;
+    std::atomic<u32> m_dropped_event_count{ 0 };
+    EventFilterFn m_event_filter;
+
+    std::vector<std::string> m_action_names;
+    std::vector<Binding> m_bindings;
+    InputSnapshot m_snapshot;
+    u64 m_next_frame_index{ 0 };
+    std::vector<InputEvent> m_frame_events;
+  };
+}
@@ -0,0 +1,94 @@
+/*
+ * Half.h - conversion between 32 bit and 16 bit IEEE floats
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  // Rounds to nearest even; values beyond the half range become infinity, NaNs stay NaNs. Matches f16tof32 in HLSL.
+  inline u16 f32_to_f16(f32 value)
+  {
+    constexpr u32 f32_infinity = 255u << 23;
+    constexpr u32 f16_overflow = (127u + 16u) << 23;
+    constexpr u32 f16_min_normal = 113u << 23;
+    constexpr u32 denormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    u32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const u32 sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    u16 result;
+    if (bits >= f16_overflow)
+    {
+      result = bits > f32_infinity ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < f16_min_normal)
+    {
+      // let the FPU round the mantissa into the denormal range
+      f32 denormal;
+      f32 magic;
+      std::memcpy(&denormal, &bits, sizeof(bits));
+      std::memcpy(&magic, &denormal_magic, sizeof(magic));
+      denormal += magic;
+      std::memcpy(&bits, &denormal, sizeof(bits));
+      result = static_cast<u16>(bits - denormal_magic);
+    }
+    else
+    {
+      const u32 mantissa_odd = (bits >> 13) & 1u;
+      // rebias the exponent and round, unsigned wrap-around is intended
+      bits += ((15u - 127u) << 23) + 0xfffu;
+      bits += mantissa_odd;
+      result = static_cast<u16>(bits >> 13);
+    }
+
+    return static_cast<u16>(result | (sign >> 16));
+  }
+
+  inline f32 f16_to_f32(u16 value)
+  {
+    const u32 sign = static_cast<u32>(value & 0x8000u) << 16;
+    u32 exponent = (value >> 10) & 0x1fu;
+    u32 mantissa = value & 0x3ffu;
+
+    u32 bits;
+    if (exponent == 0)
+    {
+      if (mantissa == 0)
+      {
+        bits = sign;
+      }
+      else
+      {
+        // normalize the denormal
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400u) == 0)
+        {
+          mantissa <<= 1;
+          --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+      }
+    }
+    else if (exponent == 31)
+    {
+      bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else
+    {
+      bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    f32 result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+}
@@ -0,0 +1,278 @@
+/*
+ * Simd.cpp - SIMD vector, matrix and quaternion math for hot paths
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Math/Simd.h>
+
+
+const char* zv::simd::get_instruction_set_name()
+{
+#if SIMD_AVX2
+  return "AVX2";
+#elif SIMD_SSE
+  return "SSE2";
+#elif SIMD_NEON
+  return "NEON";
+#else
+  return "Scalar";
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Mat4
+//------------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+  using zv::simd::Vec4;
+
+  // 2x2 row-major matrices packed as (m00, m01, m10, m11)
+
+  // a * b
+  inline Vec4 mat2_mul(Vec4 a, Vec4 b)
+  {
+    using namespace zv::simd;
+    return add(mul(a, swizzle<0, 3, 0, 3>(b)), mul(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+  }
+
+  // adjugate(a) * b
+  inline Vec4 mat2_adj_mul(Vec4 a, Vec4 b)
+  {
+    using namespace zv::simd;
+    return sub(mul(swizzle<3, 3, 0, 0>(a), b), mul(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+  }
+
+  // a * adjugate(b)
+  inline Vec4 mat2_mul_adj(Vec4 a, Vec4 b)
+  {
+    using namespace zv::simd;
+    return sub(mul(a, swizzle<3, 0, 3, 0>(b)), mul(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+  }
+}
+
+// Block-wise inverse: the matrix is split into the 2x2 sub-matrices A B / C D and inverted through their adjugates,
+// which only needs shuffles, multiplies and a single division.
+zv::simd::Mat4 zv::simd::inverse(const Mat4& m)
+{
+  const Vec4 a = shuffle<0, 1, 0, 1>(m.r[0], m.r[1]);
+  const Vec4 b = shuffle<2, 3, 2, 3>(m.r[0], m.r[1]);
+  const Vec4 c = shuffle<0, 1, 0, 1>(m.r[2], m.r[3]);
+  const Vec4 d = shuffle<2, 3, 2, 3>(m.r[2], m.r[3]);
+
+  // determinants of the sub-matrices as (|A|, |B|, |C|, |D|)
+  const Vec4 det_sub = sub(mul(shuffle<0, 2, 0, 2>(m.r[0], m.r[2]), shuffle<1, 3, 1, 3>(m.r[1], m.r[3])),
+                           mul(shuffle<1, 3, 1, 3>(m.r[0], m.r[2]), shuffle<0, 2, 0, 2>(m.r[1], m.r[3])));
+  const Vec4 det_a = broadcast<0>(det_sub);
+  const Vec4 det_b = broadcast<1>(det_sub);
+  const Vec4 det_c = broadcast<2>(det_sub);
+  const Vec4 det_d = broadcast<3>(det_sub);
+
+  const Vec4 d_c = mat2_adj_mul(d, c);
+  const Vec4 a_b = mat2_adj_mul(a, b);
+
+  Vec4 x = sub(mul(det_d, a), mat2_mul(b, d_c));
+  Vec4 w = sub(mul(det_a, d), mat2_mul(c, a_b));
+  Vec4 y = sub(mul(det_b, c), mat2_mul_adj(d, a_b));
+  Vec4 z = sub(mul(det_c, b), mat2_mul_adj(a, d_c));
+
+  // |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+  const Vec4 trace = sum_all(mul(a_b, swizzle<0, 2, 1, 3>(d_c)));
+  const Vec4 det_m = sub(add(mul(det_a, det_d), mul(det_b, det_c)), trace);
+
+  const Vec4 rcp_det = div(set(1.0f, -1.0f, -1.0f, 1.0f), det_m);
+  x = mul(x, rcp_det);
+  y = mul(y, rcp_det);
+  z = mul(z, rcp_det);
+  w = mul(w, rcp_det);
+
+  // the adjugate shuffle and the store shuffle are combined
+  return { { shuffle<3, 1, 3, 1>(x, y), shuffle<2, 0, 2, 0>(x, y), shuffle<3, 1, 3, 1>(z, w), shuffle<2, 0, 2, 0>(z, w) } };
+}
+
+zv::simd::Mat4 zv::simd::inverse_affine(const Mat4& m)
+{
+  // transpose the 3x3 part and divide by the squared row lengths to undo the scale
+  const Vec4 t0 = shuffle<0, 1, 0, 1>(m.r[0], m.r[1]);
+  const Vec4 t1 = shuffle<2, 3, 2, 3>(m.r[0], m.r[1]);
+  Vec4 r0 = shuffle<0, 2, 0, 3>(t0, m.r[2]);
+  Vec4 r1 = shuffle<1, 3, 1, 3>(t0, m.r[2]);
+  Vec4 r2 = shuffle<0, 2, 2, 3>(t1, m.r[2]);
+
+  Vec4 scale_sq = mul(r0, r0);
+  scale_sq = madd(r1, r1, scale_sq);
+  scale_sq = madd(r2, r2, scale_sq);
+
+  const Vec4 one = splat(1.0f);
+  const Vec4 rcp_scale_sq = select(cmp_gt(scale_sq, splat(1e-12f)), div(one, scale_sq), one);
+  const Vec4 xyz_mask = set(internal::from_bits(~0u), internal::from_bits(~0u), internal::from_bits(~0u), 0.0f);
+  r0 = bit_and(mul(r0, rcp_scale_sq), xyz_mask);
+  r1 = bit_and(mul(r1, rcp_scale_sq), xyz_mask);
+  r2 = bit_and(mul(r2, rcp_scale_sq), xyz_mask);
+
+  Vec4 r3 = mul(broadcast<0>(m.r[3]), r0);
+  r3 = madd(broadcast<1>(m.r[3]), r1, r3);
+  r3 = madd(broadcast<2>(m.r[3]), r2, r3);
+  r3 = sub(set(0.0f, 0.0f, 0.0f, 1.0f), r3);
+
+  return { { r0, r1, r2, r3 } };
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Quat
+//------------------------------------------------------------------------------------------------------------------------------------
+
+zv::simd::Mat4 zv::simd::quat_to_mat4(Quat q)
+{
+  f32 v[4];
+  store(v, q.v);
+  const f32 x = v[0], y = v[1], z = v[2], w = v[3];
+
+  const f32 xx = x * x, yy = y * y, zz = z * z;
+  const f32 xy = x * y, xz = x * z, yz = y * z;
+  const f32 wx = w * x, wy = w * y, wz = w * z;
+
+  return { {
+    set(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz),        2.0f * (xz - wy),        0.0f),
+    set(2.0f * (xy - wz),        1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx),        0.0f),
+    set(2.0f * (xz + wy),        2.0f * (yz - wx),        1.0f - 2.0f * (xx + yy), 0.0f),
+    set(0.0f,                    0.0f,                    0.0f,                    1.0f)
+  } };
+}
+
+zv::simd::Mat4 zv::simd::mat4_from_trs(Vec4 translation, Quat rotation, Vec4 scale)
+{
+  const Mat4 r = quat_to_mat4(rotation);
+  const Vec4 w_mask = set(0.0f, 0.0f, 0.0f, internal::from_bits(~0u));
+  return { {
+    mul(r.r[0], broadcast<0>(scale)),
+    mul(r.r[1], broadcast<1>(scale)),
+    mul(r.r[2], broadcast<2>(scale)),
+    select(w_mask, splat(1.0f), translation)
+  } };
+}
+
+zv::simd::Quat zv::simd::quat_nlerp(Quat a, Quat b, f32 t)
+{
+  // take the shortest path
+  const Vec4 sign = select(cmp_lt(dot4_all(a.v, b.v), zero()), splat(-1.0f), splat(1.0f));
+  return quat_normalize({ lerp(a.v, mul(b.v, sign), t) });
+}
+
+zv::simd::Quat zv::simd::quat_slerp(Quat a, Quat b, f32 t)
+{
+  f32 cos_theta = dot4(a.v, b.v);
+  Vec4 end = b.v;
+  if (cos_theta < 0.0f)
+  {
+    cos_theta = -cos_theta;
+    end = neg(end);
+  }
+
+  // fall back to nlerp for nearly parallel quaternions
+  if (cos_theta > 0.9995f)
+  {
+    return quat_normalize({ lerp(a.v, end, t) });
+  }
+
+  const f32 theta = std::acos(cos_theta);
+  const f32 rcp_sin_theta = 1.0f / std::sin(theta);
+  const f32 wa = std::sin((1.0f - t) * theta) * rcp_sin_theta;
+  const f32 wb = std::sin(t * theta) * rcp_sin_theta;
+  return { madd(a.v, splat(wa), mul(end, splat(wb))) };
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Batch operations
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void zv::simd::transform_points(const Mat4& m, const Vector3* ptr_in, Vector3* ptr_out, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Vector3& p = ptr_in[i];
+    Vec4 r = madd(splat(p.x), m.r[0], m.r[3]);
+    r = madd(splat(p.y), m.r[1], r);
+    r = madd(splat(p.z), m.r[2], r);
+    store(ptr_out[i], r);
+  }
+}
+
+void zv::simd::transform_points_soa(const Mat4& m, const f32* ptr_x, const f32* ptr_y, const f32* ptr_z,
+                                    f32* ptr_out_x, f32* ptr_out_y, f32* ptr_out_z, size_t count)
+{
+  f32 e[4][4];
+  for (u32 row = 0; row < 4; ++row)
+  {
+    store(e[row], m.r[row]);
+  }
+
+  size_t i = 0;
+
+#if SIMD_AVX2
+  {
+    __m256 c[4][3];
+    for (u32 row = 0; row < 4; ++row)
+    {
+      for (u32 col = 0; col < 3; ++col)
+      {
+        c[row][col] = _mm256_set1_ps(e[row][col]);
+      }
+    }
+
+    for (; i + 8 <= count; i += 8)
+    {
+      const __m256 x = _mm256_loadu_ps(ptr_x + i);
+      const __m256 y = _mm256_loadu_ps(ptr_y + i);
+      const __m256 z = _mm256_loadu_ps(ptr_z + i);
+
+      for (u32 col = 0; col < 3; ++col)
+      {
+        __m256 r = _mm256_add_ps(_mm256_mul_ps(x, c[0][col]), c[3][col]);
+        r = _mm256_add_ps(_mm256_mul_ps(y, c[1][col]), r);
+        r = _mm256_add_ps(_mm256_mul_ps(z, c[2][col]), r);
+        f32* ptr_out = col == 0 ? ptr_out_x : (col == 1 ? ptr_out_y : ptr_out_z);
+        _mm256_storeu_ps(ptr_out + i, r);
+      }
+    }
+  }
+#endif
+
+  {
+    Vec4 c[4][3];
+    for (u32 row = 0; row < 4; ++row)
+    {
+      for (u32 col = 0; col < 3; ++col)
+      {
+        c[row][col] = splat(e[row][col]);
+      }
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+      const Vec4 x = load(ptr_x + i);
+      const Vec4 y = load(ptr_y + i);
+      const Vec4 z = load(ptr_z + i);
+
+      store(ptr_out_x + i, madd(z, c[2][0], madd(y, c[1][0], madd(x, c[0][0], c[3][0]))));
+      store(ptr_out_y + i, madd(z, c[2][1], madd(y, c[1][1], madd(x, c[0][1], c[3][1]))));
+      store(ptr_out_z + i, madd(z, c[2][2], madd(y, c[1][2], madd(x, c[0][2], c[3][2]))));
+    }
+  }
+
+  for (; i < count; ++i)
+  {
+    const f32 x = ptr_x[i], y = ptr_y[i], z = ptr_z[i];
+    ptr_out_x[i] = x * e[0][0] + y * e[1][0] + z * e[2][0] + e[3][0];
+    ptr_out_y[i] = x * e[0][1] + y * e[1][1] + z * e[2][1] + e[3][1];
+    ptr_out_z[i] = x * e[0][2] + y * e[1][2] + z * e[2][2] + e[3][2];
+  }
+}
+
+void zv::simd::mul_batch(const Matrix44* ptr_a, const Mat4& b, Matrix44* ptr_out, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    store(ptr_out[i], mul(load(ptr_a[i]), b));
+  }
+}
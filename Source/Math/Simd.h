@@ -0,0 +1,593 @@
+/*
+ * Simd.h - SIMD vector, matrix and quaternion math for hot paths
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <Core/PlatformContext.h>
+#include <Core/PrimitiveTypes.h>
+#include <MathDefines.h>
+
+#if SIMD_AVX2
+#include <immintrin.h>
+#elif SIMD_SSE
+#include <emmintrin.h>
+#elif SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// The implementation is selected at compile time through the SIMD_* macros of PlatformContext.h (SSE2 on x86/x64,
+// NEON on ARM, scalar everywhere else or when ZV_SIMD_FORCE_SCALAR is set). AVX2 is only used by the batch functions.
+//
+// Conventions match Diligent's BasicMath: matrices are row-major and vectors are row vectors, i.e. a point is transformed
+// as p * M and A * B applies A first. Mat4 has the exact memory layout of Matrix44, so converting between both is a plain
+// (unaligned) load / store that the compiler folds into the surrounding code.
+
+namespace zv
+{
+  namespace simd
+  {
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Types
+    //----------------------------------------------------------------------------------------------------------------------------
+
+#if SIMD_SSE
+    typedef __m128 NativeVec4;
+#elif SIMD_NEON
+    typedef float32x4_t NativeVec4;
+#else
+    struct NativeVec4 { f32 f[4]; };
+#endif
+
+    // four packed floats (x, y, z, w); masks returned by comparisons are stored in the same type
+    struct Vec4
+    {
+      NativeVec4 m;
+    };
+
+    // four rows of four floats, layout compatible with Matrix44
+    struct Mat4
+    {
+      Vec4 r[4];
+    };
+
+    // rotation quaternion stored as (x, y, z, w)
+    struct Quat
+    {
+      Vec4 v;
+    };
+
+    static_assert(sizeof(Vec4) == sizeof(Vector4), "Vec4 must match the layout of Vector4.");
+    static_assert(sizeof(Mat4) == sizeof(Matrix44), "Mat4 must match the layout of Matrix44.");
+
+    // name of the instruction set the library was compiled for
+    const char* get_instruction_set_name();
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Scalar helpers
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    namespace internal
+    {
+      inline u32 as_bits(f32 value) { u32 bits; std::memcpy(&bits, &value, sizeof(bits)); return bits; }
+      inline f32 from_bits(u32 bits) { f32 value; std::memcpy(&value, &bits, sizeof(value)); return value; }
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Vec4 - construction, load and store
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    inline Vec4 set(f32 x, f32 y, f32 z, f32 w)
+    {
+#if SIMD_SSE
+      return { _mm_setr_ps(x, y, z, w) };
+#elif SIMD_NEON
+      const f32 values[4] = { x, y, z, w };
+      return { vld1q_f32(values) };
+#else
+      return { { { x, y, z, w } } };
+#endif
+    }
+
+    inline Vec4 splat(f32 value)
+    {
+#if SIMD_SSE
+      return { _mm_set1_ps(value) };
+#elif SIMD_NEON
+      return { vdupq_n_f32(value) };
+#else
+      return { { { value, value, value, value } } };
+#endif
+    }
+
+    inline Vec4 zero() { return splat(0.0f); }
+
+    // p does not need to be aligned
+    inline Vec4 load(const f32* p)
+    {
+#if SIMD_SSE
+      return { _mm_loadu_ps(p) };
+#elif SIMD_NEON
+      return { vld1q_f32(p) };
+#else
+      return { { { p[0], p[1], p[2], p[3] } } };
+#endif
+    }
+
+    // p does not need to be aligned
+    inline void store(f32* p, Vec4 a)
+    {
+#if SIMD_SSE
+      _mm_storeu_ps(p, a.m);
+#elif SIMD_NEON
+      vst1q_f32(p, a.m);
+#else
+      std::memcpy(p, a.m.f, sizeof(a.m.f));
+#endif
+    }
+
+    inline Vec4 load(const Vector4& v) { return load(&v.x); }
+    inline Vec4 load(const Vector3& v, f32 w) { return set(v.x, v.y, v.z, w); }
+
+    inline void store(Vector4& out, Vec4 a) { store(&out.x, a); }
+    inline void store(Vector3& out, Vec4 a) { f32 tmp[4]; store(tmp, a); out.x = tmp[0]; out.y = tmp[1]; out.z = tmp[2]; }
+
+    inline Vector4 to_vector4(Vec4 a) { Vector4 out; store(out, a); return out; }
+    inline Vector3 to_vector3(Vec4 a) { Vector3 out; store(out, a); return out; }
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Vec4 - lane access and permutation
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    template<u32 I>
+    inline f32 get(Vec4 a)
+    {
+      static_assert(I < 4, "Lane index out of range.");
+#if SIMD_SSE
+      return _mm_cvtss_f32(_mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(I, I, I, I)));
+#elif SIMD_NEON
+      return vgetq_lane_f32(a.m, I);
+#else
+      return a.m.f[I];
+#endif
+    }
+
+    inline f32 get_x(Vec4 a) { return get<0>(a); }
+    inline f32 get_y(Vec4 a) { return get<1>(a); }
+    inline f32 get_z(Vec4 a) { return get<2>(a); }
+    inline f32 get_w(Vec4 a) { return get<3>(a); }
+
+    // returns (a[X], a[Y], b[Z], b[W])
+    template<u32 X, u32 Y, u32 Z, u32 W>
+    inline Vec4 shuffle(Vec4 a, Vec4 b)
+    {
+      static_assert(X < 4 && Y < 4 && Z < 4 && W < 4, "Lane index out of range.");
+#if SIMD_SSE
+      return { _mm_shuffle_ps(a.m, b.m, _MM_SHUFFLE(W, Z, Y, X)) };
+#elif SIMD_NEON
+      float32x4_t r = vdupq_n_f32(vgetq_lane_f32(a.m, X));
+      r = vsetq_lane_f32(vgetq_lane_f32(a.m, Y), r, 1);
+      r = vsetq_lane_f32(vgetq_lane_f32(b.m, Z), r, 2);
+      r = vsetq_lane_f32(vgetq_lane_f32(b.m, W), r, 3);
+      return { r };
+#else
+      return { { { a.m.f[X], a.m.f[Y], b.m.f[Z], b.m.f[W] } } };
+#endif
+    }
+
+    // returns (a[X], a[Y], a[Z], a[W])
+    template<u32 X, u32 Y, u32 Z, u32 W>
+    inline Vec4 swizzle(Vec4 a) { return shuffle<X, Y, Z, W>(a, a); }
+
+    // broadcasts lane I to all lanes
+    template<u32 I>
+    inline Vec4 broadcast(Vec4 a)
+    {
+#if SIMD_NEON && ARCH_ARM64
+      return { vdupq_laneq_f32(a.m, I) };
+#else
+      return swizzle<I, I, I, I>(a);
+#endif
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Vec4 - arithmetic
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    inline Vec4 add(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_add_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return { vaddq_f32(a.m, b.m) };
+#else
+      return { { { a.m.f[0] + b.m.f[0], a.m.f[1] + b.m.f[1], a.m.f[2] + b.m.f[2], a.m.f[3] + b.m.f[3] } } };
+#endif
+    }
+
+    inline Vec4 sub(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_sub_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return { vsubq_f32(a.m, b.m) };
+#else
+      return { { { a.m.f[0] - b.m.f[0], a.m.f[1] - b.m.f[1], a.m.f[2] - b.m.f[2], a.m.f[3] - b.m.f[3] } } };
+#endif
+    }
+
+    inline Vec4 mul(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_mul_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return { vmulq_f32(a.m, b.m) };
+#else
+      return { { { a.m.f[0] * b.m.f[0], a.m.f[1] * b.m.f[1], a.m.f[2] * b.m.f[2], a.m.f[3] * b.m.f[3] } } };
+#endif
+    }
+
+    inline Vec4 div(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_div_ps(a.m, b.m) };
+#elif SIMD_NEON && ARCH_ARM64
+      return { vdivq_f32(a.m, b.m) };
+#else
+      f32 fa[4], fb[4];
+      store(fa, a);
+      store(fb, b);
+      return set(fa[0] / fb[0], fa[1] / fb[1], fa[2] / fb[2], fa[3] / fb[3]);
+#endif
+    }
+
+    // returns a * b + c
+    inline Vec4 madd(Vec4 a, Vec4 b, Vec4 c)
+    {
+#if SIMD_NEON
+      return { vmlaq_f32(c.m, a.m, b.m) };
+#else
+      return add(mul(a, b), c);
+#endif
+    }
+
+    inline Vec4 min(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_min_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return { vminq_f32(a.m, b.m) };
+#else
+      return { { { std::fmin(a.m.f[0], b.m.f[0]), std::fmin(a.m.f[1], b.m.f[1]), std::fmin(a.m.f[2], b.m.f[2]), std::fmin(a.m.f[3], b.m.f[3]) } } };
+#endif
+    }
+
+    inline Vec4 max(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_max_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return { vmaxq_f32(a.m, b.m) };
+#else
+      return { { { std::fmax(a.m.f[0], b.m.f[0]), std::fmax(a.m.f[1], b.m.f[1]), std::fmax(a.m.f[2], b.m.f[2]), std::fmax(a.m.f[3], b.m.f[3]) } } };
+#endif
+    }
+
+    inline Vec4 sqrt(Vec4 a)
+    {
+#if SIMD_SSE
+      return { _mm_sqrt_ps(a.m) };
+#elif SIMD_NEON && ARCH_ARM64
+      return { vsqrtq_f32(a.m) };
+#else
+      f32 fa[4];
+      store(fa, a);
+      return set(std::sqrt(fa[0]), std::sqrt(fa[1]), std::sqrt(fa[2]), std::sqrt(fa[3]));
+#endif
+    }
+
+    inline Vec4 neg(Vec4 a) { return sub(zero(), a); }
+
+    inline Vec4 operator+(Vec4 a, Vec4 b) { return add(a, b); }
+    inline Vec4 operator-(Vec4 a, Vec4 b) { return sub(a, b); }
+    inline Vec4 operator*(Vec4 a, Vec4 b) { return mul(a, b); }
+    inline Vec4 operator/(Vec4 a, Vec4 b) { return div(a, b); }
+    inline Vec4 operator*(Vec4 a, f32 s) { return mul(a, splat(s)); }
+    inline Vec4 operator-(Vec4 a) { return neg(a); }
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Vec4 - comparison and bitwise operations
+    //----------------------------------------------------------------------------------------------------------------------------
+
+#if SIMD_NEON
+#  define ZV_SIMD_NEON_CMP(op, a, b) { vreinterpretq_f32_u32(op(a.m, b.m)) }
+#  define ZV_SIMD_NEON_BITS(op, a, b) { vreinterpretq_f32_u32(op(vreinterpretq_u32_f32(a.m), vreinterpretq_u32_f32(b.m))) }
+#elif SIMD_SCALAR
+#  define ZV_SIMD_SCALAR_CMP(op, a, b) { { { \
+    internal::from_bits(a.m.f[0] op b.m.f[0] ? ~0u : 0u), internal::from_bits(a.m.f[1] op b.m.f[1] ? ~0u : 0u), \
+    internal::from_bits(a.m.f[2] op b.m.f[2] ? ~0u : 0u), internal::from_bits(a.m.f[3] op b.m.f[3] ? ~0u : 0u) } } }
+#  define ZV_SIMD_SCALAR_BITS(op, a, b) { { { \
+    internal::from_bits(internal::as_bits(a.m.f[0]) op internal::as_bits(b.m.f[0])), internal::from_bits(internal::as_bits(a.m.f[1]) op internal::as_bits(b.m.f[1])), \
+    internal::from_bits(internal::as_bits(a.m.f[2]) op internal::as_bits(b.m.f[2])), internal::from_bits(internal::as_bits(a.m.f[3]) op internal::as_bits(b.m.f[3])) } } }
+#endif
+
+    inline Vec4 cmp_lt(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_cmplt_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return ZV_SIMD_NEON_CMP(vcltq_f32, a, b);
+#else
+      return ZV_SIMD_SCALAR_CMP(<, a, b);
+#endif
+    }
+
+    inline Vec4 cmp_le(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_cmple_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return ZV_SIMD_NEON_CMP(vcleq_f32, a, b);
+#else
+      return ZV_SIMD_SCALAR_CMP(<=, a, b);
+#endif
+    }
+
+    inline Vec4 cmp_gt(Vec4 a, Vec4 b) { return cmp_lt(b, a); }
+    inline Vec4 cmp_ge(Vec4 a, Vec4 b) { return cmp_le(b, a); }
+
+    inline Vec4 bit_and(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_and_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return ZV_SIMD_NEON_BITS(vandq_u32, a, b);
+#else
+      return ZV_SIMD_SCALAR_BITS(&, a, b);
+#endif
+    }
+
+    inline Vec4 bit_or(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_or_ps(a.m, b.m) };
+#elif SIMD_NEON
+      return ZV_SIMD_NEON_BITS(vorrq_u32, a, b);
+#else
+      return ZV_SIMD_SCALAR_BITS(|, a, b);
+#endif
+    }
+
+    // returns a & ~b
+    inline Vec4 bit_and_not(Vec4 a, Vec4 b)
+    {
+#if SIMD_SSE
+      return { _mm_andnot_ps(b.m, a.m) };
+#elif SIMD_NEON
+      return ZV_SIMD_NEON_BITS(vbicq_u32, a, b);
+#else
+      return ZV_SIMD_SCALAR_BITS(&~, a, b);
+#endif
+    }
+
+    // picks a where the mask is set and b otherwise
+    inline Vec4 select(Vec4 mask, Vec4 a, Vec4 b)
+    {
+#if SIMD_NEON
+      return { vbslq_f32(vreinterpretq_u32_f32(mask.m), a.m, b.m) };
+#else
+      return bit_or(bit_and(mask, a), bit_and_not(b, mask));
+#endif
+    }
+
+    // packs the sign bit of every lane into the lowest four bits (lane 0 -> bit 0)
+    inline u32 move_mask(Vec4 mask)
+    {
+#if SIMD_SSE
+      return static_cast<u32>(_mm_movemask_ps(mask.m));
+#elif SIMD_NEON && ARCH_ARM64
+      static const int32_t k_lane_shifts[4] = { 0, 1, 2, 3 };
+      const uint32x4_t sign_bits = vshrq_n_u32(vreinterpretq_u32_f32(mask.m), 31);
+      return static_cast<u32>(vaddvq_u32(vshlq_u32(sign_bits, vld1q_s32(k_lane_shifts))));
+#else
+      f32 fa[4];
+      store(fa, mask);
+      return (internal::as_bits(fa[0]) >> 31) | ((internal::as_bits(fa[1]) >> 31) << 1) |
+             ((internal::as_bits(fa[2]) >> 31) << 2) | ((internal::as_bits(fa[3]) >> 31) << 3);
+#endif
+    }
+
+#undef ZV_SIMD_NEON_CMP
+#undef ZV_SIMD_NEON_BITS
+#undef ZV_SIMD_SCALAR_CMP
+#undef ZV_SIMD_SCALAR_BITS
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Vec4 - geometric operations
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    // horizontal sum, broadcast to all lanes
+    inline Vec4 sum_all(Vec4 a)
+    {
+      const Vec4 t = add(a, swizzle<1, 0, 3, 2>(a));
+      return add(t, swizzle<2, 3, 0, 1>(t));
+    }
+
+    inline Vec4 dot4_all(Vec4 a, Vec4 b) { return sum_all(mul(a, b)); }
+    inline f32 dot4(Vec4 a, Vec4 b) { return get_x(dot4_all(a, b)); }
+
+    inline f32 dot3(Vec4 a, Vec4 b)
+    {
+      const Vec4 m = mul(a, b);
+      return get_x(m) + get_y(m) + get_z(m);
+    }
+
+    // the w component of the result is zero when a.w and b.w are
+    inline Vec4 cross3(Vec4 a, Vec4 b)
+    {
+      const Vec4 a_yzx = swizzle<1, 2, 0, 3>(a);
+      const Vec4 b_yzx = swizzle<1, 2, 0, 3>(b);
+      return swizzle<1, 2, 0, 3>(sub(mul(a, b_yzx), mul(a_yzx, b)));
+    }
+
+    inline f32 length3(Vec4 a) { return std::sqrt(dot3(a, a)); }
+
+    inline Vec4 normalize3(Vec4 a)
+    {
+      const f32 len = length3(a);
+      return len > 0.0f ? mul(a, splat(1.0f / len)) : a;
+    }
+
+    inline Vec4 lerp(Vec4 a, Vec4 b, f32 t) { return madd(sub(b, a), splat(t), a); }
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Mat4
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    inline Mat4 load(const Matrix44& m)
+    {
+      const f32* p = &m._11;
+      return { { load(p), load(p + 4), load(p + 8), load(p + 12) } };
+    }
+
+    inline void store(Matrix44& out, const Mat4& m)
+    {
+      f32* p = &out._11;
+      store(p, m.r[0]);
+      store(p + 4, m.r[1]);
+      store(p + 8, m.r[2]);
+      store(p + 12, m.r[3]);
+    }
+
+    inline Matrix44 to_matrix44(const Mat4& m) { Matrix44 out; store(out, m); return out; }
+
+    inline Mat4 identity()
+    {
+      return { { set(1.0f, 0.0f, 0.0f, 0.0f), set(0.0f, 1.0f, 0.0f, 0.0f), set(0.0f, 0.0f, 1.0f, 0.0f), set(0.0f, 0.0f, 0.0f, 1.0f) } };
+    }
+
+    inline Mat4 translation(Vec4 t)
+    {
+      Mat4 m = identity();
+      m.r[3] = select(set(0.0f, 0.0f, 0.0f, internal::from_bits(~0u)), m.r[3], t);
+      return m;
+    }
+
+    // row vector times matrix: v * m
+    inline Vec4 transform(Vec4 v, const Mat4& m)
+    {
+      Vec4 r = mul(broadcast<0>(v), m.r[0]);
+      r = madd(broadcast<1>(v), m.r[1], r);
+      r = madd(broadcast<2>(v), m.r[2], r);
+      return madd(broadcast<3>(v), m.r[3], r);
+    }
+
+    // transforms (x, y, z, 1) and ignores the input w
+    inline Vec4 transform_point(Vec4 p, const Mat4& m)
+    {
+      Vec4 r = madd(broadcast<0>(p), m.r[0], m.r[3]);
+      r = madd(broadcast<1>(p), m.r[1], r);
+      return madd(broadcast<2>(p), m.r[2], r);
+    }
+
+    // transforms (x, y, z, 0) and ignores the input w
+    inline Vec4 transform_vector(Vec4 v, const Mat4& m)
+    {
+      Vec4 r = mul(broadcast<0>(v), m.r[0]);
+      r = madd(broadcast<1>(v), m.r[1], r);
+      return madd(broadcast<2>(v), m.r[2], r);
+    }
+
+    // a * b, i.e. a is applied first
+    inline Mat4 mul(const Mat4& a, const Mat4& b)
+    {
+      return { { transform(a.r[0], b), transform(a.r[1], b), transform(a.r[2], b), transform(a.r[3], b) } };
+    }
+
+    inline Mat4 operator*(const Mat4& a, const Mat4& b) { return mul(a, b); }
+
+    inline Mat4 transpose(const Mat4& m)
+    {
+      const Vec4 t0 = shuffle<0, 1, 0, 1>(m.r[0], m.r[1]);
+      const Vec4 t1 = shuffle<2, 3, 2, 3>(m.r[0], m.r[1]);
+      const Vec4 t2 = shuffle<0, 1, 0, 1>(m.r[2], m.r[3]);
+      const Vec4 t3 = shuffle<2, 3, 2, 3>(m.r[2], m.r[3]);
+      return { { shuffle<0, 2, 0, 2>(t0, t2), shuffle<1, 3, 1, 3>(t0, t2), shuffle<0, 2, 0, 2>(t1, t3), shuffle<1, 3, 1, 3>(t1, t3) } };
+    }
+
+    // general inverse; the result is undefined for singular matrices
+    Mat4 inverse(const Mat4& m);
+
+    // inverse of a matrix that only contains rotation, uniform or non-uniform scale and translation
+    Mat4 inverse_affine(const Mat4& m);
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Quat
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    inline Quat quat_identity() { return { set(0.0f, 0.0f, 0.0f, 1.0f) }; }
+
+    inline Quat quat_from_axis_angle(const Vector3& axis, f32 angle)
+    {
+      const f32 s = std::sin(angle * 0.5f);
+      return { mul(normalize3(load(axis, 0.0f)), set(s, s, s, 0.0f)) + set(0.0f, 0.0f, 0.0f, std::cos(angle * 0.5f)) };
+    }
+
+    inline Quat quat_conjugate(Quat q) { return { mul(q.v, set(-1.0f, -1.0f, -1.0f, 1.0f)) }; }
+
+    inline Quat quat_normalize(Quat q)
+    {
+      const Vec4 len_sq = dot4_all(q.v, q.v);
+      return { div(q.v, sqrt(len_sq)) };
+    }
+
+    // rotation a followed by rotation b, consistent with quat_to_mat4(a) * quat_to_mat4(b)
+    inline Quat quat_mul(Quat a, Quat b)
+    {
+      const Vec4 p = b.v;
+      const Vec4 q = a.v;
+      Vec4 r = mul(broadcast<3>(p), q);
+      r = madd(broadcast<0>(p), mul(swizzle<3, 2, 1, 0>(q), set(1.0f, -1.0f, 1.0f, -1.0f)), r);
+      r = madd(broadcast<1>(p), mul(swizzle<2, 3, 0, 1>(q), set(1.0f, 1.0f, -1.0f, -1.0f)), r);
+      r = madd(broadcast<2>(p), mul(swizzle<1, 0, 3, 2>(q), set(-1.0f, 1.0f, 1.0f, -1.0f)), r);
+      return { r };
+    }
+
+    inline Quat operator*(Quat a, Quat b) { return quat_mul(a, b); }
+
+    // rotates the xyz part of v, w is passed through
+    inline Vec4 quat_rotate(Quat q, Vec4 v)
+    {
+      const Vec4 u = mul(q.v, set(1.0f, 1.0f, 1.0f, 0.0f));
+      const Vec4 t = mul(cross3(u, v), splat(2.0f));
+      return add(add(v, mul(broadcast<3>(q.v), t)), cross3(u, t));
+    }
+
+    Mat4 quat_to_mat4(Quat q);
+
+    // composes scale, then rotation, then translation
+    Mat4 mat4_from_trs(Vec4 translation, Quat rotation, Vec4 scale);
+
+    Quat quat_nlerp(Quat a, Quat b, f32 t);
+    Quat quat_slerp(Quat a, Quat b, f32 t);
+
+    //----------------------------------------------------------------------------------------------------------------------------
+    // Batch operations
+    //----------------------------------------------------------------------------------------------------------------------------
+
+    // out[i] = (in[i], 1) * m; in and out may alias
+    void transform_points(const Mat4& m, const Vector3* ptr_in, Vector3* ptr_out, size_t count);
+
+    // same as above for structure-of-arrays input; uses 8 lanes per iteration when compiled with AVX2
+    void transform_points_soa(const Mat4& m, const f32* ptr_x, const f32* ptr_y, const f32* ptr_z,
+                              f32* ptr_out_x, f32* ptr_out_y, f32* ptr_out_z, size_t count);
+
+    // out[i] = a[i] * b; a and out may alias
+    void mul_batch(const Matrix44* ptr_a, const Mat4& b, Matrix44* ptr_out, size_t count);
+  }
+}
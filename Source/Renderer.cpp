@@ -1,13 +1,28 @@
 #include <Core/PlatformContext.h>
 
 #include <Renderer.h>
+#include <Core/JobSystem.h>
 #include <Core/Logger.h>
+#include <Core/Format.h>
+#include <Core/Time.h>
+#include <Math/Simd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 
 #include <ThirdParty/DiligentCore/Primitives/interface/DebugOutput.h>
 
-#include <ThirdParty/DiligentCore/Platforms/Win32/interface/Win32NativeWindow.h>
+#include <ThirdParty/DiligentCore/Platforms/interface/NativeWindow.h>
+#if D3D11_SUPPORTED
 #include <ThirdParty/DiligentCore/Graphics/GraphicsEngineD3D11/interface/EngineFactoryD3D11.h>
+#endif
+#if D3D12_SUPPORTED
 #include <ThirdParty/DiligentCore/Graphics/GraphicsEngineD3D12/interface/EngineFactoryD3D12.h>
+#endif
+#if VULKAN_SUPPORTED
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h>
+#endif
 
 #include <ThirdParty/DiligentCore/Graphics/GraphicsAccessories/interface/ColorConversion.h>
 
@@ -31,6 +46,113 @@ static void diligent_log_callback(Diligent::DEBUG_MESSAGE_SEVERITY severity, con
   ZV_LOG("EXTERN", "**Diligent** [{}] {}", priority_str, message);
 }
 
+// Instance data layout must match zv::PackedInstance
+static const char* k_instanced_cube_vs = R"(
+cbuffer Constants
+{
+    float4x4 g_ViewProj;
+};
+
+struct InstanceData
+{
+    float4 WorldRow0;
+    float4 WorldRow1;
+    float4 WorldRow2;
+    uint2  Color;
+};
+
+StructuredBuffer<InstanceData> g_Instances;
+
+struct VSInput
+{
+    float3 Pos      : ATTRIB0;
+    float3 Normal   : ATTRIB1;
+    uint   Instance : ATTRIB2;
+};
+
+struct PSInput
+{
+    float4 Pos   : SV_POSITION;
+    float4 Color : COLOR0;
+};
+
+void main(in VSInput VSIn, out PSInput PSIn)
+{
+    InstanceData Inst = g_Instances[VSIn.Instance];
+
+    float4 LocalPos = float4(VSIn.Pos, 1.0);
+    float3 WorldPos = float3(dot(Inst.WorldRow0, LocalPos), dot(Inst.WorldRow1, LocalPos), dot(Inst.WorldRow2, LocalPos));
+    float3 WorldNormal = normalize(float3(dot(Inst.WorldRow0.xyz, VSIn.Normal), dot(Inst.WorldRow1.xyz, VSIn.Normal), dot(Inst.WorldRow2.xyz, VSIn.Normal)));
+
+    float4 Color = float4(f16tof32(Inst.Color.x), f16tof32(Inst.Color.x >> 16), f16tof32(Inst.Color.y), f16tof32(Inst.Color.y >> 16));
+    float Light = 0.35 + 0.65 * saturate(dot(WorldNormal, normalize(float3(0.3, 0.8, -0.5))));
+
+    PSIn.Pos   = mul(float4(WorldPos, 1.0), g_ViewProj);
+    PSIn.Color = float4(Color.rgb * Light, Color.a);
+}
+)";
+
+static const char* k_instanced_cube_ps = R"(
+struct PSInput
+{
+    float4 Pos   : SV_POSITION;
+    float4 Color : COLOR0;
+};
+
+struct PSOutput
+{
+    float4 Color : SV_TARGET;
+};
+
+void main(in PSInput PSIn, out PSOutput PSOut)
+{
+    float4 Color = PSIn.Color;
+#if CONVERT_PS_OUTPUT_TO_GAMMA
+    // Use fast approximation for gamma correction.
+    Color.rgb = pow(Color.rgb, float3(1.0 / 2.2, 1.0 / 2.2, 1.0 / 2.2));
+#endif
+    PSOut.Color = Color;
+}
+)";
+
+// The settings window shows per-frame numbers, they are readable at this rate
+static constexpr f32 k_settings_refresh_interval_s = 0.1f;
+
+// Vertices, indices and commands of all lists; the fields are hashed one by one, ImDrawCmd has padding
+static u64 hash_draw_data(const ImDrawData* ptr_draw_data)
+{
+  u64 hash = zv::k_fnv1a_offset_basis;
+  if (ptr_draw_data == nullptr)
+  {
+    return hash;
+  }
+
+  hash = zv::hash_value(ptr_draw_data->DisplayPos, hash);
+  hash = zv::hash_value(ptr_draw_data->DisplaySize, hash);
+  hash = zv::hash_value(ptr_draw_data->CmdListsCount, hash);
+  for (int i = 0; i < ptr_draw_data->CmdListsCount; ++i)
+  {
+    const ImDrawList* ptr_list = ptr_draw_data->CmdLists[i];
+    hash = zv::hash_bytes(ptr_list->VtxBuffer.Data, static_cast<u64>(ptr_list->VtxBuffer.Size) * sizeof(ImDrawVert), hash);
+    hash = zv::hash_bytes(ptr_list->IdxBuffer.Data, static_cast<u64>(ptr_list->IdxBuffer.Size) * sizeof(ImDrawIdx), hash);
+    for (const ImDrawCmd& cmd : ptr_list->CmdBuffer)
+    {
+      hash = zv::hash_value(cmd.ClipRect, hash);
+      hash = zv::hash_value(cmd.TextureId, hash);
+      hash = zv::hash_value(cmd.VtxOffset, hash);
+      hash = zv::hash_value(cmd.IdxOffset, hash);
+      hash = zv::hash_value(cmd.ElemCount, hash);
+    }
+  }
+  return hash;
+}
+
+// Surface transform of the swap chain, offscreen targets are never rotated
+static Diligent::SURFACE_TRANSFORM get_pre_transform(const Diligent::ISwapChain* ptr_swap_chain)
+{
+  return ptr_swap_chain ? ptr_swap_chain->GetDesc().PreTransform : Diligent::SURFACE_TRANSFORM_IDENTITY;
+}
+
 zv::Renderer::Renderer()
 {
   m_imgui_renderables.reserve(1);
@@ -48,11 +170,30 @@ bool zv::Renderer::create(const CreateParams& params)
 {
   using namespace Diligent;
 
+  ZV_ASSERT(params.offscreen || params.ptr_window != nullptr);
+
+  m_vsynch_enabled = params.enable_vsynch;
+  m_clear_color = params.clear_color;
+
+  NativeWindow window;
+  if (!params.offscreen)
+  {
+    const NativeWindowHandle handle = params.ptr_window->get_native_window_handle();
 #if OS_WINDOWS
-  Win32NativeWindow window{params.ptr_window->get_native_window_handle()};
+    window = Win32NativeWindow{handle};
+#elif OS_LINUX
+    // Diligent creates Vulkan surfaces for X11 windows only, Wayland sessions have to go through XWayland
+    if (handle.subsystem != NativeWindowHandle::eSubsystem::X11)
+    {
+      ZV_ERROR("Only X11 windows are supported, run with SDL_VIDEODRIVER=x11 or in offscreen mode.");
+      return false;
+    }
+    window.WindowId = static_cast<Uint32>(handle.window_id);
+    window.pDisplay = handle.ptr_display;
 #else
 # error "Other platforms currently not supported."
 #endif
+  }
 
   SwapChainDesc swap_chain_desc;
 
@@ -61,8 +202,12 @@ bool zv::Renderer::create(const CreateParams& params)
   fsm_desc.RefreshRateNumerator = params.enable_vsynch ? 60 : 0;
   fsm_desc.RefreshRateDenominator = 1;
 
+  // the factories return the immediate context followed by the deferred contexts
+  std::vector<IDeviceContext*> ptr_contexts(1 + params.deferred_context_count, nullptr);
+
   switch (params.device_type)
   {
+#if D3D11_SUPPORTED
     case eRenderDeviceType::RENDER_DEVICE_TYPE_D3D11:
     {
 #if ENGINE_DLL
@@ -75,11 +220,19 @@ bool zv::Renderer::create(const CreateParams& params)
       m_ptr_engine_factory->SetMessageCallback(diligent_log_callback);
 
       EngineD3D11CreateInfo engine_ci;
-      ptr_factory_d3d11->CreateDeviceAndContextsD3D11(engine_ci, &m_ptr_device, &m_ptr_immediate_context);
-      ptr_factory_d3d11->CreateSwapChainD3D11(m_ptr_device, m_ptr_immediate_context, swap_chain_desc, fsm_desc, window, &m_ptr_swap_chain);
+      engine_ci.NumDeferredContexts = params.deferred_context_count;
+      engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      engine_ci.Features.PipelineStatisticsQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      ptr_factory_d3d11->CreateDeviceAndContextsD3D11(engine_ci, &m_ptr_device, ptr_contexts.data());
+      if (!params.offscreen && m_ptr_device)
+      {
+        ptr_factory_d3d11->CreateSwapChainD3D11(m_ptr_device, ptr_contexts[0], swap_chain_desc, fsm_desc, window, &m_ptr_swap_chain);
+      }
 
       break;
     }
+#endif
+#if D3D12_SUPPORTED
     case eRenderDeviceType::RENDER_DEVICE_TYPE_D3D12:
     {
 #if ENGINE_DLL
@@ -92,11 +245,45 @@ bool zv::Renderer::create(const CreateParams& params)
       m_ptr_engine_factory->SetMessageCallback(diligent_log_callback);
 
       EngineD3D12CreateInfo engine_ci;
-      ptr_factory_d3d12->CreateDeviceAndContextsD3D12(engine_ci, &m_ptr_device, &m_ptr_immediate_context);
-      ptr_factory_d3d12->CreateSwapChainD3D12(m_ptr_device, m_ptr_immediate_context, swap_chain_desc, fsm_desc, window, &m_ptr_swap_chain);
+      engine_ci.NumDeferredContexts = params.deferred_context_count;
+      engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      engine_ci.Features.PipelineStatisticsQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      ptr_factory_d3d12->CreateDeviceAndContextsD3D12(engine_ci, &m_ptr_device, ptr_contexts.data());
+      if (!params.offscreen && m_ptr_device)
+      {
+        ptr_factory_d3d12->CreateSwapChainD3D12(m_ptr_device, ptr_contexts[0], swap_chain_desc, fsm_desc, window, &m_ptr_swap_chain);
+      }
 
       break;
     }
+#endif
+#if VULKAN_SUPPORTED
+    case eRenderDeviceType::RENDER_DEVICE_TYPE_VULKAN:
+    {
+#if EXPLICITLY_LOAD_ENGINE_VK_DLL
+      // Load the dll and import GetEngineFactoryVk() function
+      auto* GetEngineFactoryVk = LoadGraphicsEngineVk();
+#endif
+      auto* ptr_factory_vk = GetEngineFactoryVk();
+      m_ptr_engine_factory = ptr_factory_vk;
+
+      m_ptr_engine_factory->SetMessageCallback(diligent_log_callback);
+
+      // Picks the first compatible adapter, which is the software rasterizer (lavapipe, SwiftShader) when it is the
+      // only ICD installed, e.g. on CI machines
+      EngineVkCreateInfo engine_ci;
+      engine_ci.NumDeferredContexts = params.deferred_context_count;
+      engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      engine_ci.Features.PipelineStatisticsQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+      ptr_factory_vk->CreateDeviceAndContextsVk(engine_ci, &m_ptr_device, ptr_contexts.data());
+      if (!params.offscreen && m_ptr_device)
+      {
+        ptr_factory_vk->CreateSwapChainVk(m_ptr_device, ptr_contexts[0], swap_chain_desc, window, &m_ptr_swap_chain);
+      }
+
+      break;
+    }
+#endif
     default:
     {
       ZV_ERROR("Unknown / unsupported device type.");
@@ -104,35 +291,96 @@ bool zv::Renderer::create(const CreateParams& params)
     }
   }
 
-  if (m_ptr_device == nullptr || m_ptr_immediate_context == nullptr || m_ptr_swap_chain == nullptr)
+  // the returned contexts carry a reference that the smart pointers take over
+  m_ptr_immediate_context.Attach(ptr_contexts[0]);
+  for (u32 i = 1; i < ptr_contexts.size(); ++i)
+  {
+    if (ptr_contexts[i] != nullptr)
+    {
+      m_deferred_contexts.emplace_back().Attach(ptr_contexts[i]);
+    }
+  }
+  m_command_lists.resize(m_deferred_contexts.size());
+  m_ptr_command_lists.resize(m_deferred_contexts.size());
+  set_record_thread_count(get_max_record_thread_count());
+
+  if (m_ptr_device == nullptr || m_ptr_immediate_context == nullptr)
+  {
+    return false;
+  }
+
+  if (!m_resources.create(ResourceManager::CreateParams{}))
+  {
+    return false;
+  }
+
+  if (params.offscreen)
+  {
+    if (!create_offscreen_targets(params.offscreen_width, params.offscreen_height))
+    {
+      return false;
+    }
+  }
+  else if (m_ptr_swap_chain == nullptr)
   {
     return false;
   }
 
-  m_convert_ps_output_to_gamma = (swap_chain_desc.ColorBufferFormat == eTextureFormat::TEX_FORMAT_RGBA8_UNORM ||
-                                  swap_chain_desc.ColorBufferFormat == eTextureFormat::TEX_FORMAT_BGRA8_UNORM);
+  const eTextureFormat color_format = get_color_target_view()->GetDesc().Format;
+  m_convert_ps_output_to_gamma = (color_format == eTextureFormat::TEX_FORMAT_RGBA8_UNORM ||
+                                  color_format == eTextureFormat::TEX_FORMAT_BGRA8_UNORM);
+
+  ZV_INFO("Render device: {}, {}, {} deferred contexts", m_ptr_device->GetAdapterInfo().Description, params.offscreen ? "offscreen" : "swap chain",
+          m_deferred_contexts.size());
 
   m_wireframe_supported = m_ptr_device->GetDeviceInfo().Features.WireframeFill;
+  m_imgui_available = params.init_imgui && params.ptr_window != nullptr;
+
+  ZV_INFO("SIMD instruction set: {}", simd::get_instruction_set_name());
+
+  if (!m_streaming.create(m_ptr_device, &m_resources, StreamingSystem::CreateParams{ params.stream_upload_budget_bytes, params.stream_residency_budget_bytes }))
+  {
+    return false;
+  }
+
+  if (!m_gpu_profiler.create(m_ptr_device))
+  {
+    return false;
+  }
+  m_frame_graph.set_profiler(&m_gpu_profiler);
+
+  PipelineCache::CreateParams pipeline_cache_params;
+  pipeline_cache_params.ptr_directory = params.pipeline_cache_directory;
+  if (!m_pipeline_cache.create(m_ptr_device, pipeline_cache_params))
+  {
+    return false;
+  }
 
-  // create_pipeline_state();
+  if (!create_instance_buffer() || !create_cube_buffers() || !build_frame_graph() || !create_pipeline_state())
+  {
+    return false;
+  }
 
   // // Load textured cube
-  // m_cube_vertex_buffer = CreateVertexBuffer(m_ptr_device, VERTEX_COMPONENT_FLAG_POS_UV);
-  // m_cube_index_buffer  = CreateIndexBuffer(m_ptr_device);
   // m_texture_srv       = LoadTexture(m_ptr_device, "Assets/Textures/grid.png")->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
   // // Set cube texture SRV in the SRB
   // m_ptr_srb->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_texture_srv);
 
-  // create_instance_buffer();
+  // The grid is static, its rotation is set once and only changed instances are uploaded afterwards
+  m_grid_transform = m_transforms.create();
+  const simd::Quat grid_rotation = simd::quat_from_axis_angle(Vector3{0.f, 1.f, 0.f}, 1.0f) *
+                                   simd::quat_from_axis_angle(Vector3{1.f, 0.f, 0.f}, -PI_F * 0.1f);
+  m_transforms.set_local_rotation(m_grid_transform, simd::to_vector4(grid_rotation.v));
 
-  m_vsynch_enabled = params.enable_vsynch;
-  m_clear_color = params.clear_color;
-  m_imgui_available = params.init_imgui;
+  populate_instance_buffer();
 
   if (m_imgui_available)
   {
     m_imgui_show = true;
 
+    // imgui renders into whatever target is bound, so it needs the actual target formats
+    swap_chain_desc.ColorBufferFormat = color_format;
+    swap_chain_desc.DepthBufferFormat = get_depth_target_view()->GetDesc().Format;
     if (!init_imgui(swap_chain_desc, params.ptr_window))
     {
       ZV_ERROR("Failed to initialize imgui.");
@@ -152,7 +400,10 @@ bool zv::Renderer::init_imgui(const SwapChainDesc& swap_chain_desc, const Window
   // TODO
   // ImGui::StyleColorsDark();
 
-  if (!ImGui_ImplSDL2_InitForD3D(ptr_window->m_ptr_sdl_window))
+  const bool sdl_initialized = m_ptr_device->GetDeviceInfo().Type == Diligent::RENDER_DEVICE_TYPE_VULKAN
+                                ? ImGui_ImplSDL2_InitForVulkan(ptr_window->m_ptr_sdl_window)
+                                : ImGui_ImplSDL2_InitForD3D(ptr_window->m_ptr_sdl_window);
+  if (!sdl_initialized)
   {
     return false;
   }
@@ -162,6 +413,69 @@ bool zv::Renderer::init_imgui(const SwapChainDesc& swap_chain_desc, const Window
   return true;
 }
 
+bool zv::Renderer::create_offscreen_targets(u32 width, u32 height)
+{
+  using namespace Diligent;
+
+  // same format as the default swap chain, so pipelines work with both; the depth target is a frame graph transient
+  TextureDesc color_desc;
+  color_desc.Name                = "Offscreen color target";
+  color_desc.Type                = RESOURCE_DIM_TEX_2D;
+  color_desc.Width               = width;
+  color_desc.Height              = height;
+  color_desc.Format              = TEX_FORMAT_RGBA8_UNORM_SRGB;
+  color_desc.BindFlags           = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+  color_desc.ClearValue.Format   = color_desc.Format;
+  color_desc.ClearValue.Color[0] = m_clear_color.x;
+  color_desc.ClearValue.Color[1] = m_clear_color.y;
+  color_desc.ClearValue.Color[2] = m_clear_color.z;
+  color_desc.ClearValue.Color[3] = m_clear_color.w;
+  m_offscreen_color = m_resources.create(make_resource_id(color_desc.Name), color_desc.Name, [this, &color_desc]()
+  {
+    RefCntAutoPtr<ITexture> ptr_texture;
+    m_ptr_device->CreateTexture(color_desc, nullptr, &ptr_texture);
+    return RefCntAutoPtr<IObject>{ ptr_texture };
+  });
+
+  if (m_resources.get(m_offscreen_color) == nullptr)
+  {
+    ZV_ERROR("Failed to create {}x{} offscreen render target.", width, height);
+    return false;
+  }
+
+  return true;
+}
+
+zv::ITexture* zv::Renderer::get_offscreen_color_texture() const
+{
+  return m_ptr_swap_chain ? nullptr : m_resources.get<ITexture>(m_offscreen_color);
+}
+
+zv::ITextureView* zv::Renderer::get_color_target_view() const
+{
+  return m_ptr_swap_chain ? m_ptr_swap_chain->GetCurrentBackBufferRTV() : get_offscreen_color_texture()->GetDefaultView(Diligent::TEXTURE_VIEW_RENDER_TARGET);
+}
+
+zv::ITextureView* zv::Renderer::get_depth_target_view() const
+{
+  return m_ptr_swap_chain ? m_ptr_swap_chain->GetDepthBufferDSV() : m_frame_graph.get_texture_view(m_depth_target, Diligent::TEXTURE_VIEW_DEPTH_STENCIL);
+}
+
+void zv::Renderer::get_target_size(u32& out_width, u32& out_height) const
+{
+  if (m_ptr_swap_chain)
+  {
+    out_width = m_ptr_swap_chain->GetDesc().Width;
+    out_height = m_ptr_swap_chain->GetDesc().Height;
+  }
+  else
+  {
+    const ITexture* ptr_color = get_offscreen_color_texture();
+    out_width = ptr_color->GetDesc().Width;
+    out_height = ptr_color->GetDesc().Height;
+  }
+}
+
 void zv::Renderer::destroy()
 {
   if (m_ptr_immediate_context)
@@ -169,11 +483,38 @@ void zv::Renderer::destroy()
     m_ptr_immediate_context->Flush();
   }
 
+  m_pipeline_cache.destroy();
+  m_streaming.destroy();
+  for (ResourceHandle* ptr_handle : { &m_srb, &m_pipeline_state, &m_cube_vertex_buffer, &m_cube_index_buffer, &m_vs_constants, &m_offscreen_color })
+  {
+    if (ptr_handle->is_valid())
+    {
+      m_resources.release(*ptr_handle);
+      *ptr_handle = ResourceHandle{};
+    }
+  }
+  m_resources.destroy();
+  m_instance_buffer.destroy();
+
+  m_frame_graph.destroy();
+  m_gpu_profiler.destroy();
+  m_color_target = k_invalid_frame_graph_id;
+  m_depth_target = k_invalid_frame_graph_id;
+
+  m_command_lists.clear();
+  m_ptr_command_lists.clear();
+  m_deferred_contexts.clear();
+
   m_ptr_device = nullptr;
   m_ptr_immediate_context = nullptr;
   m_ptr_swap_chain = nullptr;
   m_ptr_imgui_renderer = nullptr;
 
+  m_transforms.clear();
+  m_grid_transform = k_invalid_transform;
+  m_instance_transforms.clear();
+  m_instance_bvh.clear();
+
   if (m_imgui_available)
   {
     ImGui_ImplSDL2_Shutdown();
@@ -187,33 +528,108 @@ void zv::Renderer::register_imgui_renderable(IImGuiRenderable *ptr_imgui_rendera
   m_imgui_renderables.emplace_back(ptr_imgui_renderable);
 }
 
+void zv::Renderer::build_imgui_frame()
+{
+  const u64 start_counter = Time::read_counter();
+
+  u32 target_width, target_height;
+  get_target_size(target_width, target_height);
+
+  ImGui_ImplSDL2_NewFrame();
+  m_ptr_imgui_renderer->NewFrame(target_width, target_height, get_pre_transform(m_ptr_swap_chain));
+  ImGui::NewFrame();
+
+  for (IImGuiRenderable* ptr_renderable : m_imgui_renderables)
+  {
+    ptr_renderable->imgui_update();
+  }
+
+  ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+  if (ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+  {
+    if (ImGui::SliderInt("Grid Size", &m_grid_size, 1, k_max_grid_size))
+    {
+      populate_instance_buffer();
+    }
+    ImGui::Text("Instances drawn: %u / %u", m_instance_buffer.get_draw_count(), static_cast<u32>(m_instance_transforms.size()));
+    ImGui::Text("Instances uploaded: %u (%u copies, %llu bytes)", m_instance_buffer.get_uploaded_instance_count(), m_instance_buffer.get_copy_count(),
+                static_cast<unsigned long long>(m_instance_buffer.get_upload_bytes()));
+
+    ImGui::Checkbox("Draw Per Instance", &m_draw_per_instance);
+    s32 record_thread_count = static_cast<s32>(m_record_thread_count);
+    if (ImGui::SliderInt("Record Threads", &record_thread_count, 1, static_cast<s32>(get_max_record_thread_count())))
+    {
+      set_record_thread_count(static_cast<u32>(record_thread_count));
+    }
+    ImGui::Text("Draw recording: %.3f ms", m_record_time_ms);
+
+    const PipelineCache::CacheStats cache_stats = m_pipeline_cache.get_stats();
+    ImGui::Text("Pipelines: %u cached, %u compiled (%.1f ms)", cache_stats.hits, cache_stats.misses, cache_stats.compile_time_ms);
+
+    const StreamingSystem::FrameStats& stream_stats = m_streaming.get_frame_stats();
+    ImGui::Text("Streaming: %u resident (%.1f MB), %u loading, %.2f MB uploaded", stream_stats.resident_count,
+                stream_stats.resident_bytes / (1024.0 * 1024.0), stream_stats.loading_count, stream_stats.uploaded_bytes / (1024.0 * 1024.0));
+
+    const ResourceManager::ResourceStats resource_stats = m_resources.get_stats();
+    ImGui::Text("Resources: %u (%u loading, %u unused), %llu shared requests", resource_stats.resource_count, resource_stats.loading_count,
+                resource_stats.unused_count, static_cast<unsigned long long>(resource_stats.shared_requests));
+  }
+  ImGui::End();
+
+  if (m_imgui_show)
+  {
+    ImGui::Render();
+    const u64 hash = hash_draw_data(ImGui::GetDrawData());
+    m_imgui_frame_stats.changed_count += hash != m_imgui_draw_data_hash;
+    m_imgui_draw_data_hash = hash;
+  }
+  else
+  {
+    ImGui::EndFrame();
+  }
+
+  ++m_imgui_frame_stats.build_count;
+  m_imgui_frame_stats.build_time_ms = static_cast<f32>(static_cast<f64>(Time::read_counter() - start_counter) * 1000.0 / Time::counter_frequency());
+}
+
+f32 zv::Renderer::get_imgui_refresh_interval_s() const
+{
+  f32 interval_s = k_settings_refresh_interval_s;
+  for (const IImGuiRenderable* ptr_renderable : m_imgui_renderables)
+  {
+    interval_s = std::min(interval_s, ptr_renderable->get_refresh_interval_s());
+  }
+  return interval_s;
+}
+
+void zv::Renderer::set_record_thread_count(u32 thread_count)
+{
+  m_record_thread_count = std::clamp(thread_count, 1u, get_max_record_thread_count());
+}
+
 void zv::Renderer::update()
 {
   using namespace Diligent;
 
+  // Without input or a panel that is due, the draw data of the last build stays valid and is drawn again
   if (m_ptr_imgui_renderer)
   {
-    const auto& sc_desc = m_ptr_swap_chain->GetDesc();
-
-    ImGui_ImplSDL2_NewFrame();
-  	m_ptr_imgui_renderer->NewFrame(sc_desc.Width, sc_desc.Height, sc_desc.PreTransform);
-  	ImGui::NewFrame();
+    PerfScope scope{ m_ptr_perf_counters, "UI" };
 
-    for (IImGuiRenderable* ptr_renderable : m_imgui_renderables)
+    ++m_imgui_frame_stats.frame_count;
+    const f64 time_s = Time::wall_time_s_64();
+    if (!m_imgui_caching || m_imgui_dirty || time_s >= m_imgui_next_build_time_s)
     {
-      ptr_renderable->imgui_update();
+      build_imgui_frame();
+      m_imgui_dirty = false;
+      m_imgui_next_build_time_s = time_s + get_imgui_refresh_interval_s();
     }
+  }
 
-    // Update imgui
-    //   ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
-    //   if (ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
-    //   {
-    //     if (ImGui::SliderInt("Grid Size", &m_grid_size, 1, 32))
-    //     {
-    //       // populate_instance_buffer();
-    //     }
-    //   }
-    //   ImGui::End();
+  // Pipelines missing from the cache compile in the background, the scene is drawn once they are done
+  if (!m_srb.is_valid() && !m_pipeline_failed)
+  {
+    m_pipeline_failed = !create_pipeline_state();
   }
 
   // // Set cube view matrix
@@ -231,10 +647,6 @@ void zv::Renderer::update()
   // // Global rotation matrix
   // m_rotation_matrix = Matrix44::RotationY(Time::get().elapsed_time_s() * 1.0f) * Matrix44::RotationX(-Time::get().elapsed_time_s() * 0.25f);
 
-  // Apply rotation
-  // Matrix44 CubeModelTransform = Matrix44::Identity();
-  Matrix44 CubeModelTransform = Matrix44::RotationY(/*Time::get().elapsed_time_s() * */1.0f) * Matrix44::RotationX(-PI_F * 0.1f);
-
   // Camera is at (0, 0, -5) looking along the Z axis
   Matrix44 View = Matrix44::Translation(0.f, -1.0f, 5.0f);
 
@@ -242,95 +654,528 @@ void zv::Renderer::update()
   auto SrfPreTransform = get_surface_pretransform_matrix(float3{0, 0, 1});
 
   // Get projection matrix adjusted to the current screen orientation
-  auto Proj = get_adjusted_projection_matrix(PI_F / 4.0f, 0.1f, 100.f);
+  constexpr f32 far_plane = 100.f;
+  auto Proj = get_adjusted_projection_matrix(PI_F / 4.0f, 0.1f, far_plane);
 
-  // Compute world-view-projection matrix
-  m_world_view_proj_matrix = CubeModelTransform * View * SrfPreTransform * Proj;
+  // Compute view-projection matrix
+  const simd::Mat4 view_proj = simd::load(View) * simd::load(SrfPreTransform) * simd::load(Proj);
+  m_view_proj_matrix = simd::to_matrix44(view_proj);
 
-  ///////////////////////////
-  // Pre Render
-  ///////////////////////////
-  // ZE_ASSERT(m_ptr_immediate_context && m_ptr_swap_chain);
+  // Update world and world-view-projection matrices of all changed transforms
+  {
+    PerfScope scope{ m_ptr_perf_counters, "Transforms" };
+    m_transforms.update(m_view_proj_matrix);
+  }
 
-  // m_ptr_immediate_context->ClearStats();
+  // Repack the instances whose world matrix changed, the instance buffer uploads only those
+  const u32 transform_count = m_transforms.get_count();
+  const TransformId* ptr_transform_ids = m_transforms.get_ids();
+  const Matrix44* ptr_world_matrices = m_transforms.get_world_matrices();
+  const u8* ptr_world_changed = m_transforms.get_world_changed_flags();
+  for (u32 i = 0; i < transform_count; ++i)
+  {
+    if (ptr_world_changed[i] && ptr_transform_ids[i] != m_grid_transform)
+    {
+      m_instance_buffer.set_transform(ptr_transform_ids[i], ptr_world_matrices[i]);
+    }
+  }
 
-  // Set render targets before issuing any draw command.
-  // Note that Present() unbinds the back buffer if it is set as render target.
-  ITextureView* ptr_rtv = m_ptr_swap_chain->GetCurrentBackBufferRTV();
-  ITextureView* ptr_dsv = m_ptr_swap_chain->GetDepthBufferDSV();
-  m_ptr_immediate_context->SetRenderTargets(1, &ptr_rtv, ptr_dsv, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+  // Cull the transformed cube bounds against the view frustum through the instance BVH, which is refitted every frame and
+  // rebuilt when it degrades; the visible list holds dense transform indices
+  {
+    PerfScope scope{ m_ptr_perf_counters, "Culling" };
+    m_frustum = extract_frustum(m_view_proj_matrix, m_ptr_device->GetDeviceInfo().NDC.MinZ == -1);
+    transform_aabbs(m_transforms.get_world_matrices(), m_transforms.get_count(), Vector3{0.f, 0.f, 0.f}, Vector3{1.f, 1.f, 1.f}, m_instance_bounds);
+    m_instance_bvh.update(m_instance_bounds);
+    m_visible_instances.clear();
+    m_instance_bvh.query_frustum(m_frustum, m_visible_instances);
+  }
 
-  // Clear the back buffer
-  Vector4 clear_color = m_clear_color;
-  if (m_convert_ps_output_to_gamma)
+  // Draw list of the visible instances, by transform id, and the draw packets that render it. Per-instance draws are
+  // keyed front to back by their view depth (clip w), instanced draws cover one part of the draw list per record thread.
   {
-      // If manual gamma correction is required, we need to clear the render target with sRGB color
-      clear_color = LinearToSRGB(clear_color);
+    PerfScope scope{ m_ptr_perf_counters, "Draw list" };
+    DrawPacket packet;
+    packet.ptr_pipeline_state    = m_resources.get<IPipelineState>(m_pipeline_state);
+    packet.ptr_srb               = m_resources.get<IShaderResourceBinding>(m_srb);
+    packet.ptr_vertex_buffers[0] = m_resources.get<IBuffer>(m_cube_vertex_buffer);
+    packet.ptr_vertex_buffers[1] = m_instance_buffer.get_draw_list_buffer();
+    packet.vertex_stream_count   = 2;
+    packet.ptr_index_buffer      = m_resources.get<IBuffer>(m_cube_index_buffer);
+    packet.index_count           = 36;
+
+    m_draw_list.clear();
+    m_draw_queue.clear();
+    for (u32 dense_index : m_visible_instances)
+    {
+      if (ptr_transform_ids[dense_index] == m_grid_transform || packet.ptr_srb == nullptr)
+      {
+        continue;
+      }
+
+      if (m_draw_per_instance)
+      {
+        const Matrix44& world = ptr_world_matrices[dense_index];
+        const f32 view_depth = world.m[3][0] * m_view_proj_matrix.m[0][3] + world.m[3][1] * m_view_proj_matrix.m[1][3] +
+                               world.m[3][2] * m_view_proj_matrix.m[2][3] + m_view_proj_matrix.m[3][3];
+        packet.sort_key       = make_draw_sort_key(0, 0, 0, 0, quantize_sort_depth(view_depth / far_plane));
+        packet.first_instance = static_cast<u32>(m_draw_list.size());
+        m_draw_queue.add(packet);
+      }
+
+      m_draw_list.push_back(ptr_transform_ids[dense_index]);
+    }
+
+    if (!m_draw_per_instance && packet.ptr_srb != nullptr)
+    {
+      const u32 draw_count = static_cast<u32>(m_draw_list.size());
+      const u32 packet_count = std::min(m_record_thread_count, draw_count);
+      for (u32 i = 0; i < packet_count; ++i)
+      {
+        packet.first_instance = static_cast<u32>(u64(draw_count) * i / packet_count);
+        packet.instance_count = static_cast<u32>(u64(draw_count) * (i + 1) / packet_count) - packet.first_instance;
+        m_draw_queue.add(packet);
+      }
+    }
+
+    m_draw_queue.sort();
   }
-  m_ptr_immediate_context->ClearRenderTarget(ptr_rtv, clear_color.Data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-  m_ptr_immediate_context->ClearDepthStencil(ptr_dsv, CLEAR_DEPTH_FLAG, 1.0f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
   ///////////////////////////
   // Render
   ///////////////////////////
-  // {
-  //   // Map the buffer and write current world-view-projection matrix
-  //   MapHelper<Matrix44> cb_constants(m_ptr_immediate_context, ptr_material->vertex_shader_constants(), MAP_WRITE, MAP_FLAG_DISCARD);
-  //   cb_constants[0] = m_world_view_proj_matrix;
-  // }
-
-  // // Bind vertex and index buffers
-  // const u64 offsets[] = {0};
-  // IBuffer* ptr_buffs[] = {ptr_mesh->vertex_buffer()};
-  // m_ptr_immediate_context->SetVertexBuffers(0, _countof(ptr_buffs), ptr_buffs, offsets, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
-  // m_ptr_immediate_context->SetIndexBuffer(ptr_mesh->index_buffer(), 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-  // // Set the pipeline state in the immediate context
-  // m_ptr_immediate_context->SetPipelineState(ptr_material->pipeline_state());
-  // // Commit shader resources. RESOURCE_STATE_TRANSITION_MODE_TRANSITION mode
-  // // makes sure that resources are transitioned to required states.
-  // m_ptr_immediate_context->CommitShaderResources(ptr_material->shader_resource_binding(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-  // DrawIndexedAttribs draw_attrs;       // This is an indexed draw call
-  // draw_attrs.IndexType    = VT_UINT32; // Index type
-  // draw_attrs.NumIndices   = 36;
-  // // Verify the state of vertex and index buffers
-  // draw_attrs.Flags = DRAW_FLAG_VERIFY_ALL;
-  // m_ptr_immediate_context->DrawIndexed(draw_attrs);
+  // Streamed assets are uploaded outside of the graph, they are only transitioned into their final state once
+  {
+    PerfScope scope{ m_ptr_perf_counters, "Streaming" };
+    m_streaming.update(m_ptr_immediate_context);
+    m_resources.update();
+  }
+
+  // The graph uploads, clears and draws the scene and renders imgui on top, see build_frame_graph()
+  // Present() unbinds and rotates the back buffer, so the color target is imported anew every frame
+  m_frame_graph.set_imported_texture(m_color_target, get_color_target_view()->GetTexture());
+  if (m_ptr_swap_chain)
+  {
+    m_frame_graph.set_imported_texture(m_depth_target, get_depth_target_view()->GetTexture());
+  }
+  // the counters cover the graph only, streaming uploads above are not part of them
+  clear_context_counters(m_ptr_immediate_context);
+  for (IDeviceContext* ptr_context : m_deferred_contexts)
+  {
+    clear_context_counters(ptr_context);
+  }
+
+  {
+    PerfScope scope{ m_ptr_perf_counters, "Frame graph" };
+    m_gpu_profiler.begin_frame(m_ptr_immediate_context);
+    m_frame_graph.execute(m_ptr_immediate_context, m_deferred_contexts);
+    m_gpu_profiler.end_frame(m_ptr_immediate_context);
+  }
+
+  m_context_counters = DeviceContextCounters{};
+  accumulate_context_counters(m_ptr_immediate_context, m_context_counters);
+  for (IDeviceContext* ptr_context : m_deferred_contexts)
+  {
+    accumulate_context_counters(ptr_context, m_context_counters);
+  }
 
   ///////////////////////////
   // Post Render
   ///////////////////////////
-  if (m_ptr_imgui_renderer)
+  PerfScope scope{ m_ptr_perf_counters, "Present" };
+  if (m_ptr_swap_chain)
+  {
+    m_ptr_swap_chain->Present(m_vsynch_enabled ? 1 : 0);
+  }
+  else
+  {
+    // Without a swap chain the frame has to be submitted and ended explicitly, which also releases the dynamic
+    // memory of the frame
+    m_ptr_immediate_context->Flush();
+    m_ptr_immediate_context->FinishFrame();
+  }
+}
+
+bool zv::Renderer::build_frame_graph()
+{
+  using namespace Diligent;
+
+  m_frame_graph.clear();
+
+  u32 target_width, target_height;
+  get_target_size(target_width, target_height);
+
+  m_color_target = m_frame_graph.import_texture("Color target", m_ptr_swap_chain ? eFrameGraphAccess::Present : eFrameGraphAccess::ShaderResource);
+  m_depth_target = m_ptr_swap_chain ? m_frame_graph.import_texture("Depth target")
+                                    : m_frame_graph.create_texture(FrameGraphTextureDesc{ "Depth target", target_width, target_height, TEX_FORMAT_D32_FLOAT });
+
+  const FrameGraphResourceId instance_upload = m_frame_graph.import_buffer("Instance upload ring");
+  const FrameGraphResourceId instance_data = m_frame_graph.import_buffer("Instance data");
+  const FrameGraphResourceId draw_list = m_frame_graph.import_buffer("Draw list");
+  const FrameGraphResourceId constants = m_frame_graph.import_buffer("VS constants");
+  const FrameGraphResourceId cube_vertices = m_frame_graph.import_buffer("Cube vertices");
+  const FrameGraphResourceId cube_indices = m_frame_graph.import_buffer("Cube indices");
+
+  // Copies have to stay outside of render passes, so uploading is a pass of its own; its copies only verify the states
+  const FrameGraphPassId upload_pass = m_frame_graph.add_pass("Upload", [this](IDeviceContext* ptr_context) { upload_scene_data(ptr_context); });
+  m_frame_graph.read(upload_pass, instance_upload, eFrameGraphAccess::CopySource);
+  m_frame_graph.write(upload_pass, instance_data, eFrameGraphAccess::CopyDest);
+  m_frame_graph.write(upload_pass, draw_list, eFrameGraphAccess::CopyDest);
+  m_frame_graph.write(upload_pass, constants, eFrameGraphAccess::CopyDest);
+
+  const FrameGraphPassId scene_pass = m_frame_graph.add_pass("Scene", [this](IDeviceContext* ptr_context)
+  {
+    m_record_time_ms = 0.0;
+    m_draw_stats = DrawStats{};
+    if (m_instances_ready && m_draw_queue.get_count() > 0)
+    {
+      const auto record_start = std::chrono::steady_clock::now();
+      submit_scene_draws(ptr_context);
+      m_record_time_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - record_start).count();
+    }
+  });
+  m_frame_graph.read(scene_pass, cube_vertices, eFrameGraphAccess::VertexBuffer);
+  m_frame_graph.read(scene_pass, draw_list, eFrameGraphAccess::VertexBuffer);
+  m_frame_graph.read(scene_pass, cube_indices, eFrameGraphAccess::IndexBuffer);
+  m_frame_graph.read(scene_pass, constants, eFrameGraphAccess::ConstantBuffer);
+  m_frame_graph.read(scene_pass, instance_data, eFrameGraphAccess::ShaderResource);
+  m_frame_graph.write(scene_pass, m_color_target, eFrameGraphAccess::RenderTarget);
+  m_frame_graph.write(scene_pass, m_depth_target, eFrameGraphAccess::DepthWrite);
+  // If manual gamma correction is required, the render target has to be cleared with the sRGB color
+  m_frame_graph.set_clear_color(scene_pass, m_color_target, m_convert_ps_output_to_gamma ? LinearToSRGB(m_clear_color) : m_clear_color);
+  m_frame_graph.set_clear_depth(scene_pass, m_depth_target, 1.0f);
+
+  if (m_imgui_available)
+  {
+    const FrameGraphPassId imgui_pass = m_frame_graph.add_pass("ImGui", [this](IDeviceContext* ptr_context)
+    {
+      // the draw data of the latest build, see update(); the renderer uploads it again every time
+      ImDrawData* ptr_draw_data = ImGui::GetDrawData();
+      if (m_imgui_show && ptr_draw_data != nullptr)
+      {
+        m_ptr_imgui_renderer->RenderDrawData(ptr_context, ptr_draw_data);
+      }
+    }, FrameGraph::k_pass_flag_side_effects);
+    m_frame_graph.write(imgui_pass, m_color_target, eFrameGraphAccess::RenderTarget);
+  }
+
+  if (!m_frame_graph.compile() || !m_frame_graph.allocate(m_ptr_device))
+  {
+    ZV_ERROR("Failed to build the frame graph.");
+    return false;
+  }
+
+  m_frame_graph.set_imported_buffer(instance_upload, m_instance_buffer.get_upload_buffer());
+  m_frame_graph.set_imported_buffer(instance_data, m_instance_buffer.get_instance_buffer());
+  m_frame_graph.set_imported_buffer(draw_list, m_instance_buffer.get_draw_list_buffer());
+  m_frame_graph.set_imported_buffer(constants, m_resources.get<IBuffer>(m_vs_constants));
+  m_frame_graph.set_imported_buffer(cube_vertices, m_resources.get<IBuffer>(m_cube_vertex_buffer));
+  m_frame_graph.set_imported_buffer(cube_indices, m_resources.get<IBuffer>(m_cube_index_buffer));
+
+  return true;
+}
+
+void zv::Renderer::upload_scene_data(IDeviceContext* ptr_context)
+{
+  using namespace Diligent;
+
+  m_instances_ready = m_instance_buffer.upload(ptr_context, m_draw_list.data(), static_cast<u32>(m_draw_list.size()));
+
+  // The view-projection matrix is transposed for the shader's column-major matrices. The constant buffer lives in
+  // device memory, dynamic memory mapped here would not be visible to the deferred contexts.
+  const Matrix44 view_proj_transposed = simd::to_matrix44(simd::transpose(simd::load(m_view_proj_matrix)));
+  ptr_context->UpdateBuffer(m_resources.get<IBuffer>(m_vs_constants), 0, sizeof(Matrix44), &view_proj_transposed, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+}
+
+void zv::Renderer::submit_scene_draws(IDeviceContext* ptr_context)
+{
+  using namespace Diligent;
+
+  const u32 packet_count = m_draw_queue.get_count();
+  const u32 list_count = std::min(m_record_thread_count, packet_count);
+
+  m_draw_stats = DrawStats{};
+
+  // Only a pass on the immediate context can fan out, a pass the frame graph put on a deferred context records alone
+  if (list_count <= 1 || m_deferred_contexts.empty() || ptr_context != m_ptr_immediate_context)
   {
-    if (m_imgui_show)
+    m_draw_queue.submit(ptr_context, 0, packet_count, m_draw_stats);
+    return;
+  }
+
+  // Every deferred context records one contiguous part of the sorted packets; the command lists are executed in order,
+  // so the result is the same as submitting all packets on the immediate context. The frame graph already moved all
+  // resources into their states.
+  ITextureView* ptr_rtv = get_color_target_view();
+  ITextureView* ptr_dsv = get_depth_target_view();
+  m_context_draw_stats.assign(list_count, DrawStats{});
+  Jobs::parallel_for(list_count, 1, [&](u32 begin, u32 end)
+  {
+    for (u32 i = begin; i < end; ++i)
     {
-      //m_ptr_imgui->Render(m_ptr_immediate_context);
-       ImGui::Render();
-       m_ptr_imgui_renderer->RenderDrawData(m_ptr_immediate_context, ImGui::GetDrawData());
+      IDeviceContext* ptr_deferred_context = m_deferred_contexts[i];
+      ptr_deferred_context->Begin(0);
+      ptr_deferred_context->SetRenderTargets(1, &ptr_rtv, ptr_dsv, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+      m_draw_queue.submit(ptr_deferred_context, static_cast<u32>(u64(packet_count) * i / list_count), static_cast<u32>(u64(packet_count) * (i + 1) / list_count),
+                          m_context_draw_stats[i]);
+      ptr_deferred_context->FinishCommandList(&m_command_lists[i]);
     }
-    else
+  });
+
+  for (u32 i = 0; i < list_count; ++i)
+  {
+    m_ptr_command_lists[i] = m_command_lists[i];
+  }
+  m_gpu_profiler.execute_command_lists(m_ptr_immediate_context, list_count, m_ptr_command_lists.data());
+
+  // The deferred contexts release their per-frame dynamic memory once their command lists are submitted
+  for (u32 i = 0; i < list_count; ++i)
+  {
+    m_command_lists[i] = nullptr;
+    m_ptr_command_lists[i] = nullptr;
+    m_deferred_contexts[i]->FinishFrame();
+
+    m_draw_stats += m_context_draw_stats[i];
+  }
+
+  // Executing command lists resets the immediate context's state
+  m_ptr_immediate_context->SetRenderTargets(1, &ptr_rtv, ptr_dsv, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+}
+
+bool zv::Renderer::create_pipeline_state()
+{
+  using namespace Diligent;
+
+  GraphicsPipelineStateCreateInfo pso_ci;
+  pso_ci.PSODesc.Name         = "Instanced cube PSO";
+  pso_ci.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
+
+  pso_ci.GraphicsPipeline.NumRenderTargets             = 1;
+  pso_ci.GraphicsPipeline.RTVFormats[0]                = get_color_target_view()->GetDesc().Format;
+  pso_ci.GraphicsPipeline.DSVFormat                    = get_depth_target_view()->GetDesc().Format;
+  pso_ci.GraphicsPipeline.PrimitiveTopology            = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pso_ci.GraphicsPipeline.RasterizerDesc.CullMode      = CULL_MODE_BACK;
+  pso_ci.GraphicsPipeline.DepthStencilDesc.DepthEnable = True;
+
+  ShaderCreateInfo vs_ci;
+  vs_ci.SourceLanguage                  = SHADER_SOURCE_LANGUAGE_HLSL;
+  vs_ci.Desc.UseCombinedTextureSamplers = true;
+  vs_ci.EntryPoint                      = "main";
+  vs_ci.Desc.ShaderType                 = SHADER_TYPE_VERTEX;
+  vs_ci.Desc.Name                       = "Instanced cube VS";
+  vs_ci.Source                          = k_instanced_cube_vs;
+
+  const ShaderMacro ps_macros[] =
+  {
+    ShaderMacro{"CONVERT_PS_OUTPUT_TO_GAMMA", m_convert_ps_output_to_gamma ? "1" : "0"},
+  };
+  ShaderCreateInfo ps_ci = vs_ci;
+  ps_ci.Desc.ShaderType = SHADER_TYPE_PIXEL;
+  ps_ci.Desc.Name       = "Instanced cube PS";
+  ps_ci.Source          = k_instanced_cube_ps;
+  ps_ci.Macros          = ShaderMacroArray{ps_macros, static_cast<u32>(std::size(ps_macros))};
+
+  LayoutElement layout_elems[] =
+  {
+    // Attribute 0 - vertex position
+    LayoutElement{0, 0, 3, VT_FLOAT32, False},
+    // Attribute 1 - vertex normal
+    LayoutElement{1, 0, 3, VT_FLOAT32, False},
+    // Attribute 2 - instance index from the draw list, advanced once per instance
+    LayoutElement{2, 1, 1, VT_UINT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE},
+  };
+  pso_ci.GraphicsPipeline.InputLayout.LayoutElements = layout_elems;
+  pso_ci.GraphicsPipeline.InputLayout.NumElements    = static_cast<u32>(std::size(layout_elems));
+
+  // Constants and instance data never change their buffers, so both are bound once as static variables
+  pso_ci.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+
+  IPipelineState* ptr_pso = nullptr;
+  const ePipelineStatus status = m_pipeline_cache.request_graphics_pipeline(pso_ci, vs_ci, ps_ci, ptr_pso);
+  if (status == ePipelineStatus::Pending)
+  {
+    return true;
+  }
+  if (status == ePipelineStatus::Failed)
+  {
+    ZV_ERROR("Failed to create the instanced cube pipeline state.");
+    return false;
+  }
+
+  // the cache keeps the pipeline for later requests, the manager shares it with anything else that draws the cube
+  m_pipeline_state = m_resources.create(make_resource_id(pso_ci.PSODesc.Name), pso_ci.PSODesc.Name, [ptr_pso]()
+  {
+    return RefCntAutoPtr<IObject>{ ptr_pso };
+  });
+
+  ptr_pso->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_resources.get<IBuffer>(m_vs_constants));
+  ptr_pso->GetStaticVariableByName(SHADER_TYPE_VERTEX, "g_Instances")->Set(m_instance_buffer.get_instance_view());
+  m_srb = m_resources.create(make_resource_id("Instanced cube SRB"), "Instanced cube SRB", [ptr_pso]()
+  {
+    RefCntAutoPtr<IShaderResourceBinding> ptr_srb;
+    ptr_pso->CreateShaderResourceBinding(&ptr_srb, true);
+    return RefCntAutoPtr<IObject>{ ptr_srb };
+  });
+
+  return m_resources.get(m_srb) != nullptr;
+}
+
+bool zv::Renderer::create_cube_buffers()
+{
+  using namespace Diligent;
+
+  struct CubeVertex
+  {
+    Vector3 pos;
+    Vector3 normal;
+  };
+
+  // Faces as (normal, u, v) with cross(u, v) == -normal, so the corners -u-v, -u+v, +u+v, +u-v run clockwise when
+  // seen from outside
+  const Vector3 faces[6][3] =
+  {
+    { Vector3{ 0.f,  0.f, -1.f}, Vector3{ 1.f, 0.f,  0.f}, Vector3{0.f, 1.f,  0.f} },
+    { Vector3{ 0.f,  0.f,  1.f}, Vector3{-1.f, 0.f,  0.f}, Vector3{0.f, 1.f,  0.f} },
+    { Vector3{ 1.f,  0.f,  0.f}, Vector3{ 0.f, 0.f,  1.f}, Vector3{0.f, 1.f,  0.f} },
+    { Vector3{-1.f,  0.f,  0.f}, Vector3{ 0.f, 0.f, -1.f}, Vector3{0.f, 1.f,  0.f} },
+    { Vector3{ 0.f,  1.f,  0.f}, Vector3{ 1.f, 0.f,  0.f}, Vector3{0.f, 0.f,  1.f} },
+    { Vector3{ 0.f, -1.f,  0.f}, Vector3{ 1.f, 0.f,  0.f}, Vector3{0.f, 0.f, -1.f} },
+  };
+
+  CubeVertex vertices[24];
+  u32 indices[36];
+  for (u32 face = 0; face < 6; ++face)
+  {
+    const Vector3& n = faces[face][0];
+    const Vector3& u = faces[face][1];
+    const Vector3& v = faces[face][2];
+
+    vertices[face * 4 + 0] = CubeVertex{ n - u - v, n };
+    vertices[face * 4 + 1] = CubeVertex{ n - u + v, n };
+    vertices[face * 4 + 2] = CubeVertex{ n + u + v, n };
+    vertices[face * 4 + 3] = CubeVertex{ n + u - v, n };
+
+    const u32 face_indices[6] = { 0, 1, 2, 0, 2, 3 };
+    for (u32 i = 0; i < 6; ++i)
     {
-      //m_ptr_imgui->EndFrame();
-       ImGui::EndFrame();
+      indices[face * 6 + i] = face * 4 + face_indices[i];
     }
   }
 
-  m_ptr_swap_chain->Present(m_vsynch_enabled ? 1 : 0);
+  // The buffers are owned by the resource manager under fixed ids, so anything else drawing the cube shares them
+  auto create_buffer = [this](const BufferDesc& desc, const BufferData* ptr_data)
+  {
+    return m_resources.create(make_resource_id(desc.Name), desc.Name, [this, &desc, ptr_data]()
+    {
+      RefCntAutoPtr<IBuffer> ptr_buffer;
+      m_ptr_device->CreateBuffer(desc, ptr_data, &ptr_buffer);
+      return RefCntAutoPtr<IObject>{ ptr_buffer };
+    });
+  };
+
+  BufferDesc vb_desc;
+  vb_desc.Name      = "Cube vertex buffer";
+  vb_desc.Usage     = USAGE_IMMUTABLE;
+  vb_desc.BindFlags = BIND_VERTEX_BUFFER;
+  vb_desc.Size      = sizeof(vertices);
+  BufferData vb_data;
+  vb_data.pData    = vertices;
+  vb_data.DataSize = sizeof(vertices);
+  m_cube_vertex_buffer = create_buffer(vb_desc, &vb_data);
+
+  BufferDesc ib_desc;
+  ib_desc.Name      = "Cube index buffer";
+  ib_desc.Usage     = USAGE_IMMUTABLE;
+  ib_desc.BindFlags = BIND_INDEX_BUFFER;
+  ib_desc.Size      = sizeof(indices);
+  BufferData ib_data;
+  ib_data.pData    = indices;
+  ib_data.DataSize = sizeof(indices);
+  m_cube_index_buffer = create_buffer(ib_desc, &ib_data);
+
+  BufferDesc cb_desc;
+  cb_desc.Name           = "VS constants CB";
+  cb_desc.Size           = sizeof(Matrix44);
+  cb_desc.Usage          = USAGE_DEFAULT;
+  cb_desc.BindFlags      = BIND_UNIFORM_BUFFER;
+  m_vs_constants = create_buffer(cb_desc, nullptr);
+
+  if (m_resources.get(m_cube_vertex_buffer) == nullptr || m_resources.get(m_cube_index_buffer) == nullptr ||
+      m_resources.get(m_vs_constants) == nullptr)
+  {
+    ZV_ERROR("Failed to create the cube buffers.");
+    return false;
+  }
+
+  return true;
+}
+
+bool zv::Renderer::create_instance_buffer()
+{
+  using namespace Diligent;
+
+  // D3D12 and Vulkan suballocate dynamic buffers from a per-frame heap, see UploadRing
+  InstanceBuffer::CreateParams params;
+  params.max_instances = k_max_instances + 1;
+  params.discard_each_frame = m_ptr_device->GetDeviceInfo().Type != RENDER_DEVICE_TYPE_D3D11;
+
+  if (!m_instance_buffer.create(m_ptr_device, params))
+  {
+    ZV_ERROR("Failed to create the instance buffer.");
+    return false;
+  }
+
+  return true;
+}
+
+void zv::Renderer::populate_instance_buffer()
+{
+  for (TransformId id : m_instance_transforms)
+  {
+    m_transforms.destroy(id);
+  }
+  m_instance_transforms.clear();
+
+  // Cubes are spread over [-1, 1] in the grid's local space
+  const f32 grid_size = static_cast<f32>(m_grid_size);
+  const f32 scale = 0.6f / grid_size;
+  const f32 color_step = m_grid_size > 1 ? 1.0f / (grid_size - 1.0f) : 0.0f;
+
+  for (s32 x = 0; x < m_grid_size; ++x)
+  {
+    for (s32 y = 0; y < m_grid_size; ++y)
+    {
+      for (s32 z = 0; z < m_grid_size; ++z)
+      {
+        const TransformId id = m_transforms.create(m_grid_transform);
+        m_transforms.set_local_position(id, Vector3{ 2.0f * (x + 0.5f) / grid_size - 1.0f,
+                                                     2.0f * (y + 0.5f) / grid_size - 1.0f,
+                                                     2.0f * (z + 0.5f) / grid_size - 1.0f });
+        m_transforms.set_local_scale(id, Vector3{ scale, scale, scale });
+
+        // transform ids stay below the instance count plus the grid transform, as freed ids are reused
+        ZV_ASSERT(id < m_instance_buffer.get_max_instances());
+        m_instance_buffer.set_color(id, Vector4{ 0.2f + 0.8f * x * color_step, 0.2f + 0.8f * y * color_step, 0.2f + 0.8f * z * color_step, 1.0f });
+        m_instance_transforms.push_back(id);
+      }
+    }
+  }
 }
 
 zv::Matrix44 zv::Renderer::get_adjusted_projection_matrix(f32 fov, f32 near_plane, f32 far_plane) const
 {
   using namespace Diligent;
 
-  const auto& SCDesc = m_ptr_swap_chain->GetDesc();
+  u32 target_width, target_height;
+  get_target_size(target_width, target_height);
+  const SURFACE_TRANSFORM pre_transform = get_pre_transform(m_ptr_swap_chain);
 
-  float AspectRatio = static_cast<float>(SCDesc.Width) / static_cast<float>(SCDesc.Height);
+  float AspectRatio = static_cast<float>(target_width) / static_cast<float>(target_height);
   float XScale, YScale;
-  if (SCDesc.PreTransform == SURFACE_TRANSFORM_ROTATE_90 ||
-      SCDesc.PreTransform == SURFACE_TRANSFORM_ROTATE_270 ||
-      SCDesc.PreTransform == SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_90 ||
-      SCDesc.PreTransform == SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_270)
+  if (pre_transform == SURFACE_TRANSFORM_ROTATE_90 ||
+      pre_transform == SURFACE_TRANSFORM_ROTATE_270 ||
+      pre_transform == SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_90 ||
+      pre_transform == SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_270)
   {
       // When the screen is rotated, vertical FOV becomes horizontal FOV
       XScale = 1.f / std::tan(fov / 2.f);
@@ -354,8 +1199,7 @@ zv::Matrix44 zv::Renderer::get_surface_pretransform_matrix(const zv::Vector3 &ca
 {
   using namespace Diligent;
 
-  const auto& SCDesc = m_ptr_swap_chain->GetDesc();
-  switch (SCDesc.PreTransform)
+  switch (get_pre_transform(m_ptr_swap_chain))
   {
     case SURFACE_TRANSFORM_ROTATE_90:
         // The image content is rotated 90 degrees clockwise.
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <Core/PerfCounters.h>
 #include <Core/PrimitiveTypes.h>
+#include <Core/ResourceManager.h>
 #include <RendererDecl.h>
 #include <MathDefines.h>
 #include <Window.h>
+#include <Renderer/Culling.h>
+#include <Renderer/DrawQueue.h>
+#include <Renderer/FrameGraph.h>
+#include <Renderer/GpuProfiler.h>
+#include <Renderer/InstanceBuffer.h>
+#include <Renderer/PipelineCache.h>
+#include <Renderer/StreamingSystem.h>
+#include <Scene/Bvh.h>
+#include <Scene/TransformSystem.h>
 
 
 namespace zv
@@ -11,6 +22,18 @@ namespace zv
   class IImGuiRenderable {
   public:
     virtual void imgui_update() = 0;
+    // Seconds between updates the panel needs, 0 for every frame. Imgui rebuilds all panels together, so the UI is
+    // rebuilt at the shortest interval of all of them and on input; in between the last draw data is drawn again.
+    virtual f32 get_refresh_interval_s() const { return 0.0f; }
+  };
+
+  // UI frames since the start; draw data that hashes the same as the previous build counts as unchanged
+  struct ImGuiFrameStats
+  {
+    u64 frame_count{ 0 };
+    u64 build_count{ 0 };
+    u64 changed_count{ 0 };
+    f32 build_time_ms{ 0.0f };
   };
 
   class Renderer
@@ -21,22 +44,95 @@ namespace zv
 
   public:
     struct CreateParams {
+      // may be null in offscreen mode
       Window* ptr_window;
       eRenderDeviceType device_type;
       Vector4 clear_color{ 0.0f, 0.0f, 0.0f, 1.0f };
       bool enable_fullscreen{ false };
       bool enable_vsynch{ true };
       bool init_imgui{ true };
+      // renders into a texture of offscreen_width x offscreen_height instead of a swap chain, e.g. for headless runs
+      // on software rasterizers; imgui needs a window and is only initialized if one is given
+      bool offscreen{ false };
+      u32 offscreen_width{ 1280 };
+      u32 offscreen_height{ 720 };
+      // deferred contexts that record the scene draws in parallel on the job system, 0 records on the immediate
+      // context only
+      u32 deferred_context_count{ 0 };
+      // shader bytecode and pipeline blobs are kept here between runs, null compiles everything on every start
+      const char* pipeline_cache_directory{ nullptr };
+      // streamed bytes uploaded per frame and resident before the least recently used assets are evicted
+      u64 stream_upload_budget_bytes{ 8ull << 20 };
+      u64 stream_residency_budget_bytes{ 512ull << 20 };
     };
     bool create(const CreateParams& params);
     void destroy();
 
+    bool is_offscreen() const { return m_ptr_swap_chain == nullptr; }
+    // color target in offscreen mode, null otherwise
+    ITexture* get_offscreen_color_texture() const;
+
     void register_imgui_renderable(IImGuiRenderable* ptr_imgui_renderable);
+    // Imgui saw input since the last frame, the UI is rebuilt in the next one regardless of the refresh intervals
+    void invalidate_imgui() { m_imgui_dirty = true; }
+    // off rebuilds the UI every frame
+    void set_imgui_caching(bool enable) { m_imgui_caching = enable; }
+    const ImGuiFrameStats& get_imgui_frame_stats() const { return m_imgui_frame_stats; }
+
+    // textures and meshes requested here are loaded in the background and uploaded at the start of update()
+    StreamingSystem& get_streaming() { return m_streaming; }
+    // device objects shared by id; unused ones are released by update()
+    ResourceManager& get_resources() { return m_resources; }
+
+    // Number of command lists the scene draws are split into, clamped to [1, deferred context count]. With 1 the draws
+    // are recorded directly on the immediate context.
+    void set_record_thread_count(u32 thread_count);
+    u32 get_record_thread_count() const { return m_record_thread_count; }
+    u32 get_max_record_thread_count() const { return m_deferred_contexts.empty() ? 1 : static_cast<u32>(m_deferred_contexts.size()); }
+    // Issues one draw call per instance instead of a single instanced draw, which turns the grid into a draw
+    // submission stress test
+    void set_draw_per_instance(bool enable) { m_draw_per_instance = enable; }
+    // CPU time of recording and submitting the scene draws in the last frame
+    f64 get_record_time_ms() const { return m_record_time_ms; }
+    // draws and state changes of the last frame's scene submission
+    const DrawStats& get_draw_stats() const { return m_draw_stats; }
+    // GPU timings and pipeline statistics of the latest frame whose queries were available, a few frames behind
+    const GpuFrameStats& get_gpu_frame_stats() const { return m_gpu_profiler.get_frame_stats(); }
+    bool is_gpu_timing_supported() const { return m_gpu_profiler.is_timing_supported(); }
+    // commands recorded on all device contexts in the last frame
+    const DeviceContextCounters& get_context_counters() const { return m_context_counters; }
+    // CPU counter scopes around the phases of update(); the counters must belong to the thread that calls update()
+    void set_perf_counters(PerfCounters* ptr_perf_counters) { m_ptr_perf_counters = ptr_perf_counters; }
 
     void update();
 
   private:
     bool init_imgui(const SwapChainDesc& swap_chain_desc, const Window* ptr_window);
+    // new imgui frame with all panels and the settings window, ends with the draw data that the imgui pass renders
+    void build_imgui_frame();
+    f32 get_imgui_refresh_interval_s() const;
+    bool create_offscreen_targets(u32 width, u32 height);
+
+    // render targets of the current frame, either the swap chain's or the offscreen textures
+    ITextureView* get_color_target_view() const;
+    ITextureView* get_depth_target_view() const;
+    void get_target_size(u32& out_width, u32& out_height) const;
+
+    // requests the scene pipeline from the pipeline cache; succeeds while it is still compiling, m_srb is set once it
+    // is ready
+    bool create_pipeline_state();
+    bool create_cube_buffers();
+    bool create_instance_buffer();
+    // recreates the instance transforms for the current grid size
+    void populate_instance_buffer();
+
+    // Declares the frame's passes (upload, scene, imgui) and compiles the graph once; the frame graph transitions all
+    // resources, so recording never needs RESOURCE_STATE_TRANSITION_MODE_TRANSITION and can happen on any context
+    bool build_frame_graph();
+    // uploads changed instances, the draw list and the scene constants
+    void upload_scene_data(IDeviceContext* ptr_context);
+    // submits the sorted scene draw packets, in parallel on deferred contexts if more than one record thread is set
+    void submit_scene_draws(IDeviceContext* ptr_context);
 
     // Returns projection matrix adjusted to the current screen orientation
     Matrix44 get_adjusted_projection_matrix(f32 fov, f32 near_plane, f32 far_plane) const;
@@ -51,8 +147,31 @@ namespace zv
     RefCntAutoPtr<IRenderDevice>  m_ptr_device{ nullptr };
     RefCntAutoPtr<IDeviceContext> m_ptr_immediate_context{ nullptr };
 
+    std::vector<RefCntAutoPtr<IDeviceContext>> m_deferred_contexts;
+    std::vector<RefCntAutoPtr<ICommandList>>   m_command_lists;
+    std::vector<ICommandList*>                 m_ptr_command_lists;
+
+    // owns the device objects below, declared first so it outlives the systems that hold handles
+    ResourceManager m_resources;
+    // offscreen mode only
+    ResourceHandle  m_offscreen_color;
+
+    FrameGraph           m_frame_graph;
+    FrameGraphResourceId m_color_target{ k_invalid_frame_graph_id };
+    // transient in offscreen mode, the swap chain's depth buffer otherwise
+    FrameGraphResourceId m_depth_target{ k_invalid_frame_graph_id };
+
+    GpuProfiler           m_gpu_profiler;
+    DeviceContextCounters m_context_counters;
+    PerfCounters*         m_ptr_perf_counters{ nullptr };
+
     std::unique_ptr<ImGuiDiligentRenderer> m_ptr_imgui_renderer{ nullptr };
     std::vector<IImGuiRenderable*> m_imgui_renderables;
+    ImGuiFrameStats m_imgui_frame_stats;
+    u64 m_imgui_draw_data_hash{ 0 };
+    f64 m_imgui_next_build_time_s{ 0.0 };
+    bool m_imgui_dirty{ true };
+    bool m_imgui_caching{ true };
 
     Vector4 m_clear_color{ 0.0f, 0.0f, 0.0f, 1.0f };
 
@@ -61,26 +180,47 @@ namespace zv
     bool m_wireframe_supported{ false };
     bool m_imgui_available{ false };
     bool m_imgui_show{ false };
+    bool m_draw_per_instance{ false };
+    bool m_instances_ready{ false };
+    bool m_pipeline_failed{ false };
+
+    u32 m_record_thread_count{ 1 };
+    f64 m_record_time_ms{ 0.0 };
 
     //std::unique_ptr<ImGuiImplDiligent> m_ptr_imgui;
 
-    // // RefCntAutoPtr<IPipelineState> m_ptr_pso; //
+    PipelineCache                         m_pipeline_cache;
+    StreamingSystem                       m_streaming;
+    ResourceHandle                        m_pipeline_state;
 
-    // // RefCntAutoPtr<IBuffer>                m_cube_vertex_buffer; //
-    // // RefCntAutoPtr<IBuffer>                m_cube_index_buffer; //
-    // // RefCntAutoPtr<IBuffer>                m_vs_constants; //
-    // // RefCntAutoPtr<IBuffer>                m_instance_buffer;
+    ResourceHandle                        m_cube_vertex_buffer;
+    ResourceHandle                        m_cube_index_buffer;
+    ResourceHandle                        m_vs_constants;
+    InstanceBuffer                        m_instance_buffer;
 
-    // // RefCntAutoPtr<IShaderResourceBinding> m_ptr_srb; //
+    ResourceHandle                        m_srb;
 
     // // RefCntAutoPtr<ITextureView>           m_texture_srv; //
 
-    Matrix44             m_world_view_proj_matrix;
+    TransformSystem          m_transforms;
+    // parent of all grid instances; instances are indexed by their transform id in the instance buffer
+    TransformId              m_grid_transform{ k_invalid_transform };
+    std::vector<TransformId> m_instance_transforms;
+
+    Frustum              m_frustum;
+    AabbSoA              m_instance_bounds;
+    Bvh                  m_instance_bvh;
+    std::vector<u32>     m_visible_instances;
+    std::vector<u32>     m_draw_list;
+    DrawQueue            m_draw_queue;
+    DrawStats            m_draw_stats;
+    // per deferred context while recording in parallel
+    std::vector<DrawStats> m_context_draw_stats;
 
     Matrix44             m_view_proj_matrix;
     Matrix44             m_rotation_matrix;
     s32                  m_grid_size   = 5;
-    // static constexpr s32 k_max_grid_size  = 32;
-    // static constexpr s32 k_max_instances = k_max_grid_size * k_max_grid_size * k_max_grid_size;
+    static constexpr s32 k_max_grid_size  = 32;
+    static constexpr s32 k_max_instances = k_max_grid_size * k_max_grid_size * k_max_grid_size;
   };
 }
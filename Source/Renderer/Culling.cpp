@@ -0,0 +1,430 @@
+/*
+ * Culling.cpp - frustum extraction and SIMD visibility tests on bounding volume arrays
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/Culling.h>
+#include <Core/JobSystem.h>
+#include <Math/Simd.h>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// number of volumes culled by one parallel_for chunk; a multiple of the widest SIMD width
+static const u32 k_cull_grain_size = 16 * 1024;
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Frustum
+//------------------------------------------------------------------------------------------------------------------------------------
+
+zv::Frustum zv::extract_frustum(const Matrix44& view_proj, bool ndc_min_z_is_minus_one)
+{
+  // clip = p * M, so the clip components are the dot products of p with the columns of M
+  const simd::Mat4 columns = simd::transpose(simd::load(view_proj));
+  const simd::Vec4 x = columns.r[0];
+  const simd::Vec4 y = columns.r[1];
+  const simd::Vec4 z = columns.r[2];
+  const simd::Vec4 w = columns.r[3];
+
+  const simd::Vec4 planes[Frustum::Count] = {
+    w + x,                                  // -w <= x
+    w - x,                                  //  x <= w
+    w + y,                                  // -w <= y
+    w - y,                                  //  y <= w
+    ndc_min_z_is_minus_one ? w + z : z,     // -w <= z or 0 <= z
+    w - z                                   //  z <= w
+  };
+
+  Frustum frustum;
+  for (u32 i = 0; i < Frustum::Count; ++i)
+  {
+    const f32 rcp_length = 1.0f / simd::length3(planes[i]);
+    frustum.planes[i] = simd::to_vector4(planes[i] * rcp_length);
+  }
+  return frustum;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Bounding volume arrays
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void zv::AabbSoA::resize(u32 count)
+{
+  center_x.resize(count); center_y.resize(count); center_z.resize(count);
+  extent_x.resize(count); extent_y.resize(count); extent_z.resize(count);
+}
+
+void zv::AabbSoA::set(u32 index, const Vector3& center, const Vector3& extent)
+{
+  center_x[index] = center.x; center_y[index] = center.y; center_z[index] = center.z;
+  extent_x[index] = extent.x; extent_y[index] = extent.y; extent_z[index] = extent.z;
+}
+
+void zv::AabbSoA::push_back(const Vector3& center, const Vector3& extent)
+{
+  center_x.push_back(center.x); center_y.push_back(center.y); center_z.push_back(center.z);
+  extent_x.push_back(extent.x); extent_y.push_back(extent.y); extent_z.push_back(extent.z);
+}
+
+void zv::SphereSoA::resize(u32 count)
+{
+  center_x.resize(count); center_y.resize(count); center_z.resize(count);
+  radius.resize(count);
+}
+
+void zv::SphereSoA::set(u32 index, const Vector3& center, f32 r)
+{
+  center_x[index] = center.x; center_y[index] = center.y; center_z[index] = center.z;
+  radius[index] = r;
+}
+
+void zv::SphereSoA::push_back(const Vector3& center, f32 r)
+{
+  center_x.push_back(center.x); center_y.push_back(center.y); center_z.push_back(center.z);
+  radius.push_back(r);
+}
+
+void zv::transform_aabbs(const Matrix44* ptr_world_matrices, u32 count, const Vector3& local_center, const Vector3& local_extent, AabbSoA& out_aabbs)
+{
+  out_aabbs.resize(count);
+
+  const simd::Vec4 center = simd::load(local_center, 1.0f);
+  const simd::Vec4 ex = simd::splat(local_extent.x);
+  const simd::Vec4 ey = simd::splat(local_extent.y);
+  const simd::Vec4 ez = simd::splat(local_extent.z);
+  const simd::Vec4 sign_mask = simd::splat(-0.0f);
+
+  for (u32 i = 0; i < count; ++i)
+  {
+    const simd::Mat4 m = simd::load(ptr_world_matrices[i]);
+
+    // the new half extent is the local extent projected onto the absolute rotation / scale rows
+    simd::Vec4 extent = simd::mul(ex, simd::bit_and_not(m.r[0], sign_mask));
+    extent = simd::madd(ey, simd::bit_and_not(m.r[1], sign_mask), extent);
+    extent = simd::madd(ez, simd::bit_and_not(m.r[2], sign_mask), extent);
+
+    out_aabbs.set(i, simd::to_vector3(simd::transform_point(center, m)), simd::to_vector3(extent));
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Single volume tests
+//------------------------------------------------------------------------------------------------------------------------------------
+
+bool zv::is_aabb_visible(const Frustum& frustum, const Vector3& center, const Vector3& extent)
+{
+  for (const Vector4& plane : frustum.planes)
+  {
+    const f32 distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+    const f32 radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+    if (distance + radius < 0.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool zv::is_sphere_visible(const Frustum& frustum, const Vector3& center, f32 radius)
+{
+  for (const Vector4& plane : frustum.planes)
+  {
+    if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w + radius < 0.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Batch culling
+//------------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+  inline u32 append_lanes(u32 mask, u32 base, u32* ptr_out)
+  {
+    u32 count = 0;
+    for (u32 lane = 0; mask != 0; ++lane, mask >>= 1)
+    {
+      if (mask & 1)
+      {
+        ptr_out[count++] = base + lane;
+      }
+    }
+    return count;
+  }
+
+  // culls [begin, end) and writes the visible indices to ptr_out; returns the visible count
+  u32 cull_aabb_range(const zv::Frustum& frustum, const zv::AabbSoA& aabbs, u32 begin, u32 end, u32* ptr_out)
+  {
+    using namespace zv;
+
+    u32 visible = 0;
+    u32 i = begin;
+
+#if SIMD_AVX2
+    {
+      __m256 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+      __m256 ax[Frustum::Count], ay[Frustum::Count], az[Frustum::Count];
+      for (u32 p = 0; p < Frustum::Count; ++p)
+      {
+        const Vector4& plane = frustum.planes[p];
+        nx[p] = _mm256_set1_ps(plane.x); ny[p] = _mm256_set1_ps(plane.y); nz[p] = _mm256_set1_ps(plane.z); d[p] = _mm256_set1_ps(plane.w);
+        ax[p] = _mm256_set1_ps(std::fabs(plane.x)); ay[p] = _mm256_set1_ps(std::fabs(plane.y)); az[p] = _mm256_set1_ps(std::fabs(plane.z));
+      }
+
+      const __m256 zero = _mm256_setzero_ps();
+      for (; i + 8 <= end; i += 8)
+      {
+        const __m256 cx = _mm256_loadu_ps(aabbs.center_x.data() + i);
+        const __m256 cy = _mm256_loadu_ps(aabbs.center_y.data() + i);
+        const __m256 cz = _mm256_loadu_ps(aabbs.center_z.data() + i);
+        const __m256 ex = _mm256_loadu_ps(aabbs.extent_x.data() + i);
+        const __m256 ey = _mm256_loadu_ps(aabbs.extent_y.data() + i);
+        const __m256 ez = _mm256_loadu_ps(aabbs.extent_z.data() + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (u32 p = 0; p < Frustum::Count; ++p)
+        {
+          __m256 dist = _mm256_add_ps(_mm256_mul_ps(cx, nx[p]), d[p]);
+          dist = _mm256_add_ps(_mm256_mul_ps(cy, ny[p]), dist);
+          dist = _mm256_add_ps(_mm256_mul_ps(cz, nz[p]), dist);
+          dist = _mm256_add_ps(_mm256_mul_ps(ex, ax[p]), dist);
+          dist = _mm256_add_ps(_mm256_mul_ps(ey, ay[p]), dist);
+          dist = _mm256_add_ps(_mm256_mul_ps(ez, az[p]), dist);
+          inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, zero, _CMP_GE_OQ));
+        }
+
+        visible += append_lanes(static_cast<u32>(_mm256_movemask_ps(inside)), i, ptr_out + visible);
+      }
+    }
+#endif
+
+    {
+      simd::Vec4 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+      simd::Vec4 ax[Frustum::Count], ay[Frustum::Count], az[Frustum::Count];
+      for (u32 p = 0; p < Frustum::Count; ++p)
+      {
+        const Vector4& plane = frustum.planes[p];
+        nx[p] = simd::splat(plane.x); ny[p] = simd::splat(plane.y); nz[p] = simd::splat(plane.z); d[p] = simd::splat(plane.w);
+        ax[p] = simd::splat(std::fabs(plane.x)); ay[p] = simd::splat(std::fabs(plane.y)); az[p] = simd::splat(std::fabs(plane.z));
+      }
+
+      const simd::Vec4 zero = simd::zero();
+      for (; i + 4 <= end; i += 4)
+      {
+        const simd::Vec4 cx = simd::load(aabbs.center_x.data() + i);
+        const simd::Vec4 cy = simd::load(aabbs.center_y.data() + i);
+        const simd::Vec4 cz = simd::load(aabbs.center_z.data() + i);
+        const simd::Vec4 ex = simd::load(aabbs.extent_x.data() + i);
+        const simd::Vec4 ey = simd::load(aabbs.extent_y.data() + i);
+        const simd::Vec4 ez = simd::load(aabbs.extent_z.data() + i);
+
+        simd::Vec4 inside = simd::cmp_ge(zero, zero);
+        for (u32 p = 0; p < Frustum::Count; ++p)
+        {
+          simd::Vec4 dist = simd::madd(cx, nx[p], d[p]);
+          dist = simd::madd(cy, ny[p], dist);
+          dist = simd::madd(cz, nz[p], dist);
+          dist = simd::madd(ex, ax[p], dist);
+          dist = simd::madd(ey, ay[p], dist);
+          dist = simd::madd(ez, az[p], dist);
+          inside = simd::bit_and(inside, simd::cmp_ge(dist, zero));
+        }
+
+        visible += append_lanes(simd::move_mask(inside), i, ptr_out + visible);
+      }
+    }
+
+    for (; i < end; ++i)
+    {
+      if (is_aabb_visible(frustum, Vector3{ aabbs.center_x[i], aabbs.center_y[i], aabbs.center_z[i] },
+                                   Vector3{ aabbs.extent_x[i], aabbs.extent_y[i], aabbs.extent_z[i] }))
+      {
+        ptr_out[visible++] = i;
+      }
+    }
+
+    return visible;
+  }
+
+  u32 cull_sphere_range(const zv::Frustum& frustum, const zv::SphereSoA& spheres, u32 begin, u32 end, u32* ptr_out)
+  {
+    using namespace zv;
+
+    u32 visible = 0;
+    u32 i = begin;
+
+#if SIMD_AVX2
+    {
+      __m256 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+      for (u32 p = 0; p < Frustum::Count; ++p)
+      {
+        const Vector4& plane = frustum.planes[p];
+        nx[p] = _mm256_set1_ps(plane.x); ny[p] = _mm256_set1_ps(plane.y); nz[p] = _mm256_set1_ps(plane.z); d[p] = _mm256_set1_ps(plane.w);
+      }
+
+      for (; i + 8 <= end; i += 8)
+      {
+        const __m256 cx = _mm256_loadu_ps(spheres.center_x.data() + i);
+        const __m256 cy = _mm256_loadu_ps(spheres.center_y.data() + i);
+        const __m256 cz = _mm256_loadu_ps(spheres.center_z.data() + i);
+        const __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius.data() + i));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (u32 p = 0; p < Frustum::Count; ++p)
+        {
+          __m256 dist = _mm256_add_ps(_mm256_mul_ps(cx, nx[p]), d[p]);
+          dist = _mm256_add_ps(_mm256_mul_ps(cy, ny[p]), dist);
+          dist = _mm256_add_ps(_mm256_mul_ps(cz, nz[p]), dist);
+          inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_r, _CMP_GE_OQ));
+        }
+
+        visible += append_lanes(static_cast<u32>(_mm256_movemask_ps(inside)), i, ptr_out + visible);
+      }
+    }
+#endif
+
+    {
+      simd::Vec4 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+      for (u32 p = 0; p < Frustum::Count; ++p)
+      {
+        const Vector4& plane = frustum.planes[p];
+        nx[p] = simd::splat(plane.x); ny[p] = simd::splat(plane.y); nz[p] = simd::splat(plane.z); d[p] = simd::splat(plane.w);
+      }
+
+      for (; i + 4 <= end; i += 4)
+      {
+        const simd::Vec4 cx = simd::load(spheres.center_x.data() + i);
+        const simd::Vec4 cy = simd::load(spheres.center_y.data() + i);
+        const simd::Vec4 cz = simd::load(spheres.center_z.data() + i);
+        const simd::Vec4 neg_r = simd::neg(simd::load(spheres.radius.data() + i));
+
+        simd::Vec4 inside = simd::cmp_ge(neg_r, neg_r);
+        for (u32 p = 0; p < Frustum::Count; ++p)
+        {
+          simd::Vec4 dist = simd::madd(cx, nx[p], d[p]);
+          dist = simd::madd(cy, ny[p], dist);
+          dist = simd::madd(cz, nz[p], dist);
+          inside = simd::bit_and(inside, simd::cmp_ge(dist, neg_r));
+        }
+
+        visible += append_lanes(simd::move_mask(inside), i, ptr_out + visible);
+      }
+    }
+
+    for (; i < end; ++i)
+    {
+      if (is_sphere_visible(frustum, Vector3{ spheres.center_x[i], spheres.center_y[i], spheres.center_z[i] }, spheres.radius[i]))
+      {
+        ptr_out[visible++] = i;
+      }
+    }
+
+    return visible;
+  }
+
+  // Each chunk writes its visible indices to the front of its own slice of out_visible; the slices are compacted afterwards,
+  // which keeps the output sorted without any synchronization between chunks.
+  template<typename CullRange>
+  u32 cull_parallel(u32 count, std::vector<u32>& out_visible, const CullRange& cull_range)
+  {
+    out_visible.resize(count);
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    const u32 chunk_count = (count + k_cull_grain_size - 1) / k_cull_grain_size;
+    std::vector<u32> chunk_visible(chunk_count, 0);
+
+    zv::Jobs::parallel_for(count, k_cull_grain_size, [&](u32 begin, u32 end)
+    {
+      for (u32 chunk_begin = begin; chunk_begin < end; chunk_begin += k_cull_grain_size)
+      {
+        const u32 chunk_end = std::min(chunk_begin + k_cull_grain_size, end);
+        chunk_visible[chunk_begin / k_cull_grain_size] = cull_range(chunk_begin, chunk_end, out_visible.data() + chunk_begin);
+      }
+    });
+
+    u32 total = chunk_visible[0];
+    for (u32 chunk = 1; chunk < chunk_count; ++chunk)
+    {
+      std::memmove(out_visible.data() + total, out_visible.data() + chunk * k_cull_grain_size, chunk_visible[chunk] * sizeof(u32));
+      total += chunk_visible[chunk];
+    }
+
+    out_visible.resize(total);
+    return total;
+  }
+}
+
+u32 zv::cull_aabbs(const Frustum& frustum, const AabbSoA& aabbs, std::vector<u32>& out_visible)
+{
+  return cull_parallel(aabbs.size(), out_visible, [&](u32 begin, u32 end, u32* ptr_out)
+  {
+    return cull_aabb_range(frustum, aabbs, begin, end, ptr_out);
+  });
+}
+
+u32 zv::cull_spheres(const Frustum& frustum, const SphereSoA& spheres, std::vector<u32>& out_visible)
+{
+  return cull_parallel(spheres.size(), out_visible, [&](u32 begin, u32 end, u32* ptr_out)
+  {
+    return cull_sphere_range(frustum, spheres, begin, end, ptr_out);
+  });
+}
+
+u32 zv::cull_aabbs(const Frustum& frustum, const AabbSoA& aabbs, u32 begin, u32 end, u32* ptr_out)
+{
+  return cull_aabb_range(frustum, aabbs, begin, end, ptr_out);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Hierarchical culling
+//------------------------------------------------------------------------------------------------------------------------------------
+
+zv::FrustumPlanesSoA zv::transpose_frustum(const Frustum& frustum)
+{
+  FrustumPlanesSoA planes;
+  for (u32 p = 0; p < 8; ++p)
+  {
+    const Vector4 plane = p < Frustum::Count ? frustum.planes[p] : Vector4{ 0.0f, 0.0f, 0.0f, 1.0f };
+    planes.nx[p] = plane.x; planes.ny[p] = plane.y; planes.nz[p] = plane.z; planes.d[p] = plane.w;
+    planes.abs_nx[p] = std::fabs(plane.x); planes.abs_ny[p] = std::fabs(plane.y); planes.abs_nz[p] = std::fabs(plane.z);
+  }
+  return planes;
+}
+
+bool zv::classify_aabb(const FrustumPlanesSoA& planes, const Vector3& center, const Vector3& extent, u32& inout_plane_mask)
+{
+  const simd::Vec4 cx = simd::splat(center.x), cy = simd::splat(center.y), cz = simd::splat(center.z);
+  const simd::Vec4 ex = simd::splat(extent.x), ey = simd::splat(extent.y), ez = simd::splat(extent.z);
+  const simd::Vec4 zero = simd::zero();
+
+  u32 outside_mask = 0;
+  u32 inside_mask = 0;
+  for (u32 group = 0; group < 2; ++group)
+  {
+    const u32 first = group * 4;
+    simd::Vec4 distance = simd::madd(cx, simd::load(planes.nx + first), simd::load(planes.d + first));
+    distance = simd::madd(cy, simd::load(planes.ny + first), distance);
+    distance = simd::madd(cz, simd::load(planes.nz + first), distance);
+    simd::Vec4 radius = simd::mul(ex, simd::load(planes.abs_nx + first));
+    radius = simd::madd(ey, simd::load(planes.abs_ny + first), radius);
+    radius = simd::madd(ez, simd::load(planes.abs_nz + first), radius);
+
+    outside_mask |= simd::move_mask(simd::cmp_lt(simd::add(distance, radius), zero)) << first;
+    inside_mask |= simd::move_mask(simd::cmp_ge(simd::sub(distance, radius), zero)) << first;
+  }
+
+  if (outside_mask & inout_plane_mask)
+  {
+    return false;
+  }
+  inout_plane_mask &= ~inside_mask;
+  return true;
+}
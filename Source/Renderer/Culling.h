@@ -0,0 +1,83 @@
+/*
+ * Culling.h - frustum extraction and SIMD visibility tests on bounding volume arrays
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <MathDefines.h>
+
+namespace zv
+{
+  // Planes are stored normalized as (nx, ny, nz, d) with normals pointing inwards, so the signed distance of a point p is
+  // dot(n, p) + d and p is inside when it is positive for all planes.
+  struct Frustum
+  {
+    enum ePlane : u32 { Left, Right, Bottom, Top, Near, Far, Count };
+
+    Vector4 planes[ePlane::Count];
+  };
+
+  // Extracts the frustum planes of a row-vector view-projection matrix. ndc_min_z_is_minus_one selects the OpenGL
+  // depth range [-1, 1] instead of [0, 1] (see DeviceInfo::NDC.MinZ).
+  Frustum extract_frustum(const Matrix44& view_proj, bool ndc_min_z_is_minus_one = false);
+
+  // axis-aligned boxes in center / half-extent form, structure-of-arrays
+  struct AabbSoA
+  {
+    std::vector<f32> center_x, center_y, center_z;
+    std::vector<f32> extent_x, extent_y, extent_z;
+
+    u32 size() const { return static_cast<u32>(center_x.size()); }
+    void resize(u32 count);
+    void clear() { resize(0); }
+    void set(u32 index, const Vector3& center, const Vector3& extent);
+    void push_back(const Vector3& center, const Vector3& extent);
+  };
+
+  // bounding spheres, structure-of-arrays
+  struct SphereSoA
+  {
+    std::vector<f32> center_x, center_y, center_z;
+    std::vector<f32> radius;
+
+    u32 size() const { return static_cast<u32>(center_x.size()); }
+    void resize(u32 count);
+    void clear() { resize(0); }
+    void set(u32 index, const Vector3& center, f32 radius);
+    void push_back(const Vector3& center, f32 radius);
+  };
+
+  // Writes the world-space boxes of a local box transformed by each of the world matrices.
+  void transform_aabbs(const Matrix44* ptr_world_matrices, u32 count, const Vector3& local_center, const Vector3& local_extent, AabbSoA& out_aabbs);
+
+  // Culling functions write the indices of all visible volumes into out_visible in ascending order and return their
+  // count. Volumes are tested four at a time (eight with AVX2) and large arrays are split across the job system.
+  u32 cull_aabbs(const Frustum& frustum, const AabbSoA& aabbs, std::vector<u32>& out_visible);
+  u32 cull_spheres(const Frustum& frustum, const SphereSoA& spheres, std::vector<u32>& out_visible);
+
+  // The same test for the volumes [begin, end) on the calling thread, e.g. the primitives of a BVH leaf; ptr_out needs
+  // room for end - begin indices
+  u32 cull_aabbs(const Frustum& frustum, const AabbSoA& aabbs, u32 begin, u32 end, u32* ptr_out);
+
+  // The planes of a frustum transposed, so one box is tested against all of them at once. The two planes after the
+  // six of the frustum are padding that every box is inside of.
+  struct FrustumPlanesSoA
+  {
+    f32 nx[8], ny[8], nz[8], d[8];
+    f32 abs_nx[8], abs_ny[8], abs_nz[8];
+  };
+
+  FrustumPlanesSoA transpose_frustum(const Frustum& frustum);
+
+  // Tests a box against the planes set in inout_plane_mask. Returns false if it is outside of one of them, otherwise
+  // clears the bits of the planes the box is fully inside of, which its children do not need to be tested against.
+  bool classify_aabb(const FrustumPlanesSoA& planes, const Vector3& center, const Vector3& extent, u32& inout_plane_mask);
+
+  // single volume tests
+  bool is_aabb_visible(const Frustum& frustum, const Vector3& center, const Vector3& extent);
+  bool is_sphere_visible(const Frustum& frustum, const Vector3& center, f32 radius);
+}
@@ -0,0 +1,149 @@
+/*
+ * DrawQueue.cpp - sort-key ordered draw packets with redundant state filtering
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/DrawQueue.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+
+
+u32 zv::quantize_sort_depth(f32 depth)
+{
+  constexpr f32 k_max_depth = static_cast<f32>((1u << k_sort_key_depth_bits) - 1);
+  return static_cast<u32>(std::clamp(depth, 0.0f, 1.0f) * k_max_depth + 0.5f);
+}
+
+zv::DrawStats& zv::DrawStats::operator+=(const DrawStats& other)
+{
+  draw_count += other.draw_count;
+  pipeline_changes += other.pipeline_changes;
+  srb_commits += other.srb_commits;
+  vertex_buffer_binds += other.vertex_buffer_binds;
+  index_buffer_binds += other.index_buffer_binds;
+  return *this;
+}
+
+void zv::DrawQueue::clear()
+{
+  m_packets.clear();
+  m_order.clear();
+}
+
+void zv::DrawQueue::reserve(u32 packet_count)
+{
+  m_packets.reserve(packet_count);
+  m_order.reserve(packet_count);
+  m_keys.reserve(packet_count);
+  m_keys_scratch.reserve(packet_count);
+  m_order_scratch.reserve(packet_count);
+}
+
+void zv::DrawQueue::sort()
+{
+  const u32 count = get_count();
+
+  m_keys.resize(count);
+  m_keys_scratch.resize(count);
+  m_order.resize(count);
+  m_order_scratch.resize(count);
+
+  for (u32 i = 0; i < count; ++i)
+  {
+    m_keys[i] = m_packets[i].sort_key;
+    m_order[i] = i;
+  }
+
+  // Keys and packet indices are sorted together, the packets themselves never move
+  for (u32 shift = 0; shift < 64; shift += 8)
+  {
+    u32 histogram[256] = {};
+    for (u32 i = 0; i < count; ++i)
+    {
+      ++histogram[(m_keys[i] >> shift) & 0xFF];
+    }
+
+    // typical frames use few pipelines, materials and meshes, so most bytes are the same for every key
+    if (count == 0 || histogram[(m_keys[0] >> shift) & 0xFF] == count)
+    {
+      continue;
+    }
+
+    u32 offset = 0;
+    for (u32& bucket : histogram)
+    {
+      const u32 bucket_count = bucket;
+      bucket = offset;
+      offset += bucket_count;
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+      const u32 dst = histogram[(m_keys[i] >> shift) & 0xFF]++;
+      m_keys_scratch[dst] = m_keys[i];
+      m_order_scratch[dst] = m_order[i];
+    }
+
+    m_keys.swap(m_keys_scratch);
+    m_order.swap(m_order_scratch);
+  }
+}
+
+void zv::DrawQueue::submit(IDeviceContext* ptr_context, u32 begin, u32 end, DrawStats& out_stats) const
+{
+  using namespace Diligent;
+
+  ZV_ASSERT(m_order.size() == m_packets.size() && begin <= end && end <= m_order.size());
+
+  const DrawPacket* ptr_last = nullptr;
+  for (u32 i = begin; i < end; ++i)
+  {
+    const DrawPacket& packet = m_packets[m_order[i]];
+
+    if (!ptr_last || packet.ptr_pipeline_state != ptr_last->ptr_pipeline_state)
+    {
+      ptr_context->SetPipelineState(packet.ptr_pipeline_state);
+      ++out_stats.pipeline_changes;
+    }
+
+    // a new pipeline invalidates the committed resources
+    if (!ptr_last || packet.ptr_srb != ptr_last->ptr_srb || packet.ptr_pipeline_state != ptr_last->ptr_pipeline_state)
+    {
+      ptr_context->CommitShaderResources(packet.ptr_srb, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+      ++out_stats.srb_commits;
+    }
+
+    if (!ptr_last || packet.vertex_stream_count != ptr_last->vertex_stream_count ||
+        std::memcmp(packet.ptr_vertex_buffers, ptr_last->ptr_vertex_buffers, sizeof(IBuffer*) * packet.vertex_stream_count) != 0)
+    {
+      const u64 offsets[DrawPacket::k_max_vertex_streams] = {};
+      ptr_context->SetVertexBuffers(0, packet.vertex_stream_count, packet.ptr_vertex_buffers, offsets, RESOURCE_STATE_TRANSITION_MODE_VERIFY,
+                                    SET_VERTEX_BUFFERS_FLAG_RESET);
+      ++out_stats.vertex_buffer_binds;
+    }
+
+    if (!ptr_last || packet.ptr_index_buffer != ptr_last->ptr_index_buffer)
+    {
+      ptr_context->SetIndexBuffer(packet.ptr_index_buffer, 0, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+      ++out_stats.index_buffer_binds;
+    }
+
+    DrawIndexedAttribs draw_attrs;
+    draw_attrs.IndexType             = VT_UINT32;
+    draw_attrs.NumIndices            = packet.index_count;
+    draw_attrs.FirstIndexLocation    = packet.first_index;
+    draw_attrs.NumInstances          = packet.instance_count;
+    draw_attrs.FirstInstanceLocation = packet.first_instance;
+    // Verify the state of vertex and index buffers
+    draw_attrs.Flags = DRAW_FLAG_VERIFY_ALL;
+    ptr_context->DrawIndexed(draw_attrs);
+    ++out_stats.draw_count;
+
+    ptr_last = &packet;
+  }
+}
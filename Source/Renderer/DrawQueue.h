@@ -0,0 +1,98 @@
+/*
+ * DrawQueue.h - sort-key ordered draw packets with redundant state filtering
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace zv
+{
+  // 64-bit draw sort key, most significant first:
+  //   layer 4 | pipeline 12 | material 16 | mesh 16 | depth 16
+  // Sorting by key groups draws by pipeline, then material and mesh, so consecutive packets share as much state as
+  // possible; depth orders draws within a group (front to back for opaque layers, invert it for translucent ones).
+  constexpr u32 k_sort_key_layer_bits    = 4;
+  constexpr u32 k_sort_key_pipeline_bits = 12;
+  constexpr u32 k_sort_key_material_bits = 16;
+  constexpr u32 k_sort_key_mesh_bits     = 16;
+  constexpr u32 k_sort_key_depth_bits    = 16;
+
+  constexpr u64 make_draw_sort_key(u32 layer, u32 pipeline, u32 material, u32 mesh, u32 depth)
+  {
+    return (u64(layer    & ((1u << k_sort_key_layer_bits) - 1))    << 60) |
+           (u64(pipeline & ((1u << k_sort_key_pipeline_bits) - 1)) << 48) |
+           (u64(material & ((1u << k_sort_key_material_bits) - 1)) << 32) |
+           (u64(mesh     & ((1u << k_sort_key_mesh_bits) - 1))     << 16) |
+            u64(depth    & ((1u << k_sort_key_depth_bits) - 1));
+  }
+
+  // maps depth in [0, 1] to the key's depth bits, values outside are clamped
+  u32 quantize_sort_depth(f32 depth);
+
+  // One draw call with the complete state it needs. Objects are not referenced, they have to outlive the submission.
+  struct DrawPacket
+  {
+    static constexpr u32 k_max_vertex_streams = 2;
+
+    u64 sort_key{ 0 };
+    IPipelineState* ptr_pipeline_state{ nullptr };
+    IShaderResourceBinding* ptr_srb{ nullptr };
+    IBuffer* ptr_vertex_buffers[k_max_vertex_streams]{};
+    u32 vertex_stream_count{ 0 };
+    IBuffer* ptr_index_buffer{ nullptr };
+
+    u32 index_count{ 0 };
+    u32 first_index{ 0 };
+    u32 instance_count{ 1 };
+    u32 first_instance{ 0 };
+  };
+
+  // Bound state changes of a submission; draws minus changes are the calls the queue saved
+  struct DrawStats
+  {
+    u32 draw_count{ 0 };
+    u32 pipeline_changes{ 0 };
+    u32 srb_commits{ 0 };
+    u32 vertex_buffer_binds{ 0 };
+    u32 index_buffer_binds{ 0 };
+
+    DrawStats& operator+=(const DrawStats& other);
+  };
+
+  // Collects the draw packets of a frame, radix sorts them by key and submits them while only setting the state that
+  // differs from the previous packet. Submission of disjoint ranges may run in parallel on different contexts.
+  class DrawQueue : public NonCopyable
+  {
+  public:
+    void clear();
+    void reserve(u32 packet_count);
+    void add(const DrawPacket& packet) { m_packets.push_back(packet); }
+
+    // stable LSD radix sort over the keys, 8 bits per pass; passes where all keys share the byte are skipped
+    void sort();
+
+    // submits the sorted packets [begin, end); state bound before the call is not known, so the first packet sets all
+    // of it. All resources must already be in their required states.
+    void submit(IDeviceContext* ptr_context, u32 begin, u32 end, DrawStats& out_stats) const;
+
+    u32 get_count() const { return static_cast<u32>(m_packets.size()); }
+    // packet at the given position in sort order, only valid after sort()
+    const DrawPacket& get_sorted(u32 index) const { return m_packets[m_order[index]]; }
+
+  private:
+    std::vector<DrawPacket> m_packets;
+    // packet indices in sort order
+    std::vector<u32> m_order;
+
+    // radix sort scratch
+    std::vector<u64> m_keys;
+    std::vector<u64> m_keys_scratch;
+    std::vector<u32> m_order_scratch;
+  };
+}
@@ -0,0 +1,754 @@
+/*
+ * FrameGraph.cpp - declarative pass graph with precomputed resource transitions and transient texture aliasing
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/FrameGraph.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include <Core/JobSystem.h>
+#include <Core/Logger.h>
+#include <Renderer/GpuProfiler.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+
+
+namespace
+{
+  using namespace Diligent;
+
+  RESOURCE_STATE to_resource_state(zv::eFrameGraphAccess access)
+  {
+    switch (access)
+    {
+      case zv::eFrameGraphAccess::RenderTarget:   return RESOURCE_STATE_RENDER_TARGET;
+      case zv::eFrameGraphAccess::DepthWrite:     return RESOURCE_STATE_DEPTH_WRITE;
+      case zv::eFrameGraphAccess::DepthRead:      return RESOURCE_STATE_DEPTH_READ;
+      case zv::eFrameGraphAccess::ShaderResource: return RESOURCE_STATE_SHADER_RESOURCE;
+      case zv::eFrameGraphAccess::ConstantBuffer: return RESOURCE_STATE_CONSTANT_BUFFER;
+      case zv::eFrameGraphAccess::VertexBuffer:   return RESOURCE_STATE_VERTEX_BUFFER;
+      case zv::eFrameGraphAccess::IndexBuffer:    return RESOURCE_STATE_INDEX_BUFFER;
+      case zv::eFrameGraphAccess::CopySource:     return RESOURCE_STATE_COPY_SOURCE;
+      case zv::eFrameGraphAccess::CopyDest:       return RESOURCE_STATE_COPY_DEST;
+      case zv::eFrameGraphAccess::Present:        return RESOURCE_STATE_PRESENT;
+      default:                                    return RESOURCE_STATE_UNKNOWN;
+    }
+  }
+
+  u32 to_bind_flags(u32 access_mask)
+  {
+    const auto has = [access_mask](zv::eFrameGraphAccess access) { return (access_mask & (1u << static_cast<u32>(access))) != 0; };
+
+    u32 bind_flags = BIND_NONE;
+    if (has(zv::eFrameGraphAccess::RenderTarget))
+    {
+      bind_flags |= BIND_RENDER_TARGET;
+    }
+    if (has(zv::eFrameGraphAccess::DepthWrite) || has(zv::eFrameGraphAccess::DepthRead))
+    {
+      bind_flags |= BIND_DEPTH_STENCIL;
+    }
+    if (has(zv::eFrameGraphAccess::ShaderResource))
+    {
+      bind_flags |= BIND_SHADER_RESOURCE;
+    }
+    return bind_flags;
+  }
+
+  bool is_attachment_access(zv::eFrameGraphAccess access)
+  {
+    return access == zv::eFrameGraphAccess::RenderTarget || access == zv::eFrameGraphAccess::DepthWrite ||
+           access == zv::eFrameGraphAccess::DepthRead;
+  }
+
+  bool is_same_texture_desc(const zv::FrameGraphTextureDesc& a, const zv::FrameGraphTextureDesc& b)
+  {
+    return a.width == b.width && a.height == b.height && a.format == b.format;
+  }
+}
+
+bool zv::is_write_access(eFrameGraphAccess access)
+{
+  return access == eFrameGraphAccess::RenderTarget || access == eFrameGraphAccess::DepthWrite || access == eFrameGraphAccess::CopyDest;
+}
+
+zv::FrameGraph::~FrameGraph()
+{
+  destroy();
+}
+
+void zv::FrameGraph::clear()
+{
+  m_passes.clear();
+  m_resources.clear();
+  m_levels.clear();
+  m_final_barriers.clear();
+  m_declarations_valid = true;
+  m_compiled = false;
+}
+
+zv::FrameGraphResourceId zv::FrameGraph::create_texture(const FrameGraphTextureDesc& desc)
+{
+  ZV_ASSERT(desc.width > 0 && desc.height > 0);
+  return add_resource(desc.name, true, true, desc, eFrameGraphAccess::Unknown);
+}
+
+zv::FrameGraphResourceId zv::FrameGraph::import_texture(const char* name, eFrameGraphAccess final_access)
+{
+  return add_resource(name, false, true, FrameGraphTextureDesc{ name }, final_access);
+}
+
+zv::FrameGraphResourceId zv::FrameGraph::import_buffer(const char* name, eFrameGraphAccess final_access)
+{
+  return add_resource(name, false, false, FrameGraphTextureDesc{ name }, final_access);
+}
+
+zv::FrameGraphResourceId zv::FrameGraph::add_resource(const char* name, bool transient, bool texture, const FrameGraphTextureDesc& desc,
+                                                      eFrameGraphAccess final_access)
+{
+  Resource resource;
+  resource.name = name;
+  resource.transient = transient;
+  resource.texture = texture;
+  resource.desc = desc;
+  resource.final_access = final_access;
+  m_resources.push_back(resource);
+
+  m_compiled = false;
+  return static_cast<FrameGraphResourceId>(m_resources.size() - 1);
+}
+
+zv::FrameGraphPassId zv::FrameGraph::add_pass(const char* name, ExecuteFn fn, u32 flags)
+{
+  Pass pass;
+  pass.name = name;
+  pass.fn = std::move(fn);
+  pass.flags = flags;
+  m_passes.push_back(std::move(pass));
+
+  m_compiled = false;
+  return static_cast<FrameGraphPassId>(m_passes.size() - 1);
+}
+
+void zv::FrameGraph::read(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access)
+{
+  ZV_ASSERT(!is_write_access(access));
+  add_access(pass, resource, access, false);
+}
+
+void zv::FrameGraph::write(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access)
+{
+  ZV_ASSERT(is_write_access(access));
+  add_access(pass, resource, access, true);
+}
+
+void zv::FrameGraph::add_access(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access, bool write)
+{
+  ZV_ASSERT(pass < m_passes.size() && resource < m_resources.size());
+  ZV_ASSERT(!is_attachment_access(access) || m_resources[resource].texture);
+
+  m_compiled = false;
+
+  if (Access* ptr_access = find_access(pass, resource))
+  {
+    // a resource is in exactly one state while a pass executes
+    if (ptr_access->access != access)
+    {
+      ZV_ERROR("Frame graph pass '{}' uses '{}' in two different states.", m_passes[pass].name, m_resources[resource].name);
+      m_declarations_valid = false;
+    }
+    return;
+  }
+
+  m_passes[pass].accesses.push_back(Access{ resource, access, write, false, Vector4{ 0.f, 0.f, 0.f, 0.f } });
+}
+
+zv::FrameGraph::Access* zv::FrameGraph::find_access(FrameGraphPassId pass, FrameGraphResourceId resource)
+{
+  for (Access& access : m_passes[pass].accesses)
+  {
+    if (access.resource == resource)
+    {
+      return &access;
+    }
+  }
+  return nullptr;
+}
+
+void zv::FrameGraph::set_clear_color(FrameGraphPassId pass, FrameGraphResourceId resource, const Vector4& color)
+{
+  Access* ptr_access = find_access(pass, resource);
+  ZV_ASSERT(ptr_access && ptr_access->access == eFrameGraphAccess::RenderTarget);
+
+  ptr_access->clear = true;
+  ptr_access->clear_value = color;
+  m_compiled = false;
+}
+
+void zv::FrameGraph::set_clear_depth(FrameGraphPassId pass, FrameGraphResourceId resource, f32 depth)
+{
+  Access* ptr_access = find_access(pass, resource);
+  ZV_ASSERT(ptr_access && ptr_access->access == eFrameGraphAccess::DepthWrite);
+
+  ptr_access->clear = true;
+  ptr_access->clear_value = Vector4{ depth, 0.f, 0.f, 0.f };
+  m_compiled = false;
+}
+
+bool zv::FrameGraph::compile()
+{
+  m_compiled = false;
+  if (!m_declarations_valid)
+  {
+    return false;
+  }
+
+  cull_passes();
+  compute_barriers();
+  schedule_passes();
+  alias_transients();
+
+  m_compiled = true;
+  return true;
+}
+
+void zv::FrameGraph::cull_passes()
+{
+  // Walks the passes backwards and keeps a pass if a later pass or the frame's outputs need one of its writes. A
+  // cleared attachment overwrites everything, so writers before it are only needed if someone reads in between.
+  std::vector<u8> needed(m_resources.size(), 0);
+  for (u32 i = 0; i < m_resources.size(); ++i)
+  {
+    needed[i] = !m_resources[i].transient && m_resources[i].final_access != eFrameGraphAccess::Unknown;
+  }
+
+  for (u32 p = static_cast<u32>(m_passes.size()); p-- > 0;)
+  {
+    Pass& pass = m_passes[p];
+
+    bool alive = (pass.flags & k_pass_flag_side_effects) != 0;
+    for (const Access& access : pass.accesses)
+    {
+      alive = alive || (access.write && needed[access.resource]);
+    }
+
+    pass.culled = !alive;
+    if (!alive)
+    {
+      continue;
+    }
+
+    for (const Access& access : pass.accesses)
+    {
+      needed[access.resource] = !(access.write && access.clear);
+    }
+  }
+}
+
+void zv::FrameGraph::compute_barriers()
+{
+  for (Resource& resource : m_resources)
+  {
+    resource.first_pass = k_invalid_frame_graph_id;
+  }
+
+  std::vector<eFrameGraphAccess> last_access(m_resources.size(), eFrameGraphAccess::Unknown);
+  for (u32 p = 0; p < m_passes.size(); ++p)
+  {
+    if (m_passes[p].culled)
+    {
+      continue;
+    }
+
+    for (const Access& access : m_passes[p].accesses)
+    {
+      Resource& resource = m_resources[access.resource];
+      if (resource.first_pass == k_invalid_frame_graph_id)
+      {
+        resource.first_pass = p;
+        if (resource.transient && !access.write)
+        {
+          ZV_WARNING("Frame graph pass '{}' reads transient '{}' before it is written.", m_passes[p].name, resource.name);
+        }
+      }
+      last_access[access.resource] = access.access;
+    }
+  }
+
+  // Transient contents do not survive the frame, they start from whatever state their physical texture was left in.
+  // Imported resources enter the frame in the state they left the last one.
+  std::vector<eFrameGraphAccess> current(m_resources.size());
+  for (u32 i = 0; i < m_resources.size(); ++i)
+  {
+    Resource& resource = m_resources[i];
+    resource.initial_access = eFrameGraphAccess::Unknown;
+    if (!resource.transient)
+    {
+      resource.initial_access = resource.final_access != eFrameGraphAccess::Unknown ? resource.final_access : last_access[i];
+    }
+    current[i] = resource.initial_access;
+  }
+
+  for (Pass& pass : m_passes)
+  {
+    pass.barriers.clear();
+    if (pass.culled)
+    {
+      continue;
+    }
+
+    for (const Access& access : pass.accesses)
+    {
+      if (current[access.resource] != access.access)
+      {
+        pass.barriers.push_back(Barrier{ access.resource, current[access.resource], access.access });
+        current[access.resource] = access.access;
+      }
+    }
+  }
+
+  m_final_barriers.clear();
+  for (u32 i = 0; i < m_resources.size(); ++i)
+  {
+    const Resource& resource = m_resources[i];
+    if (resource.final_access != eFrameGraphAccess::Unknown && current[i] != resource.final_access)
+    {
+      m_final_barriers.push_back(Barrier{ i, current[i], resource.final_access });
+    }
+  }
+}
+
+void zv::FrameGraph::alias_transients()
+{
+  // the textures of the last compilation stay around for allocate() to pick from
+  for (PhysicalTexture& physical : m_physical_textures)
+  {
+    if (physical.ptr_texture)
+    {
+      m_texture_pool.push_back(std::move(physical.ptr_texture));
+    }
+  }
+  m_physical_textures.clear();
+
+  // Lifetimes are measured in levels, not in declaration order: levels run one after the other, but the passes of one
+  // level may run in any order or in parallel, and a pass declared late can land in an early level
+  for (Resource& resource : m_resources)
+  {
+    resource.physical_index = k_invalid_frame_graph_id;
+    resource.first_level = k_invalid_frame_graph_id;
+    resource.last_level = 0;
+  }
+
+  for (const Pass& pass : m_passes)
+  {
+    if (pass.culled)
+    {
+      continue;
+    }
+
+    for (const Access& access : pass.accesses)
+    {
+      Resource& resource = m_resources[access.resource];
+      resource.first_level = std::min(resource.first_level, pass.level);
+      resource.last_level = std::max(resource.last_level, pass.level);
+    }
+  }
+
+  std::vector<FrameGraphResourceId> transients;
+  for (u32 i = 0; i < m_resources.size(); ++i)
+  {
+    if (m_resources[i].transient && m_resources[i].first_level != k_invalid_frame_graph_id)
+    {
+      transients.push_back(i);
+    }
+  }
+
+  std::stable_sort(transients.begin(), transients.end(), [this](FrameGraphResourceId a, FrameGraphResourceId b)
+  {
+    return m_resources[a].first_level < m_resources[b].first_level;
+  });
+
+  // Greedy interval assignment: a transient goes into the first compatible texture whose last user ran in an earlier level
+  for (FrameGraphResourceId id : transients)
+  {
+    Resource& resource = m_resources[id];
+
+    u32 physical_index = k_invalid_frame_graph_id;
+    for (u32 i = 0; i < m_physical_textures.size(); ++i)
+    {
+      const PhysicalTexture& physical = m_physical_textures[i];
+      if (physical.last_level < resource.first_level && is_same_texture_desc(physical.desc, resource.desc))
+      {
+        physical_index = i;
+        break;
+      }
+    }
+
+    if (physical_index == k_invalid_frame_graph_id)
+    {
+      physical_index = static_cast<u32>(m_physical_textures.size());
+      m_physical_textures.emplace_back();
+      m_physical_textures.back().desc = resource.desc;
+    }
+
+    PhysicalTexture& physical = m_physical_textures[physical_index];
+    physical.last_level = resource.last_level;
+    for (const Pass& pass : m_passes)
+    {
+      for (const Access& access : pass.accesses)
+      {
+        if (access.resource == id)
+        {
+          physical.access_mask |= 1u << static_cast<u32>(access.access);
+        }
+      }
+    }
+
+    resource.physical_index = physical_index;
+  }
+}
+
+void zv::FrameGraph::schedule_passes()
+{
+  // Two passes depend on each other if they share a resource that one of them writes or that they need in different
+  // states. Passes with side effects keep their order, their effects are not declared.
+  const auto depends = [](const Pass& earlier, const Pass& later)
+  {
+    if ((earlier.flags & later.flags & k_pass_flag_side_effects) != 0)
+    {
+      return true;
+    }
+
+    for (const Access& a : earlier.accesses)
+    {
+      for (const Access& b : later.accesses)
+      {
+        if (a.resource == b.resource && (a.write || b.write || a.access != b.access))
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+
+  m_levels.clear();
+  for (u32 p = 0; p < m_passes.size(); ++p)
+  {
+    Pass& pass = m_passes[p];
+    pass.level = 0;
+    if (pass.culled)
+    {
+      continue;
+    }
+
+    for (u32 q = 0; q < p; ++q)
+    {
+      if (!m_passes[q].culled && depends(m_passes[q], pass))
+      {
+        pass.level = std::max(pass.level, m_passes[q].level + 1);
+      }
+    }
+
+    if (pass.level >= m_levels.size())
+    {
+      m_levels.resize(pass.level + 1);
+    }
+    m_levels[pass.level].push_back(p);
+  }
+}
+
+bool zv::FrameGraph::allocate(IRenderDevice* ptr_device)
+{
+  using namespace Diligent;
+
+  ZV_ASSERT(m_compiled);
+
+  for (PhysicalTexture& physical : m_physical_textures)
+  {
+    const u32 bind_flags = to_bind_flags(physical.access_mask);
+
+    for (auto it = m_texture_pool.begin(); it != m_texture_pool.end(); ++it)
+    {
+      const TextureDesc& desc = (*it)->GetDesc();
+      if (desc.Width == physical.desc.width && desc.Height == physical.desc.height && desc.Format == physical.desc.format &&
+          (desc.BindFlags & bind_flags) == bind_flags)
+      {
+        physical.ptr_texture = std::move(*it);
+        m_texture_pool.erase(it);
+        break;
+      }
+    }
+
+    if (physical.ptr_texture)
+    {
+      continue;
+    }
+
+    TextureDesc desc;
+    desc.Name      = physical.desc.name;
+    desc.Type      = RESOURCE_DIM_TEX_2D;
+    desc.Width     = physical.desc.width;
+    desc.Height    = physical.desc.height;
+    desc.Format    = physical.desc.format;
+    desc.BindFlags = static_cast<BIND_FLAGS>(bind_flags);
+    if (bind_flags & BIND_DEPTH_STENCIL)
+    {
+      desc.ClearValue.Format             = desc.Format;
+      desc.ClearValue.DepthStencil.Depth = 1.0f;
+    }
+    ptr_device->CreateTexture(desc, nullptr, &physical.ptr_texture);
+
+    if (physical.ptr_texture == nullptr)
+    {
+      ZV_ERROR("Failed to create frame graph texture '{}' ({}x{}).", physical.desc.name, physical.desc.width, physical.desc.height);
+      return false;
+    }
+  }
+
+  m_texture_pool.clear();
+
+  for (Resource& resource : m_resources)
+  {
+    if (resource.transient)
+    {
+      resource.ptr_texture = resource.physical_index != k_invalid_frame_graph_id ? m_physical_textures[resource.physical_index].ptr_texture.RawPtr() : nullptr;
+    }
+  }
+
+  return true;
+}
+
+void zv::FrameGraph::destroy()
+{
+  clear();
+  m_physical_textures.clear();
+  m_texture_pool.clear();
+  m_command_lists.clear();
+  m_ptr_command_lists.clear();
+}
+
+void zv::FrameGraph::set_imported_texture(FrameGraphResourceId resource, ITexture* ptr_texture)
+{
+  ZV_ASSERT(!m_resources[resource].transient && m_resources[resource].texture);
+  m_resources[resource].ptr_texture = ptr_texture;
+}
+
+void zv::FrameGraph::set_imported_buffer(FrameGraphResourceId resource, IBuffer* ptr_buffer)
+{
+  ZV_ASSERT(!m_resources[resource].transient && !m_resources[resource].texture);
+  m_resources[resource].ptr_buffer = ptr_buffer;
+}
+
+zv::ITexture* zv::FrameGraph::get_texture(FrameGraphResourceId resource) const
+{
+  return m_resources[resource].ptr_texture;
+}
+
+zv::ITextureView* zv::FrameGraph::get_texture_view(FrameGraphResourceId resource, eTextureViewType view_type) const
+{
+  ITexture* ptr_texture = m_resources[resource].ptr_texture;
+  return ptr_texture ? ptr_texture->GetDefaultView(view_type) : nullptr;
+}
+
+void zv::FrameGraph::issue_barriers(IDeviceContext* ptr_context, const std::vector<Barrier>& barriers)
+{
+  using namespace Diligent;
+
+  // The old state is left to the state tracking: it only differs from the compiled one for objects that are new this
+  // frame, and aliased transients start in whatever state the previous user of their texture left behind
+  constexpr u32 k_batch_size = 16;
+  StateTransitionDesc descs[k_batch_size];
+  u32 count = 0;
+
+  for (const Barrier& barrier : barriers)
+  {
+    const Resource& resource = m_resources[barrier.resource];
+
+    StateTransitionDesc& desc = descs[count];
+    desc = StateTransitionDesc{};
+    desc.pResource = resource.texture ? static_cast<IDeviceObject*>(resource.ptr_texture) : static_cast<IDeviceObject*>(resource.ptr_buffer);
+    desc.OldState  = RESOURCE_STATE_UNKNOWN;
+    desc.NewState  = to_resource_state(barrier.after);
+    desc.Flags     = STATE_TRANSITION_FLAG_UPDATE_STATE;
+    ZV_ASSERT(desc.pResource != nullptr);
+
+    if (++count == k_batch_size)
+    {
+      ptr_context->TransitionResourceStates(count, descs);
+      count = 0;
+    }
+  }
+
+  if (count > 0)
+  {
+    ptr_context->TransitionResourceStates(count, descs);
+  }
+}
+
+void zv::FrameGraph::begin_pass(IDeviceContext* ptr_context, const Pass& pass) const
+{
+  using namespace Diligent;
+
+  ITextureView* ptr_rtvs[MAX_RENDER_TARGETS] = {};
+  ITextureView* ptr_dsv = nullptr;
+  u32 rtv_count = 0;
+
+  for (const Access& access : pass.accesses)
+  {
+    ITexture* ptr_texture = m_resources[access.resource].ptr_texture;
+    switch (access.access)
+    {
+      case eFrameGraphAccess::RenderTarget:
+        ZV_ASSERT(rtv_count < MAX_RENDER_TARGETS);
+        ptr_rtvs[rtv_count++] = ptr_texture->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
+        break;
+      case eFrameGraphAccess::DepthWrite:
+        ptr_dsv = ptr_texture->GetDefaultView(TEXTURE_VIEW_DEPTH_STENCIL);
+        break;
+      case eFrameGraphAccess::DepthRead:
+        ptr_dsv = ptr_texture->GetDefaultView(TEXTURE_VIEW_READ_ONLY_DEPTH_STENCIL);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (rtv_count == 0 && ptr_dsv == nullptr)
+  {
+    return;
+  }
+
+  // all states are set by the graph's barriers, the context only verifies them
+  ptr_context->SetRenderTargets(rtv_count, ptr_rtvs, ptr_dsv, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+
+  u32 rtv_index = 0;
+  for (const Access& access : pass.accesses)
+  {
+    if (access.access == eFrameGraphAccess::RenderTarget)
+    {
+      if (access.clear)
+      {
+        ptr_context->ClearRenderTarget(ptr_rtvs[rtv_index], access.clear_value.Data(), RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+      }
+      ++rtv_index;
+    }
+    else if (access.access == eFrameGraphAccess::DepthWrite && access.clear)
+    {
+      ptr_context->ClearDepthStencil(ptr_dsv, CLEAR_DEPTH_FLAG, access.clear_value.x, 0, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    }
+  }
+}
+
+void zv::FrameGraph::execute_pass(IDeviceContext* ptr_immediate_context, const Pass& pass) const
+{
+  const bool timed = m_ptr_profiler != nullptr && m_ptr_profiler->begin_scope(ptr_immediate_context, pass.name);
+  begin_pass(ptr_immediate_context, pass);
+  pass.fn(ptr_immediate_context);
+  if (timed)
+  {
+    m_ptr_profiler->end_scope(ptr_immediate_context);
+  }
+}
+
+void zv::FrameGraph::execute(IDeviceContext* ptr_immediate_context, const std::vector<RefCntAutoPtr<IDeviceContext>>& deferred_contexts)
+{
+  ZV_ASSERT(m_compiled);
+
+  // Imported objects that are new this frame, like the next back buffer, are moved into the state the compiled
+  // barriers expect at the beginning of the frame
+  m_level_barriers.clear();
+  for (u32 i = 0; i < m_resources.size(); ++i)
+  {
+    Resource& resource = m_resources[i];
+    const void* ptr_object = resource.texture ? static_cast<const void*>(resource.ptr_texture) : static_cast<const void*>(resource.ptr_buffer);
+    if (!resource.transient && ptr_object != resource.ptr_last_object && resource.initial_access != eFrameGraphAccess::Unknown)
+    {
+      m_level_barriers.push_back(Barrier{ i, eFrameGraphAccess::Unknown, resource.initial_access });
+    }
+    resource.ptr_last_object = ptr_object;
+  }
+  issue_barriers(ptr_immediate_context, m_level_barriers);
+
+  for (const std::vector<FrameGraphPassId>& level : m_levels)
+  {
+    m_level_barriers.clear();
+    for (FrameGraphPassId p : level)
+    {
+      m_level_barriers.insert(m_level_barriers.end(), m_passes[p].barriers.begin(), m_passes[p].barriers.end());
+    }
+    issue_barriers(ptr_immediate_context, m_level_barriers);
+
+    m_deferred_passes.clear();
+    for (FrameGraphPassId p : level)
+    {
+      if ((m_passes[p].flags & k_pass_flag_deferred) != 0 && level.size() > 1 && !deferred_contexts.empty())
+      {
+        m_deferred_passes.push_back(p);
+        continue;
+      }
+
+      execute_pass(ptr_immediate_context, m_passes[p]);
+    }
+
+    if (m_deferred_passes.size() == 1)
+    {
+      execute_pass(ptr_immediate_context, m_passes[m_deferred_passes[0]]);
+    }
+    else if (m_deferred_passes.size() > 1)
+    {
+      // Independent passes of one level are recorded in parallel, context i takes passes i, i + n, ...; their order
+      // within the level does not matter
+      const u32 list_count = std::min(static_cast<u32>(m_deferred_passes.size()), static_cast<u32>(deferred_contexts.size()));
+      m_command_lists.resize(list_count);
+      m_ptr_command_lists.resize(list_count);
+
+      Jobs::parallel_for(list_count, 1, [&](u32 begin, u32 end)
+      {
+        for (u32 i = begin; i < end; ++i)
+        {
+          IDeviceContext* ptr_context = deferred_contexts[i];
+          ptr_context->Begin(0);
+          for (u32 k = i; k < m_deferred_passes.size(); k += list_count)
+          {
+            const Pass& pass = m_passes[m_deferred_passes[k]];
+            begin_pass(ptr_context, pass);
+            pass.fn(ptr_context);
+          }
+          ptr_context->FinishCommandList(&m_command_lists[i]);
+        }
+      });
+
+      for (u32 i = 0; i < list_count; ++i)
+      {
+        m_ptr_command_lists[i] = m_command_lists[i];
+      }
+      // Queries are only issued on the immediate context, the parallel passes of a level are timed together
+      const bool timed = m_ptr_profiler != nullptr && m_ptr_profiler->begin_scope(ptr_immediate_context, "Parallel passes");
+      if (m_ptr_profiler != nullptr)
+      {
+        m_ptr_profiler->execute_command_lists(ptr_immediate_context, list_count, m_ptr_command_lists.data());
+      }
+      else
+      {
+        ptr_immediate_context->ExecuteCommandLists(list_count, m_ptr_command_lists.data());
+      }
+      if (timed)
+      {
+        m_ptr_profiler->end_scope(ptr_immediate_context);
+      }
+
+      for (u32 i = 0; i < list_count; ++i)
+      {
+        m_command_lists[i] = nullptr;
+        m_ptr_command_lists[i] = nullptr;
+        deferred_contexts[i]->FinishFrame();
+      }
+    }
+  }
+
+  issue_barriers(ptr_immediate_context, m_final_barriers);
+}
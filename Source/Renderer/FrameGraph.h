@@ -0,0 +1,221 @@
+/*
+ * FrameGraph.h - declarative pass graph with precomputed resource transitions and transient texture aliasing
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <MathDefines.h>
+#include <RendererDecl.h>
+
+namespace zv
+{
+  class GpuProfiler;
+
+  using FrameGraphResourceId = u32;
+  using FrameGraphPassId = u32;
+  constexpr u32 k_invalid_frame_graph_id = ~0u;
+
+  // How a pass uses a resource; every access maps to one resource state. RenderTarget, DepthWrite and CopyDest are
+  // writes, everything else is a read.
+  enum class eFrameGraphAccess : u8
+  {
+    Unknown,
+    RenderTarget,
+    DepthWrite,
+    DepthRead,
+    ShaderResource,
+    ConstantBuffer,
+    VertexBuffer,
+    IndexBuffer,
+    CopySource,
+    CopyDest,
+    Present,
+  };
+
+  bool is_write_access(eFrameGraphAccess access);
+
+  struct FrameGraphTextureDesc
+  {
+    const char* name{ nullptr };
+    u32 width{ 0 };
+    u32 height{ 0 };
+    eTextureFormat format{};
+  };
+
+  // The graph is declared once: resources are either transient textures owned by the graph or imported device objects,
+  // passes declare which resources they read and write. compile() works on the declarations only, so it runs without a
+  // render device:
+  //  - passes that contribute neither to an output nor have side effects are culled
+  //  - the state transitions in front of every pass are computed once, executing a frame only issues them
+  //  - passes are grouped into levels of mutually independent passes, levels with several passes that allow it are
+  //    recorded in parallel on deferred contexts
+  //  - transient textures with the same description share one physical texture if the levels they are used in do not
+  //    overlap
+  //
+  // Imported resources are assumed to enter each frame in the state they leave the previous one (the final access if
+  // one is given, the last access otherwise), so resources used the same way every frame need no transitions at all.
+  class FrameGraph : public NonCopyable
+  {
+  public:
+    using ExecuteFn = std::function<void(IDeviceContext* ptr_context)>;
+
+    enum ePassFlags : u32
+    {
+      k_pass_flag_none         = 0,
+      // never culled, e.g. passes that present or read back
+      k_pass_flag_side_effects = 1 << 0,
+      // may be recorded on a deferred context; the pass must not map dynamic resources
+      k_pass_flag_deferred     = 1 << 1,
+    };
+
+    struct Barrier
+    {
+      FrameGraphResourceId resource;
+      eFrameGraphAccess before;
+      eFrameGraphAccess after;
+    };
+
+  public:
+    FrameGraph() = default;
+    ~FrameGraph();
+
+  public:
+    // removes all passes and resources; physical textures are kept for the next allocate()
+    void clear();
+
+    FrameGraphResourceId create_texture(const FrameGraphTextureDesc& desc);
+    // final_access other than Unknown makes the resource a graph output and is the state it is left in
+    FrameGraphResourceId import_texture(const char* name, eFrameGraphAccess final_access = eFrameGraphAccess::Unknown);
+    FrameGraphResourceId import_buffer(const char* name, eFrameGraphAccess final_access = eFrameGraphAccess::Unknown);
+
+    FrameGraphPassId add_pass(const char* name, ExecuteFn fn, u32 flags = k_pass_flag_none);
+    void read(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access);
+    // RenderTarget and DepthWrite writes bind the texture before the pass executes; unless cleared, they keep the
+    // previous contents and therefore also depend on earlier writers
+    void write(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access);
+    void set_clear_color(FrameGraphPassId pass, FrameGraphResourceId resource, const Vector4& color);
+    void set_clear_depth(FrameGraphPassId pass, FrameGraphResourceId resource, f32 depth);
+
+    // returns false if the declarations are inconsistent, e.g. one pass using a resource in two states
+    bool compile();
+
+    // creates the physical textures of a compiled graph, textures of a previous allocation are reused where they fit
+    bool allocate(IRenderDevice* ptr_device);
+    void destroy();
+
+    // imported objects may change every frame, e.g. the current back buffer
+    void set_imported_texture(FrameGraphResourceId resource, ITexture* ptr_texture);
+    void set_imported_buffer(FrameGraphResourceId resource, IBuffer* ptr_buffer);
+
+    // passes executed on the immediate context become GPU scopes of the profiler, null disables timing
+    void set_profiler(GpuProfiler* ptr_profiler) { m_ptr_profiler = ptr_profiler; }
+    void execute(IDeviceContext* ptr_immediate_context, const std::vector<RefCntAutoPtr<IDeviceContext>>& deferred_contexts);
+
+    // compiled graph
+    bool is_compiled() const { return m_compiled; }
+    bool is_pass_culled(FrameGraphPassId pass) const { return m_passes[pass].culled; }
+    const std::vector<Barrier>& get_pass_barriers(FrameGraphPassId pass) const { return m_passes[pass].barriers; }
+    const std::vector<Barrier>& get_final_barriers() const { return m_final_barriers; }
+    u32 get_pass_level(FrameGraphPassId pass) const { return m_passes[pass].level; }
+    u32 get_level_count() const { return static_cast<u32>(m_levels.size()); }
+    // physical texture a transient texture is placed in
+    u32 get_physical_index(FrameGraphResourceId resource) const { return m_resources[resource].physical_index; }
+    u32 get_physical_texture_count() const { return static_cast<u32>(m_physical_textures.size()); }
+
+    // texture of a transient or imported texture, transient ones are only valid after allocate()
+    ITexture* get_texture(FrameGraphResourceId resource) const;
+    ITextureView* get_texture_view(FrameGraphResourceId resource, eTextureViewType view_type) const;
+
+  private:
+    struct Access
+    {
+      FrameGraphResourceId resource;
+      eFrameGraphAccess access;
+      bool write;
+      bool clear;
+      Vector4 clear_value;
+    };
+
+    struct Pass
+    {
+      const char* name;
+      ExecuteFn fn;
+      u32 flags;
+      std::vector<Access> accesses;
+
+      bool culled{ false };
+      u32 level{ 0 };
+      std::vector<Barrier> barriers;
+    };
+
+    struct Resource
+    {
+      const char* name;
+      bool transient;
+      bool texture;
+      FrameGraphTextureDesc desc;
+      eFrameGraphAccess final_access;
+
+      ITexture* ptr_texture{ nullptr };
+      IBuffer* ptr_buffer{ nullptr };
+      // imported object of the last executed frame, a new object gets transitioned into the expected state first
+      const void* ptr_last_object{ nullptr };
+
+      // compiled
+      eFrameGraphAccess initial_access{ eFrameGraphAccess::Unknown };
+      u32 first_pass{ k_invalid_frame_graph_id };
+      u32 first_level{ k_invalid_frame_graph_id };
+      u32 last_level{ 0 };
+      u32 physical_index{ k_invalid_frame_graph_id };
+    };
+
+    struct PhysicalTexture
+    {
+      FrameGraphTextureDesc desc;
+      // bit per eFrameGraphAccess of all resources placed in the texture, decides the bind flags
+      u32 access_mask{ 0 };
+      u32 last_level{ 0 };
+      RefCntAutoPtr<ITexture> ptr_texture;
+    };
+
+  private:
+    FrameGraphResourceId add_resource(const char* name, bool transient, bool texture, const FrameGraphTextureDesc& desc, eFrameGraphAccess final_access);
+    void add_access(FrameGraphPassId pass, FrameGraphResourceId resource, eFrameGraphAccess access, bool write);
+    Access* find_access(FrameGraphPassId pass, FrameGraphResourceId resource);
+
+    void cull_passes();
+    void compute_barriers();
+    void schedule_passes();
+    void alias_transients();
+
+    void issue_barriers(IDeviceContext* ptr_context, const std::vector<Barrier>& barriers);
+    void begin_pass(IDeviceContext* ptr_context, const Pass& pass) const;
+    // begins and executes a pass on the immediate context, timed as a GPU scope if a profiler is set
+    void execute_pass(IDeviceContext* ptr_immediate_context, const Pass& pass) const;
+
+  private:
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<PhysicalTexture> m_physical_textures;
+    // passes per level in declaration order, only passes that are not culled
+    std::vector<std::vector<FrameGraphPassId>> m_levels;
+    std::vector<Barrier> m_final_barriers;
+    // physical textures of earlier compilations, reused by allocate()
+    std::vector<RefCntAutoPtr<ITexture>> m_texture_pool;
+    bool m_declarations_valid{ true };
+    bool m_compiled{ false };
+    GpuProfiler* m_ptr_profiler{ nullptr };
+
+    // execution scratch
+    std::vector<Barrier> m_level_barriers;
+    std::vector<FrameGraphPassId> m_deferred_passes;
+    std::vector<RefCntAutoPtr<ICommandList>> m_command_lists;
+    std::vector<ICommandList*> m_ptr_command_lists;
+  };
+}
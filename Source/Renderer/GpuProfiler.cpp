@@ -0,0 +1,272 @@
+/*
+ * GpuProfiler.cpp - ring-buffered GPU timestamp and pipeline statistics queries
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/GpuProfiler.h>
+
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/Query.h>
+
+
+zv::GpuProfiler::~GpuProfiler()
+{
+  destroy();
+}
+
+bool zv::GpuProfiler::create(IRenderDevice* ptr_device)
+{
+  using namespace Diligent;
+
+  destroy();
+
+  m_ptr_device = ptr_device;
+  const DeviceFeatures& features = ptr_device->GetDeviceInfo().Features;
+  m_timestamps_supported = features.TimestampQueries == DEVICE_FEATURE_STATE_ENABLED;
+  m_pipeline_statistics_supported = features.PipelineStatisticsQueries == DEVICE_FEATURE_STATE_ENABLED;
+
+  if (!m_timestamps_supported)
+  {
+    ZV_INFO("GPU timestamp queries are not supported, GPU timings are unavailable.");
+    return true;
+  }
+
+  for (FrameQueries& frame : m_frames)
+  {
+    QueryDesc timestamp_desc;
+    timestamp_desc.Name = "GPU profiler timestamp";
+    timestamp_desc.Type = QUERY_TYPE_TIMESTAMP;
+    for (RefCntAutoPtr<IQuery>& ptr_query : frame.timestamps)
+    {
+      ptr_device->CreateQuery(timestamp_desc, &ptr_query);
+      if (ptr_query == nullptr)
+      {
+        ZV_ERROR("Failed to create the GPU profiler's timestamp queries.");
+        destroy();
+        return false;
+      }
+    }
+
+    if (m_pipeline_statistics_supported)
+    {
+      QueryDesc statistics_desc;
+      statistics_desc.Name = "GPU profiler pipeline statistics";
+      statistics_desc.Type = QUERY_TYPE_PIPELINE_STATISTICS;
+      for (RefCntAutoPtr<IQuery>& ptr_query : frame.pipeline_statistics)
+      {
+        ptr_device->CreateQuery(statistics_desc, &ptr_query);
+        m_pipeline_statistics_supported &= ptr_query != nullptr;
+      }
+    }
+  }
+
+  return true;
+}
+
+void zv::GpuProfiler::destroy()
+{
+  for (FrameQueries& frame : m_frames)
+  {
+    frame = FrameQueries{};
+  }
+
+  m_ptr_device = nullptr;
+  m_timestamps_supported = false;
+  m_pipeline_statistics_supported = false;
+  m_frame_index = 0;
+  m_in_frame = false;
+  m_in_scope = false;
+  m_in_statistics_segment = false;
+  m_frame_stats = GpuFrameStats{};
+  m_dropped_frame_count = 0;
+}
+
+void zv::GpuProfiler::begin_frame(IDeviceContext* ptr_context)
+{
+  if (!m_timestamps_supported)
+  {
+    return;
+  }
+
+  // The set issued k_frame_latency frames ago is reused now; its results are taken if the GPU is done with it,
+  // otherwise they are lost, reading them would have to wait for the GPU
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  if (frame.pending && !read_results(frame))
+  {
+    ++m_dropped_frame_count;
+  }
+
+  frame.pending = true;
+  frame.frame_index = m_frame_index;
+  frame.scope_count = 0;
+  frame.statistics_segment_count = 0;
+  frame.statistics_partial = false;
+  ptr_context->EndQuery(frame.timestamps[0]);
+  begin_statistics_segment(ptr_context);
+  m_in_frame = true;
+}
+
+void zv::GpuProfiler::end_frame(IDeviceContext* ptr_context)
+{
+  if (!m_timestamps_supported)
+  {
+    return;
+  }
+
+  ZV_ASSERT(!m_in_scope);
+
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  end_statistics_segment(ptr_context);
+  ptr_context->EndQuery(frame.timestamps[1]);
+  m_in_frame = false;
+  ++m_frame_index;
+}
+
+bool zv::GpuProfiler::begin_scope(IDeviceContext* ptr_context, const char* name)
+{
+  if (!m_timestamps_supported)
+  {
+    return false;
+  }
+
+  ZV_ASSERT(!m_in_scope);
+
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  if (frame.scope_count == k_max_scopes)
+  {
+    return false;
+  }
+
+  frame.scope_names[frame.scope_count] = name;
+  ptr_context->EndQuery(frame.timestamps[2 + 2 * frame.scope_count]);
+  m_in_scope = true;
+  return true;
+}
+
+void zv::GpuProfiler::end_scope(IDeviceContext* ptr_context)
+{
+  ZV_ASSERT(m_in_scope);
+
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  ptr_context->EndQuery(frame.timestamps[3 + 2 * frame.scope_count]);
+  ++frame.scope_count;
+  m_in_scope = false;
+}
+
+void zv::GpuProfiler::execute_command_lists(IDeviceContext* ptr_context, u32 command_list_count, ICommandList* const* ptr_command_lists)
+{
+  if (!m_in_frame)
+  {
+    ptr_context->ExecuteCommandLists(command_list_count, ptr_command_lists);
+    return;
+  }
+
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  end_statistics_segment(ptr_context);
+  frame.statistics_partial = true;
+  ptr_context->ExecuteCommandLists(command_list_count, ptr_command_lists);
+  begin_statistics_segment(ptr_context);
+}
+
+void zv::GpuProfiler::begin_statistics_segment(IDeviceContext* ptr_context)
+{
+  FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+  if (m_pipeline_statistics_supported && frame.statistics_segment_count < k_max_statistics_segments)
+  {
+    ptr_context->BeginQuery(frame.pipeline_statistics[frame.statistics_segment_count]);
+    m_in_statistics_segment = true;
+  }
+}
+
+void zv::GpuProfiler::end_statistics_segment(IDeviceContext* ptr_context)
+{
+  if (m_in_statistics_segment)
+  {
+    FrameQueries& frame = m_frames[m_frame_index % k_frame_latency];
+    ptr_context->EndQuery(frame.pipeline_statistics[frame.statistics_segment_count]);
+    ++frame.statistics_segment_count;
+    m_in_statistics_segment = false;
+  }
+}
+
+bool zv::GpuProfiler::read_results(FrameQueries& frame)
+{
+  using namespace Diligent;
+
+  // all queries are checked before anything is published, so the stats never mix two frames
+  QueryDataTimestamp timestamps[2 + 2 * k_max_scopes];
+  const u32 timestamp_count = 2 + 2 * frame.scope_count;
+  for (u32 i = 0; i < timestamp_count; ++i)
+  {
+    if (!frame.timestamps[i]->GetData(&timestamps[i], sizeof(QueryDataTimestamp)))
+    {
+      return false;
+    }
+  }
+
+  // summed over the immediate context segments of the frame
+  QueryDataPipelineStatistics statistics_sum;
+  bool statistics_valid = m_pipeline_statistics_supported && frame.statistics_segment_count > 0;
+  for (u32 i = 0; statistics_valid && i < frame.statistics_segment_count; ++i)
+  {
+    QueryDataPipelineStatistics statistics;
+    statistics_valid = frame.pipeline_statistics[i]->GetData(&statistics, sizeof(statistics));
+    statistics_sum.InputPrimitives    += statistics.InputPrimitives;
+    statistics_sum.ClippingPrimitives += statistics.ClippingPrimitives;
+    statistics_sum.VSInvocations      += statistics.VSInvocations;
+    statistics_sum.PSInvocations      += statistics.PSInvocations;
+  }
+
+  auto to_ms = [](const QueryDataTimestamp& begin, const QueryDataTimestamp& end)
+  {
+    return end.Counter > begin.Counter ? static_cast<f32>(f64(end.Counter - begin.Counter) * 1000.0 / f64(end.Frequency)) : 0.0f;
+  };
+
+  m_frame_stats.frame_index = frame.frame_index;
+  m_frame_stats.valid = true;
+  m_frame_stats.frame_time_ms = to_ms(timestamps[0], timestamps[1]);
+  m_frame_stats.scopes.clear();
+  for (u32 i = 0; i < frame.scope_count; ++i)
+  {
+    m_frame_stats.scopes.push_back(GpuScopeTiming{ frame.scope_names[i], to_ms(timestamps[2 + 2 * i], timestamps[3 + 2 * i]) });
+  }
+
+  m_frame_stats.pipeline_statistics_valid = statistics_valid;
+  if (statistics_valid)
+  {
+    // segments past k_max_statistics_segments were not counted either
+    m_frame_stats.pipeline_statistics_partial = frame.statistics_partial;
+    m_frame_stats.input_primitives    = statistics_sum.InputPrimitives;
+    m_frame_stats.clipping_primitives = statistics_sum.ClippingPrimitives;
+    m_frame_stats.vs_invocations      = statistics_sum.VSInvocations;
+    m_frame_stats.ps_invocations      = statistics_sum.PSInvocations;
+  }
+
+  frame.pending = false;
+  return true;
+}
+
+void zv::accumulate_context_counters(IDeviceContext* ptr_context, DeviceContextCounters& out_counters)
+{
+  using namespace Diligent;
+
+  const DeviceContextStats& stats = ptr_context->GetStats();
+  const DeviceContextCommandCounters& commands = stats.CommandCounters;
+  out_counters.draws               += commands.Draw;
+  out_counters.indexed_draws       += commands.DrawIndexed;
+  out_counters.pipeline_changes    += commands.SetPipelineState;
+  out_counters.srb_commits         += commands.CommitShaderResources;
+  out_counters.vertex_buffer_binds += commands.SetVertexBuffers;
+  out_counters.index_buffer_binds  += commands.SetIndexBuffer;
+  out_counters.render_target_binds += commands.SetRenderTargets;
+  out_counters.transitions         += commands.TransitionResourceStates;
+  out_counters.triangles           += u64(stats.PrimitiveCounts[PRIMITIVE_TOPOLOGY_TRIANGLE_LIST]) + stats.PrimitiveCounts[PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP];
+}
+
+void zv::clear_context_counters(IDeviceContext* ptr_context)
+{
+  ptr_context->ClearStats();
+}
@@ -0,0 +1,142 @@
+/*
+ * GpuProfiler.h - ring-buffered GPU timestamp and pipeline statistics queries
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace Diligent
+{
+  class IQuery;
+}
+
+namespace zv
+{
+  struct GpuScopeTiming
+  {
+    const char* name;
+    f32 time_ms;
+  };
+
+  struct GpuFrameStats
+  {
+    // the frame the results belong to, k_frame_latency or more frames behind the current one
+    u64 frame_index{ 0 };
+    bool valid{ false };
+    // first to last timestamp of the frame
+    f32 frame_time_ms{ 0.0f };
+    std::vector<GpuScopeTiming> scopes;
+
+    bool pipeline_statistics_valid{ false };
+    // The statistics only count work recorded on the immediate context, command lists executed from deferred contexts
+    // were left out; true if the frame executed any
+    bool pipeline_statistics_partial{ false };
+    u64 input_primitives{ 0 };
+    u64 clipping_primitives{ 0 };
+    u64 vs_invocations{ 0 };
+    u64 ps_invocations{ 0 };
+  };
+
+  // Commands recorded on the device contexts, summed over the immediate and all deferred contexts
+  struct DeviceContextCounters
+  {
+    u32 draws{ 0 };
+    u32 indexed_draws{ 0 };
+    u32 pipeline_changes{ 0 };
+    u32 srb_commits{ 0 };
+    u32 vertex_buffer_binds{ 0 };
+    u32 index_buffer_binds{ 0 };
+    u32 render_target_binds{ 0 };
+    u32 transitions{ 0 };
+    u64 triangles{ 0 };
+  };
+
+  // adds the counters the context collected since its last clear_context_counters()
+  void accumulate_context_counters(IDeviceContext* ptr_context, DeviceContextCounters& out_counters);
+  void clear_context_counters(IDeviceContext* ptr_context);
+
+  // Brackets the frame and named scopes with timestamp queries and the immediate context's work with pipeline statistics
+  // queries. Every frame uses its own set of queries out of a ring of k_frame_latency sets, and begin_frame() reads the set
+  // it is about to reuse without waiting: results that are not available yet are dropped instead of stalling on the GPU.
+  //
+  // Queries are only issued on the immediate context; scopes must not nest across begin_frame()/end_frame(). A pipeline
+  // statistics query has to begin and end in the same command list, and executing command lists ends the immediate
+  // context's current one, so command lists go through execute_command_lists(): it closes the statistics query around
+  // them and the frame's statistics are the sum of the segments in between. Draws of deferred contexts are not counted,
+  // queries cannot be issued there.
+  class GpuProfiler : public NonCopyable
+  {
+  public:
+    static constexpr u32 k_frame_latency = 4;
+    static constexpr u32 k_max_scopes = 16;
+    // immediate context segments per frame with pipeline statistics, later ones are not counted
+    static constexpr u32 k_max_statistics_segments = 16;
+
+  public:
+    GpuProfiler() = default;
+    ~GpuProfiler();
+
+  public:
+    // succeeds without timestamp support, the profiler then records nothing
+    bool create(IRenderDevice* ptr_device);
+    void destroy();
+
+    bool is_timing_supported() const { return m_timestamps_supported; }
+    bool is_pipeline_statistics_supported() const { return m_pipeline_statistics_supported; }
+
+    void begin_frame(IDeviceContext* ptr_context);
+    void end_frame(IDeviceContext* ptr_context);
+
+    // returns false once k_max_scopes are used this frame; end_scope() must only follow a successful begin_scope()
+    bool begin_scope(IDeviceContext* ptr_context, const char* name);
+    void end_scope(IDeviceContext* ptr_context);
+
+    // ExecuteCommandLists() on the immediate context, with the pipeline statistics query of the frame split around it
+    void execute_command_lists(IDeviceContext* ptr_context, u32 command_list_count, ICommandList* const* ptr_command_lists);
+
+    // latest frame whose queries were available
+    const GpuFrameStats& get_frame_stats() const { return m_frame_stats; }
+    // frames whose results were not available when their queries were reused
+    u64 get_dropped_frame_count() const { return m_dropped_frame_count; }
+
+  private:
+    struct FrameQueries
+    {
+      // frame begin, frame end, then begin and end per scope
+      std::array<RefCntAutoPtr<Diligent::IQuery>, 2 + 2 * k_max_scopes> timestamps;
+      std::array<RefCntAutoPtr<Diligent::IQuery>, k_max_statistics_segments> pipeline_statistics;
+      u32 statistics_segment_count{ 0 };
+      bool statistics_partial{ false };
+      std::array<const char*, k_max_scopes> scope_names{};
+      u32 scope_count{ 0 };
+      u64 frame_index{ 0 };
+      bool pending{ false };
+    };
+
+    // false if any query of the set has no data yet
+    bool read_results(FrameQueries& queries);
+    void begin_statistics_segment(IDeviceContext* ptr_context);
+    void end_statistics_segment(IDeviceContext* ptr_context);
+
+  private:
+    RefCntAutoPtr<IRenderDevice> m_ptr_device;
+    bool m_timestamps_supported{ false };
+    bool m_pipeline_statistics_supported{ false };
+
+    std::array<FrameQueries, k_frame_latency> m_frames;
+    u64 m_frame_index{ 0 };
+    bool m_in_frame{ false };
+    bool m_in_scope{ false };
+    bool m_in_statistics_segment{ false };
+
+    GpuFrameStats m_frame_stats;
+    u64 m_dropped_frame_count{ 0 };
+  };
+}
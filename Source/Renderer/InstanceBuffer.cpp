@@ -0,0 +1,204 @@
+/*
+ * InstanceBuffer.cpp - packed per-instance data with partial GPU updates for instanced drawing
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/InstanceBuffer.h>
+
+#include <algorithm>
+
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+
+
+namespace
+{
+  // clean instances bridged when merging dirty runs into one copy
+  constexpr u32 k_max_dirty_gap = 8;
+}
+
+zv::InstanceBuffer::~InstanceBuffer()
+{
+  destroy();
+}
+
+bool zv::InstanceBuffer::create(IRenderDevice* ptr_device, const CreateParams& params)
+{
+  using namespace Diligent;
+
+  destroy();
+
+  ZV_ASSERT(params.max_instances > 0);
+
+  BufferDesc desc;
+  desc.Name              = "Instance buffer";
+  desc.Size              = u64(params.max_instances) * sizeof(PackedInstance);
+  desc.Usage             = USAGE_DEFAULT;
+  desc.BindFlags         = BIND_SHADER_RESOURCE;
+  desc.Mode              = BUFFER_MODE_STRUCTURED;
+  desc.ElementByteStride = sizeof(PackedInstance);
+  ptr_device->CreateBuffer(desc, nullptr, &m_ptr_instance_buffer);
+
+  if (m_ptr_instance_buffer == nullptr)
+  {
+    ZV_ERROR("Failed to create instance buffer for {} instances.", params.max_instances);
+    return false;
+  }
+
+  m_ptr_instance_view = m_ptr_instance_buffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE);
+
+  BufferDesc draw_list_desc;
+  draw_list_desc.Name      = "Instance draw list";
+  draw_list_desc.Size      = u64(params.max_instances) * sizeof(u32);
+  draw_list_desc.Usage     = USAGE_DEFAULT;
+  draw_list_desc.BindFlags = BIND_VERTEX_BUFFER;
+  ptr_device->CreateBuffer(draw_list_desc, nullptr, &m_ptr_draw_list_buffer);
+
+  if (m_ptr_draw_list_buffer == nullptr)
+  {
+    ZV_ERROR("Failed to create instance draw list for {} instances.", params.max_instances);
+    destroy();
+    return false;
+  }
+
+  // worst case frame: every instance changed and drawn, plus alignment padding
+  const u64 frame_bytes = u64(params.max_instances) * (sizeof(PackedInstance) + sizeof(u32)) + 64;
+  const u64 ring_bytes = params.discard_each_frame ? frame_bytes : frame_bytes * std::max(params.frames_in_flight, 1u);
+  if (!m_upload_ring.create(ptr_device, "Instance upload ring", ring_bytes, BIND_VERTEX_BUFFER, params.discard_each_frame))
+  {
+    destroy();
+    return false;
+  }
+
+  m_instances.assign(params.max_instances, PackedInstance{});
+  m_dirty.assign(params.max_instances, 0);
+
+  return true;
+}
+
+void zv::InstanceBuffer::destroy()
+{
+  m_upload_ring.destroy();
+  m_ptr_instance_view = nullptr;
+  m_ptr_instance_buffer = nullptr;
+  m_ptr_draw_list_buffer = nullptr;
+
+  m_instances.clear();
+  m_dirty.clear();
+  m_dirty_ranges.clear();
+  m_dirty_begin = 0;
+  m_dirty_end = 0;
+
+  m_draw_count = 0;
+  m_uploaded_instance_count = 0;
+  m_copy_count = 0;
+}
+
+void zv::InstanceBuffer::set_transform(u32 index, const Matrix44& world)
+{
+  pack_instance_transform(world, m_instances[index]);
+  mark_dirty(index);
+}
+
+void zv::InstanceBuffer::set_color(u32 index, const Vector4& color)
+{
+  pack_instance_color(color, m_instances[index]);
+  mark_dirty(index);
+}
+
+void zv::InstanceBuffer::mark_dirty(u32 index)
+{
+  ZV_ASSERT(index < m_dirty.size());
+
+  if (m_dirty_begin == m_dirty_end)
+  {
+    m_dirty_begin = index;
+    m_dirty_end = index + 1;
+  }
+  else
+  {
+    m_dirty_begin = std::min(m_dirty_begin, index);
+    m_dirty_end = std::max(m_dirty_end, index + 1);
+  }
+
+  m_dirty[index] = 1;
+}
+
+bool zv::InstanceBuffer::upload(IDeviceContext* ptr_context, const u32* ptr_draw_list, u32 draw_count)
+{
+  using namespace Diligent;
+
+  m_upload_ring.begin_frame();
+  m_uploaded_instance_count = 0;
+  m_copy_count = 0;
+  m_draw_count = 0;
+
+  build_dirty_ranges(m_dirty.data(), m_dirty_begin, m_dirty_end, k_max_dirty_gap, m_dirty_ranges);
+
+  if (!m_dirty_ranges.empty())
+  {
+    u32 instance_count = 0;
+    for (const InstanceRange& range : m_dirty_ranges)
+    {
+      instance_count += range.count;
+    }
+
+    // all ranges are packed back to back into one mapped allocation and copied to their place in the instance buffer
+    UploadRing::Allocation allocation;
+    if (!m_upload_ring.reserve(u64(instance_count) * sizeof(PackedInstance), 16, allocation))
+    {
+      ZV_WARNING("Instance upload of {} instances does not fit into the upload ring.", instance_count);
+      return false;
+    }
+
+    auto* ptr_dst = static_cast<PackedInstance*>(m_upload_ring.map(ptr_context, allocation));
+    if (ptr_dst == nullptr)
+    {
+      return false;
+    }
+
+    for (const InstanceRange& range : m_dirty_ranges)
+    {
+      std::copy_n(m_instances.data() + range.begin, range.count, ptr_dst);
+      ptr_dst += range.count;
+    }
+    m_upload_ring.unmap(ptr_context);
+
+    u64 src_offset = allocation.offset;
+    for (const InstanceRange& range : m_dirty_ranges)
+    {
+      const u64 size = u64(range.count) * sizeof(PackedInstance);
+      ptr_context->CopyBuffer(m_upload_ring.get_buffer(), src_offset, RESOURCE_STATE_TRANSITION_MODE_VERIFY,
+                              m_ptr_instance_buffer, u64(range.begin) * sizeof(PackedInstance), size, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+      src_offset += size;
+    }
+
+    std::fill(m_dirty.begin() + m_dirty_begin, m_dirty.begin() + m_dirty_end, u8(0));
+    m_dirty_begin = 0;
+    m_dirty_end = 0;
+
+    m_uploaded_instance_count = instance_count;
+    m_copy_count = static_cast<u32>(m_dirty_ranges.size());
+  }
+
+  if (draw_count > 0)
+  {
+    ZV_ASSERT(draw_count <= m_instances.size());
+
+    const u64 size = u64(draw_count) * sizeof(u32);
+    u64 src_offset;
+    if (!m_upload_ring.write(ptr_context, ptr_draw_list, size, sizeof(u32), src_offset))
+    {
+      ZV_WARNING("Draw list of {} instances does not fit into the upload ring.", draw_count);
+      return false;
+    }
+
+    ptr_context->CopyBuffer(m_upload_ring.get_buffer(), src_offset, RESOURCE_STATE_TRANSITION_MODE_VERIFY,
+                            m_ptr_draw_list_buffer, 0, size, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+  }
+
+  m_draw_count = draw_count;
+  return true;
+}
@@ -0,0 +1,85 @@
+/*
+ * InstanceBuffer.h - packed per-instance data with partial GPU updates for instanced drawing
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+#include <Renderer/InstanceData.h>
+#include <Renderer/UploadRing.h>
+
+namespace zv
+{
+  // Instance data lives in a structured buffer in device memory that only receives the instances changed since the last
+  // upload. Changed ranges and the per-frame draw list (one u32 instance index per drawn instance, bound as per-instance
+  // vertex stream) go through an upload ring, so one draw call renders any subset of the instances without stalls.
+  // Both end up in device-local buffers, which unlike mapped dynamic memory can be bound from deferred contexts.
+  class InstanceBuffer : public NonCopyable
+  {
+  public:
+    struct CreateParams
+    {
+      u32 max_instances{ 0 };
+      // number of frames the upload ring can hold before wrapping; ignored with discard_each_frame
+      u32 frames_in_flight{ 3 };
+      // see UploadRing
+      bool discard_each_frame{ false };
+    };
+
+  public:
+    InstanceBuffer() = default;
+    ~InstanceBuffer();
+
+  public:
+    bool create(IRenderDevice* ptr_device, const CreateParams& params);
+    void destroy();
+
+    void set_transform(u32 index, const Matrix44& world);
+    void set_color(u32 index, const Vector4& color);
+    void mark_dirty(u32 index);
+    const PackedInstance& get_instance(u32 index) const { return m_instances[index]; }
+
+    // Copies the dirty instances to the GPU and uploads the draw list. Has to be called once per frame before drawing;
+    // returns false if the frame ran out of upload space, the dirty instances stay dirty in that case. The copies only
+    // verify states: the upload buffer has to be a copy source, the instance and draw list buffers copy destinations.
+    bool upload(IDeviceContext* ptr_context, const u32* ptr_draw_list, u32 draw_count);
+
+    // per-instance vertex stream with the instance indices of the last upload, starting at offset 0
+    IBuffer* get_draw_list_buffer() const { return m_ptr_draw_list_buffer; }
+    u32 get_draw_count() const { return m_draw_count; }
+
+    IBuffer* get_instance_buffer() const { return m_ptr_instance_buffer; }
+    // dynamic buffer of the upload ring, the source of all copies in upload()
+    IBuffer* get_upload_buffer() const { return m_upload_ring.get_buffer(); }
+    // shader resource view of the structured instance buffer
+    IBufferView* get_instance_view() const { return m_ptr_instance_view; }
+
+    u32 get_max_instances() const { return static_cast<u32>(m_instances.size()); }
+    // statistics of the last upload
+    u32 get_uploaded_instance_count() const { return m_uploaded_instance_count; }
+    u32 get_copy_count() const { return m_copy_count; }
+    u64 get_upload_bytes() const { return m_upload_ring.get_frame_bytes(); }
+
+  private:
+    RefCntAutoPtr<IBuffer> m_ptr_instance_buffer;
+    RefCntAutoPtr<IBuffer> m_ptr_draw_list_buffer;
+    IBufferView* m_ptr_instance_view{ nullptr };
+    UploadRing m_upload_ring;
+
+    // CPU copy of the GPU instance data with dirty flags, dirty instances lie within [m_dirty_begin, m_dirty_end)
+    std::vector<PackedInstance> m_instances;
+    std::vector<u8> m_dirty;
+    std::vector<InstanceRange> m_dirty_ranges;
+    u32 m_dirty_begin{ 0 };
+    u32 m_dirty_end{ 0 };
+
+    u32 m_draw_count{ 0 };
+    u32 m_uploaded_instance_count{ 0 };
+    u32 m_copy_count{ 0 };
+  };
+}
@@ -0,0 +1,79 @@
+/*
+ * InstanceData.cpp - per-instance data layout and dirty range collection of the instance buffer
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/InstanceData.h>
+
+#include <Math/Half.h>
+
+void zv::pack_instance_transform(const Matrix44& world, PackedInstance& out_instance)
+{
+  for (u32 column = 0; column < 3; ++column)
+  {
+    out_instance.world_rows[column] = Vector4{ world.m[0][column], world.m[1][column], world.m[2][column], world.m[3][column] };
+  }
+}
+
+void zv::pack_instance_color(const Vector4& color, PackedInstance& out_instance)
+{
+  out_instance.color[0] = f32_to_f16(color.x);
+  out_instance.color[1] = f32_to_f16(color.y);
+  out_instance.color[2] = f32_to_f16(color.z);
+  out_instance.color[3] = f32_to_f16(color.w);
+}
+
+zv::Matrix44 zv::unpack_instance_transform(const PackedInstance& instance)
+{
+  Matrix44 world = Matrix44::Identity();
+  for (u32 column = 0; column < 3; ++column)
+  {
+    const Vector4& row = instance.world_rows[column];
+    world.m[0][column] = row.x;
+    world.m[1][column] = row.y;
+    world.m[2][column] = row.z;
+    world.m[3][column] = row.w;
+  }
+  return world;
+}
+
+zv::Vector4 zv::unpack_instance_color(const PackedInstance& instance)
+{
+  return Vector4{ f16_to_f32(instance.color[0]), f16_to_f32(instance.color[1]), f16_to_f32(instance.color[2]), f16_to_f32(instance.color[3]) };
+}
+
+void zv::build_dirty_ranges(const u8* ptr_dirty, u32 begin, u32 end, u32 max_gap, std::vector<InstanceRange>& out_ranges)
+{
+  out_ranges.clear();
+
+  u32 i = begin;
+  while (i < end)
+  {
+    if (!ptr_dirty[i])
+    {
+      ++i;
+      continue;
+    }
+
+    const u32 range_begin = i;
+    u32 range_end = ++i;
+    while (i < end)
+    {
+      if (ptr_dirty[i])
+      {
+        range_end = ++i;
+      }
+      else if (i - range_end >= max_gap)
+      {
+        break;
+      }
+      else
+      {
+        ++i;
+      }
+    }
+
+    out_ranges.push_back(InstanceRange{ range_begin, range_end - range_begin });
+    i = range_end;
+  }
+}
@@ -0,0 +1,39 @@
+/*
+ * InstanceData.h - per-instance data layout and dirty range collection of the instance buffer
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <MathDefines.h>
+
+namespace zv
+{
+  // 56 bytes per instance: the first three columns of the row-vector world matrix stored as rows (so that
+  // world.x = dot(world_rows[0], float4(local, 1))) and an RGBA colour as half floats. Must match InstanceData in the
+  // instanced vertex shaders.
+  struct PackedInstance
+  {
+    Vector4 world_rows[3];
+    u16 color[4];
+  };
+  static_assert(sizeof(PackedInstance) == 56, "PackedInstance must stay tightly packed");
+
+  void pack_instance_transform(const Matrix44& world, PackedInstance& out_instance);
+  void pack_instance_color(const Vector4& color, PackedInstance& out_instance);
+  Matrix44 unpack_instance_transform(const PackedInstance& instance);
+  Vector4 unpack_instance_color(const PackedInstance& instance);
+
+  struct InstanceRange
+  {
+    u32 begin;
+    u32 count;
+  };
+
+  // Collects the runs of non-zero flags in [begin, end) as ranges. Runs separated by at most max_gap clean entries are
+  // merged, re-uploading a few unchanged instances is cheaper than recording another copy.
+  void build_dirty_ranges(const u8* ptr_dirty, u32 begin, u32 end, u32 max_gap, std::vector<InstanceRange>& out_ranges);
+}
@@ -0,0 +1,829 @@
+/*
+ * Mesh.cpp - import-time mesh processing: deduplication, cache/overdraw/fetch ordering, quantization and LODs
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/Mesh.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Core/Utility.h>
+#include <Math/Half.h>
+
+
+namespace
+{
+  // Forsyth's scoring: vertices recently used score high, the last triangle's vertices a bit less so the strip does not
+  // turn back on itself, and vertices with few remaining triangles get a boost so they are finished off
+  constexpr u32 k_forsyth_cache_size = 32;
+  constexpr f32 k_forsyth_cache_decay_power = 1.5f;
+  constexpr f32 k_forsyth_last_triangle_score = 0.75f;
+  constexpr f32 k_forsyth_valence_boost_scale = 2.0f;
+  constexpr f32 k_forsyth_valence_boost_power = 0.5f;
+
+  f32 forsyth_vertex_score(s32 cache_position, u32 remaining_triangles)
+  {
+    if (remaining_triangles == 0)
+    {
+      return -1.0f;
+    }
+
+    f32 score = 0.0f;
+    if (cache_position >= 0)
+    {
+      if (cache_position < 3)
+      {
+        score = k_forsyth_last_triangle_score;
+      }
+      else
+      {
+        const f32 scaler = 1.0f / (k_forsyth_cache_size - 3);
+        score = std::pow(1.0f - (cache_position - 3) * scaler, k_forsyth_cache_decay_power);
+      }
+    }
+    return score + k_forsyth_valence_boost_scale * std::pow(static_cast<f32>(remaining_triangles), -k_forsyth_valence_boost_power);
+  }
+
+  // triangles per vertex as offsets into one array
+  void build_adjacency(const u32* ptr_indices, u32 index_count, u32 vertex_count, std::vector<u32>& out_offsets, std::vector<u32>& out_triangles)
+  {
+    out_offsets.assign(vertex_count + 1, 0);
+    for (u32 i = 0; i < index_count; ++i)
+    {
+      ++out_offsets[ptr_indices[i] + 1];
+    }
+    for (u32 v = 0; v < vertex_count; ++v)
+    {
+      out_offsets[v + 1] += out_offsets[v];
+    }
+
+    out_triangles.resize(index_count);
+    std::vector<u32> cursor(out_offsets.begin(), out_offsets.end() - 1);
+    for (u32 i = 0; i < index_count; ++i)
+    {
+      out_triangles[cursor[ptr_indices[i]]++] = i / 3;
+    }
+  }
+
+  zv::Vector3 sub(const zv::Vector3& a, const zv::Vector3& b) { return zv::Vector3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+  zv::Vector3 cross(const zv::Vector3& a, const zv::Vector3& b) { return zv::Vector3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+  f32 dot(const zv::Vector3& a, const zv::Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+  void compute_bounds(const zv::MeshVertex* ptr_vertices, u32 vertex_count, zv::Vector3& out_min, zv::Vector3& out_max)
+  {
+    out_min = zv::Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+    out_max = zv::Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+      const zv::Vector3& p = ptr_vertices[i].position;
+      out_min = zv::Vector3{ std::min(out_min.x, p.x), std::min(out_min.y, p.y), std::min(out_min.z, p.z) };
+      out_max = zv::Vector3{ std::max(out_max.x, p.x), std::max(out_max.y, p.y), std::max(out_max.z, p.z) };
+    }
+  }
+
+  // vertex clustering on a grid with resolution cells along the largest extent; every cell collapses onto the vertex
+  // closest to the cell's average position, degenerate and duplicate triangles are dropped
+  void cluster_vertices(const zv::MeshData& mesh, const zv::Vector3& bounds_min, f32 extent, u32 resolution, std::vector<u32>& out_indices)
+  {
+    const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+    const f32 cell_scale = resolution / extent;
+    const u64 max_cell = resolution - 1;
+
+    std::unordered_map<u64, u32> cluster_of_cell;
+    std::vector<zv::Vector3> cluster_sum;
+    std::vector<u32> cluster_count;
+    std::vector<u32> cluster_of_vertex(vertex_count);
+    for (u32 v = 0; v < vertex_count; ++v)
+    {
+      const zv::Vector3& p = mesh.vertices[v].position;
+      const u64 cx = std::min(static_cast<u64>((p.x - bounds_min.x) * cell_scale), max_cell);
+      const u64 cy = std::min(static_cast<u64>((p.y - bounds_min.y) * cell_scale), max_cell);
+      const u64 cz = std::min(static_cast<u64>((p.z - bounds_min.z) * cell_scale), max_cell);
+      const u64 cell = (cx << 42) | (cy << 21) | cz;
+
+      auto it = cluster_of_cell.emplace(cell, static_cast<u32>(cluster_sum.size())).first;
+      if (it->second == cluster_sum.size())
+      {
+        cluster_sum.push_back(zv::Vector3{ 0.0f, 0.0f, 0.0f });
+        cluster_count.push_back(0);
+      }
+      const u32 cluster = it->second;
+      cluster_of_vertex[v] = cluster;
+      cluster_sum[cluster] = zv::Vector3{ cluster_sum[cluster].x + p.x, cluster_sum[cluster].y + p.y, cluster_sum[cluster].z + p.z };
+      ++cluster_count[cluster];
+    }
+
+    // the representative is the vertex nearest to the average, the lower index on ties
+    std::vector<u32> representative(cluster_sum.size(), ~0u);
+    std::vector<f32> representative_distance(cluster_sum.size(), FLT_MAX);
+    for (u32 v = 0; v < vertex_count; ++v)
+    {
+      const u32 cluster = cluster_of_vertex[v];
+      const f32 inv_count = 1.0f / cluster_count[cluster];
+      const zv::Vector3 average{ cluster_sum[cluster].x * inv_count, cluster_sum[cluster].y * inv_count, cluster_sum[cluster].z * inv_count };
+      const zv::Vector3 d = sub(mesh.vertices[v].position, average);
+      const f32 distance = dot(d, d);
+      if (distance < representative_distance[cluster])
+      {
+        representative_distance[cluster] = distance;
+        representative[cluster] = v;
+      }
+    }
+
+    out_indices.clear();
+    std::unordered_set<u64> emitted;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+      u32 a = representative[cluster_of_vertex[mesh.indices[i + 0]]];
+      u32 b = representative[cluster_of_vertex[mesh.indices[i + 1]]];
+      u32 c = representative[cluster_of_vertex[mesh.indices[i + 2]]];
+      if (a == b || b == c || a == c)
+      {
+        continue;
+      }
+
+      // rotate the smallest index first, so the same triangle always has the same key
+      while (a > b || a > c)
+      {
+        const u32 t = a; a = b; b = c; c = t;
+      }
+      const u64 key = zv::hash_value(c, zv::hash_value(b, zv::hash_value(a, zv::k_fnv1a_offset_basis)));
+      if (!emitted.insert(key).second)
+      {
+        continue;
+      }
+
+      out_indices.push_back(a);
+      out_indices.push_back(b);
+      out_indices.push_back(c);
+    }
+  }
+}
+
+u32 zv::deduplicate_vertices(MeshData& mesh)
+{
+  const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+  std::vector<u32> remap(vertex_count);
+  std::vector<MeshVertex> unique_vertices;
+  unique_vertices.reserve(vertex_count);
+
+  // buckets by hash, vertices within a bucket are compared bitwise
+  std::unordered_multimap<u64, u32> unique_of_hash;
+  unique_of_hash.reserve(vertex_count);
+  for (u32 v = 0; v < vertex_count; ++v)
+  {
+    const MeshVertex& vertex = mesh.vertices[v];
+    const u64 hash = hash_bytes(&vertex, sizeof(MeshVertex));
+
+    u32 unique = ~0u;
+    const auto range = unique_of_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (std::memcmp(&unique_vertices[it->second], &vertex, sizeof(MeshVertex)) == 0)
+      {
+        unique = it->second;
+        break;
+      }
+    }
+
+    if (unique == ~0u)
+    {
+      unique = static_cast<u32>(unique_vertices.size());
+      unique_vertices.push_back(vertex);
+      unique_of_hash.emplace(hash, unique);
+    }
+    remap[v] = unique;
+  }
+
+  for (u32& index : mesh.indices)
+  {
+    index = remap[index];
+  }
+
+  const u32 removed = vertex_count - static_cast<u32>(unique_vertices.size());
+  mesh.vertices.swap(unique_vertices);
+  return removed;
+}
+
+void zv::optimize_vertex_cache(u32* ptr_indices, u32 index_count, u32 vertex_count)
+{
+  const u32 triangle_count = index_count / 3;
+  if (triangle_count == 0)
+  {
+    return;
+  }
+
+  std::vector<u32> adjacency_offsets;
+  std::vector<u32> adjacency;
+  build_adjacency(ptr_indices, triangle_count * 3, vertex_count, adjacency_offsets, adjacency);
+
+  std::vector<u32> remaining(vertex_count);
+  std::vector<s32> cache_position(vertex_count, -1);
+  std::vector<f32> vertex_score(vertex_count);
+  for (u32 v = 0; v < vertex_count; ++v)
+  {
+    remaining[v] = adjacency_offsets[v + 1] - adjacency_offsets[v];
+    vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+  }
+
+  std::vector<f32> triangle_score(triangle_count);
+  std::vector<u8> emitted(triangle_count, 0);
+  for (u32 t = 0; t < triangle_count; ++t)
+  {
+    triangle_score[t] = vertex_score[ptr_indices[t * 3]] + vertex_score[ptr_indices[t * 3 + 1]] + vertex_score[ptr_indices[t * 3 + 2]];
+  }
+
+  std::vector<u32> output;
+  output.reserve(triangle_count * 3);
+
+  // LRU cache with room for the three vertices pushed in front of a full cache
+  u32 cache[k_forsyth_cache_size + 3];
+  u32 cache_count = 0;
+  u32 next_unemitted = 0;
+  u32 best_triangle = ~0u;
+
+  for (u32 emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+  {
+    // without a candidate from the cache, continue with the next triangle in input order
+    if (best_triangle == ~0u)
+    {
+      while (emitted[next_unemitted])
+      {
+        ++next_unemitted;
+      }
+      best_triangle = next_unemitted;
+    }
+
+    emitted[best_triangle] = 1;
+    const u32* ptr_triangle = ptr_indices + best_triangle * 3;
+    output.insert(output.end(), ptr_triangle, ptr_triangle + 3);
+
+    // move the triangle's vertices to the front of the cache and remove the triangle from their adjacency
+    u32 new_cache[k_forsyth_cache_size + 3];
+    u32 new_count = 0;
+    for (u32 i = 0; i < 3; ++i)
+    {
+      const u32 v = ptr_triangle[i];
+      new_cache[new_count++] = v;
+
+      u32* ptr_begin = adjacency.data() + adjacency_offsets[v];
+      u32* ptr_end = ptr_begin + remaining[v];
+      *std::find(ptr_begin, ptr_end, best_triangle) = *(ptr_end - 1);
+      --remaining[v];
+    }
+    for (u32 i = 0; i < cache_count; ++i)
+    {
+      const u32 v = cache[i];
+      if (v != ptr_triangle[0] && v != ptr_triangle[1] && v != ptr_triangle[2])
+      {
+        new_cache[new_count++] = v;
+      }
+    }
+
+    // rescore the cached vertices (and the ones that just dropped out) and pick the best triangle among their
+    // remaining triangles
+    best_triangle = ~0u;
+    f32 best_score = -1.0f;
+    for (u32 i = 0; i < new_count; ++i)
+    {
+      const u32 v = new_cache[i];
+      cache_position[v] = i < k_forsyth_cache_size ? static_cast<s32>(i) : -1;
+      const f32 score = forsyth_vertex_score(cache_position[v], remaining[v]);
+      const f32 delta = score - vertex_score[v];
+      vertex_score[v] = score;
+
+      const u32* ptr_adjacent = adjacency.data() + adjacency_offsets[v];
+      for (u32 j = 0; j < remaining[v]; ++j)
+      {
+        const u32 t = ptr_adjacent[j];
+        triangle_score[t] += delta;
+      }
+    }
+    for (u32 i = 0; i < std::min(new_count, k_forsyth_cache_size); ++i)
+    {
+      const u32 v = new_cache[i];
+      const u32* ptr_adjacent = adjacency.data() + adjacency_offsets[v];
+      for (u32 j = 0; j < remaining[v]; ++j)
+      {
+        const u32 t = ptr_adjacent[j];
+        // ties go to the lower triangle index, so the order does not depend on the adjacency order
+        if (triangle_score[t] > best_score || (triangle_score[t] == best_score && t < best_triangle))
+        {
+          best_score = triangle_score[t];
+          best_triangle = t;
+        }
+      }
+    }
+
+    cache_count = std::min(new_count, k_forsyth_cache_size);
+    std::copy(new_cache, new_cache + cache_count, cache);
+  }
+
+  std::copy(output.begin(), output.end(), ptr_indices);
+}
+
+/*
+ * Tipsify's cluster sorting (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw"). The cache order is cut into clusters that can be drawn in any order without losing much of the cache
+ * efficiency, then the clusters are sorted by a view-independent occlusion estimate.
+ */
+void zv::optimize_overdraw(u32* ptr_indices, u32 index_count, const MeshVertex* ptr_vertices, u32 vertex_count, u32 cache_size, f32 threshold)
+{
+  const u32 triangle_count = index_count / 3;
+  if (triangle_count < 2)
+  {
+    return;
+  }
+
+  // FIFO cache: a vertex is cached while fewer than cache_size misses happened since it was loaded
+  std::vector<u32> cache_stamp(vertex_count, 0);
+  u32 time = cache_size + 1;
+  const auto count_misses = [&](u32 t)
+  {
+    u32 misses = 0;
+    for (u32 i = 0; i < 3; ++i)
+    {
+      const u32 v = ptr_indices[t * 3 + i];
+      if (time - cache_stamp[v] > cache_size)
+      {
+        cache_stamp[v] = time++;
+        ++misses;
+      }
+    }
+    return misses;
+  };
+  // empties the simulated cache
+  const auto flush = [&]() { time += cache_size + 1; };
+
+  // Hard clusters start where the cache order starts over, i.e. at triangles that miss the cache with all their vertices
+  std::vector<u32> hard_starts;
+  for (u32 t = 0; t < triangle_count; ++t)
+  {
+    if (count_misses(t) == 3 || t == 0)
+    {
+      hard_starts.push_back(t);
+    }
+  }
+  hard_starts.push_back(triangle_count);
+
+  // Soft clusters split the hard ones: each starts with a cold cache and ends as soon as its ACMR is within threshold
+  // of the whole hard cluster's, so reordering them costs at most that much cache efficiency
+  std::vector<u32> cluster_starts;
+  for (size_t h = 0; h + 1 < hard_starts.size(); ++h)
+  {
+    const u32 begin = hard_starts[h];
+    const u32 end = hard_starts[h + 1];
+
+    flush();
+    u32 hard_misses = 0;
+    for (u32 t = begin; t < end; ++t)
+    {
+      hard_misses += count_misses(t);
+    }
+    const f32 max_acmr = threshold * hard_misses / (end - begin);
+
+    flush();
+    u32 start = begin;
+    u32 misses = 0;
+    for (u32 t = begin; t < end; ++t)
+    {
+      misses += count_misses(t);
+      if (static_cast<f32>(misses) / (t + 1 - start) <= max_acmr || t + 1 == end)
+      {
+        cluster_starts.push_back(start);
+        start = t + 1;
+        misses = 0;
+        flush();
+      }
+    }
+  }
+  cluster_starts.push_back(triangle_count);
+
+  // area-weighted centroid of the surface
+  Vector3 mesh_centroid{ 0.0f, 0.0f, 0.0f };
+  f32 mesh_area = 0.0f;
+  const u32 cluster_count = static_cast<u32>(cluster_starts.size()) - 1;
+  std::vector<Vector3> cluster_centroid(cluster_count);
+  std::vector<Vector3> cluster_normal(cluster_count);
+  for (u32 c = 0; c < cluster_count; ++c)
+  {
+    Vector3 centroid{ 0.0f, 0.0f, 0.0f };
+    Vector3 normal{ 0.0f, 0.0f, 0.0f };
+    f32 area_sum = 0.0f;
+    for (u32 t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t)
+    {
+      const Vector3& a = ptr_vertices[ptr_indices[t * 3 + 0]].position;
+      const Vector3& b = ptr_vertices[ptr_indices[t * 3 + 1]].position;
+      const Vector3& c0 = ptr_vertices[ptr_indices[t * 3 + 2]].position;
+      // front faces are clockwise, as in the pipelines
+      const Vector3 n = cross(sub(c0, a), sub(b, a));
+      const f32 area = std::sqrt(dot(n, n));
+      normal = Vector3{ normal.x + n.x, normal.y + n.y, normal.z + n.z };
+      centroid = Vector3{ centroid.x + (a.x + b.x + c0.x) * area, centroid.y + (a.y + b.y + c0.y) * area, centroid.z + (a.z + b.z + c0.z) * area };
+      area_sum += area;
+    }
+
+    mesh_centroid = Vector3{ mesh_centroid.x + centroid.x, mesh_centroid.y + centroid.y, mesh_centroid.z + centroid.z };
+    mesh_area += area_sum;
+
+    const f32 inv_area = area_sum > 0.0f ? 1.0f / (3.0f * area_sum) : 0.0f;
+    cluster_centroid[c] = Vector3{ centroid.x * inv_area, centroid.y * inv_area, centroid.z * inv_area };
+    const f32 normal_length = std::sqrt(dot(normal, normal));
+    const f32 inv_normal_length = normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+    cluster_normal[c] = Vector3{ normal.x * inv_normal_length, normal.y * inv_normal_length, normal.z * inv_normal_length };
+  }
+
+  const f32 inv_mesh_area = mesh_area > 0.0f ? 1.0f / (3.0f * mesh_area) : 0.0f;
+  mesh_centroid = Vector3{ mesh_centroid.x * inv_mesh_area, mesh_centroid.y * inv_mesh_area, mesh_centroid.z * inv_mesh_area };
+
+  // Clusters far out along their normal are likely to occlude the rest from most directions and are drawn first
+  std::vector<f32> cluster_sort_key(cluster_count);
+  for (u32 c = 0; c < cluster_count; ++c)
+  {
+    cluster_sort_key[c] = dot(sub(cluster_centroid[c], mesh_centroid), cluster_normal[c]);
+  }
+
+  std::vector<u32> cluster_order(cluster_count);
+  for (u32 c = 0; c < cluster_count; ++c)
+  {
+    cluster_order[c] = c;
+  }
+  std::stable_sort(cluster_order.begin(), cluster_order.end(), [&cluster_sort_key](u32 a, u32 b)
+  {
+    return cluster_sort_key[a] > cluster_sort_key[b];
+  });
+
+  std::vector<u32> output;
+  output.reserve(triangle_count * 3);
+  for (u32 c : cluster_order)
+  {
+    output.insert(output.end(), ptr_indices + cluster_starts[c] * 3, ptr_indices + cluster_starts[c + 1] * 3);
+  }
+  std::copy(output.begin(), output.end(), ptr_indices);
+}
+
+void zv::optimize_vertex_fetch(MeshData& mesh)
+{
+  const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+  std::vector<u32> remap(vertex_count, ~0u);
+  std::vector<MeshVertex> vertices;
+  vertices.reserve(vertex_count);
+
+  for (u32& index : mesh.indices)
+  {
+    if (remap[index] == ~0u)
+    {
+      remap[index] = static_cast<u32>(vertices.size());
+      vertices.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  // vertices no triangle uses are dropped
+  mesh.vertices.swap(vertices);
+}
+
+void zv::generate_lods(const MeshData& mesh, u32 lod_count, f32 triangle_ratio, std::vector<MeshLod>& out_lods)
+{
+  out_lods.clear();
+  if (mesh.vertices.empty() || mesh.indices.size() < 3)
+  {
+    return;
+  }
+
+  Vector3 bounds_min;
+  Vector3 bounds_max;
+  compute_bounds(mesh.vertices.data(), static_cast<u32>(mesh.vertices.size()), bounds_min, bounds_max);
+  const f32 extent = std::max({ bounds_max.x - bounds_min.x, bounds_max.y - bounds_min.y, bounds_max.z - bounds_min.z, FLT_MIN });
+
+  // Each level searches for the finest grid that gets below the triangle target; triangle counts only roughly
+  // decrease with the resolution, so the search takes the best result it saw rather than relying on monotonicity
+  u32 previous_triangles = static_cast<u32>(mesh.indices.size() / 3);
+  u32 max_resolution = 1u << 20;
+  std::vector<u32> indices;
+  for (u32 lod = 0; lod < lod_count; ++lod)
+  {
+    const u32 target_triangles = static_cast<u32>(previous_triangles * triangle_ratio);
+    if (target_triangles == 0)
+    {
+      break;
+    }
+
+    MeshLod best;
+    u32 best_resolution = 0;
+    u32 low = 1;
+    u32 high = max_resolution;
+    while (low <= high)
+    {
+      const u32 resolution = low + (high - low) / 2;
+      cluster_vertices(mesh, bounds_min, extent, resolution, indices);
+      if (indices.size() / 3 <= target_triangles)
+      {
+        if (indices.size() > best.indices.size())
+        {
+          best.indices = indices;
+          best_resolution = resolution;
+        }
+        low = resolution + 1;
+      }
+      else
+      {
+        high = resolution - 1;
+      }
+    }
+
+    if (best.indices.empty())
+    {
+      break;
+    }
+
+    best.error = 1.0f / best_resolution;
+    optimize_vertex_cache(best.indices.data(), static_cast<u32>(best.indices.size()), static_cast<u32>(mesh.vertices.size()));
+    previous_triangles = static_cast<u32>(best.indices.size() / 3);
+    max_resolution = best_resolution;
+    out_lods.push_back(std::move(best));
+  }
+}
+
+void zv::quantize_mesh(const MeshData& mesh, VertexComponentFlags components, QuantizedMesh& out_mesh)
+{
+  out_mesh.components = components;
+  out_mesh.vertex_stride = get_vertex_stride(components, eVertexEncoding::Quantized);
+  out_mesh.vertex_data.assign(mesh.vertices.size() * out_mesh.vertex_stride, 0);
+
+  Vector3 bounds_min;
+  Vector3 bounds_max;
+  compute_bounds(mesh.vertices.data(), static_cast<u32>(mesh.vertices.size()), bounds_min, bounds_max);
+  const Vector3 extent{ std::max(bounds_max.x - bounds_min.x, FLT_MIN), std::max(bounds_max.y - bounds_min.y, FLT_MIN),
+                        std::max(bounds_max.z - bounds_min.z, FLT_MIN) };
+  out_mesh.position_offset = bounds_min;
+  out_mesh.position_scale = Vector3{ extent.x / 65535.0f, extent.y / 65535.0f, extent.z / 65535.0f };
+
+  auto quantize_unorm16 = [](f32 value)
+  {
+    return static_cast<u16>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+  };
+
+  u8* ptr_vertex = out_mesh.vertex_data.data();
+  for (const MeshVertex& vertex : mesh.vertices)
+  {
+    u8* ptr_component = ptr_vertex;
+    if (components & VERTEX_COMPONENT_FLAG_POSITION)
+    {
+      const u16 position[4] =
+      {
+        quantize_unorm16((vertex.position.x - bounds_min.x) / extent.x),
+        quantize_unorm16((vertex.position.y - bounds_min.y) / extent.y),
+        quantize_unorm16((vertex.position.z - bounds_min.z) / extent.z),
+        0,
+      };
+      std::memcpy(ptr_component, position, sizeof(position));
+      ptr_component += sizeof(position);
+    }
+    if (components & VERTEX_COMPONENT_FLAG_NORMAL)
+    {
+      s16 normal[2];
+      encode_octahedral_normal(vertex.normal, normal[0], normal[1]);
+      std::memcpy(ptr_component, normal, sizeof(normal));
+      ptr_component += sizeof(normal);
+    }
+    if (components & VERTEX_COMPONENT_FLAG_UV)
+    {
+      const u16 uv[2] = { f32_to_f16(vertex.uv.x), f32_to_f16(vertex.uv.y) };
+      std::memcpy(ptr_component, uv, sizeof(uv));
+    }
+    ptr_vertex += out_mesh.vertex_stride;
+  }
+}
+
+void zv::process_mesh(MeshData& mesh, const MeshProcessParams& params, std::vector<MeshLod>& out_lods)
+{
+  deduplicate_vertices(mesh);
+
+  const u32 index_count = static_cast<u32>(mesh.indices.size());
+  const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+  optimize_vertex_cache(mesh.indices.data(), index_count, vertex_count);
+  if (params.optimize_overdraw)
+  {
+    optimize_overdraw(mesh.indices.data(), index_count, mesh.vertices.data(), vertex_count, params.cache_size, params.overdraw_threshold);
+  }
+
+  // LODs index the vertices of the full mesh, so they are generated before the fetch order is final and remapped
+  // with it; vertices only they use are appended behind the full mesh's
+  generate_lods(mesh, params.lod_count, params.lod_triangle_ratio, out_lods);
+
+  std::vector<u32> remap(vertex_count, ~0u);
+  std::vector<MeshVertex> vertices;
+  vertices.reserve(vertex_count);
+  auto remap_indices = [&](std::vector<u32>& indices)
+  {
+    for (u32& index : indices)
+    {
+      if (remap[index] == ~0u)
+      {
+        remap[index] = static_cast<u32>(vertices.size());
+        vertices.push_back(mesh.vertices[index]);
+      }
+      index = remap[index];
+    }
+  };
+  remap_indices(mesh.indices);
+  for (MeshLod& lod : out_lods)
+  {
+    remap_indices(lod.indices);
+  }
+  mesh.vertices.swap(vertices);
+}
+
+zv::VertexCacheStats zv::analyze_vertex_cache(const u32* ptr_indices, u32 index_count, u32 vertex_count, u32 cache_size)
+{
+  VertexCacheStats stats;
+  if (index_count < 3 || vertex_count == 0)
+  {
+    return stats;
+  }
+
+  // FIFO cache, as in most post-transform caches
+  std::vector<u32> cache_stamp(vertex_count, 0);
+  std::vector<u8> used(vertex_count, 0);
+  u32 time = cache_size + 1;
+  u32 misses = 0;
+  u32 used_count = 0;
+  for (u32 i = 0; i < index_count; ++i)
+  {
+    const u32 v = ptr_indices[i];
+    if (time - cache_stamp[v] > cache_size)
+    {
+      cache_stamp[v] = time++;
+      ++misses;
+    }
+    used_count += used[v] == 0;
+    used[v] = 1;
+  }
+
+  stats.acmr = static_cast<f32>(misses) / (index_count / 3);
+  stats.atvr = static_cast<f32>(misses) / used_count;
+  return stats;
+}
+
+f32 zv::analyze_vertex_fetch(const u32* ptr_indices, u32 index_count, u32 vertex_count, u32 vertex_stride)
+{
+  constexpr u32 k_line_size = 64;
+  constexpr u32 k_line_count = 4096 / k_line_size;
+
+  if (index_count == 0 || vertex_count == 0)
+  {
+    return 0.0f;
+  }
+
+  // FIFO cache of lines, keyed by line index
+  const u64 total_lines = (u64(vertex_count) * vertex_stride + k_line_size - 1) / k_line_size;
+  std::vector<u32> line_stamp(total_lines, 0);
+  std::vector<u8> used(vertex_count, 0);
+  u32 time = k_line_count + 1;
+  u64 fetched_bytes = 0;
+  u64 used_bytes = 0;
+  for (u32 i = 0; i < index_count; ++i)
+  {
+    const u32 v = ptr_indices[i];
+    const u64 first_line = u64(v) * vertex_stride / k_line_size;
+    const u64 last_line = (u64(v) * vertex_stride + vertex_stride - 1) / k_line_size;
+    for (u64 line = first_line; line <= last_line; ++line)
+    {
+      if (time - line_stamp[line] > k_line_count)
+      {
+        line_stamp[line] = time++;
+        fetched_bytes += k_line_size;
+      }
+    }
+    used_bytes += used[v] == 0 ? vertex_stride : 0;
+    used[v] = 1;
+  }
+
+  return static_cast<f32>(fetched_bytes) / used_bytes;
+}
+
+f32 zv::analyze_overdraw(const u32* ptr_indices, u32 index_count, const MeshVertex* ptr_vertices, u32 vertex_count)
+{
+  constexpr u32 k_grid_size = 256;
+
+  if (index_count < 3 || vertex_count == 0)
+  {
+    return 0.0f;
+  }
+
+  Vector3 bounds_min, bounds_max;
+  compute_bounds(ptr_vertices, vertex_count, bounds_min, bounds_max);
+  const f32 extent = std::max({ bounds_max.x - bounds_min.x, bounds_max.y - bounds_min.y, bounds_max.z - bounds_min.z });
+  if (extent <= 0.0f)
+  {
+    return 0.0f;
+  }
+
+  // Looking down each axis, triangles are split by facing into two depth buffers: one for the view from the front with
+  // back-face culling and one for the view from behind, where depth runs the other way
+  std::vector<f32> depth(2 * k_grid_size * k_grid_size);
+  u64 shaded = 0;
+  u64 covered = 0;
+  const f32 scale = (k_grid_size - 1) / extent;
+  for (u32 axis = 0; axis < 3; ++axis)
+  {
+    std::fill(depth.begin(), depth.end(), FLT_MAX);
+    for (u32 i = 0; i + 2 < index_count; i += 3)
+    {
+      f32 x[3], y[3], z[3];
+      for (u32 k = 0; k < 3; ++k)
+      {
+        const Vector3& p = ptr_vertices[ptr_indices[i + k]].position;
+        const f32 local[3] = { (p.x - bounds_min.x) * scale, (p.y - bounds_min.y) * scale, (p.z - bounds_min.z) * scale };
+        x[k] = local[(axis + 1) % 3];
+        y[k] = local[(axis + 2) % 3];
+        z[k] = local[axis];
+      }
+
+      const f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+      if (area == 0.0f)
+      {
+        continue;
+      }
+      // clockwise front faces: positive area faces the view from the front, negative area the one from behind
+      const u32 side = area > 0.0f ? 0 : 1;
+      const f32 inv_area = 1.0f / area;
+      f32* ptr_depth = depth.data() + side * k_grid_size * k_grid_size;
+
+      // pixel centers inside the triangle, depth interpolated with barycentrics
+      const s32 min_x = std::max(static_cast<s32>(std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f)), 0);
+      const s32 max_x = std::min(static_cast<s32>(std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f)), s32(k_grid_size - 1));
+      const s32 min_y = std::max(static_cast<s32>(std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f)), 0);
+      const s32 max_y = std::min(static_cast<s32>(std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f)), s32(k_grid_size - 1));
+      for (s32 py = min_y; py <= max_y; ++py)
+      {
+        for (s32 px = min_x; px <= max_x; ++px)
+        {
+          const f32 cx = px + 0.5f;
+          const f32 cy = py + 0.5f;
+          const f32 w0 = ((x[1] - cx) * (y[2] - cy) - (y[1] - cy) * (x[2] - cx)) * inv_area;
+          const f32 w1 = ((x[2] - cx) * (y[0] - cy) - (y[2] - cy) * (x[0] - cx)) * inv_area;
+          const f32 w2 = 1.0f - w0 - w1;
+          if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+          {
+            continue;
+          }
+
+          const f32 pixel_depth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+          f32& stored = ptr_depth[py * k_grid_size + px];
+          const f32 view_depth = side == 0 ? pixel_depth : -pixel_depth;
+          if (view_depth < stored)
+          {
+            covered += stored == FLT_MAX;
+            stored = view_depth;
+            ++shaded;
+          }
+        }
+      }
+    }
+  }
+
+  return covered > 0 ? static_cast<f32>(shaded) / covered : 0.0f;
+}
+
+void zv::encode_octahedral_normal(const Vector3& normal, s16& out_x, s16& out_y)
+{
+  // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+  const f32 l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  const f32 inv_l1 = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+  f32 x = normal.x * inv_l1;
+  f32 y = normal.y * inv_l1;
+  if (normal.z < 0.0f)
+  {
+    const f32 folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const f32 folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+
+  out_x = static_cast<s16>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+  out_y = static_cast<s16>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+zv::Vector3 zv::decode_octahedral_normal(s16 x, s16 y)
+{
+  f32 fx = std::max(x / 32767.0f, -1.0f);
+  f32 fy = std::max(y / 32767.0f, -1.0f);
+  const f32 fz = 1.0f - std::abs(fx) - std::abs(fy);
+  if (fz < 0.0f)
+  {
+    const f32 unfolded_x = (1.0f - std::abs(fy)) * (fx >= 0.0f ? 1.0f : -1.0f);
+    const f32 unfolded_y = (1.0f - std::abs(fx)) * (fy >= 0.0f ? 1.0f : -1.0f);
+    fx = unfolded_x;
+    fy = unfolded_y;
+  }
+
+  const f32 length = std::sqrt(fx * fx + fy * fy + fz * fz);
+  return Vector3{ fx / length, fy / length, fz / length };
+}
@@ -0,0 +1,99 @@
+/*
+ * Mesh.h - import-time mesh processing: deduplication, cache/overdraw/fetch ordering, quantization and LODs
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <MathDefines.h>
+#include <Renderer/VertexComponent.h>
+
+namespace zv
+{
+  struct MeshVertex
+  {
+    Vector3 position;
+    Vector3 normal;
+    Vector2 uv;
+  };
+
+  // Indexed triangle list
+  struct MeshData
+  {
+    std::vector<MeshVertex> vertices;
+    std::vector<u32> indices;
+  };
+
+  // Index buffer of a simplified level of detail; it references the vertices of the source mesh
+  struct MeshLod
+  {
+    std::vector<u32> indices;
+    // clustering cell size relative to the largest extent of the mesh, a bound on how far vertices moved
+    f32 error{ 0.0f };
+  };
+
+  struct QuantizedMesh
+  {
+    VertexComponentFlags components{ VERTEX_COMPONENT_FLAG_NONE };
+    u32 vertex_stride{ 0 };
+    // position = position_offset + unorm16 position * position_scale
+    Vector3 position_offset;
+    Vector3 position_scale;
+    std::vector<u8> vertex_data;
+  };
+
+  struct MeshProcessParams
+  {
+    // FIFO size the cache statistics are simulated with; the ordering itself is tuned for caches up to 32 entries
+    u32 cache_size{ 16 };
+    bool optimize_overdraw{ true };
+    // ACMR the overdraw ordering may give up, relative to the cache order; higher values allow smaller clusters
+    f32 overdraw_threshold{ 1.05f };
+    // additional levels of detail after the full mesh, each with about lod_triangle_ratio of the previous triangles
+    u32 lod_count{ 3 };
+    f32 lod_triangle_ratio{ 0.5f };
+  };
+
+  struct VertexCacheStats
+  {
+    // average cache misses per triangle, 3 is the worst case and 0.5 the best for large regular meshes
+    f32 acmr{ 0.0f };
+    // average cache misses per vertex, 1 is optimal
+    f32 atvr{ 0.0f };
+  };
+
+  // All processing is CPU-only and deterministic: the same input always gives the same output.
+
+  // Merges bitwise identical vertices and returns how many were removed
+  u32 deduplicate_vertices(MeshData& mesh);
+  // Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+  void optimize_vertex_cache(u32* ptr_indices, u32 index_count, u32 vertex_count);
+  // Splits a cache-optimized index buffer into clusters whose ACMR stays within threshold of the cache order and sorts
+  // them so clusters far out along their normal come first, which lets early depth reject more of the rest from most
+  // view directions (Tipsify's cluster sorting); the cache order inside the clusters is kept
+  void optimize_overdraw(u32* ptr_indices, u32 index_count, const MeshVertex* ptr_vertices, u32 vertex_count, u32 cache_size, f32 threshold);
+  // Reorders vertices in the order the index buffer first uses them, so vertex fetch walks memory linearly
+  void optimize_vertex_fetch(MeshData& mesh);
+  // Vertex clustering on grids of decreasing resolution; every level has at most triangle_ratio of the previous
+  // level's triangles and is cache-optimized
+  void generate_lods(const MeshData& mesh, u32 lod_count, f32 triangle_ratio, std::vector<MeshLod>& out_lods);
+  // Packs the vertices with eVertexEncoding::Quantized
+  void quantize_mesh(const MeshData& mesh, VertexComponentFlags components, QuantizedMesh& out_mesh);
+
+  // deduplicate, then vertex cache, overdraw and vertex fetch order
+  void process_mesh(MeshData& mesh, const MeshProcessParams& params, std::vector<MeshLod>& out_lods);
+
+  VertexCacheStats analyze_vertex_cache(const u32* ptr_indices, u32 index_count, u32 vertex_count, u32 cache_size);
+  // bytes fetched through a 4 KB cache of 64 byte lines per byte of vertex data, 1 is optimal
+  f32 analyze_vertex_fetch(const u32* ptr_indices, u32 index_count, u32 vertex_count, u32 vertex_stride);
+  // Pixels shaded per pixel covered when rasterizing the triangles in order with a depth test and back-face culling at
+  // 256x256, averaged over the six axis-aligned views; 1 is optimal
+  f32 analyze_overdraw(const u32* ptr_indices, u32 index_count, const MeshVertex* ptr_vertices, u32 vertex_count);
+
+  // octahedral encoding of a unit vector into two snorm16 values
+  void encode_octahedral_normal(const Vector3& normal, s16& out_x, s16& out_y);
+  Vector3 decode_octahedral_normal(s16 x, s16 y);
+}
@@ -0,0 +1,543 @@
+/*
+ * PipelineCache.cpp - hashed shader and pipeline state cache with on-disk persistence and background compilation
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/PipelineCache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Common/interface/DataBlobImpl.hpp>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/PipelineStateCache.h>
+#include <ThirdParty/DiligentTools/RenderStateCache/interface/RenderStateCache.h>
+
+
+namespace
+{
+  // bump when the key computation changes, older cache files are ignored then
+  constexpr u32 k_cache_version = 1;
+
+  template<typename... Ts>
+  u64 hash_fields(u64 seed, const Ts&... values)
+  {
+    ((seed = zv::hash_value(values, seed)), ...);
+    return seed;
+  }
+
+  u64 hash_shader(const Diligent::ShaderCreateInfo& shader_ci, u64 seed)
+  {
+    u64 hash = seed;
+    if (shader_ci.Source != nullptr)
+    {
+      const u64 length = shader_ci.SourceLength != 0 ? shader_ci.SourceLength : std::strlen(shader_ci.Source);
+      hash = zv::hash_bytes(shader_ci.Source, length, hash);
+    }
+    // sources loaded through a stream factory are only identified by their path
+    hash = zv::hash_string(shader_ci.FilePath, hash);
+    hash = zv::hash_string(shader_ci.EntryPoint, hash);
+    hash = zv::hash_string(shader_ci.CombinedSamplerSuffix, hash);
+    hash = hash_fields(hash, shader_ci.Desc.ShaderType, shader_ci.Desc.UseCombinedTextureSamplers, shader_ci.SourceLanguage,
+                       shader_ci.ShaderCompiler, shader_ci.CompileFlags);
+
+    for (u32 i = 0; i < shader_ci.Macros.Count; ++i)
+    {
+      hash = zv::hash_string(shader_ci.Macros.Elements[i].Name, hash);
+      hash = zv::hash_string(shader_ci.Macros.Elements[i].Definition, hash);
+    }
+    return hash;
+  }
+
+  u64 hash_graphics_pipeline(const Diligent::GraphicsPipelineStateCreateInfo& pso_ci, u64 seed)
+  {
+    const Diligent::PipelineResourceLayoutDesc& layout = pso_ci.PSODesc.ResourceLayout;
+    u64 hash = hash_fields(seed, pso_ci.PSODesc.PipelineType, layout.DefaultVariableType, layout.DefaultVariableMergeStages, pso_ci.Flags);
+
+    for (u32 i = 0; i < layout.NumVariables; ++i)
+    {
+      const Diligent::ShaderResourceVariableDesc& variable = layout.Variables[i];
+      hash = zv::hash_string(variable.Name, hash);
+      hash = hash_fields(hash, variable.ShaderStages, variable.Type, variable.Flags);
+    }
+
+    for (u32 i = 0; i < layout.NumImmutableSamplers; ++i)
+    {
+      const Diligent::ImmutableSamplerDesc& sampler = layout.ImmutableSamplers[i];
+      const Diligent::SamplerDesc& desc = sampler.Desc;
+      hash = zv::hash_string(sampler.SamplerOrTextureName, hash);
+      hash = hash_fields(hash, sampler.ShaderStages, desc.MinFilter, desc.MagFilter, desc.MipFilter, desc.AddressU, desc.AddressV, desc.AddressW,
+                         desc.MipLODBias, desc.MaxAnisotropy, desc.ComparisonFunc, desc.BorderColor, desc.MinLOD, desc.MaxLOD);
+    }
+
+    const Diligent::GraphicsPipelineDesc& graphics = pso_ci.GraphicsPipeline;
+
+    const Diligent::BlendStateDesc& blend = graphics.BlendDesc;
+    hash = hash_fields(hash, blend.AlphaToCoverageEnable, blend.IndependentBlendEnable);
+    for (u32 i = 0; i < graphics.NumRenderTargets; ++i)
+    {
+      const Diligent::RenderTargetBlendDesc& target = blend.RenderTargets[i];
+      hash = hash_fields(hash, target.BlendEnable, target.LogicOperationEnable, target.SrcBlend, target.DestBlend, target.BlendOp,
+                         target.SrcBlendAlpha, target.DestBlendAlpha, target.BlendOpAlpha, target.LogicOp, target.RenderTargetWriteMask);
+    }
+
+    const Diligent::RasterizerStateDesc& raster = graphics.RasterizerDesc;
+    hash = hash_fields(hash, raster.FillMode, raster.CullMode, raster.FrontCounterClockwise, raster.DepthClipEnable, raster.ScissorEnable,
+                       raster.AntialiasedLineEnable, raster.DepthBias, raster.DepthBiasClamp, raster.SlopeScaledDepthBias);
+
+    const Diligent::DepthStencilStateDesc& depth = graphics.DepthStencilDesc;
+    hash = hash_fields(hash, depth.DepthEnable, depth.DepthWriteEnable, depth.DepthFunc, depth.StencilEnable, depth.StencilReadMask,
+                       depth.StencilWriteMask);
+    for (const Diligent::StencilOpDesc* ptr_face : { &depth.FrontFace, &depth.BackFace })
+    {
+      hash = hash_fields(hash, ptr_face->StencilFailOp, ptr_face->StencilDepthFailOp, ptr_face->StencilPassOp, ptr_face->StencilFunc);
+    }
+
+    for (u32 i = 0; i < graphics.InputLayout.NumElements; ++i)
+    {
+      const Diligent::LayoutElement& element = graphics.InputLayout.LayoutElements[i];
+      hash = zv::hash_string(element.HLSLSemantic, hash);
+      hash = hash_fields(hash, element.InputIndex, element.BufferSlot, element.NumComponents, element.ValueType, element.IsNormalized,
+                         element.RelativeOffset, element.Stride, element.Frequency, element.InstanceDataStepRate);
+    }
+
+    hash = hash_fields(hash, graphics.SampleMask, graphics.PrimitiveTopology, graphics.NumViewports, graphics.NumRenderTargets,
+                       graphics.SubpassIndex, graphics.ShadingRateFlags, graphics.DSVFormat, graphics.SmplDesc.Count,
+                       graphics.SmplDesc.Quality, graphics.NodeMask);
+    for (u32 i = 0; i < graphics.NumRenderTargets; ++i)
+    {
+      hash = hash_fields(hash, graphics.RTVFormats[i]);
+    }
+    return hash;
+  }
+
+  const char* get_device_name(Diligent::RENDER_DEVICE_TYPE type)
+  {
+    switch (type)
+    {
+      case Diligent::RENDER_DEVICE_TYPE_D3D11:  return "d3d11";
+      case Diligent::RENDER_DEVICE_TYPE_D3D12:  return "d3d12";
+      case Diligent::RENDER_DEVICE_TYPE_VULKAN: return "vulkan";
+      default:                                  return "unknown";
+    }
+  }
+
+  bool read_file(const std::string& path, std::vector<u8>& out_data)
+  {
+    std::ifstream file{ path, std::ios::binary | std::ios::ate };
+    if (!file.is_open())
+    {
+      return false;
+    }
+
+    out_data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(out_data.data()), static_cast<std::streamsize>(out_data.size())));
+  }
+
+  bool write_file(const std::string& path, const void* ptr_data, u64 size)
+  {
+    // write to a temporary file first, a crash while saving must not leave a truncated cache behind
+    const std::string temp_path = path + ".tmp";
+    {
+      std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+      if (!file.write(static_cast<const char*>(ptr_data), static_cast<std::streamsize>(size)))
+      {
+        return false;
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    return !error;
+  }
+}
+
+// A requested pipeline with copies of everything its compilation needs
+struct zv::PipelineCache::Pipeline
+{
+  PipelineKey key{ 0 };
+  std::atomic<ePipelineStatus> status{ ePipelineStatus::Pending };
+  RefCntAutoPtr<IPipelineState> ptr_pso;
+
+  Diligent::GraphicsPipelineStateCreateInfo pso_ci;
+  Diligent::ShaderCreateInfo vs_ci;
+  Diligent::ShaderCreateInfo ps_ci;
+
+  std::list<std::string> strings;
+  std::vector<Diligent::LayoutElement> layout_elements;
+  std::vector<Diligent::ShaderResourceVariableDesc> variables;
+  std::vector<Diligent::ImmutableSamplerDesc> immutable_samplers;
+  std::vector<Diligent::ShaderMacro> vs_macros;
+  std::vector<Diligent::ShaderMacro> ps_macros;
+
+  const char* keep(const char* str)
+  {
+    return str != nullptr ? strings.emplace_back(str).c_str() : nullptr;
+  }
+
+  void copy_shader(const Diligent::ShaderCreateInfo& src, Diligent::ShaderCreateInfo& dst, std::vector<Diligent::ShaderMacro>& macros)
+  {
+    dst = src;
+    if (src.Source != nullptr)
+    {
+      const size_t length = src.SourceLength != 0 ? src.SourceLength : std::strlen(src.Source);
+      dst.Source = strings.emplace_back(src.Source, length).c_str();
+      dst.SourceLength = length;
+    }
+    dst.FilePath = keep(src.FilePath);
+    dst.EntryPoint = keep(src.EntryPoint);
+    dst.CombinedSamplerSuffix = keep(src.CombinedSamplerSuffix);
+    dst.Desc.Name = keep(src.Desc.Name);
+
+    macros.clear();
+    for (u32 i = 0; i < src.Macros.Count; ++i)
+    {
+      macros.push_back(Diligent::ShaderMacro{ keep(src.Macros.Elements[i].Name), keep(src.Macros.Elements[i].Definition) });
+    }
+    dst.Macros = Diligent::ShaderMacroArray{ macros.data(), static_cast<u32>(macros.size()) };
+  }
+
+  void copy_pipeline(const Diligent::GraphicsPipelineStateCreateInfo& src)
+  {
+    pso_ci = src;
+    pso_ci.PSODesc.Name = keep(src.PSODesc.Name);
+    pso_ci.pVS = nullptr;
+    pso_ci.pPS = nullptr;
+
+    const Diligent::InputLayoutDesc& layout = src.GraphicsPipeline.InputLayout;
+    layout_elements.assign(layout.LayoutElements, layout.LayoutElements + layout.NumElements);
+    pso_ci.GraphicsPipeline.InputLayout.LayoutElements = layout_elements.data();
+
+    const Diligent::PipelineResourceLayoutDesc& resources = src.PSODesc.ResourceLayout;
+    variables.assign(resources.Variables, resources.Variables + resources.NumVariables);
+    immutable_samplers.assign(resources.ImmutableSamplers, resources.ImmutableSamplers + resources.NumImmutableSamplers);
+    pso_ci.PSODesc.ResourceLayout.Variables = variables.data();
+    pso_ci.PSODesc.ResourceLayout.ImmutableSamplers = immutable_samplers.data();
+  }
+};
+
+zv::PipelineCache::~PipelineCache()
+{
+  destroy();
+}
+
+bool zv::PipelineCache::create(IRenderDevice* ptr_device, const CreateParams& params)
+{
+  using namespace Diligent;
+
+  destroy();
+
+  m_ptr_device = ptr_device;
+  m_directory = params.ptr_directory != nullptr ? params.ptr_directory : "";
+  m_async_compilation = params.async_compilation;
+
+  RenderStateCacheCreateInfo state_cache_ci;
+  state_cache_ci.pDevice  = ptr_device;
+  state_cache_ci.LogLevel = RENDER_STATE_CACHE_LOG_LEVEL_DISABLED;
+  CreateRenderStateCache(state_cache_ci, &m_ptr_state_cache);
+  if (m_ptr_state_cache == nullptr)
+  {
+    // shaders are still deduplicated, they just compile on every start
+    ZV_WARNING("Failed to create the render state cache, shader bytecode is not cached.");
+  }
+
+  if (!m_directory.empty())
+  {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error)
+    {
+      ZV_WARNING("Failed to create the pipeline cache directory '{}'.", m_directory);
+      m_directory.clear();
+    }
+  }
+
+  return load_files();
+}
+
+void zv::PipelineCache::destroy()
+{
+  if (m_ptr_device == nullptr)
+  {
+    return;
+  }
+
+  Jobs::wait(m_pending);
+  save();
+
+  m_pipeline_map.clear();
+  m_pipelines.clear();
+  m_known_keys.clear();
+  m_shaders.clear();
+  m_stats = CacheStats{};
+
+  m_ptr_pso_cache = nullptr;
+  m_ptr_state_cache = nullptr;
+  m_ptr_device = nullptr;
+}
+
+std::string zv::PipelineCache::get_file_path(const char* suffix) const
+{
+  return (std::filesystem::path{ m_directory } / (std::string{ "pipelines_" } + get_device_name(m_ptr_device->GetDeviceInfo().Type) + suffix)).string();
+}
+
+bool zv::PipelineCache::load_files()
+{
+  using namespace Diligent;
+
+  std::vector<u8> data;
+  const bool persistent = !m_directory.empty();
+
+  if (persistent && m_ptr_state_cache != nullptr && read_file(get_file_path(".shaders"), data))
+  {
+    RefCntAutoPtr<DataBlobImpl> ptr_blob = DataBlobImpl::Create(data.size(), data.data());
+    if (!m_ptr_state_cache->Load(ptr_blob, k_cache_version))
+    {
+      ZV_WARNING("Ignoring outdated shader cache '{}'.", get_file_path(".shaders"));
+    }
+  }
+
+  // driver pipeline blobs only exist on D3D12 and Vulkan
+  const RENDER_DEVICE_TYPE device_type = m_ptr_device->GetDeviceInfo().Type;
+  if (device_type == RENDER_DEVICE_TYPE_D3D12 || device_type == RENDER_DEVICE_TYPE_VULKAN)
+  {
+    data.clear();
+    if (persistent)
+    {
+      read_file(get_file_path(".psocache"), data);
+    }
+
+    PipelineStateCacheCreateInfo pso_cache_ci;
+    pso_cache_ci.Desc.Name     = "Pipeline state cache";
+    pso_cache_ci.Desc.Mode     = PSO_CACHE_MODE_LOAD_STORE;
+    pso_cache_ci.pCacheData    = data.empty() ? nullptr : data.data();
+    pso_cache_ci.CacheDataSize = static_cast<u32>(data.size());
+    m_ptr_device->CreatePipelineStateCache(pso_cache_ci, &m_ptr_pso_cache);
+    if (m_ptr_pso_cache == nullptr && !data.empty())
+    {
+      // blobs of a different driver or GPU are rejected, start with an empty cache instead
+      pso_cache_ci.pCacheData    = nullptr;
+      pso_cache_ci.CacheDataSize = 0;
+      m_ptr_device->CreatePipelineStateCache(pso_cache_ci, &m_ptr_pso_cache);
+    }
+  }
+
+  // the index only lists pipelines whose shaders and blobs are in the files loaded above
+  data.clear();
+  if (persistent && read_file(get_file_path(".index"), data) && data.size() >= sizeof(u32) && data.size() % sizeof(PipelineKey) == sizeof(u32))
+  {
+    u32 version;
+    std::memcpy(&version, data.data(), sizeof(u32));
+    if (version == k_cache_version)
+    {
+      m_known_keys.resize((data.size() - sizeof(u32)) / sizeof(PipelineKey));
+      std::memcpy(m_known_keys.data(), data.data() + sizeof(u32), m_known_keys.size() * sizeof(PipelineKey));
+      std::sort(m_known_keys.begin(), m_known_keys.end());
+    }
+  }
+
+  if (persistent)
+  {
+    ZV_INFO("Pipeline cache: {} known pipelines in '{}'.", m_known_keys.size(), m_directory);
+  }
+  return true;
+}
+
+bool zv::PipelineCache::save()
+{
+  using namespace Diligent;
+
+  if (m_directory.empty() || m_ptr_device == nullptr)
+  {
+    return false;
+  }
+
+  Jobs::wait(m_pending);
+
+  bool success = true;
+  if (m_ptr_state_cache != nullptr)
+  {
+    RefCntAutoPtr<IDataBlob> ptr_blob;
+    if (m_ptr_state_cache->WriteToBlob(k_cache_version, &ptr_blob) && ptr_blob != nullptr)
+    {
+      success &= write_file(get_file_path(".shaders"), ptr_blob->GetConstDataPtr(), ptr_blob->GetSize());
+    }
+  }
+
+  if (m_ptr_pso_cache != nullptr)
+  {
+    RefCntAutoPtr<IDataBlob> ptr_blob;
+    m_ptr_pso_cache->GetData(&ptr_blob);
+    if (ptr_blob != nullptr)
+    {
+      success &= write_file(get_file_path(".psocache"), ptr_blob->GetConstDataPtr(), ptr_blob->GetSize());
+    }
+  }
+
+  // pipelines of earlier runs stay in the index, their data is still in the caches
+  std::vector<PipelineKey> keys = m_known_keys;
+  for (const Pipeline& pipeline : m_pipelines)
+  {
+    if (pipeline.status.load(std::memory_order_acquire) == ePipelineStatus::Ready)
+    {
+      keys.push_back(pipeline.key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  std::vector<u8> index(sizeof(u32) + keys.size() * sizeof(PipelineKey));
+  std::memcpy(index.data(), &k_cache_version, sizeof(u32));
+  std::memcpy(index.data() + sizeof(u32), keys.data(), keys.size() * sizeof(PipelineKey));
+  success &= write_file(get_file_path(".index"), index.data(), index.size());
+
+  if (!success)
+  {
+    ZV_WARNING("Failed to save the pipeline cache to '{}'.", m_directory);
+  }
+  return success;
+}
+
+zv::PipelineCache::CacheStats zv::PipelineCache::get_stats() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_stats;
+}
+
+zv::PipelineKey zv::PipelineCache::compute_key(const Diligent::GraphicsPipelineStateCreateInfo& pso_ci, const Diligent::ShaderCreateInfo& vs_ci,
+                                               const Diligent::ShaderCreateInfo& ps_ci)
+{
+  u64 hash = hash_value(k_cache_version, k_fnv1a_offset_basis);
+  hash = hash_shader(vs_ci, hash);
+  hash = hash_shader(ps_ci, hash);
+  return hash_graphics_pipeline(pso_ci, hash);
+}
+
+zv::ePipelineStatus zv::PipelineCache::request_graphics_pipeline(const Diligent::GraphicsPipelineStateCreateInfo& pso_ci, const Diligent::ShaderCreateInfo& vs_ci,
+                                                                 const Diligent::ShaderCreateInfo& ps_ci, IPipelineState*& out_ptr_pso, bool allow_async)
+{
+  ZV_ASSERT(m_ptr_device != nullptr);
+
+  out_ptr_pso = nullptr;
+
+  const PipelineKey key = compute_key(pso_ci, vs_ci, ps_ci);
+  auto it = m_pipeline_map.find(key);
+  if (it == m_pipeline_map.end())
+  {
+    Pipeline& pipeline = m_pipelines.emplace_back();
+    pipeline.key = key;
+    pipeline.copy_pipeline(pso_ci);
+    pipeline.copy_shader(vs_ci, pipeline.vs_ci, pipeline.vs_macros);
+    pipeline.copy_shader(ps_ci, pipeline.ps_ci, pipeline.ps_macros);
+    it = m_pipeline_map.emplace(key, &pipeline).first;
+
+    // a known key only unpacks cached bytecode and blobs, that is cheap enough to do right away
+    const bool known = std::binary_search(m_known_keys.begin(), m_known_keys.end(), key);
+    if (!known && allow_async && m_async_compilation)
+    {
+      // compiling takes milliseconds and must not hold up the frame's parallel_for; it logs from the worker
+      Jobs::submit_background([this, &pipeline]() { compile(pipeline); }, &m_pending);
+    }
+    else
+    {
+      compile(pipeline);
+    }
+  }
+
+  const Pipeline& pipeline = *it->second;
+  const ePipelineStatus status = pipeline.status.load(std::memory_order_acquire);
+  if (status == ePipelineStatus::Ready)
+  {
+    out_ptr_pso = pipeline.ptr_pso;
+  }
+  return status;
+}
+
+RefCntAutoPtr<Diligent::IShader> zv::PipelineCache::create_shader(const Diligent::ShaderCreateInfo& shader_ci)
+{
+  using namespace Diligent;
+
+  const u64 hash = hash_shader(shader_ci, k_fnv1a_offset_basis);
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    auto it = m_shaders.find(hash);
+    if (it != m_shaders.end())
+    {
+      return it->second;
+    }
+  }
+
+  // two pipelines sharing a new shader may both compile it, the first one to finish is kept
+  RefCntAutoPtr<IShader> ptr_shader;
+  if (m_ptr_state_cache != nullptr)
+  {
+    m_ptr_state_cache->CreateShader(shader_ci, &ptr_shader);
+  }
+  else
+  {
+    m_ptr_device->CreateShader(shader_ci, &ptr_shader);
+  }
+
+  if (ptr_shader == nullptr)
+  {
+    return ptr_shader;
+  }
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_shaders.emplace(hash, ptr_shader).first->second;
+}
+
+void zv::PipelineCache::compile(Pipeline& pipeline)
+{
+  using namespace Diligent;
+
+  const auto compile_start = std::chrono::steady_clock::now();
+
+  RefCntAutoPtr<IShader> ptr_vs = create_shader(pipeline.vs_ci);
+  RefCntAutoPtr<IShader> ptr_ps = create_shader(pipeline.ps_ci);
+  if (ptr_vs != nullptr && ptr_ps != nullptr)
+  {
+    pipeline.pso_ci.pVS       = ptr_vs;
+    pipeline.pso_ci.pPS       = ptr_ps;
+    pipeline.pso_ci.pPSOCache = m_ptr_pso_cache;
+    m_ptr_device->CreateGraphicsPipelineState(pipeline.pso_ci, &pipeline.ptr_pso);
+    pipeline.pso_ci.pVS = nullptr;
+    pipeline.pso_ci.pPS = nullptr;
+  }
+
+  const f64 compile_time_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - compile_start).count();
+  const bool known = std::binary_search(m_known_keys.begin(), m_known_keys.end(), pipeline.key);
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    if (pipeline.ptr_pso == nullptr)
+    {
+      ++m_stats.failures;
+    }
+    else if (known)
+    {
+      ++m_stats.hits;
+    }
+    else
+    {
+      ++m_stats.misses;
+    }
+    m_stats.compile_time_ms += compile_time_ms;
+  }
+
+  if (pipeline.ptr_pso == nullptr)
+  {
+    ZV_ERROR("Failed to create pipeline '{}'.", pipeline.pso_ci.PSODesc.Name ? pipeline.pso_ci.PSODesc.Name : "");
+    pipeline.status.store(ePipelineStatus::Failed, std::memory_order_release);
+    return;
+  }
+
+  ZV_INFO("Created pipeline '{}' in {:.2f} ms ({}).", pipeline.pso_ci.PSODesc.Name ? pipeline.pso_ci.PSODesc.Name : "", compile_time_ms,
+          known ? "cached" : "compiled");
+  pipeline.status.store(ePipelineStatus::Ready, std::memory_order_release);
+}
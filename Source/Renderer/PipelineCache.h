@@ -0,0 +1,125 @@
+/*
+ * PipelineCache.h - hashed shader and pipeline state cache with on-disk persistence and background compilation
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Core/JobSystem.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace Diligent
+{
+  class IShader;
+  class IRenderStateCache;
+  class IPipelineStateCache;
+  struct ShaderCreateInfo;
+  struct GraphicsPipelineStateCreateInfo;
+}
+
+namespace zv
+{
+  using PipelineKey = u64;
+
+  enum class ePipelineStatus : u8
+  {
+    Ready,
+    Pending,
+    Failed,
+  };
+
+  // Creates shaders and graphics pipelines keyed by a hash of their source, entry point, macros and pipeline
+  // description:
+  //  - identical requests share one object for the lifetime of the cache
+  //  - compiled bytecode goes through a Diligent render state cache, driver pipeline blobs through a pipeline state
+  //    cache (D3D12 and Vulkan); both are written to the cache directory by save() and loaded by create(), so warm
+  //    starts create pipelines without compiling anything
+  //  - pipelines whose key is not in the loaded index are misses and compile on the job system; the caller gets
+  //    ePipelineStatus::Pending until they are done and keeps drawing without them
+  class PipelineCache : public NonCopyable
+  {
+  public:
+    struct CreateParams
+    {
+      // directory of the cache files, null keeps the cache in memory only
+      const char* ptr_directory{ nullptr };
+      // misses compile synchronously when disabled
+      bool async_compilation{ true };
+    };
+
+    struct CacheStats
+    {
+      // created from the on-disk cache or an earlier request
+      u32 hits{ 0 };
+      // compiled in this run
+      u32 misses{ 0 };
+      u32 failures{ 0 };
+      f64 compile_time_ms{ 0.0 };
+    };
+
+  public:
+    PipelineCache() = default;
+    ~PipelineCache();
+
+  public:
+    bool create(IRenderDevice* ptr_device, const CreateParams& params);
+    // waits for pending compilations and saves the cache
+    void destroy();
+
+    // writes bytecode, pipeline blobs and the key index to the cache directory
+    bool save();
+
+    // pVS and pPS of pso_ci are ignored, the shaders are described by their own create infos
+    static PipelineKey compute_key(const Diligent::GraphicsPipelineStateCreateInfo& pso_ci, const Diligent::ShaderCreateInfo& vs_ci,
+                                   const Diligent::ShaderCreateInfo& ps_ci);
+
+    // Returns the status of the pipeline and the pipeline once it is ready. The first request of a key that is not in
+    // the cache starts the compilation, later requests with the same key poll it. Create infos are copied for
+    // background compilation, except for the name strings of layout elements, variables and samplers, which have to
+    // outlive the compilation (string literals in practice).
+    ePipelineStatus request_graphics_pipeline(const Diligent::GraphicsPipelineStateCreateInfo& pso_ci, const Diligent::ShaderCreateInfo& vs_ci,
+                                              const Diligent::ShaderCreateInfo& ps_ci, IPipelineState*& out_ptr_pso, bool allow_async = true);
+
+    CacheStats get_stats() const;
+
+  private:
+    struct Pipeline;
+
+    bool load_files();
+    std::string get_file_path(const char* suffix) const;
+
+    // runs on any thread
+    void compile(Pipeline& pipeline);
+    RefCntAutoPtr<Diligent::IShader> create_shader(const Diligent::ShaderCreateInfo& shader_ci);
+
+  private:
+    RefCntAutoPtr<IRenderDevice> m_ptr_device;
+    RefCntAutoPtr<Diligent::IRenderStateCache> m_ptr_state_cache;
+    RefCntAutoPtr<Diligent::IPipelineStateCache> m_ptr_pso_cache;
+
+    std::string m_directory;
+    bool m_async_compilation{ true };
+
+    // pipelines stay at their address, background jobs write to them
+    std::list<Pipeline> m_pipelines;
+    std::unordered_map<PipelineKey, Pipeline*> m_pipeline_map;
+    // keys of the pipelines in the loaded cache files
+    std::vector<PipelineKey> m_known_keys;
+
+    // guards the shaders and stats, which background compilations update
+    mutable std::mutex m_mutex;
+    std::unordered_map<u64, RefCntAutoPtr<Diligent::IShader>> m_shaders;
+
+    Jobs::Counter m_pending;
+    CacheStats m_stats;
+  };
+}
@@ -0,0 +1,573 @@
+/*
+ * StreamingSystem.cpp - asynchronous texture and mesh streaming with budgeted uploads and LRU residency
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/StreamingSystem.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <Core/AssetArchive.h>
+#include <Core/Logger.h>
+#include <Core/MappedFile.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsAccessories/interface/GraphicsAccessories.hpp>
+#include <ThirdParty/DiligentTools/TextureLoader/interface/TextureLoader.h>
+
+
+namespace
+{
+  // granularity of mesh uploads, so one large mesh cannot take a whole frame's budget at once
+  constexpr u64 k_mesh_chunk_bytes = 256ull << 10;
+}
+
+// An asset on its way from disk to the GPU
+struct zv::StreamingSystem::Load
+{
+  StreamHandle handle;
+  eStreamAssetType type{ eStreamAssetType::Texture };
+  std::string path;
+  bool failed{ false };
+
+  // Either a loose file or an archive entry. Both stay mapped until the upload is done, loaders and meshes reference
+  // the data without copies; only compressed archive entries are decompressed into a buffer.
+  MappedFile file;
+  const ArchiveEntry* ptr_archive_entry{ nullptr };
+  std::vector<u8> decompressed;
+  const u8* ptr_data{ nullptr };
+  u64 size{ 0 };
+
+  // decoded texture
+  RefCntAutoPtr<Diligent::ITextureLoader> ptr_texture_loader;
+  // decoded mesh, points into the mapped file
+  const StreamMeshHeader* ptr_mesh_header{ nullptr };
+  const u8* ptr_vertices{ nullptr };
+  const u8* ptr_indices{ nullptr };
+
+  // upload progress: next subresource of a texture, next byte of the mesh's vertex and index data
+  u32 next_subresource{ 0 };
+  u64 next_byte{ 0 };
+
+  // the object being uploaded, handed to the resource manager once it is complete
+  RefCntAutoPtr<ITexture> ptr_texture;
+  RefCntAutoPtr<IBuffer> ptr_buffer;
+};
+
+zv::StreamingSystem::StreamingSystem() = default;
+
+zv::StreamingSystem::~StreamingSystem()
+{
+  destroy();
+}
+
+bool zv::StreamingSystem::create(IRenderDevice* ptr_device, ResourceManager* ptr_resources, const CreateParams& params)
+{
+  destroy();
+
+  ZV_ASSERT(ptr_resources != nullptr && params.upload_budget_bytes > 0);
+
+  m_ptr_device = ptr_device;
+  m_ptr_resources = ptr_resources;
+  m_params = params;
+  m_quit = false;
+  m_io_thread = std::thread{ &StreamingSystem::io_thread_main, this };
+
+  return true;
+}
+
+void zv::StreamingSystem::destroy()
+{
+  if (m_io_thread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock{ m_read_mutex };
+      m_quit = true;
+    }
+    m_read_cv.notify_all();
+    m_io_thread.join();
+  }
+
+  // loads still queued for reading are owned by their assets and simply dropped
+  m_read_queue.clear();
+  Jobs::wait(m_decode_counter);
+  m_decoded.clear();
+
+  // resources of abandoned loads stay Loading until the resource manager is destroyed
+  for (const Asset& asset : m_assets)
+  {
+    if (asset.state != eStreamState::Unloaded)
+    {
+      m_ptr_resources->release(asset.handle);
+    }
+  }
+  m_assets.clear();
+  m_ptr_archive = nullptr;
+  m_upload_queue.clear();
+  m_frame_index = 0;
+  m_resident_bytes = 0;
+  m_frame_stats = FrameStats{};
+
+  m_ptr_device = nullptr;
+  m_ptr_resources = nullptr;
+}
+
+zv::StreamHandle zv::StreamingSystem::request(const char* path, eStreamAssetType type)
+{
+  ZV_ASSERT(m_ptr_device != nullptr);
+
+  bool started = false;
+  const StreamHandle handle = m_ptr_resources->begin_load(make_resource_id(path), path, started);
+  if (handle.index >= m_assets.size())
+  {
+    m_assets.resize(handle.index + 1);
+  }
+
+  Asset& asset = m_assets[handle.index];
+  if (asset.handle == handle && asset.state != eStreamState::Unloaded)
+  {
+    // requested before, the asset holds its reference already
+    m_ptr_resources->release(handle);
+    asset.last_used_frame = m_frame_index;
+    return handle;
+  }
+
+  // an asset that was evicted keeps its slot until its resource is swept, then the slot goes to another resource
+  if (asset.handle != handle)
+  {
+    asset = Asset{};
+    asset.handle = handle;
+    asset.path = path;
+    asset.type = type;
+  }
+  asset.last_used_frame = m_frame_index;
+  asset.state = eStreamState::Loading;
+
+  if (!started)
+  {
+    adopt(asset);
+    return handle;
+  }
+
+  asset.ptr_load = std::make_unique<Load>();
+  asset.ptr_load->handle = handle;
+  asset.ptr_load->type = asset.type;
+  asset.ptr_load->path = asset.path;
+  asset.ptr_load->ptr_archive_entry = m_ptr_archive ? m_ptr_archive->find(asset.path.c_str()) : nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_read_mutex };
+    m_read_queue.push_back(asset.ptr_load.get());
+  }
+  m_read_cv.notify_one();
+
+  return handle;
+}
+
+void zv::StreamingSystem::set_archive(const AssetArchive* ptr_archive)
+{
+  // loads in flight may reference the previous archive
+  ZV_ASSERT(std::none_of(m_assets.begin(), m_assets.end(), [](const Asset& asset) { return asset.ptr_load != nullptr; }));
+  m_ptr_archive = ptr_archive;
+}
+
+void zv::StreamingSystem::touch(StreamHandle handle)
+{
+  if (find(handle) != nullptr)
+  {
+    m_assets[handle.index].last_used_frame = m_frame_index;
+  }
+}
+
+zv::eStreamState zv::StreamingSystem::get_state(StreamHandle handle) const
+{
+  const Asset* ptr_asset = find(handle);
+  return ptr_asset ? ptr_asset->state : eStreamState::Unloaded;
+}
+
+zv::ITexture* zv::StreamingSystem::get_texture(StreamHandle handle) const
+{
+  const Asset* ptr_asset = find(handle);
+  const bool resident = ptr_asset && ptr_asset->state == eStreamState::Resident && ptr_asset->type == eStreamAssetType::Texture;
+  return resident ? m_ptr_resources->get<ITexture>(handle) : nullptr;
+}
+
+zv::IBuffer* zv::StreamingSystem::get_mesh_buffer(StreamHandle handle) const
+{
+  const Asset* ptr_asset = find(handle);
+  const bool resident = ptr_asset && ptr_asset->state == eStreamState::Resident && ptr_asset->type == eStreamAssetType::Mesh;
+  return resident ? m_ptr_resources->get<IBuffer>(handle) : nullptr;
+}
+
+u64 zv::StreamingSystem::get_index_offset(StreamHandle handle) const
+{
+  const Asset* ptr_asset = find(handle);
+  return ptr_asset && ptr_asset->state == eStreamState::Resident ? ptr_asset->index_offset : 0;
+}
+
+u32 zv::StreamingSystem::get_index_count(StreamHandle handle) const
+{
+  const Asset* ptr_asset = find(handle);
+  return ptr_asset && ptr_asset->state == eStreamState::Resident ? ptr_asset->index_count : 0;
+}
+
+const zv::StreamingSystem::Asset* zv::StreamingSystem::find(StreamHandle handle) const
+{
+  return handle.index < m_assets.size() && m_assets[handle.index].handle == handle ? &m_assets[handle.index] : nullptr;
+}
+
+bool zv::StreamingSystem::adopt(Asset& asset)
+{
+  switch (m_ptr_resources->get_state(asset.handle))
+  {
+    case eResourceState::Loading:
+      return false;
+    case eResourceState::Ready:
+      // an evicted asset still knows its size, resources that were loaded elsewhere do not count towards the budget
+      asset.state = eStreamState::Resident;
+      m_resident_bytes += asset.resident_bytes;
+      return true;
+    default:
+      asset.state = eStreamState::Failed;
+      return true;
+  }
+}
+
+void zv::StreamingSystem::fail(Asset& asset)
+{
+  // the resource manager reports the failure
+  m_ptr_resources->finish_load(asset.handle, nullptr);
+  asset.state = eStreamState::Failed;
+  asset.ptr_load.reset();
+}
+
+void zv::StreamingSystem::io_thread_main()
+{
+  while (true)
+  {
+    Load* ptr_load = nullptr;
+    {
+      std::unique_lock<std::mutex> lock{ m_read_mutex };
+      m_read_cv.wait(lock, [this]() { return m_quit || !m_read_queue.empty(); });
+      if (m_quit)
+      {
+        return;
+      }
+      ptr_load = m_read_queue.front();
+      m_read_queue.pop_front();
+    }
+
+    // the disk reads happen here, decoding on the workers only touches resident pages
+    if (ptr_load->ptr_archive_entry)
+    {
+      m_ptr_archive->prefetch(*ptr_load->ptr_archive_entry);
+    }
+    else if (ptr_load->file.open(ptr_load->path.c_str()))
+    {
+      ptr_load->file.prefetch(0, ptr_load->file.get_size());
+      ptr_load->ptr_data = ptr_load->file.get_data();
+      ptr_load->size = ptr_load->file.get_size();
+    }
+    else
+    {
+      ptr_load->failed = true;
+    }
+
+    // decoding takes milliseconds, on the frame queue a burst of loads would hold up the frame's parallel_for
+    Jobs::submit_background([this, ptr_load]()
+    {
+      if (ptr_load->ptr_archive_entry)
+      {
+        const ArchiveEntry& entry = *ptr_load->ptr_archive_entry;
+        ptr_load->ptr_data = m_ptr_archive->get_data(entry);
+        ptr_load->size = entry.size;
+        if (ptr_load->ptr_data == nullptr)
+        {
+          ptr_load->failed = !m_ptr_archive->read(entry, ptr_load->decompressed);
+          ptr_load->ptr_data = ptr_load->decompressed.data();
+        }
+      }
+
+      if (!ptr_load->failed)
+      {
+        decode(*ptr_load);
+      }
+
+      std::lock_guard<std::mutex> lock{ m_decoded_mutex };
+      m_decoded.push_back(ptr_load);
+    }, &m_decode_counter);
+  }
+}
+
+void zv::StreamingSystem::decode(Load& load)
+{
+  using namespace Diligent;
+
+  const u8* ptr_data = load.ptr_data;
+  const u64 size = load.size;
+
+  if (load.type == eStreamAssetType::Texture)
+  {
+    // compressed containers (dds, ktx) reference the mapped data, images are decoded and get their mips generated here
+    TextureLoadInfo load_info;
+    load_info.Name         = load.path.c_str();
+    load_info.Usage        = USAGE_DEFAULT;
+    load_info.BindFlags    = BIND_SHADER_RESOURCE;
+    load_info.GenerateMips = true;
+    if (ptr_data != nullptr)
+    {
+      CreateTextureLoaderFromMemory(ptr_data, static_cast<size_t>(size), false, load_info, &load.ptr_texture_loader);
+    }
+    load.failed = load.ptr_texture_loader == nullptr;
+    return;
+  }
+
+  const auto* ptr_header = reinterpret_cast<const StreamMeshHeader*>(ptr_data);
+  if (size < sizeof(StreamMeshHeader) || ptr_header->magic != StreamMeshHeader::k_magic || ptr_header->version != StreamMeshHeader::k_version)
+  {
+    load.failed = true;
+    return;
+  }
+
+  const u64 vertex_bytes = u64(ptr_header->vertex_stride) * ptr_header->vertex_count;
+  const u64 index_bytes = u64(ptr_header->index_count) * sizeof(u32);
+  if (vertex_bytes == 0 || index_bytes == 0 || sizeof(StreamMeshHeader) + vertex_bytes + index_bytes > size)
+  {
+    load.failed = true;
+    return;
+  }
+
+  load.ptr_mesh_header = ptr_header;
+  load.ptr_vertices = ptr_data + sizeof(StreamMeshHeader);
+  load.ptr_indices = load.ptr_vertices + vertex_bytes;
+}
+
+void zv::StreamingSystem::update(IDeviceContext* ptr_context)
+{
+  ++m_frame_index;
+  m_frame_stats = FrameStats{};
+
+  m_decoded_scratch.clear();
+  {
+    std::lock_guard<std::mutex> lock{ m_decoded_mutex };
+    m_decoded_scratch.swap(m_decoded);
+  }
+
+  for (Load* ptr_load : m_decoded_scratch)
+  {
+    Asset& asset = m_assets[ptr_load->handle.index];
+    if (ptr_load->failed)
+    {
+      fail(asset);
+      continue;
+    }
+
+    asset.state = eStreamState::Uploading;
+    m_upload_queue.push_back(ptr_load->handle);
+  }
+
+  // Every frame uploads something, even if the next subresource alone exceeds the budget
+  u64 budget = m_params.upload_budget_bytes;
+  while (!m_upload_queue.empty() && budget > 0)
+  {
+    Asset& asset = m_assets[m_upload_queue.front().index];
+    const u64 budget_before = budget;
+    const bool done = upload(ptr_context, asset, budget);
+    m_frame_stats.uploaded_bytes += budget_before - budget;
+
+    if (!done)
+    {
+      if (asset.state == eStreamState::Failed)
+      {
+        m_upload_queue.pop_front();
+        continue;
+      }
+      break;
+    }
+
+    m_upload_queue.pop_front();
+    const Load& load = *asset.ptr_load;
+    m_ptr_resources->finish_load(asset.handle, load.ptr_texture ? RefCntAutoPtr<IObject>{ load.ptr_texture } : RefCntAutoPtr<IObject>{ load.ptr_buffer });
+    asset.state = eStreamState::Resident;
+    asset.ptr_load.reset();
+    m_resident_bytes += asset.resident_bytes;
+  }
+
+  for (Asset& asset : m_assets)
+  {
+    if (asset.state == eStreamState::Loading && asset.ptr_load == nullptr)
+    {
+      adopt(asset);
+    }
+  }
+
+  evict_over_budget();
+
+  m_frame_stats.resident_bytes = m_resident_bytes;
+  for (const Asset& asset : m_assets)
+  {
+    m_frame_stats.resident_count += asset.state == eStreamState::Resident;
+    m_frame_stats.loading_count += asset.state == eStreamState::Loading || asset.state == eStreamState::Uploading;
+  }
+}
+
+bool zv::StreamingSystem::upload(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget)
+{
+  return asset.type == eStreamAssetType::Texture ? upload_texture(ptr_context, asset, inout_budget) : upload_mesh(ptr_context, asset, inout_budget);
+}
+
+bool zv::StreamingSystem::upload_texture(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget)
+{
+  using namespace Diligent;
+
+  Load& load = *asset.ptr_load;
+  const TextureDesc& loader_desc = load.ptr_texture_loader->GetTextureDesc();
+
+  if (load.ptr_texture == nullptr)
+  {
+    // created empty, the subresources follow as the budget allows
+    TextureDesc desc = loader_desc;
+    desc.Name = asset.path.c_str();
+    m_ptr_device->CreateTexture(desc, nullptr, &load.ptr_texture);
+    if (load.ptr_texture == nullptr)
+    {
+      fail(asset);
+      return false;
+    }
+  }
+
+  const TextureFormatAttribs& format = GetTextureFormatAttribs(loader_desc.Format);
+  const u32 slice_count = loader_desc.Type == RESOURCE_DIM_TEX_3D ? 1 : loader_desc.ArraySize;
+  const u32 subresource_count = loader_desc.MipLevels * slice_count;
+
+  for (; load.next_subresource < subresource_count; ++load.next_subresource)
+  {
+    const u32 mip = load.next_subresource % loader_desc.MipLevels;
+    const u32 slice = load.next_subresource / loader_desc.MipLevels;
+    const u32 width = std::max(loader_desc.Width >> mip, 1u);
+    const u32 height = std::max(loader_desc.Height >> mip, 1u);
+    const u32 depth = loader_desc.Type == RESOURCE_DIM_TEX_3D ? std::max(loader_desc.Depth >> mip, 1u) : 1u;
+    const u32 rows = format.ComponentType == COMPONENT_TYPE_COMPRESSED ? (height + format.BlockHeight - 1) / format.BlockHeight : height;
+
+    const TextureSubResData& data = load.ptr_texture_loader->GetSubresourceData(mip, slice);
+    const u64 bytes = u64(data.Stride) * rows * depth;
+    // an untouched budget takes any subresource, so textures with mips larger than the budget still finish
+    if (bytes > inout_budget && inout_budget < m_params.upload_budget_bytes)
+    {
+      return false;
+    }
+
+    Box region{ 0, width, 0, height, 0, depth };
+    ptr_context->UpdateTexture(load.ptr_texture, mip, slice, region, data, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    inout_budget -= std::min(bytes, inout_budget);
+    asset.resident_bytes += bytes;
+  }
+
+  StateTransitionDesc barrier{ load.ptr_texture, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE };
+  ptr_context->TransitionResourceStates(1, &barrier);
+  return true;
+}
+
+bool zv::StreamingSystem::upload_mesh(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget)
+{
+  using namespace Diligent;
+
+  Load& load = *asset.ptr_load;
+  const StreamMeshHeader& header = *load.ptr_mesh_header;
+  const u64 vertex_bytes = u64(header.vertex_stride) * header.vertex_count;
+  const u64 index_bytes = u64(header.index_count) * sizeof(u32);
+  // index buffer bindings need offsets aligned to the index size
+  const u64 index_offset = (vertex_bytes + sizeof(u32) - 1) & ~u64(sizeof(u32) - 1);
+
+  // one buffer, so the mesh is one resource
+  if (load.ptr_buffer == nullptr)
+  {
+    BufferDesc desc;
+    desc.Name      = asset.path.c_str();
+    desc.Size      = index_offset + index_bytes;
+    desc.Usage     = USAGE_DEFAULT;
+    desc.BindFlags = BIND_VERTEX_BUFFER | BIND_INDEX_BUFFER;
+    m_ptr_device->CreateBuffer(desc, nullptr, &load.ptr_buffer);
+    if (load.ptr_buffer == nullptr)
+    {
+      fail(asset);
+      return false;
+    }
+  }
+
+  // vertex and index data are uploaded as one range, chunk by chunk
+  const u64 total_bytes = vertex_bytes + index_bytes;
+  while (load.next_byte < total_bytes)
+  {
+    if (inout_budget == 0)
+    {
+      return false;
+    }
+
+    const bool in_vertices = load.next_byte < vertex_bytes;
+    const u64 range_end = in_vertices ? vertex_bytes : total_bytes;
+    const u64 chunk = std::min({ range_end - load.next_byte, k_mesh_chunk_bytes, inout_budget });
+
+    if (in_vertices)
+    {
+      ptr_context->UpdateBuffer(load.ptr_buffer, load.next_byte, chunk, load.ptr_vertices + load.next_byte, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+    else
+    {
+      const u64 offset = load.next_byte - vertex_bytes;
+      ptr_context->UpdateBuffer(load.ptr_buffer, index_offset + offset, chunk, load.ptr_indices + offset, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+
+    load.next_byte += chunk;
+    inout_budget -= std::min(chunk, inout_budget);
+  }
+
+  StateTransitionDesc barrier{ load.ptr_buffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER | RESOURCE_STATE_INDEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE };
+  ptr_context->TransitionResourceStates(1, &barrier);
+
+  asset.index_offset = index_offset;
+  asset.index_count = header.index_count;
+  asset.resident_bytes = index_offset + index_bytes;
+  return true;
+}
+
+void zv::StreamingSystem::evict_over_budget()
+{
+  if (m_resident_bytes <= m_params.residency_budget_bytes)
+  {
+    return;
+  }
+
+  // least recently used first; assets touched since the previous update are in use and stay
+  std::vector<u32> candidates;
+  for (u32 index = 0; index < m_assets.size(); ++index)
+  {
+    const Asset& asset = m_assets[index];
+    if (asset.state == eStreamState::Resident && asset.last_used_frame + 1 < m_frame_index)
+    {
+      candidates.push_back(index);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [this](u32 a, u32 b)
+  {
+    return m_assets[a].last_used_frame < m_assets[b].last_used_frame;
+  });
+
+  // The resource manager drops released objects a few frames later, and the device keeps them alive until the GPU is
+  // done with them. Evicted assets keep their size for a request that comes before the sweep.
+  for (u32 index : candidates)
+  {
+    if (m_resident_bytes <= m_params.residency_budget_bytes)
+    {
+      break;
+    }
+
+    Asset& asset = m_assets[index];
+    m_resident_bytes -= asset.resident_bytes;
+    m_ptr_resources->release(asset.handle);
+    asset.state = eStreamState::Unloaded;
+    ++m_frame_stats.evicted_count;
+  }
+}
@@ -0,0 +1,195 @@
+/*
+ * StreamingSystem.h - asynchronous texture and mesh streaming with budgeted uploads and LRU residency
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Core/JobSystem.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/ResourceManager.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace zv
+{
+  class AssetArchive;
+
+  // the handle of the asset's resource in the ResourceManager
+  using StreamHandle = ResourceHandle;
+
+  enum class eStreamAssetType : u8
+  {
+    // any image format the Diligent texture loader reads (png, jpeg, dds, ktx, ...)
+    Texture,
+    // GPU-ready mesh file, see StreamMeshHeader; uploaded into one buffer that holds the vertices followed by the
+    // indices
+    Mesh,
+  };
+
+  enum class eStreamState : u8
+  {
+    Unloaded,
+    // read on the I/O thread, decoded on a worker
+    Loading,
+    // decoded, waiting for or in the middle of its upload
+    Uploading,
+    Resident,
+    Failed,
+  };
+
+  // Mesh files are uploaded as they are: the header is followed by vertex_count interleaved vertices of vertex_stride
+  // bytes and index_count u32 indices
+  struct StreamMeshHeader
+  {
+    static constexpr u32 k_magic = 0x534D565A; // "ZVMS"
+    static constexpr u32 k_version = 1;
+
+    u32 magic;
+    u32 version;
+    u32 vertex_stride;
+    u32 vertex_count;
+    u32 index_count;
+    u32 reserved;
+  };
+
+  // Loads assets without blocking the render thread:
+  //  - assets are resources of the ResourceManager under the resource id of their path, so requests for the same
+  //    asset (from streaming or anything else) share one load and one object
+  //  - a dedicated I/O thread memory-maps the files and faults their pages in; assets found in the mounted archive
+  //    are read from its mapping instead, without opening files
+  //  - decoding (image decompression, mip generation, mesh validation) runs on the job system's background queue
+  //  - update() creates the GPU objects and uploads at most upload_budget_bytes per frame; textures are uploaded one
+  //    subresource and meshes one chunk at a time, so large assets spread over several frames
+  //  - once resident assets exceed residency_budget_bytes, the least recently touched ones are evicted by releasing
+  //    their resources; requesting an evicted asset before the ResourceManager sweeps it makes it resident again,
+  //    afterwards it is streamed back in under a new handle
+  //
+  // All functions except the internal loading stages are called from the render thread.
+  class StreamingSystem : public NonCopyable
+  {
+  public:
+    struct CreateParams
+    {
+      u64 upload_budget_bytes{ 8ull << 20 };
+      u64 residency_budget_bytes{ 512ull << 20 };
+    };
+
+    struct FrameStats
+    {
+      u64 uploaded_bytes{ 0 };
+      u64 resident_bytes{ 0 };
+      u32 resident_count{ 0 };
+      u32 loading_count{ 0 };
+      u32 evicted_count{ 0 };
+    };
+
+  public:
+    // out of line, the assets own loads of a type that is only complete in the source file
+    StreamingSystem();
+    ~StreamingSystem();
+
+  public:
+    // the resource manager must outlive the streaming system
+    bool create(IRenderDevice* ptr_device, ResourceManager* ptr_resources, const CreateParams& params);
+    void destroy();
+
+    // Assets are looked up in the archive before the file system; must not be changed while loads are in flight
+    void set_archive(const AssetArchive* ptr_archive);
+
+    // Returns the handle of the asset at path, the same path maps to the same handle until the asset is evicted and
+    // swept; paths are compared by their resource id, so differently spelled paths of one file share it. Unloaded (or
+    // evicted) assets are queued for streaming.
+    StreamHandle request(const char* path, eStreamAssetType type);
+    // keeps a resident asset from being evicted by the next update()
+    void touch(StreamHandle handle);
+
+    // Unloaded for handles of evicted assets
+    eStreamState get_state(StreamHandle handle) const;
+    // null until the asset is resident; these resolve the handle in the ResourceManager, so call them once per frame
+    ITexture* get_texture(StreamHandle handle) const;
+    // vertices start at offset 0, indices at get_index_offset()
+    IBuffer* get_mesh_buffer(StreamHandle handle) const;
+    u64 get_index_offset(StreamHandle handle) const;
+    u32 get_index_count(StreamHandle handle) const;
+
+    // Uploads decoded assets within the budget and evicts over budget; call once per frame before the assets are used
+    void update(IDeviceContext* ptr_context);
+
+    const FrameStats& get_frame_stats() const { return m_frame_stats; }
+
+  private:
+    struct Load;
+
+    // Indexed by the slot of the asset's resource; a slot holds its asset until the resource is swept and the slot is
+    // handed out again
+    struct Asset
+    {
+      // holds one reference to the resource unless the asset is Unloaded
+      StreamHandle handle;
+      std::string path;
+      eStreamAssetType type{ eStreamAssetType::Texture };
+      eStreamState state{ eStreamState::Unloaded };
+      u64 resident_bytes{ 0 };
+      u64 last_used_frame{ 0 };
+
+      u64 index_offset{ 0 };
+      u32 index_count{ 0 };
+
+      // owned by the render thread, but only touched by it outside of the Loading state; null for assets whose
+      // resource was loaded elsewhere
+      std::unique_ptr<Load> ptr_load;
+    };
+
+    // null for handles that do not belong to a streamed asset (anymore)
+    const Asset* find(StreamHandle handle) const;
+    // takes over a resource that another request loaded or is loading; false while it is still loading
+    bool adopt(Asset& asset);
+    // fails the asset's resource and drops its load
+    void fail(Asset& asset);
+
+    void io_thread_main();
+    // runs on a worker
+    static void decode(Load& load);
+
+    // returns false if the budget ran out before the asset was complete
+    bool upload(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget);
+    bool upload_texture(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget);
+    bool upload_mesh(IDeviceContext* ptr_context, Asset& asset, u64& inout_budget);
+    void evict_over_budget();
+
+  private:
+    RefCntAutoPtr<IRenderDevice> m_ptr_device;
+    ResourceManager* m_ptr_resources{ nullptr };
+    CreateParams m_params;
+    const AssetArchive* m_ptr_archive{ nullptr };
+
+    std::vector<Asset> m_assets;
+    // uploads in request order
+    std::deque<StreamHandle> m_upload_queue;
+    u64 m_frame_index{ 0 };
+    u64 m_resident_bytes{ 0 };
+    FrameStats m_frame_stats;
+
+    // I/O thread input
+    std::thread m_io_thread;
+    std::mutex m_read_mutex;
+    std::condition_variable m_read_cv;
+    std::deque<Load*> m_read_queue;
+    bool m_quit{ false };
+
+    // loads that finished decoding (or failed), picked up by update()
+    std::mutex m_decoded_mutex;
+    std::vector<Load*> m_decoded;
+    std::vector<Load*> m_decoded_scratch;
+    Jobs::Counter m_decode_counter;
+  };
+}
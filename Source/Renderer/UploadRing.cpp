@@ -0,0 +1,146 @@
+/*
+ * UploadRing.cpp - ring-buffered dynamic GPU buffer for per-frame uploads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/UploadRing.h>
+
+#include <cstring>
+
+#include <Core/Logger.h>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h>
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h>
+
+
+zv::UploadRing::~UploadRing()
+{
+  destroy();
+}
+
+bool zv::UploadRing::create(IRenderDevice* ptr_device, const char* name, u64 capacity, u32 bind_flags, bool discard_each_frame)
+{
+  using namespace Diligent;
+
+  destroy();
+
+  BufferDesc desc;
+  desc.Name           = name;
+  desc.Size           = capacity;
+  desc.Usage          = USAGE_DYNAMIC;
+  desc.BindFlags      = static_cast<BIND_FLAGS>(bind_flags);
+  desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+  ptr_device->CreateBuffer(desc, nullptr, &m_ptr_buffer);
+
+  if (m_ptr_buffer == nullptr)
+  {
+    ZV_ERROR("Failed to create upload ring '{}' ({} bytes).", name, capacity);
+    return false;
+  }
+
+  m_capacity = capacity;
+  m_head = 0;
+  m_frame_bytes = 0;
+  m_discard_each_frame = discard_each_frame;
+  m_discard_pending = true;
+
+  return true;
+}
+
+void zv::UploadRing::destroy()
+{
+  m_ptr_buffer = nullptr;
+  m_capacity = 0;
+  m_head = 0;
+  m_frame_bytes = 0;
+  m_discard_pending = true;
+}
+
+void zv::UploadRing::begin_frame()
+{
+  m_frame_bytes = 0;
+
+  if (m_discard_each_frame)
+  {
+    m_head = 0;
+    m_discard_pending = true;
+  }
+}
+
+bool zv::UploadRing::reserve(u64 size, u64 alignment, Allocation& out_allocation)
+{
+  ZV_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+  if (size > m_capacity)
+  {
+    return false;
+  }
+
+  u64 offset = (m_head + alignment - 1) & ~(alignment - 1);
+  bool discard = m_discard_pending;
+
+  if (offset + size > m_capacity)
+  {
+    if (m_discard_each_frame)
+    {
+      // a second discard within a frame would orphan data that this frame's commands still reference
+      return false;
+    }
+
+    // wrap around; the discard renames the buffer, so ranges in flight keep their old memory
+    discard = true;
+  }
+
+  if (discard)
+  {
+    offset = 0;
+  }
+
+  m_frame_bytes += discard ? size : offset + size - m_head;
+  m_head = offset + size;
+  m_discard_pending = false;
+
+  out_allocation.offset = offset;
+  out_allocation.discard = discard;
+  return true;
+}
+
+void* zv::UploadRing::map(IDeviceContext* ptr_context, const Allocation& allocation)
+{
+  using namespace Diligent;
+
+  void* ptr_data = nullptr;
+  ptr_context->MapBuffer(m_ptr_buffer, MAP_WRITE, allocation.discard ? MAP_FLAG_DISCARD : MAP_FLAG_NO_OVERWRITE, ptr_data);
+  if (ptr_data == nullptr)
+  {
+    return nullptr;
+  }
+
+  return static_cast<u8*>(ptr_data) + allocation.offset;
+}
+
+void zv::UploadRing::unmap(IDeviceContext* ptr_context)
+{
+  ptr_context->UnmapBuffer(m_ptr_buffer, Diligent::MAP_WRITE);
+}
+
+bool zv::UploadRing::write(IDeviceContext* ptr_context, const void* ptr_data, u64 size, u64 alignment, u64& out_offset)
+{
+  Allocation allocation;
+  if (!reserve(size, alignment, allocation))
+  {
+    return false;
+  }
+
+  void* ptr_dst = map(ptr_context, allocation);
+  if (ptr_dst == nullptr)
+  {
+    return false;
+  }
+
+  std::memcpy(ptr_dst, ptr_data, size);
+  unmap(ptr_context);
+
+  out_offset = allocation.offset;
+  return true;
+}
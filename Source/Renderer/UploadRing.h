@@ -0,0 +1,65 @@
+/*
+ * UploadRing.h - ring-buffered dynamic GPU buffer for per-frame uploads
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <RendererDecl.h>
+
+namespace zv
+{
+  // Sub-allocates a dynamic buffer front to back. Every write maps it with MAP_FLAG_NO_OVERWRITE, so the CPU never waits
+  // for the GPU; MAP_FLAG_DISCARD is only used for the very first map and whenever the ring wraps around, which hands out
+  // fresh memory while the GPU is still reading the old one.
+  //
+  // Backends with a per-frame dynamic heap (D3D12, Vulkan) drop dynamic buffer contents at the end of each frame and
+  // require a discard before the first no-overwrite map of a frame. With discard_each_frame the ring restarts every
+  // frame instead of wrapping, so capacity is the per-frame budget.
+  class UploadRing : public NonCopyable
+  {
+  public:
+    struct Allocation
+    {
+      u64 offset{ 0 };
+      bool discard{ false };
+    };
+
+  public:
+    UploadRing() = default;
+    ~UploadRing();
+
+  public:
+    // bind_flags are Diligent BIND_FLAGS, the ring can be used as copy source in any case
+    bool create(IRenderDevice* ptr_device, const char* name, u64 capacity, u32 bind_flags, bool discard_each_frame);
+    void destroy();
+
+    void begin_frame();
+
+    // bookkeeping only; returns false if the allocation does not fit into the buffer (or the current frame)
+    bool reserve(u64 size, u64 alignment, Allocation& out_allocation);
+
+    // maps, returns the write pointer of a reserved range, and unmap() has to follow before the range is used
+    void* map(IDeviceContext* ptr_context, const Allocation& allocation);
+    void unmap(IDeviceContext* ptr_context);
+
+    // reserve + map + copy + unmap
+    bool write(IDeviceContext* ptr_context, const void* ptr_data, u64 size, u64 alignment, u64& out_offset);
+
+    IBuffer* get_buffer() const { return m_ptr_buffer; }
+    u64 get_capacity() const { return m_capacity; }
+    // bytes handed out since begin_frame(), including alignment padding
+    u64 get_frame_bytes() const { return m_frame_bytes; }
+
+  private:
+    RefCntAutoPtr<IBuffer> m_ptr_buffer;
+
+    u64 m_capacity{ 0 };
+    u64 m_head{ 0 };
+    u64 m_frame_bytes{ 0 };
+    bool m_discard_each_frame{ false };
+    bool m_discard_pending{ true };
+  };
+}
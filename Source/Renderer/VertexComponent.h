@@ -0,0 +1,38 @@
+/*
+ * VertexComponent.h - vertex attribute flags and the strides of their float and quantized encodings
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Core/PrimitiveTypes.h>
+
+namespace zv
+{
+  using VertexComponentFlags = u32;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_NONE     = 0;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_POSITION = 1u << 0;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_NORMAL   = 1u << 1;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_UV       = 1u << 2;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_POS_UV        = VERTEX_COMPONENT_FLAG_POSITION | VERTEX_COMPONENT_FLAG_UV;
+  constexpr VertexComponentFlags VERTEX_COMPONENT_FLAG_POS_NORM_UV   = VERTEX_COMPONENT_FLAG_POS_UV | VERTEX_COMPONENT_FLAG_NORMAL;
+
+  // Components are interleaved in the order position, normal, uv
+  enum class eVertexEncoding : u8
+  {
+    // float3 position, float3 normal, float2 uv
+    Float,
+    // 4 x unorm16 position relative to the mesh bounds (w is padding), 2 x snorm16 octahedral normal, 2 x half uv
+    Quantized,
+  };
+
+  constexpr u32 get_vertex_stride(VertexComponentFlags components, eVertexEncoding encoding)
+  {
+    const bool quantized = encoding == eVertexEncoding::Quantized;
+    u32 stride = 0;
+    stride += (components & VERTEX_COMPONENT_FLAG_POSITION) ? (quantized ? 8 : 12) : 0;
+    stride += (components & VERTEX_COMPONENT_FLAG_NORMAL) ? (quantized ? 4 : 12) : 0;
+    stride += (components & VERTEX_COMPONENT_FLAG_UV) ? (quantized ? 4 : 8) : 0;
+    return stride;
+  }
+}
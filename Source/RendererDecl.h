@@ -10,9 +10,13 @@ namespace Diligent
   class IRenderDevice;
   class IDeviceContext;
   class ISwapChain;
+  class IObject;
+  class IDeviceObject;
   class IPipelineState;
   class IBuffer;
+  class IBufferView;
   class IShaderResourceBinding;
+  class ICommandList;
   class ITexture;
   class ITextureView;
   class IShaderSourceInputStreamFactory;
@@ -21,7 +25,7 @@ namespace Diligent
 
   enum TEXTURE_VIEW_TYPE : unsigned char;
   enum TEXTURE_FORMAT : u16;
-  enum RENDER_DEVICE_TYPE;
+  enum RENDER_DEVICE_TYPE : u8;
 
   struct SwapChainDesc;
   struct Win32NativeWindow;
@@ -38,9 +42,13 @@ namespace zv
   using IRenderDevice          = Diligent::IRenderDevice;
   using IDeviceContext         = Diligent::IDeviceContext;
   using ISwapChain             = Diligent::ISwapChain;
+  using IObject                = Diligent::IObject;
+  using IDeviceObject          = Diligent::IDeviceObject;
   using IPipelineState         = Diligent::IPipelineState;
   using IBuffer                = Diligent::IBuffer;
+  using IBufferView            = Diligent::IBufferView;
   using IShaderResourceBinding = Diligent::IShaderResourceBinding;
+  using ICommandList           = Diligent::ICommandList;
   using ITexture               = Diligent::ITexture;
   using ITextureView           = Diligent::ITextureView;
   using IShaderSourceInputStreamFactory = Diligent::IShaderSourceInputStreamFactory;
@@ -0,0 +1,541 @@
+/*
+ * Bvh.cpp - bounding volume hierarchy for spatial queries and hierarchical culling
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Scene/Bvh.h>
+#include <Core/Logger.h>
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+static const u32 k_max_bin_count = 32;
+// Nodes this deep are not split any further, whatever their primitive count. That bounds the traversal stacks: going
+// depth first, a traversal holds at most one pending sibling per level plus the two children it just pushed.
+static const u32 k_max_depth = 64;
+static const u32 k_traversal_stack_size = k_max_depth + 1;
+
+namespace
+{
+  inline f32 surface_area(const f32* min, const f32* max)
+  {
+    const f32 dx = max[0] - min[0];
+    const f32 dy = max[1] - min[1];
+    const f32 dz = max[2] - min[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+  }
+
+  struct Bin
+  {
+    f32 min[3] = { std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max() };
+    f32 max[3] = { std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest() };
+    u32 count = 0;
+
+    void grow(const f32* other_min, const f32* other_max)
+    {
+      for (u32 axis = 0; axis < 3; ++axis)
+      {
+        min[axis] = std::min(min[axis], other_min[axis]);
+        max[axis] = std::max(max[axis], other_max[axis]);
+      }
+    }
+
+    f32 area() const { return count > 0 ? surface_area(min, max) : 0.0f; }
+  };
+
+  inline u32 get_bin_index(f32 centroid, f32 centroid_min, f32 scale, u32 bin_count)
+  {
+    const s64 bin = static_cast<s64>((centroid - centroid_min) * scale);
+    return static_cast<u32>(std::clamp<s64>(bin, 0, bin_count - 1));
+  }
+
+  inline void get_bounds(const zv::AabbSoA& aabbs, u32 i, f32* min, f32* max)
+  {
+    min[0] = aabbs.center_x[i] - aabbs.extent_x[i]; max[0] = aabbs.center_x[i] + aabbs.extent_x[i];
+    min[1] = aabbs.center_y[i] - aabbs.extent_y[i]; max[1] = aabbs.center_y[i] + aabbs.extent_y[i];
+    min[2] = aabbs.center_z[i] - aabbs.extent_z[i]; max[2] = aabbs.center_z[i] + aabbs.extent_z[i];
+  }
+
+  inline f32 get_center(const zv::AabbSoA& aabbs, u32 i, u32 axis)
+  {
+    return axis == 0 ? aabbs.center_x[i] : (axis == 1 ? aabbs.center_y[i] : aabbs.center_z[i]);
+  }
+
+  inline void swap_aabbs(zv::AabbSoA& aabbs, u32 a, u32 b)
+  {
+    std::swap(aabbs.center_x[a], aabbs.center_x[b]); std::swap(aabbs.center_y[a], aabbs.center_y[b]); std::swap(aabbs.center_z[a], aabbs.center_z[b]);
+    std::swap(aabbs.extent_x[a], aabbs.extent_x[b]); std::swap(aabbs.extent_y[a], aabbs.extent_y[b]); std::swap(aabbs.extent_z[a], aabbs.extent_z[b]);
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Construction
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void zv::Bvh::build(const AabbSoA& prims, const BuildParams& params)
+{
+  clear();
+
+  const u32 prim_count = prims.size();
+  if (prim_count == 0)
+  {
+    return;
+  }
+
+  m_params = params;
+  m_params.bin_count = std::clamp(m_params.bin_count, 2u, k_max_bin_count);
+  m_params.min_leaf_size = std::max(m_params.min_leaf_size, 1u);
+  m_params.max_leaf_size = std::max(m_params.max_leaf_size, m_params.min_leaf_size);
+
+  m_prim_indices.resize(prim_count);
+  std::iota(m_prim_indices.begin(), m_prim_indices.end(), 0u);
+  copy_prim_bounds(prims);
+
+  m_nodes.reserve(2 * prim_count);
+  m_nodes.push_back(BvhNode{ {}, 0, {}, prim_count });
+  update_node_bounds(0);
+
+  struct BuildEntry
+  {
+    u32 node_index;
+    u32 depth;
+  };
+
+  std::vector<BuildEntry> stack{ BuildEntry{ 0, 0 } };
+  while (!stack.empty())
+  {
+    const BuildEntry entry = stack.back();
+    stack.pop_back();
+
+    m_depth = std::max(m_depth, entry.depth);
+    if (entry.depth == k_max_depth)
+    {
+      continue;
+    }
+
+    const u32 node_count_before = static_cast<u32>(m_nodes.size());
+    subdivide(entry.node_index);
+    for (u32 child = node_count_before; child < m_nodes.size(); ++child)
+    {
+      stack.push_back(BuildEntry{ child, entry.depth + 1 });
+    }
+  }
+
+  m_build_cost = compute_sah_cost();
+}
+
+/*
+ * Splits a leaf at the cheapest binned SAH plane, or keeps it as a leaf when splitting does not pay off.
+ */
+void zv::Bvh::subdivide(u32 node_index)
+{
+  const BvhNode node = m_nodes[node_index];
+  if (node.prim_count <= m_params.min_leaf_size)
+  {
+    return;
+  }
+
+  // bounds of the primitive centroids
+  f32 centroid_min[3] = { std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max() };
+  f32 centroid_max[3] = { std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest() };
+  for (u32 i = node.first_index; i < node.first_index + node.prim_count; ++i)
+  {
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+      const f32 centroid = get_center(m_prim_aabbs, i, axis);
+      centroid_min[axis] = std::min(centroid_min[axis], centroid);
+      centroid_max[axis] = std::max(centroid_max[axis], centroid);
+    }
+  }
+
+  const u32 bin_count = m_params.bin_count;
+  f32 best_cost = std::numeric_limits<f32>::max();
+  u32 best_axis = 0;
+  u32 best_split = 0;
+
+  for (u32 axis = 0; axis < 3; ++axis)
+  {
+    const f32 extent = centroid_max[axis] - centroid_min[axis];
+    if (extent <= 0.0f)
+    {
+      continue;
+    }
+
+    Bin bins[k_max_bin_count];
+    const f32 scale = bin_count / extent;
+    for (u32 i = node.first_index; i < node.first_index + node.prim_count; ++i)
+    {
+      f32 min[3], max[3];
+      get_bounds(m_prim_aabbs, i, min, max);
+      Bin& bin = bins[get_bin_index(get_center(m_prim_aabbs, i, axis), centroid_min[axis], scale, bin_count)];
+      bin.grow(min, max);
+      ++bin.count;
+    }
+
+    // sweep from both sides to get the area and count left and right of every split plane
+    f32 left_area[k_max_bin_count - 1], right_area[k_max_bin_count - 1];
+    u32 left_count[k_max_bin_count - 1], right_count[k_max_bin_count - 1];
+    Bin left_box, right_box;
+    u32 left_sum = 0, right_sum = 0;
+    for (u32 i = 0; i < bin_count - 1; ++i)
+    {
+      left_sum += bins[i].count;
+      left_count[i] = left_sum;
+      if (bins[i].count > 0) { left_box.grow(bins[i].min, bins[i].max); left_box.count = left_sum; }
+      left_area[i] = left_box.area();
+
+      const u32 right_bin = bin_count - 1 - i;
+      right_sum += bins[right_bin].count;
+      right_count[right_bin - 1] = right_sum;
+      if (bins[right_bin].count > 0) { right_box.grow(bins[right_bin].min, bins[right_bin].max); right_box.count = right_sum; }
+      right_area[right_bin - 1] = right_box.area();
+    }
+
+    for (u32 i = 0; i < bin_count - 1; ++i)
+    {
+      const f32 cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+      if (left_count[i] > 0 && right_count[i] > 0 && cost < best_cost)
+      {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = i;
+      }
+    }
+  }
+
+  const f32 node_area = surface_area(node.min, node.max);
+  const f32 leaf_cost = m_params.intersection_cost * node.prim_count * node_area;
+  const f32 split_cost = m_params.traversal_cost * node_area + m_params.intersection_cost * best_cost;
+  const bool no_split_found = best_cost == std::numeric_limits<f32>::max();
+  if (no_split_found || (node.prim_count <= m_params.max_leaf_size && split_cost >= leaf_cost))
+  {
+    return;
+  }
+
+  // partition the primitive range in place
+  const f32 scale = bin_count / (centroid_max[best_axis] - centroid_min[best_axis]);
+  u32 i = node.first_index;
+  u32 j = node.first_index + node.prim_count;
+  while (i < j)
+  {
+    if (get_bin_index(get_center(m_prim_aabbs, i, best_axis), centroid_min[best_axis], scale, bin_count) <= best_split)
+    {
+      ++i;
+    }
+    else
+    {
+      --j;
+      std::swap(m_prim_indices[i], m_prim_indices[j]);
+      swap_aabbs(m_prim_aabbs, i, j);
+    }
+  }
+
+  const u32 left_prim_count = i - node.first_index;
+  ZV_ASSERT(left_prim_count > 0 && left_prim_count < node.prim_count);
+
+  const u32 left_index = static_cast<u32>(m_nodes.size());
+  m_nodes.push_back(BvhNode{ {}, node.first_index, {}, left_prim_count });
+  m_nodes.push_back(BvhNode{ {}, i, {}, node.prim_count - left_prim_count });
+  m_nodes[node_index].first_index = left_index;
+  m_nodes[node_index].prim_count = 0;
+
+  update_node_bounds(left_index);
+  update_node_bounds(left_index + 1);
+}
+
+void zv::Bvh::copy_prim_bounds(const AabbSoA& prims)
+{
+  const u32 prim_count = static_cast<u32>(m_prim_indices.size());
+  m_prim_aabbs.resize(prim_count);
+  for (u32 i = 0; i < prim_count; ++i)
+  {
+    const u32 prim = m_prim_indices[i];
+    m_prim_aabbs.center_x[i] = prims.center_x[prim]; m_prim_aabbs.center_y[i] = prims.center_y[prim]; m_prim_aabbs.center_z[i] = prims.center_z[prim];
+    m_prim_aabbs.extent_x[i] = prims.extent_x[prim]; m_prim_aabbs.extent_y[i] = prims.extent_y[prim]; m_prim_aabbs.extent_z[i] = prims.extent_z[prim];
+  }
+}
+
+void zv::Bvh::update_node_bounds(u32 node_index)
+{
+  BvhNode& node = m_nodes[node_index];
+  Bin bounds;
+
+  if (node.is_leaf())
+  {
+    for (u32 i = node.first_index; i < node.first_index + node.prim_count; ++i)
+    {
+      f32 min[3], max[3];
+      get_bounds(m_prim_aabbs, i, min, max);
+      bounds.grow(min, max);
+    }
+  }
+  else
+  {
+    const BvhNode& left = m_nodes[node.first_index];
+    const BvhNode& right = m_nodes[node.first_index + 1];
+    bounds.grow(left.min, left.max);
+    bounds.grow(right.min, right.max);
+  }
+
+  std::copy(bounds.min, bounds.min + 3, node.min);
+  std::copy(bounds.max, bounds.max + 3, node.max);
+}
+
+void zv::Bvh::refit(const AabbSoA& prims)
+{
+  ZV_ASSERT(prims.size() == m_prim_indices.size());
+
+  copy_prim_bounds(prims);
+
+  // children are always stored after their parent, so a reverse sweep visits them first
+  for (size_t i = m_nodes.size(); i-- > 0;)
+  {
+    update_node_bounds(static_cast<u32>(i));
+  }
+}
+
+bool zv::Bvh::update(const AabbSoA& prims, f32 max_cost_ratio)
+{
+  if (prims.size() != m_prim_indices.size() || m_nodes.empty())
+  {
+    build(prims, m_params);
+    return true;
+  }
+
+  refit(prims);
+  if (compute_sah_cost() > m_build_cost * max_cost_ratio)
+  {
+    build(prims, m_params);
+    return true;
+  }
+
+  return false;
+}
+
+void zv::Bvh::clear()
+{
+  m_nodes.clear();
+  m_prim_indices.clear();
+  m_prim_aabbs.clear();
+  m_build_cost = 0.0f;
+  m_depth = 0;
+}
+
+f32 zv::Bvh::compute_sah_cost() const
+{
+  if (m_nodes.empty())
+  {
+    return 0.0f;
+  }
+
+  f32 cost = 0.0f;
+  for (const BvhNode& node : m_nodes)
+  {
+    const f32 area = surface_area(node.min, node.max);
+    cost += node.is_leaf() ? m_params.intersection_cost * node.prim_count * area : m_params.traversal_cost * area;
+  }
+
+  const f32 root_area = surface_area(m_nodes[0].min, m_nodes[0].max);
+  return root_area > 0.0f ? cost / root_area : cost;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------
+// Queries
+//------------------------------------------------------------------------------------------------------------------------------------
+
+void zv::Bvh::query_frustum(const Frustum& frustum, std::vector<u32>& out_prims) const
+{
+  if (m_nodes.empty())
+  {
+    return;
+  }
+
+  struct Entry
+  {
+    u32 node_index;
+    // planes the node still straddles
+    u32 plane_mask;
+  };
+
+  const u32 k_all_planes = (1u << Frustum::Count) - 1;
+  const FrustumPlanesSoA planes = transpose_frustum(frustum);
+  Entry stack[k_traversal_stack_size];
+  u32 stack_size = 0;
+  stack[stack_size++] = Entry{ 0, k_all_planes };
+
+  while (stack_size > 0)
+  {
+    const Entry entry = stack[--stack_size];
+    const BvhNode& node = m_nodes[entry.node_index];
+
+    u32 plane_mask = entry.plane_mask;
+    if (plane_mask != 0)
+    {
+      const Vector3 center{ 0.5f * (node.min[0] + node.max[0]), 0.5f * (node.min[1] + node.max[1]), 0.5f * (node.min[2] + node.max[2]) };
+      const Vector3 extent{ 0.5f * (node.max[0] - node.min[0]), 0.5f * (node.max[1] - node.min[1]), 0.5f * (node.max[2] - node.min[2]) };
+      if (!classify_aabb(planes, center, extent, plane_mask))
+      {
+        continue;
+      }
+    }
+
+    if (node.is_leaf())
+    {
+      if (plane_mask == 0)
+      {
+        out_prims.insert(out_prims.end(), m_prim_indices.begin() + node.first_index, m_prim_indices.begin() + node.first_index + node.prim_count);
+        continue;
+      }
+
+      // the leaf culls its range of the leaf-ordered boxes and maps the survivors back to primitive indices
+      const size_t offset = out_prims.size();
+      out_prims.resize(offset + node.prim_count);
+      const u32 visible_count = cull_aabbs(frustum, m_prim_aabbs, node.first_index, node.first_index + node.prim_count, out_prims.data() + offset);
+      for (size_t i = offset; i < offset + visible_count; ++i)
+      {
+        out_prims[i] = m_prim_indices[out_prims[i]];
+      }
+      out_prims.resize(offset + visible_count);
+    }
+    else
+    {
+      ZV_ASSERT(stack_size + 2 <= k_traversal_stack_size);
+      stack[stack_size++] = Entry{ node.first_index + 1, plane_mask };
+      stack[stack_size++] = Entry{ node.first_index, plane_mask };
+    }
+  }
+}
+
+void zv::Bvh::query_aabb(const Vector3& center, const Vector3& extent, std::vector<u32>& out_prims) const
+{
+  if (m_nodes.empty())
+  {
+    return;
+  }
+
+  const f32 query_min[3] = { center.x - extent.x, center.y - extent.y, center.z - extent.z };
+  const f32 query_max[3] = { center.x + extent.x, center.y + extent.y, center.z + extent.z };
+  auto overlaps = [&](const f32* min, const f32* max)
+  {
+    return min[0] <= query_max[0] && max[0] >= query_min[0] &&
+           min[1] <= query_max[1] && max[1] >= query_min[1] &&
+           min[2] <= query_max[2] && max[2] >= query_min[2];
+  };
+
+  u32 stack[k_traversal_stack_size];
+  u32 stack_size = 0;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0)
+  {
+    const BvhNode& node = m_nodes[stack[--stack_size]];
+    if (!overlaps(node.min, node.max))
+    {
+      continue;
+    }
+
+    if (node.is_leaf())
+    {
+      for (u32 i = node.first_index; i < node.first_index + node.prim_count; ++i)
+      {
+        f32 min[3], max[3];
+        get_bounds(m_prim_aabbs, i, min, max);
+        if (overlaps(min, max))
+        {
+          out_prims.push_back(m_prim_indices[i]);
+        }
+      }
+    }
+    else
+    {
+      ZV_ASSERT(stack_size + 2 <= k_traversal_stack_size);
+      stack[stack_size++] = node.first_index + 1;
+      stack[stack_size++] = node.first_index;
+    }
+  }
+}
+
+bool zv::Bvh::raycast(const Vector3& origin, const Vector3& direction, f32 max_distance, BvhRayHit& out_hit) const
+{
+  if (m_nodes.empty())
+  {
+    return false;
+  }
+
+  const f32 ray_origin[3] = { origin.x, origin.y, origin.z };
+  const f32 rcp_direction[3] = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+  // slab test; returns the entry distance or infinity on a miss
+  auto intersect = [&](const f32* min, const f32* max, f32 closest)
+  {
+    f32 t_min = 0.0f;
+    f32 t_max = closest;
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+      const f32 t0 = (min[axis] - ray_origin[axis]) * rcp_direction[axis];
+      const f32 t1 = (max[axis] - ray_origin[axis]) * rcp_direction[axis];
+      t_min = std::max(t_min, std::min(t0, t1));
+      t_max = std::min(t_max, std::max(t0, t1));
+    }
+    return t_min <= t_max ? t_min : std::numeric_limits<f32>::infinity();
+  };
+
+  f32 closest = max_distance;
+  BvhRayHit hit;
+
+  u32 stack[k_traversal_stack_size];
+  u32 stack_size = 0;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0)
+  {
+    const BvhNode& node = m_nodes[stack[--stack_size]];
+
+    if (node.is_leaf())
+    {
+      for (u32 i = node.first_index; i < node.first_index + node.prim_count; ++i)
+      {
+        f32 min[3], max[3];
+        get_bounds(m_prim_aabbs, i, min, max);
+        const f32 t = intersect(min, max, closest);
+        if (t < closest)
+        {
+          closest = t;
+          hit = BvhRayHit{ m_prim_indices[i], t };
+        }
+      }
+      continue;
+    }
+
+    // visit the nearer child first so the farther one is more likely to be rejected
+    u32 near_child = node.first_index;
+    u32 far_child = node.first_index + 1;
+    f32 near_t = intersect(m_nodes[near_child].min, m_nodes[near_child].max, closest);
+    f32 far_t = intersect(m_nodes[far_child].min, m_nodes[far_child].max, closest);
+    if (far_t < near_t)
+    {
+      std::swap(near_child, far_child);
+      std::swap(near_t, far_t);
+    }
+
+    ZV_ASSERT(stack_size + 2 <= k_traversal_stack_size);
+    if (far_t < closest)
+    {
+      stack[stack_size++] = far_child;
+    }
+    if (near_t < closest)
+    {
+      stack[stack_size++] = near_child;
+    }
+  }
+
+  if (hit.prim_index == ~0u)
+  {
+    return false;
+  }
+
+  out_hit = hit;
+  return true;
+}
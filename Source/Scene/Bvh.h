@@ -0,0 +1,94 @@
+/*
+ * Bvh.h - bounding volume hierarchy for spatial queries and hierarchical culling
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Renderer/Culling.h>
+#include <MathDefines.h>
+
+namespace zv
+{
+  // 32 byte node, two per cache line. Interior nodes store the index of their first child in first_index, the second
+  // child directly follows it. Leaves store the range [first_index, first_index + prim_count) of the primitive list.
+  struct BvhNode
+  {
+    f32 min[3];
+    u32 first_index;
+    f32 max[3];
+    u32 prim_count;
+
+    bool is_leaf() const { return prim_count != 0; }
+  };
+
+  struct BvhRayHit
+  {
+    u32 prim_index{ ~0u };
+    f32 distance{ 0.0f };
+  };
+
+  // Built with a binned surface area heuristic over the primitive boxes. Dynamic content is kept up to date by refitting
+  // the node bounds, with a full rebuild once the refitted tree has degraded too far.
+  class Bvh
+  {
+  public:
+    struct BuildParams
+    {
+      u32 bin_count{ 16 };
+      // leaves up to min_leaf_size primitives are never split, leaves above max_leaf_size are always split if possible,
+      // unless they reached the maximum depth
+      u32 min_leaf_size{ 4 };
+      u32 max_leaf_size{ 8 };
+      // relative SAH cost of intersecting a primitive compared to traversing a node
+      f32 intersection_cost{ 1.0f };
+      f32 traversal_cost{ 1.0f };
+    };
+
+  public:
+    Bvh() = default;
+
+  public:
+    void build(const AabbSoA& prims, const BuildParams& params);
+    void build(const AabbSoA& prims) { build(prims, BuildParams{}); }
+    // updates all node bounds for moved primitives; the primitive count must not change
+    void refit(const AabbSoA& prims);
+    // refits, and rebuilds when the SAH cost grew beyond max_cost_ratio times the cost after the last build or when the
+    // primitive count changed; returns true if the tree was rebuilt
+    bool update(const AabbSoA& prims, f32 max_cost_ratio = 1.5f);
+    void clear();
+
+    // appends the indices of all primitives whose boxes intersect the frustum; nodes are tested against all planes at once
+    // and subtrees fully inside are accepted without further plane tests, leaves cull their primitives four at a time
+    void query_frustum(const Frustum& frustum, std::vector<u32>& out_prims) const;
+    // appends the indices of all primitives whose boxes overlap the given box
+    void query_aabb(const Vector3& center, const Vector3& extent, std::vector<u32>& out_prims) const;
+    // nearest primitive box hit along the ray within max_distance; direction does not need to be normalized
+    bool raycast(const Vector3& origin, const Vector3& direction, f32 max_distance, BvhRayHit& out_hit) const;
+
+    f32 compute_sah_cost() const;
+
+    // depth of the deepest leaf, the root has depth 0; nodes at depth 64 are not split any further
+    u32 get_depth() const { return m_depth; }
+    u32 get_node_count() const { return static_cast<u32>(m_nodes.size()); }
+    u32 get_prim_count() const { return static_cast<u32>(m_prim_indices.size()); }
+    const BvhNode* get_nodes() const { return m_nodes.data(); }
+
+  private:
+    void subdivide(u32 node_index);
+    void copy_prim_bounds(const AabbSoA& prims);
+    void update_node_bounds(u32 node_index);
+
+  private:
+    std::vector<BvhNode> m_nodes;
+    // primitive indices in leaf order and a copy of their boxes in the same order, which leaves cull with SIMD
+    std::vector<u32> m_prim_indices;
+    AabbSoA m_prim_aabbs;
+    BuildParams m_params;
+    f32 m_build_cost{ 0.0f };
+    u32 m_depth{ 0 };
+  };
+}
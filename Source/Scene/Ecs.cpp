@@ -0,0 +1,456 @@
+/*
+ * Ecs.cpp - archetype-based entity component storage with cached queries and command buffers
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Scene/Ecs.h>
+#include <Core/JobSystem.h>
+
+#include <cstring>
+#include <new>
+
+namespace
+{
+  // columns start on cache lines, which also satisfies the alignment of every SIMD type
+  constexpr u32 k_column_alignment = 64;
+
+  std::array<zv::ComponentTypeInfo, zv::k_max_component_types> g_component_types;
+  u32 g_component_type_count = 0;
+  std::mutex g_component_type_mutex;
+
+  u32 align_up(u32 value, u32 alignment)
+  {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  // assigns the column offsets for the capacity and returns the bytes a chunk needs
+  u32 layout_columns(zv::Archetype& archetype, u32 capacity)
+  {
+    u32 offset = static_cast<u32>(sizeof(zv::Entity)) * capacity;
+    for (zv::ComponentTypeId type : archetype.components)
+    {
+      offset = align_up(offset, k_column_alignment);
+      archetype.column_offsets[type] = offset;
+      offset += zv::get_component_type_info(type).size * capacity;
+    }
+    return offset;
+  }
+
+  u8* allocate_chunk()
+  {
+    return static_cast<u8*>(::operator new(zv::k_ecs_chunk_size, std::align_val_t{ k_column_alignment }));
+  }
+
+  void free_chunk(u8* ptr_chunk)
+  {
+    ::operator delete(ptr_chunk, std::align_val_t{ k_column_alignment });
+  }
+}
+
+zv::ComponentTypeId zv::internal::register_component_type(u32 size, u32 alignment)
+{
+  std::lock_guard<std::mutex> lock(g_component_type_mutex);
+  ZV_ASSERT(g_component_type_count < k_max_component_types);
+  ZV_ASSERT(alignment <= k_column_alignment);
+
+  g_component_types[g_component_type_count] = ComponentTypeInfo{ size, alignment };
+  return g_component_type_count++;
+}
+
+const zv::ComponentTypeInfo& zv::get_component_type_info(ComponentTypeId type)
+{
+  return g_component_types[type];
+}
+
+zv::World::World()
+{
+  // archetype 0 holds entities without components
+  get_archetype_index(0);
+}
+
+zv::World::~World()
+{
+  for (const std::unique_ptr<Archetype>& ptr_archetype : m_archetypes)
+  {
+    for (u8* ptr_chunk : ptr_archetype->chunks)
+    {
+      free_chunk(ptr_chunk);
+    }
+  }
+}
+
+zv::Entity zv::World::create()
+{
+  return create_entity(0);
+}
+
+void zv::World::destroy(Entity entity)
+{
+  ZV_ASSERT(!is_structure_locked());
+  ZV_ASSERT(is_alive(entity));
+
+  EntityRecord& record = m_records[entity.index];
+  free_row(record.archetype, record.chunk, record.row);
+
+  // generations wrap around, skipping the one reserved for command buffer placeholders
+  if (++record.generation == CommandBuffer::k_placeholder_generation)
+  {
+    record.generation = 0;
+  }
+  m_free_indices.push_back(entity.index);
+  --m_entity_count;
+}
+
+bool zv::World::is_alive(Entity entity) const
+{
+  // rows of destroyed entities are freed together with the generation bump, so a matching generation means alive
+  return entity.index < m_records.size() && m_records[entity.index].generation == entity.generation;
+}
+
+void zv::World::clear()
+{
+  ZV_ASSERT(!is_structure_locked());
+
+  for (const std::unique_ptr<Archetype>& ptr_archetype : m_archetypes)
+  {
+    Archetype& archetype = *ptr_archetype;
+    for (u32 c = 0; c < archetype.chunks.size(); ++c)
+    {
+      const Entity* ptr_entities = reinterpret_cast<const Entity*>(archetype.chunks[c]);
+      for (u32 row = 0; row < archetype.chunk_counts[c]; ++row)
+      {
+        EntityRecord& record = m_records[ptr_entities[row].index];
+        if (++record.generation == CommandBuffer::k_placeholder_generation)
+        {
+          record.generation = 0;
+        }
+        m_free_indices.push_back(ptr_entities[row].index);
+      }
+      free_chunk(archetype.chunks[c]);
+    }
+    archetype.chunks.clear();
+    archetype.chunk_counts.clear();
+    archetype.entity_count = 0;
+  }
+  m_entity_count = 0;
+}
+
+void* zv::World::add_component(Entity entity, ComponentTypeId type)
+{
+  ZV_ASSERT(is_alive(entity));
+
+  const u32 archetype_index = m_records[entity.index].archetype;
+  if (!m_archetypes[archetype_index]->has(type))
+  {
+    ZV_ASSERT(!is_structure_locked());
+
+    u32 target = m_archetypes[archetype_index]->add_edges[type];
+    if (target == Archetype::k_invalid_edge)
+    {
+      target = get_archetype_index(m_archetypes[archetype_index]->mask | (ComponentMask{ 1 } << type));
+      m_archetypes[archetype_index]->add_edges[type] = target;
+    }
+    move_entity(entity.index, target);
+  }
+  return get_component(entity, type);
+}
+
+void zv::World::remove_component(Entity entity, ComponentTypeId type)
+{
+  ZV_ASSERT(is_alive(entity));
+
+  const u32 archetype_index = m_records[entity.index].archetype;
+  if (!m_archetypes[archetype_index]->has(type))
+  {
+    return;
+  }
+
+  ZV_ASSERT(!is_structure_locked());
+
+  u32 target = m_archetypes[archetype_index]->remove_edges[type];
+  if (target == Archetype::k_invalid_edge)
+  {
+    target = get_archetype_index(m_archetypes[archetype_index]->mask & ~(ComponentMask{ 1 } << type));
+    m_archetypes[archetype_index]->remove_edges[type] = target;
+  }
+  move_entity(entity.index, target);
+}
+
+void* zv::World::get_component(Entity entity, ComponentTypeId type) const
+{
+  ZV_ASSERT(is_alive(entity));
+
+  const EntityRecord& record = m_records[entity.index];
+  const Archetype& archetype = *m_archetypes[record.archetype];
+  const u32 offset = archetype.column_offsets[type];
+  if (offset == Archetype::k_invalid_column)
+  {
+    return nullptr;
+  }
+  return archetype.chunks[record.chunk] + offset + record.row * get_component_type_info(type).size;
+}
+
+u32 zv::World::get_archetype_index(ComponentMask mask)
+{
+  auto it = m_archetype_of_mask.find(mask);
+  if (it != m_archetype_of_mask.end())
+  {
+    return it->second;
+  }
+
+  std::unique_ptr<Archetype> ptr_archetype = std::make_unique<Archetype>();
+  Archetype& archetype = *ptr_archetype;
+  archetype.mask = mask;
+  archetype.column_offsets.fill(Archetype::k_invalid_column);
+  archetype.add_edges.fill(Archetype::k_invalid_edge);
+  archetype.remove_edges.fill(Archetype::k_invalid_edge);
+
+  u32 row_size = sizeof(Entity);
+  for (ComponentTypeId type = 0; type < k_max_component_types; ++type)
+  {
+    if ((mask & (ComponentMask{ 1 } << type)) != 0)
+    {
+      archetype.components.push_back(type);
+      row_size += get_component_type_info(type).size;
+    }
+  }
+
+  // the estimate ignores the column padding, shrink until the padded layout fits
+  u32 capacity = k_ecs_chunk_size / row_size;
+  while (capacity > 0 && layout_columns(archetype, capacity) > k_ecs_chunk_size)
+  {
+    --capacity;
+  }
+  ZV_ASSERT(capacity > 0);
+  archetype.chunk_capacity = capacity;
+
+  const u32 index = static_cast<u32>(m_archetypes.size());
+  m_archetypes.push_back(std::move(ptr_archetype));
+  m_archetype_of_mask.emplace(mask, index);
+  return index;
+}
+
+zv::Entity zv::World::create_entity(u32 archetype_index)
+{
+  ZV_ASSERT(!is_structure_locked());
+
+  u32 index;
+  if (!m_free_indices.empty())
+  {
+    index = m_free_indices.back();
+    m_free_indices.pop_back();
+  }
+  else
+  {
+    index = static_cast<u32>(m_records.size());
+    m_records.push_back(EntityRecord{ 0, 0, 0, 0 });
+  }
+
+  EntityRecord& record = m_records[index];
+  record.archetype = archetype_index;
+  allocate_row(archetype_index, index, record.chunk, record.row);
+  ++m_entity_count;
+  return Entity{ index, record.generation };
+}
+
+void zv::World::allocate_row(u32 archetype_index, u32 entity_index, u32& out_chunk, u32& out_row)
+{
+  Archetype& archetype = *m_archetypes[archetype_index];
+  if (archetype.chunks.empty() || archetype.chunk_counts.back() == archetype.chunk_capacity)
+  {
+    archetype.chunks.push_back(allocate_chunk());
+    archetype.chunk_counts.push_back(0);
+  }
+
+  out_chunk = static_cast<u32>(archetype.chunks.size() - 1);
+  out_row = archetype.chunk_counts[out_chunk]++;
+  ++archetype.entity_count;
+
+  u8* ptr_chunk = archetype.chunks[out_chunk];
+  reinterpret_cast<Entity*>(ptr_chunk)[out_row] = Entity{ entity_index, m_records[entity_index].generation };
+  for (ComponentTypeId type : archetype.components)
+  {
+    const u32 size = get_component_type_info(type).size;
+    std::memset(ptr_chunk + archetype.column_offsets[type] + out_row * size, 0, size);
+  }
+}
+
+void zv::World::free_row(u32 archetype_index, u32 chunk, u32 row)
+{
+  Archetype& archetype = *m_archetypes[archetype_index];
+  const u32 last_chunk = static_cast<u32>(archetype.chunks.size() - 1);
+  const u32 last_row = archetype.chunk_counts[last_chunk] - 1;
+
+  if (chunk != last_chunk || row != last_row)
+  {
+    u8* ptr_dst = archetype.chunks[chunk];
+    const u8* ptr_src = archetype.chunks[last_chunk];
+    const Entity moved = reinterpret_cast<const Entity*>(ptr_src)[last_row];
+    reinterpret_cast<Entity*>(ptr_dst)[row] = moved;
+    for (ComponentTypeId type : archetype.components)
+    {
+      const u32 offset = archetype.column_offsets[type];
+      const u32 size = get_component_type_info(type).size;
+      std::memcpy(ptr_dst + offset + row * size, ptr_src + offset + last_row * size, size);
+    }
+    m_records[moved.index].chunk = chunk;
+    m_records[moved.index].row = row;
+  }
+
+  --archetype.chunk_counts[last_chunk];
+  --archetype.entity_count;
+  if (archetype.chunk_counts[last_chunk] == 0)
+  {
+    free_chunk(archetype.chunks[last_chunk]);
+    archetype.chunks.pop_back();
+    archetype.chunk_counts.pop_back();
+  }
+}
+
+void zv::World::move_entity(u32 entity_index, u32 target_archetype_index)
+{
+  const EntityRecord source = m_records[entity_index];
+  const Archetype& source_archetype = *m_archetypes[source.archetype];
+  const Archetype& target_archetype = *m_archetypes[target_archetype_index];
+
+  u32 chunk, row;
+  allocate_row(target_archetype_index, entity_index, chunk, row);
+
+  const u8* ptr_src = source_archetype.chunks[source.chunk];
+  u8* ptr_dst = target_archetype.chunks[chunk];
+  for (ComponentTypeId type : target_archetype.components)
+  {
+    if (source_archetype.has(type))
+    {
+      const u32 size = get_component_type_info(type).size;
+      std::memcpy(ptr_dst + target_archetype.column_offsets[type] + row * size,
+                  ptr_src + source_archetype.column_offsets[type] + source.row * size, size);
+    }
+  }
+
+  free_row(source.archetype, source.chunk, source.row);
+
+  EntityRecord& record = m_records[entity_index];
+  record.archetype = target_archetype_index;
+  record.chunk = chunk;
+  record.row = row;
+}
+
+void zv::Query::update(const World& world)
+{
+  const u32 archetype_count = world.get_archetype_count();
+  for (u32 i = m_checked_archetype_count; i < archetype_count; ++i)
+  {
+    const ComponentMask mask = world.get_archetype(i).mask;
+    if ((mask & m_all) == m_all && (mask & m_none) == 0)
+    {
+      m_archetypes.push_back(i);
+    }
+  }
+  m_checked_archetype_count = archetype_count;
+}
+
+u32 zv::Query::get_entity_count(const World& world)
+{
+  update(world);
+
+  u32 count = 0;
+  for (u32 archetype_index : m_archetypes)
+  {
+    count += world.get_archetype(archetype_index).entity_count;
+  }
+  return count;
+}
+
+void zv::Query::parallel_for_each_chunk(const World& world, const std::function<void(const ChunkView&)>& fn)
+{
+  m_chunk_views.clear();
+  for_each_chunk(world, [this](const ChunkView& chunk) { m_chunk_views.push_back(chunk); });
+
+  Jobs::parallel_for(static_cast<u32>(m_chunk_views.size()), 1, [this, &fn](u32 begin, u32 end)
+  {
+    for (u32 i = begin; i < end; ++i)
+    {
+      fn(m_chunk_views[i]);
+    }
+  });
+}
+
+zv::Entity zv::CommandBuffer::create()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const Entity placeholder{ m_created_count++, k_placeholder_generation };
+  m_commands.push_back(Command{ eCommandType::Create, 0, placeholder, 0 });
+  return placeholder;
+}
+
+void zv::CommandBuffer::destroy(Entity entity)
+{
+  record(eCommandType::Destroy, entity, 0, nullptr, 0);
+}
+
+void zv::CommandBuffer::record(eCommandType type, Entity entity, ComponentTypeId component, const void* ptr_data, u32 size)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const u32 offset = static_cast<u32>(m_data.size());
+  if (size != 0)
+  {
+    m_data.resize(offset + size);
+    std::memcpy(m_data.data() + offset, ptr_data, size);
+  }
+  m_commands.push_back(Command{ type, component, entity, offset });
+}
+
+void zv::CommandBuffer::playback(World& world)
+{
+  m_created.assign(m_created_count, k_invalid_entity);
+
+  for (const Command& command : m_commands)
+  {
+    if (command.type == eCommandType::Create)
+    {
+      m_created[command.entity.index] = world.create();
+      continue;
+    }
+
+    const Entity entity = command.entity.generation == k_placeholder_generation ? m_created[command.entity.index] : command.entity;
+    if (!world.is_alive(entity))
+    {
+      continue;
+    }
+
+    switch (command.type)
+    {
+      case eCommandType::Destroy:
+      {
+        world.destroy(entity);
+        break;
+      }
+      case eCommandType::Add:
+      {
+        std::memcpy(world.add_component(entity, command.component), m_data.data() + command.data_offset,
+                    get_component_type_info(command.component).size);
+        break;
+      }
+      case eCommandType::Remove:
+      {
+        world.remove_component(entity, command.component);
+        break;
+      }
+      default:
+      {
+        break;
+      }
+    }
+  }
+
+  clear();
+}
+
+void zv::CommandBuffer::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_commands.clear();
+  m_data.clear();
+  m_created_count = 0;
+}
@@ -0,0 +1,335 @@
+/*
+ * Ecs.h - archetype-based entity component storage with cached queries and command buffers
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <Core/Logger.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+namespace zv
+{
+  using ComponentTypeId = u32;
+  using ComponentMask = u64;
+  constexpr u32 k_max_component_types = 64;
+  // chunks are allocated in blocks of this size, each holds the components of up to chunk_capacity entities
+  constexpr u32 k_ecs_chunk_size = 16 * 1024;
+
+  struct Entity
+  {
+    u32 index{ ~0u };
+    u32 generation{ 0 };
+
+    bool is_valid() const { return index != ~0u; }
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+  };
+  constexpr Entity k_invalid_entity{};
+
+  struct ComponentTypeInfo
+  {
+    u32 size;
+    u32 alignment;
+  };
+
+  namespace internal
+  {
+    ComponentTypeId register_component_type(u32 size, u32 alignment);
+  }
+
+  // Component types get their ids on first use. Components are plain data: they are moved between chunks with memcpy
+  // and never destructed.
+  template<typename T>
+  ComponentTypeId get_component_type()
+  {
+    using Component = std::remove_const_t<T>;
+    static_assert(std::is_trivially_copyable_v<Component> && std::is_trivially_destructible_v<Component>,
+                  "components must be trivially copyable and destructible");
+    static const ComponentTypeId id = internal::register_component_type(sizeof(Component), alignof(Component));
+    return id;
+  }
+
+  const ComponentTypeInfo& get_component_type_info(ComponentTypeId type);
+
+  template<typename... Ts>
+  ComponentMask make_component_mask()
+  {
+    return (ComponentMask{ 0 } | ... | (ComponentMask{ 1 } << get_component_type<Ts>()));
+  }
+
+  // All entities with exactly the same set of component types. The components are stored in chunks as one array per
+  // type behind the array of entities, so iterating a component walks contiguous memory.
+  struct Archetype
+  {
+    static constexpr u32 k_invalid_column = ~0u;
+    static constexpr u32 k_invalid_edge = ~0u;
+
+    ComponentMask mask{ 0 };
+    // ascending
+    std::vector<ComponentTypeId> components;
+    // per component type, byte offset of its array in a chunk
+    std::array<u32, k_max_component_types> column_offsets;
+    u32 chunk_capacity{ 0 };
+
+    std::vector<u8*> chunks;
+    std::vector<u32> chunk_counts;
+    u32 entity_count{ 0 };
+
+    // archetypes reached by adding or removing one component type, resolved on first use
+    std::array<u32, k_max_component_types> add_edges;
+    std::array<u32, k_max_component_types> remove_edges;
+
+    bool has(ComponentTypeId type) const { return column_offsets[type] != k_invalid_column; }
+  };
+
+  // One chunk of an archetype as seen by a query
+  class ChunkView
+  {
+  public:
+    ChunkView(const Archetype* ptr_archetype, u8* ptr_data, u32 count)
+      : m_ptr_archetype(ptr_archetype), m_ptr_data(ptr_data), m_count(count) {}
+
+    u32 get_count() const { return m_count; }
+    const Entity* get_entities() const { return reinterpret_cast<const Entity*>(m_ptr_data); }
+
+    // array of the chunk's components; the type must be part of the query
+    template<typename T>
+    T* get() const
+    {
+      T* ptr_components = try_get<T>();
+      ZV_ASSERT(ptr_components != nullptr);
+      return ptr_components;
+    }
+
+    // null if the archetype does not have the component, e.g. for optional components of a query
+    template<typename T>
+    T* try_get() const
+    {
+      const u32 offset = m_ptr_archetype->column_offsets[get_component_type<T>()];
+      return offset != Archetype::k_invalid_column ? reinterpret_cast<T*>(m_ptr_data + offset) : nullptr;
+    }
+
+  private:
+    const Archetype* m_ptr_archetype;
+    u8* m_ptr_data;
+    u32 m_count;
+  };
+
+  // Owns all entities and their components. Adding or removing components moves an entity into another archetype,
+  // destroying one moves the archetype's last entity into the hole, so pointers to components are only valid until
+  // the next structural change. Structural changes are not thread-safe; while the structure is locked (e.g. while the
+  // system scheduler runs) they have to go through a CommandBuffer.
+  class World : public NonCopyable
+  {
+  public:
+    World();
+    ~World();
+
+  public:
+    Entity create();
+    template<typename... Ts>
+    Entity create(const Ts&... components)
+    {
+      const Entity entity = create_entity(get_archetype_index(make_component_mask<Ts...>()));
+      ((*static_cast<Ts*>(get_component(entity, get_component_type<Ts>())) = components), ...);
+      return entity;
+    }
+    void destroy(Entity entity);
+    bool is_alive(Entity entity) const;
+    // destroys all entities; archetypes are kept, so cached queries stay valid
+    void clear();
+
+    // sets the component, adding it first if the entity does not have it yet
+    template<typename T>
+    void add(Entity entity, const T& component)
+    {
+      *static_cast<T*>(add_component(entity, get_component_type<T>())) = component;
+    }
+    template<typename T>
+    void remove(Entity entity) { remove_component(entity, get_component_type<T>()); }
+    template<typename T>
+    bool has(Entity entity) const { return get_component(entity, get_component_type<T>()) != nullptr; }
+    // null if the entity does not have the component
+    template<typename T>
+    T* get(Entity entity) const { return static_cast<T*>(get_component(entity, get_component_type<T>())); }
+
+    // type-erased versions of the above, the added component is zero-initialized
+    void* add_component(Entity entity, ComponentTypeId type);
+    void remove_component(Entity entity, ComponentTypeId type);
+    void* get_component(Entity entity, ComponentTypeId type) const;
+
+    u32 get_entity_count() const { return m_entity_count; }
+    // archetypes are never removed, their indices are stable
+    u32 get_archetype_count() const { return static_cast<u32>(m_archetypes.size()); }
+    const Archetype& get_archetype(u32 index) const { return *m_archetypes[index]; }
+
+    // structural changes assert while locked; locks nest
+    void lock_structure() { ++m_structure_lock_count; }
+    void unlock_structure() { --m_structure_lock_count; }
+    bool is_structure_locked() const { return m_structure_lock_count != 0; }
+
+  private:
+    struct EntityRecord
+    {
+      u32 archetype;
+      u32 chunk;
+      u32 row;
+      u32 generation;
+    };
+
+    u32 get_archetype_index(ComponentMask mask);
+    Entity create_entity(u32 archetype_index);
+    // places the entity into the archetype and returns its record's new location; the row's components are zeroed
+    void allocate_row(u32 archetype_index, u32 entity_index, u32& out_chunk, u32& out_row);
+    // removes a row by moving the archetype's last row into it
+    void free_row(u32 archetype_index, u32 chunk, u32 row);
+    void move_entity(u32 entity_index, u32 target_archetype_index);
+
+  private:
+    std::vector<std::unique_ptr<Archetype>> m_archetypes;
+    std::unordered_map<ComponentMask, u32> m_archetype_of_mask;
+
+    std::vector<EntityRecord> m_records;
+    std::vector<u32> m_free_indices;
+    u32 m_entity_count{ 0 };
+    u32 m_structure_lock_count{ 0 };
+  };
+
+  // Entities with all components of one mask and none of another. Matching archetypes are cached: update() only looks
+  // at archetypes created since its last call, which is cheap enough to do before every iteration.
+  //
+  // A query may be iterated from one thread at a time; different queries may iterate the same world in parallel as long
+  // as the structure is not changed.
+  class Query
+  {
+  public:
+    Query() = default;
+    explicit Query(ComponentMask all, ComponentMask none = 0) : m_all(all), m_none(none) {}
+
+    ComponentMask get_all_mask() const { return m_all; }
+    ComponentMask get_none_mask() const { return m_none; }
+
+    void update(const World& world);
+    u32 get_entity_count(const World& world);
+
+    // fn(const ChunkView&) for every non-empty chunk of the matching archetypes
+    template<typename Fn>
+    void for_each_chunk(const World& world, Fn&& fn)
+    {
+      update(world);
+      for (u32 archetype_index : m_archetypes)
+      {
+        const Archetype& archetype = world.get_archetype(archetype_index);
+        for (u32 c = 0; c < archetype.chunks.size(); ++c)
+        {
+          fn(ChunkView{ &archetype, archetype.chunks[c], archetype.chunk_counts[c] });
+        }
+      }
+    }
+
+    // chunks are distributed over the job system; fn is called concurrently for different chunks
+    void parallel_for_each_chunk(const World& world, const std::function<void(const ChunkView&)>& fn);
+
+    // fn(Entity, Ts&...) for every matching entity; the types must be part of the all mask
+    template<typename... Ts, typename Fn>
+    void for_each(const World& world, Fn&& fn)
+    {
+      for_each_chunk(world, [&fn](const ChunkView& chunk)
+      {
+        const Entity* ptr_entities = chunk.get_entities();
+        const u32 count = chunk.get_count();
+        auto columns = std::make_tuple(chunk.get<Ts>()...);
+        for (u32 i = 0; i < count; ++i)
+        {
+          fn(ptr_entities[i], std::get<Ts*>(columns)[i]...);
+        }
+      });
+    }
+
+  private:
+    ComponentMask m_all{ 0 };
+    ComponentMask m_none{ 0 };
+    std::vector<u32> m_archetypes;
+    // archetypes of the world that were already matched
+    u32 m_checked_archetype_count{ 0 };
+    std::vector<ChunkView> m_chunk_views;
+  };
+
+  template<typename... Ts>
+  Query make_query(ComponentMask none = 0)
+  {
+    return Query{ make_component_mask<Ts...>(), none };
+  }
+
+  // Records structural changes to apply them later on the world's owning thread, in recording order. Recording is
+  // thread-safe; commands recorded concurrently are applied in the order they acquired the buffer. Commands for
+  // entities that are dead at playback, e.g. destroyed twice, are skipped.
+  class CommandBuffer : public NonCopyable
+  {
+  public:
+    // generation of placeholder entities, the world never hands it out
+    static constexpr u32 k_placeholder_generation = ~0u;
+
+  public:
+    CommandBuffer() = default;
+
+  public:
+    // returns a placeholder that later commands of this buffer may target; it becomes a real entity at playback
+    Entity create();
+    void destroy(Entity entity);
+    template<typename T>
+    void add(Entity entity, const T& component)
+    {
+      record(eCommandType::Add, entity, get_component_type<T>(), &component, sizeof(T));
+    }
+    template<typename T>
+    void remove(Entity entity)
+    {
+      record(eCommandType::Remove, entity, get_component_type<T>(), nullptr, 0);
+    }
+
+    // applies and clears all commands
+    void playback(World& world);
+    void clear();
+    bool is_empty() const { return m_commands.empty(); }
+    u32 get_command_count() const { return static_cast<u32>(m_commands.size()); }
+
+  private:
+    enum class eCommandType : u8
+    {
+      Create,
+      Destroy,
+      Add,
+      Remove,
+    };
+
+    struct Command
+    {
+      eCommandType type;
+      ComponentTypeId component;
+      Entity entity;
+      u32 data_offset;
+    };
+
+    void record(eCommandType type, Entity entity, ComponentTypeId component, const void* ptr_data, u32 size);
+
+  private:
+    std::mutex m_mutex;
+    std::vector<Command> m_commands;
+    std::vector<u8> m_data;
+    u32 m_created_count{ 0 };
+    // placeholder index to created entity, playback scratch
+    std::vector<Entity> m_created;
+  };
+}
@@ -0,0 +1,80 @@
+/*
+ * SystemScheduler.cpp - runs ECS systems in parallel based on their declared component access
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Scene/SystemScheduler.h>
+#include <Core/JobSystem.h>
+
+#include <algorithm>
+#include <chrono>
+
+
+u32 zv::SystemScheduler::add_system(const SystemDesc& desc)
+{
+  ZV_ASSERT(desc.fn);
+
+  std::unique_ptr<System> ptr_system = std::make_unique<System>();
+  ptr_system->desc = desc;
+
+  const u32 index = static_cast<u32>(m_systems.size());
+  for (u32 i = 0; i < index; ++i)
+  {
+    const SystemDesc& earlier = m_systems[i]->desc;
+    const bool conflict = (earlier.writes & (desc.reads | desc.writes)) != 0 || (earlier.reads & desc.writes) != 0;
+    if (conflict)
+    {
+      ptr_system->level = std::max(ptr_system->level, m_systems[i]->level + 1);
+    }
+  }
+
+  if (ptr_system->level >= m_levels.size())
+  {
+    m_levels.resize(ptr_system->level + 1);
+  }
+  m_levels[ptr_system->level].push_back(index);
+  m_systems.push_back(std::move(ptr_system));
+  return index;
+}
+
+void zv::SystemScheduler::clear()
+{
+  m_systems.clear();
+  m_levels.clear();
+}
+
+void zv::SystemScheduler::run(World& world)
+{
+  world.lock_structure();
+  for (const std::vector<u32>& level : m_levels)
+  {
+    if (level.size() == 1)
+    {
+      run_system(world, *m_systems[level[0]]);
+      continue;
+    }
+
+    Jobs::Counter counter;
+    for (u32 i = 1; i < level.size(); ++i)
+    {
+      System* ptr_system = m_systems[level[i]].get();
+      Jobs::submit([this, &world, ptr_system]() { run_system(world, *ptr_system); }, &counter);
+    }
+    // the calling thread takes the first system and then helps with the rest while waiting
+    run_system(world, *m_systems[level[0]]);
+    Jobs::wait(counter);
+  }
+  world.unlock_structure();
+
+  for (const std::unique_ptr<System>& ptr_system : m_systems)
+  {
+    ptr_system->commands.playback(world);
+  }
+}
+
+void zv::SystemScheduler::run_system(World& world, System& system)
+{
+  const auto start = std::chrono::steady_clock::now();
+  system.desc.fn(world, system.commands);
+  system.time_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,68 @@
+/*
+ * SystemScheduler.h - runs ECS systems in parallel based on their declared component access
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <Scene/Ecs.h>
+
+namespace zv
+{
+  struct SystemDesc
+  {
+    using SystemFn = std::function<void(World& world, CommandBuffer& commands)>;
+
+    const char* name{ nullptr };
+    // component types the system reads and writes; a type in both only needs to be in writes
+    ComponentMask reads{ 0 };
+    ComponentMask writes{ 0 };
+    // the world's structure is locked while the system runs, structural changes go through the command buffer
+    SystemFn fn;
+  };
+
+  // Systems are grouped into levels like the passes of the frame graph: a system is placed one level after the last
+  // earlier system it conflicts with, i.e. one that writes what it reads or writes, or reads what it writes. Systems of
+  // one level run in parallel on the job system, so the results are the same as running all systems in the order they
+  // were added. The command buffers are played back in that order after the last level.
+  class SystemScheduler : public NonCopyable
+  {
+  public:
+    SystemScheduler() = default;
+
+  public:
+    u32 add_system(const SystemDesc& desc);
+    void clear();
+
+    void run(World& world);
+
+    u32 get_system_count() const { return static_cast<u32>(m_systems.size()); }
+    const char* get_system_name(u32 system) const { return m_systems[system]->desc.name; }
+    u32 get_system_level(u32 system) const { return m_systems[system]->level; }
+    u32 get_level_count() const { return static_cast<u32>(m_levels.size()); }
+    // wall time of the system in the last run()
+    f64 get_system_time_ms(u32 system) const { return m_systems[system]->time_ms; }
+
+  private:
+    struct System
+    {
+      SystemDesc desc;
+      u32 level{ 0 };
+      CommandBuffer commands;
+      f64 time_ms{ 0.0 };
+    };
+
+    void run_system(World& world, System& system);
+
+  private:
+    // command buffers are not movable, systems are kept behind pointers
+    std::vector<std::unique_ptr<System>> m_systems;
+    std::vector<std::vector<u32>> m_levels;
+  };
+}
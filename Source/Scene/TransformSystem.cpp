@@ -0,0 +1,433 @@
+/*
+ * TransformSystem.cpp - batched transform hierarchy with structure-of-arrays storage
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Scene/TransformSystem.h>
+#include <Core/JobSystem.h>
+#include <Core/Logger.h>
+#include <Math/Simd.h>
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+// number of transforms processed by one parallel_for chunk; a multiple of the SIMD width
+static const u32 k_update_grain_size = 1024;
+
+namespace
+{
+  // loads up to four consecutive values and pads the remaining lanes
+  inline zv::simd::Vec4 load_lanes(const std::vector<f32>& values, u32 index, u32 lane_count, f32 pad)
+  {
+    if (lane_count == 4)
+    {
+      return zv::simd::load(values.data() + index);
+    }
+
+    f32 lanes[4] = { pad, pad, pad, pad };
+    for (u32 lane = 0; lane < lane_count; ++lane)
+    {
+      lanes[lane] = values[index + lane];
+    }
+    return zv::simd::load(lanes);
+  }
+}
+
+zv::TransformId zv::TransformSystem::create(TransformId parent)
+{
+  ZV_ASSERT(parent == k_invalid_transform || is_alive(parent));
+
+  TransformId id;
+  if (!m_free_ids.empty())
+  {
+    id = m_free_ids.back();
+    m_free_ids.pop_back();
+    m_parents[id] = parent;
+    m_child_counts[id] = 0;
+  }
+  else
+  {
+    id = static_cast<TransformId>(m_parents.size());
+    m_parents.push_back(parent);
+    m_child_counts.push_back(0);
+    m_dense_of_id.push_back(k_invalid_transform);
+  }
+
+  if (parent != k_invalid_transform)
+  {
+    ++m_child_counts[parent];
+  }
+
+  m_dense_of_id[id] = static_cast<u32>(m_ids.size());
+  m_ids.push_back(id);
+  m_parent_dense.push_back(k_invalid_transform);
+  m_pos_x.push_back(0.0f); m_pos_y.push_back(0.0f); m_pos_z.push_back(0.0f);
+  m_rot_x.push_back(0.0f); m_rot_y.push_back(0.0f); m_rot_z.push_back(0.0f); m_rot_w.push_back(1.0f);
+  m_scale_x.push_back(1.0f); m_scale_y.push_back(1.0f); m_scale_z.push_back(1.0f);
+  m_dirty.push_back(1);
+  m_changed.push_back(1);
+  m_world_changed.push_back(1);
+  m_world.push_back(Matrix44::Identity());
+  m_world_view_proj.push_back(Matrix44::Identity());
+
+  m_layout_dirty = true;
+  return id;
+}
+
+void zv::TransformSystem::destroy(TransformId id)
+{
+  ZV_ASSERT(is_alive(id));
+
+  const TransformId parent = m_parents[id];
+  if (m_child_counts[id] > 0)
+  {
+    for (TransformId child = 0; child < m_parents.size(); ++child)
+    {
+      if (m_parents[child] == id && is_alive(child))
+      {
+        m_parents[child] = parent;
+        m_dirty[m_dense_of_id[child]] = 1;
+      }
+    }
+
+    if (parent != k_invalid_transform)
+    {
+      m_child_counts[parent] += m_child_counts[id];
+    }
+    m_child_counts[id] = 0;
+  }
+
+  if (parent != k_invalid_transform)
+  {
+    --m_child_counts[parent];
+  }
+
+  // the dense slot is compacted away by the next layout rebuild
+  m_ids[m_dense_of_id[id]] = k_invalid_transform;
+  m_dense_of_id[id] = k_invalid_transform;
+  m_parents[id] = k_invalid_transform;
+  m_free_ids.push_back(id);
+  m_layout_dirty = true;
+}
+
+void zv::TransformSystem::clear()
+{
+  m_parents.clear();
+  m_child_counts.clear();
+  m_dense_of_id.clear();
+  m_free_ids.clear();
+  m_ids.clear();
+  m_parent_dense.clear();
+  m_pos_x.clear(); m_pos_y.clear(); m_pos_z.clear();
+  m_rot_x.clear(); m_rot_y.clear(); m_rot_z.clear(); m_rot_w.clear();
+  m_scale_x.clear(); m_scale_y.clear(); m_scale_z.clear();
+  m_dirty.clear();
+  m_changed.clear();
+  m_world_changed.clear();
+  m_world.clear();
+  m_world_view_proj.clear();
+  m_level_begin.clear();
+  m_layout_dirty = false;
+  m_view_proj_valid = false;
+  m_last_update_count = 0;
+}
+
+void zv::TransformSystem::set_parent(TransformId id, TransformId parent)
+{
+  ZV_ASSERT(is_alive(id) && (parent == k_invalid_transform || is_alive(parent)));
+
+#if ZV_DEBUG_MODE
+  for (TransformId ancestor = parent; ancestor != k_invalid_transform; ancestor = m_parents[ancestor])
+  {
+    ZV_ASSERT(ancestor != id);
+  }
+#endif
+
+  if (m_parents[id] != k_invalid_transform)
+  {
+    --m_child_counts[m_parents[id]];
+  }
+  if (parent != k_invalid_transform)
+  {
+    ++m_child_counts[parent];
+  }
+
+  m_parents[id] = parent;
+  m_dirty[m_dense_of_id[id]] = 1;
+  m_layout_dirty = true;
+}
+
+void zv::TransformSystem::set_local_position(TransformId id, const Vector3& position)
+{
+  const u32 i = m_dense_of_id[id];
+  m_pos_x[i] = position.x;
+  m_pos_y[i] = position.y;
+  m_pos_z[i] = position.z;
+  m_dirty[i] = 1;
+}
+
+void zv::TransformSystem::set_local_rotation(TransformId id, const Vector4& rotation)
+{
+  const u32 i = m_dense_of_id[id];
+  m_rot_x[i] = rotation.x;
+  m_rot_y[i] = rotation.y;
+  m_rot_z[i] = rotation.z;
+  m_rot_w[i] = rotation.w;
+  m_dirty[i] = 1;
+}
+
+void zv::TransformSystem::set_local_scale(TransformId id, const Vector3& scale)
+{
+  const u32 i = m_dense_of_id[id];
+  m_scale_x[i] = scale.x;
+  m_scale_y[i] = scale.y;
+  m_scale_z[i] = scale.z;
+  m_dirty[i] = 1;
+}
+
+zv::Vector3 zv::TransformSystem::get_local_position(TransformId id) const
+{
+  const u32 i = m_dense_of_id[id];
+  return Vector3{ m_pos_x[i], m_pos_y[i], m_pos_z[i] };
+}
+
+zv::Vector4 zv::TransformSystem::get_local_rotation(TransformId id) const
+{
+  const u32 i = m_dense_of_id[id];
+  return Vector4{ m_rot_x[i], m_rot_y[i], m_rot_z[i], m_rot_w[i] };
+}
+
+zv::Vector3 zv::TransformSystem::get_local_scale(TransformId id) const
+{
+  const u32 i = m_dense_of_id[id];
+  return Vector3{ m_scale_x[i], m_scale_y[i], m_scale_z[i] };
+}
+
+/*
+ * Sorts the live transforms by depth (and by parent within a level) and compacts destroyed slots.
+ */
+void zv::TransformSystem::rebuild_layout()
+{
+  const u32 id_count = static_cast<u32>(m_parents.size());
+
+  // depth per id, resolved iteratively along the parent chain
+  std::vector<u32> depths(id_count, k_invalid_transform);
+  std::vector<TransformId> chain;
+  for (TransformId id : m_ids)
+  {
+    if (id == k_invalid_transform)
+    {
+      continue;
+    }
+
+    TransformId walk = id;
+    while (walk != k_invalid_transform && depths[walk] == k_invalid_transform)
+    {
+      chain.push_back(walk);
+      walk = m_parents[walk];
+    }
+
+    u32 depth = walk == k_invalid_transform ? 0 : depths[walk] + 1;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+      depths[*it] = depth++;
+    }
+    chain.clear();
+  }
+
+  std::vector<u32> order;
+  order.reserve(m_ids.size());
+  for (u32 i = 0; i < m_ids.size(); ++i)
+  {
+    if (m_ids[i] != k_invalid_transform)
+    {
+      order.push_back(i);
+    }
+  }
+
+  std::sort(order.begin(), order.end(), [&](u32 a, u32 b)
+  {
+    const TransformId id_a = m_ids[a];
+    const TransformId id_b = m_ids[b];
+    if (depths[id_a] != depths[id_b])
+    {
+      return depths[id_a] < depths[id_b];
+    }
+    if (m_parents[id_a] != m_parents[id_b])
+    {
+      return m_parents[id_a] < m_parents[id_b];
+    }
+    return a < b;
+  });
+
+  auto permute = [&order](auto& values)
+  {
+    std::remove_reference_t<decltype(values)> sorted;
+    sorted.reserve(order.size());
+    for (u32 i : order)
+    {
+      sorted.push_back(values[i]);
+    }
+    values.swap(sorted);
+  };
+
+  permute(m_ids);
+  permute(m_pos_x); permute(m_pos_y); permute(m_pos_z);
+  permute(m_rot_x); permute(m_rot_y); permute(m_rot_z); permute(m_rot_w);
+  permute(m_scale_x); permute(m_scale_y); permute(m_scale_z);
+  permute(m_dirty);
+  permute(m_changed);
+  permute(m_world_changed);
+  permute(m_world);
+  permute(m_world_view_proj);
+
+  const u32 count = static_cast<u32>(m_ids.size());
+  for (u32 i = 0; i < count; ++i)
+  {
+    m_dense_of_id[m_ids[i]] = i;
+  }
+
+  m_parent_dense.resize(count);
+  m_level_begin.clear();
+  u32 current_depth = k_invalid_transform;
+  for (u32 i = 0; i < count; ++i)
+  {
+    const TransformId parent = m_parents[m_ids[i]];
+    m_parent_dense[i] = parent == k_invalid_transform ? k_invalid_transform : m_dense_of_id[parent];
+
+    if (depths[m_ids[i]] != current_depth)
+    {
+      current_depth = depths[m_ids[i]];
+      m_level_begin.push_back(i);
+    }
+  }
+  m_level_begin.push_back(count);
+
+  m_layout_dirty = false;
+}
+
+void zv::TransformSystem::update(const Matrix44& view_proj)
+{
+  if (m_layout_dirty)
+  {
+    rebuild_layout();
+  }
+
+  const bool view_proj_changed = !m_view_proj_valid || std::memcmp(&view_proj, &m_view_proj, sizeof(Matrix44)) != 0;
+  m_view_proj = view_proj;
+  m_view_proj_valid = true;
+
+  if (view_proj_changed)
+  {
+    std::fill(m_changed.begin(), m_changed.end(), u8(1));
+  }
+  else
+  {
+    std::fill(m_changed.begin(), m_changed.end(), u8(0));
+  }
+
+  // levels are processed in order, so parents are final before their children read them
+  std::atomic<u32> update_count{ 0 };
+  for (size_t level = 0; level + 1 < m_level_begin.size(); ++level)
+  {
+    const u32 level_begin = m_level_begin[level];
+    const u32 level_end = m_level_begin[level + 1];
+
+    Jobs::parallel_for(level_end - level_begin, k_update_grain_size, [&](u32 begin, u32 end)
+    {
+      update_level(level_begin + begin, level_begin + end);
+
+      u32 chunk_updates = 0;
+      for (u32 i = level_begin + begin; i < level_begin + end; ++i)
+      {
+        chunk_updates += m_dirty[i];
+      }
+      update_count.fetch_add(chunk_updates, std::memory_order_relaxed);
+    });
+  }
+
+  // dirty flags now include inherited ones, so they mark exactly the recomputed world matrices
+  m_world_changed.assign(m_dirty.begin(), m_dirty.end());
+  std::fill(m_dirty.begin(), m_dirty.end(), u8(0));
+  m_last_update_count = update_count.load();
+}
+
+/*
+ * Updates the dense range [begin, end) of a single depth level, four transforms at a time.
+ */
+void zv::TransformSystem::update_level(u32 begin, u32 end)
+{
+  using namespace simd;
+
+  const Mat4 view_proj = load(m_view_proj);
+
+  for (u32 i = begin; i < end; i += 4)
+  {
+    const u32 lane_count = std::min(4u, end - i);
+
+    // inherit dirty state from the parents
+    bool any_dirty = false;
+    for (u32 lane = 0; lane < lane_count; ++lane)
+    {
+      const u32 parent = m_parent_dense[i + lane];
+      if (parent != k_invalid_transform)
+      {
+        m_dirty[i + lane] |= m_dirty[parent];
+      }
+      any_dirty |= m_dirty[i + lane] != 0;
+    }
+
+    if (any_dirty)
+    {
+      // local matrices of four transforms, computed lane-wise from the SoA data
+      const Vec4 x = load_lanes(m_rot_x, i, lane_count, 0.0f);
+      const Vec4 y = load_lanes(m_rot_y, i, lane_count, 0.0f);
+      const Vec4 z = load_lanes(m_rot_z, i, lane_count, 0.0f);
+      const Vec4 w = load_lanes(m_rot_w, i, lane_count, 1.0f);
+      const Vec4 sx = load_lanes(m_scale_x, i, lane_count, 1.0f);
+      const Vec4 sy = load_lanes(m_scale_y, i, lane_count, 1.0f);
+      const Vec4 sz = load_lanes(m_scale_z, i, lane_count, 1.0f);
+
+      const Vec4 one = splat(1.0f);
+      const Vec4 two = splat(2.0f);
+      const Vec4 xx = x * x, yy = y * y, zz = z * z;
+      const Vec4 xy = x * y, xz = x * z, yz = y * z;
+      const Vec4 wx = w * x, wy = w * y, wz = w * z;
+
+      const Mat4 rows0 = transpose({ { (one - two * (yy + zz)) * sx, two * (xy + wz) * sx, two * (xz - wy) * sx, zero() } });
+      const Mat4 rows1 = transpose({ { two * (xy - wz) * sy, (one - two * (xx + zz)) * sy, two * (yz + wx) * sy, zero() } });
+      const Mat4 rows2 = transpose({ { two * (xz + wy) * sz, two * (yz - wx) * sz, (one - two * (xx + yy)) * sz, zero() } });
+      const Mat4 rows3 = transpose({ { load_lanes(m_pos_x, i, lane_count, 0.0f), load_lanes(m_pos_y, i, lane_count, 0.0f),
+                                       load_lanes(m_pos_z, i, lane_count, 0.0f), one } });
+
+      for (u32 lane = 0; lane < lane_count; ++lane)
+      {
+        if (!m_dirty[i + lane])
+        {
+          continue;
+        }
+
+        Mat4 world = { { rows0.r[lane], rows1.r[lane], rows2.r[lane], rows3.r[lane] } };
+        const u32 parent = m_parent_dense[i + lane];
+        if (parent != k_invalid_transform)
+        {
+          world = world * load(m_world[parent]);
+        }
+
+        store(m_world[i + lane], world);
+        store(m_world_view_proj[i + lane], world * view_proj);
+        m_changed[i + lane] = 1;
+      }
+    }
+
+    // clean transforms only need a new world-view-projection matrix when the camera moved
+    for (u32 lane = 0; lane < lane_count; ++lane)
+    {
+      if (!m_dirty[i + lane] && m_changed[i + lane])
+      {
+        store(m_world_view_proj[i + lane], load(m_world[i + lane]) * view_proj);
+      }
+    }
+  }
+}
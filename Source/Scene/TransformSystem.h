@@ -0,0 +1,98 @@
+/*
+ * TransformSystem.h - batched transform hierarchy with structure-of-arrays storage
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+#include <MathDefines.h>
+
+namespace zv
+{
+  typedef u32 TransformId;
+  const TransformId k_invalid_transform = ~0u;
+
+  // Local translation / rotation / scale is stored as structure-of-arrays and kept sorted by hierarchy depth, so every
+  // parent is updated before its children and each depth level can be processed in parallel. Only transforms that were
+  // changed, or whose ancestors were changed, are recomputed.
+  class TransformSystem : public NonCopyable
+  {
+  public:
+    TransformSystem() = default;
+
+  public:
+    TransformId create(TransformId parent = k_invalid_transform);
+    // children of a destroyed transform are attached to its parent
+    void destroy(TransformId id);
+    void clear();
+
+    void set_parent(TransformId id, TransformId parent);
+    TransformId get_parent(TransformId id) const { return m_parents[id]; }
+
+    void set_local_position(TransformId id, const Vector3& position);
+    // rotation quaternion as (x, y, z, w)
+    void set_local_rotation(TransformId id, const Vector4& rotation);
+    void set_local_scale(TransformId id, const Vector3& scale);
+
+    Vector3 get_local_position(TransformId id) const;
+    Vector4 get_local_rotation(TransformId id) const;
+    Vector3 get_local_scale(TransformId id) const;
+
+    // recomputes world matrices of changed subtrees and world-view-projection matrices of changed transforms; all
+    // world-view-projection matrices are recomputed when view_proj differs from the previous update
+    void update(const Matrix44& view_proj);
+
+    const Matrix44& get_world_matrix(TransformId id) const { return m_world[m_dense_of_id[id]]; }
+    const Matrix44& get_world_view_proj_matrix(TransformId id) const { return m_world_view_proj[m_dense_of_id[id]]; }
+
+    // dense access in update order, valid until the next update
+    u32 get_count() const { return static_cast<u32>(m_ids.size()); }
+    const TransformId* get_ids() const { return m_ids.data(); }
+    const Matrix44* get_world_matrices() const { return m_world.data(); }
+    const Matrix44* get_world_view_proj_matrices() const { return m_world_view_proj.data(); }
+    // per dense index; non-zero when the world-view-projection matrix changed in the last update
+    const u8* get_changed_flags() const { return m_changed.data(); }
+    // per dense index; non-zero when the world matrix was recomputed in the last update
+    const u8* get_world_changed_flags() const { return m_world_changed.data(); }
+
+    // number of world matrices recomputed by the last update
+    u32 get_last_update_count() const { return m_last_update_count; }
+
+  private:
+    void rebuild_layout();
+    void update_level(u32 begin, u32 end);
+    bool is_alive(TransformId id) const { return id < m_parents.size() && m_dense_of_id[id] != k_invalid_transform; }
+
+  private:
+    // per id
+    std::vector<TransformId> m_parents;
+    // children are only searched for when destroying a transform that has some
+    std::vector<u32> m_child_counts;
+    std::vector<u32> m_dense_of_id;
+    std::vector<TransformId> m_free_ids;
+
+    // per dense index, sorted by depth
+    std::vector<TransformId> m_ids;
+    std::vector<u32> m_parent_dense;
+    std::vector<f32> m_pos_x, m_pos_y, m_pos_z;
+    std::vector<f32> m_rot_x, m_rot_y, m_rot_z, m_rot_w;
+    std::vector<f32> m_scale_x, m_scale_y, m_scale_z;
+    std::vector<u8> m_dirty;
+    std::vector<u8> m_changed;
+    std::vector<u8> m_world_changed;
+    std::vector<Matrix44> m_world;
+    std::vector<Matrix44> m_world_view_proj;
+
+    // dense index ranges of the depth levels
+    std::vector<u32> m_level_begin;
+
+    Matrix44 m_view_proj{};
+    bool m_layout_dirty{ false };
+    bool m_view_proj_valid{ false };
+    u32 m_last_update_count{ 0 };
+  };
+}
@@ -4,15 +4,71 @@
  */
 
 #include <Stats.h>
+#include <Core/StringBuilder.h>
 #include <Core/Time.h>
 
+#include <string_view>
+#include <utility>
+
 #include <ThirdParty/sdl-imgui/imgui_impl_sdl.h>
 
+namespace
+{
+  // One line per frame section: IPC tells compute- from memory-bound code, LLC misses how much goes to memory
+  void imgui_counter_line(const char* name, u32 depth, f32 time_ms, const zv::PerfCounterValues& counters)
+  {
+    // formatted once on the stack and handed to imgui as is, which does not format it again
+    zv::StringBuilder<256> line;
+    line.format("{:{}}{}: {:.3f} ms, IPC ", "", depth * 2, name, time_ms);
+    if (counters.has(zv::ePerfCounter::Cycles) && counters.has(zv::ePerfCounter::Instructions))
+    {
+      line.format("{:.2f}", counters.get_ipc());
+    }
+    else
+    {
+      line.append("n/a");
+    }
+
+    const std::pair<const char*, zv::ePerfCounter> counts[] =
+    {
+      { ", LLC misses ", zv::ePerfCounter::CacheMisses },
+      { ", branch misses ", zv::ePerfCounter::BranchMisses },
+      { ", switches ", zv::ePerfCounter::ContextSwitches },
+    };
+    for (const auto& [label, counter] : counts)
+    {
+      line.append(label);
+      if (counters.has(counter))
+      {
+        line.format("{}", counters.get(counter));
+      }
+      else
+      {
+        line.append("n/a");
+      }
+    }
+
+    const std::string_view text = line.get_view();
+    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+  }
+}
+
 
 void zv::Stats::update()
 {
-  m_frame_time_ms_avg.update(Time::elapsed_time_s(), Time::delta_time_s() * 1000.0f);
-  m_fps_avg.update(Time::elapsed_time_s(), 1.0f / Time::delta_time_s());
+  // measured frame times, replays tick with the recorded deltas
+  m_frame_time_ms_avg.update(Time::elapsed_time_s(), Time::frame_time_s() * 1000.0f);
+  m_fps_avg.update(Time::elapsed_time_s(), 1.0f / Time::frame_time_s());
+}
+
+void zv::Stats::set_gpu_stats(const GpuFrameStats& gpu_stats, bool timing_supported)
+{
+  m_gpu_timing_supported = timing_supported;
+  if (gpu_stats.valid && (!m_gpu_stats.valid || gpu_stats.frame_index != m_gpu_stats.frame_index))
+  {
+    m_gpu_frame_time_ms_avg.update(Time::elapsed_time_s(), gpu_stats.frame_time_ms);
+  }
+  m_gpu_stats = gpu_stats;
 }
 
 void zv::Stats::imgui_update()
@@ -20,5 +76,69 @@ void zv::Stats::imgui_update()
   ImGui::Begin("Engine Stats");
   ImGui::Text("FPS: %.1f", m_fps_avg.get_average());
   ImGui::Text("Frame Time: %.6f ms", m_frame_time_ms_avg.get_average());
+  if (m_gpu_timing_supported)
+  {
+    // The GPU only bounds the frame if it is busy for about the whole frame, otherwise the CPU (or vsync) does
+    const f32 gpu_time_ms = m_gpu_frame_time_ms_avg.get_average();
+    ImGui::Text("GPU Time: %.6f ms (%s)", gpu_time_ms, gpu_time_ms >= 0.9f * m_frame_time_ms_avg.get_average() ? "GPU-bound" : "CPU-bound");
+  }
+  else
+  {
+    ImGui::Text("GPU Time: n/a");
+  }
+  ImGui::Text("Draw Calls: %u", m_draw_stats.draw_count);
+  ImGui::Text("Pipeline Changes: %u", m_draw_stats.pipeline_changes);
+  ImGui::Text("SRB Commits: %u", m_draw_stats.srb_commits);
+  ImGui::Text("Vertex / Index Buffer Binds: %u / %u", m_draw_stats.vertex_buffer_binds, m_draw_stats.index_buffer_binds);
+
+  if (m_gpu_stats.valid && ImGui::CollapsingHeader("GPU Passes"))
+  {
+    for (const GpuScopeTiming& scope : m_gpu_stats.scopes)
+    {
+      ImGui::Text("%s: %.3f ms", scope.name, scope.time_ms);
+    }
+  }
+  if (m_gpu_stats.pipeline_statistics_valid && ImGui::CollapsingHeader("Pipeline Statistics"))
+  {
+    ImGui::Text("Input Primitives: %llu", static_cast<unsigned long long>(m_gpu_stats.input_primitives));
+    ImGui::Text("Clipping Primitives: %llu", static_cast<unsigned long long>(m_gpu_stats.clipping_primitives));
+    ImGui::Text("VS Invocations: %llu", static_cast<unsigned long long>(m_gpu_stats.vs_invocations));
+    ImGui::Text("PS Invocations: %llu", static_cast<unsigned long long>(m_gpu_stats.ps_invocations));
+    if (m_gpu_stats.pipeline_statistics_partial)
+    {
+      ImGui::TextDisabled("Immediate context only, deferred command lists are not counted");
+    }
+  }
+  if (ImGui::CollapsingHeader("Device Context Counters"))
+  {
+    ImGui::Text("Draws / Indexed Draws: %u / %u", m_context_counters.draws, m_context_counters.indexed_draws);
+    ImGui::Text("Pipeline Changes: %u", m_context_counters.pipeline_changes);
+    ImGui::Text("SRB Commits: %u", m_context_counters.srb_commits);
+    ImGui::Text("Vertex / Index Buffer Binds: %u / %u", m_context_counters.vertex_buffer_binds, m_context_counters.index_buffer_binds);
+    ImGui::Text("Render Target Binds: %u", m_context_counters.render_target_binds);
+    ImGui::Text("State Transitions: %u", m_context_counters.transitions);
+    ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(m_context_counters.triangles));
+  }
+  if (ImGui::CollapsingHeader("CPU Counters"))
+  {
+    if (!m_cpu_counters_supported)
+    {
+      ImGui::Text("n/a");
+    }
+    else if (m_cpu_counters.valid)
+    {
+      imgui_counter_line("Frame", 0, m_cpu_counters.time_ms, m_cpu_counters.counters);
+      for (const PerfScopeCounters& scope : m_cpu_counters.scopes)
+      {
+        imgui_counter_line(scope.name, scope.depth + 1, scope.time_ms, scope.counters);
+      }
+    }
+  }
+  if (ImGui::CollapsingHeader("UI"))
+  {
+    ImGui::Text("Built: %llu of %llu frames, %llu changed", static_cast<unsigned long long>(m_imgui_frame_stats.build_count),
+                static_cast<unsigned long long>(m_imgui_frame_stats.frame_count), static_cast<unsigned long long>(m_imgui_frame_stats.changed_count));
+    ImGui::Text("Build Time: %.3f ms", m_imgui_frame_stats.build_time_ms);
+  }
   ImGui::End();
 }
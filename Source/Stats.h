@@ -6,6 +6,7 @@
 #pragma once
 
 #include <Renderer.h>
+#include <Core/PerfCounters.h>
 #include <Core/Utility.h>
 #include <Core/PrimitiveTypes.h>
 
@@ -18,9 +19,29 @@ namespace zv
   {
     MovingAverage<f32, k_sample_size> m_fps_avg{ 5.0f / k_sample_size };
     MovingAverage<f32, k_sample_size> m_frame_time_ms_avg{ 5.0f / k_sample_size };
+    MovingAverage<f32, k_sample_size> m_gpu_frame_time_ms_avg{ 5.0f / k_sample_size };
+    DrawStats m_draw_stats;
+    GpuFrameStats m_gpu_stats;
+    bool m_gpu_timing_supported{ false };
+    DeviceContextCounters m_context_counters;
+    PerfFrameStats m_cpu_counters;
+    bool m_cpu_counters_supported{ false };
+    ImGuiFrameStats m_imgui_frame_stats;
 
   public:
     void update();
+    // draw calls and state changes of the last submitted frame
+    void set_draw_stats(const DrawStats& draw_stats) { m_draw_stats = draw_stats; }
+    // GPU results lag a few frames behind, only frames not seen before go into the average
+    void set_gpu_stats(const GpuFrameStats& gpu_stats, bool timing_supported);
+    // commands of the last frame on all device contexts
+    void set_context_counters(const DeviceContextCounters& counters) { m_context_counters = counters; }
+    // CPU counters of the last frame and its scopes on the main thread
+    void set_cpu_counters(const PerfFrameStats& counters, bool supported) { m_cpu_counters = counters; m_cpu_counters_supported = supported; }
+    // UI builds so far, including the ones of this panel
+    void set_imgui_frame_stats(const ImGuiFrameStats& stats) { m_imgui_frame_stats = stats; }
     void imgui_update() override;
+    // the averages only move by a window per 0.1 s anyway
+    f32 get_refresh_interval_s() const override { return 0.1f; }
   };
 }
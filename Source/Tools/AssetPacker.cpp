@@ -0,0 +1,230 @@
+/*
+ * AssetPacker.cpp - offline tool that packs an asset directory into one archive
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/AssetArchive.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if ZV_ARCHIVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+// Usage: zv_pack <asset directory> <archive> [--compress]
+//
+// Assets are stored in the layout the runtime uploads: textures should already be block-compressed containers (dds,
+// ktx) and meshes .zvmesh files with interleaved vertices, so streaming them is a plain copy out of the mapping.
+// --compress compresses every asset in independent blocks where that saves at least an eighth of its size; assets
+// that should be read without copies are better left uncompressed.
+namespace
+{
+  struct PackedAsset
+  {
+    std::string path;
+    u64 hash;
+    std::vector<u8> stored;
+    u64 size;
+    zv::eArchiveCompression compression;
+  };
+
+  bool read_file(const std::filesystem::path& path, std::vector<u8>& out_data)
+  {
+    std::ifstream file{ path, std::ios::binary | std::ios::ate };
+    if (!file.is_open())
+    {
+      return false;
+    }
+
+    out_data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(out_data.data()), static_cast<std::streamsize>(out_data.size())));
+  }
+
+  // replaces data with its block-compressed form if that is worth it
+  bool compress(std::vector<u8>& inout_data, zv::eArchiveCompression& out_compression)
+  {
+    out_compression = zv::eArchiveCompression::None;
+
+#if ZV_ARCHIVE_ZSTD
+    const u64 block_count = (inout_data.size() + zv::k_archive_block_size - 1) / zv::k_archive_block_size;
+    std::vector<u8> compressed(block_count * sizeof(u32));
+    std::vector<u8> block_data(ZSTD_compressBound(zv::k_archive_block_size));
+
+    for (u64 block = 0; block < block_count; ++block)
+    {
+      const u64 offset = block * zv::k_archive_block_size;
+      const u64 size = std::min(zv::k_archive_block_size, u64(inout_data.size()) - offset);
+      const size_t compressed_size = ZSTD_compress(block_data.data(), block_data.size(), inout_data.data() + offset, size, 19);
+      if (ZSTD_isError(compressed_size))
+      {
+        return false;
+      }
+
+      const u32 stored_size = static_cast<u32>(compressed_size);
+      std::memcpy(compressed.data() + block * sizeof(u32), &stored_size, sizeof(u32));
+      compressed.insert(compressed.end(), block_data.begin(), block_data.begin() + compressed_size);
+    }
+
+    if (compressed.size() <= inout_data.size() - inout_data.size() / 8)
+    {
+      inout_data.swap(compressed);
+      out_compression = zv::eArchiveCompression::Zstd;
+    }
+    return true;
+#else
+    (void)inout_data;
+    return true;
+#endif
+  }
+
+  void write_padding(std::ofstream& file, u64& inout_offset, u64 alignment)
+  {
+    static const char k_zeros[zv::k_archive_alignment] = {};
+    const u64 padding = (alignment - inout_offset % alignment) % alignment;
+    file.write(k_zeros, static_cast<std::streamsize>(padding));
+    inout_offset += padding;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <asset directory> <archive> [--compress]\n", argv[0]);
+    return 1;
+  }
+
+  const std::filesystem::path root = argv[1];
+  const char* archive_path = argv[2];
+  const bool use_compression = argc > 3 && std::strcmp(argv[3], "--compress") == 0;
+
+#if !ZV_ARCHIVE_ZSTD
+  if (use_compression)
+  {
+    std::fprintf(stderr, "zv_pack was built without zstd, assets are stored uncompressed.\n");
+  }
+#endif
+
+  std::vector<PackedAsset> assets;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator{ root, error })
+  {
+    if (!entry.is_regular_file())
+    {
+      continue;
+    }
+
+    PackedAsset asset;
+    asset.path = entry.path().lexically_relative(root).generic_string();
+    asset.hash = zv::hash_archive_path(asset.path.c_str());
+    if (!read_file(entry.path(), asset.stored))
+    {
+      std::fprintf(stderr, "Failed to read '%s'.\n", entry.path().string().c_str());
+      return 1;
+    }
+
+    asset.size = asset.stored.size();
+    asset.compression = zv::eArchiveCompression::None;
+    if (use_compression && !compress(asset.stored, asset.compression))
+    {
+      std::fprintf(stderr, "Failed to compress '%s'.\n", asset.path.c_str());
+      return 1;
+    }
+    assets.push_back(std::move(asset));
+  }
+
+  if (error)
+  {
+    std::fprintf(stderr, "Failed to list '%s'.\n", root.string().c_str());
+    return 1;
+  }
+
+  // the runtime binary searches the index by hash, so hashes have to be unique
+  std::sort(assets.begin(), assets.end(), [](const PackedAsset& a, const PackedAsset& b) { return a.hash < b.hash; });
+  for (size_t i = 1; i < assets.size(); ++i)
+  {
+    if (assets[i].hash == assets[i - 1].hash)
+    {
+      std::fprintf(stderr, "Path hash collision between '%s' and '%s'.\n", assets[i - 1].path.c_str(), assets[i].path.c_str());
+      return 1;
+    }
+  }
+
+  const std::string temp_path = std::string{ archive_path } + ".tmp";
+  std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+  if (!file.is_open())
+  {
+    std::fprintf(stderr, "Failed to create '%s'.\n", archive_path);
+    return 1;
+  }
+
+  // the header is written last, once the offsets are known
+  zv::ArchiveHeader header{};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  u64 offset = sizeof(header);
+
+  std::vector<zv::ArchiveEntry> entries;
+  std::string strings;
+  u64 total_size = 0;
+  u64 total_stored = 0;
+  for (const PackedAsset& asset : assets)
+  {
+    write_padding(file, offset, zv::k_archive_alignment);
+
+    zv::ArchiveEntry entry{};
+    entry.path_hash   = asset.hash;
+    entry.offset      = offset;
+    entry.stored_size = asset.stored.size();
+    entry.size        = asset.size;
+    entry.compression = asset.compression;
+    entry.path_offset = static_cast<u32>(strings.size());
+    entry.path_length = static_cast<u32>(asset.path.size());
+    entries.push_back(entry);
+    strings += asset.path;
+
+    file.write(reinterpret_cast<const char*>(asset.stored.data()), static_cast<std::streamsize>(asset.stored.size()));
+    offset += asset.stored.size();
+    total_size += asset.size;
+    total_stored += asset.stored.size();
+  }
+
+  write_padding(file, offset, alignof(zv::ArchiveEntry));
+  header.index_offset = offset;
+  file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(zv::ArchiveEntry)));
+  offset += entries.size() * sizeof(zv::ArchiveEntry);
+
+  header.strings_offset = offset;
+  file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+  header.magic       = zv::k_archive_magic;
+  header.version     = zv::k_archive_version;
+  header.entry_count = static_cast<u32>(entries.size());
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.close();
+
+  if (!file)
+  {
+    std::fprintf(stderr, "Failed to write '%s'.\n", archive_path);
+    return 1;
+  }
+
+  std::filesystem::rename(temp_path, archive_path, error);
+  if (error)
+  {
+    std::fprintf(stderr, "Failed to replace '%s'.\n", archive_path);
+    return 1;
+  }
+
+  std::printf("Packed %zu assets, %llu bytes into %llu bytes.\n", assets.size(), static_cast<unsigned long long>(total_size),
+              static_cast<unsigned long long>(total_stored));
+  return 0;
+}
@@ -0,0 +1,403 @@
+/*
+ * Bench.cpp - micro-benchmarks of the core utilities with JSON output and baseline comparison
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/Benchmark.h>
+#include <Tools/BenchSuites.h>
+#include <Core/Format.h>
+#include <Core/JobSystem.h>
+#include <Core/Logger.h>
+#include <Core/StringBuilder.h>
+#include <Core/StringId.h>
+#include <Core/Utility.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+// Usage: zv_bench [--filter=<text>] [--samples=<count>] [--min-time-ms=<ms>] [--cpu=<index>] [--json=<file>]
+//                 [--baseline=<file>] [--alpha=<p>] [--threshold=<percent>] [--checks-only]
+//
+// Runs every benchmark whose name contains the filter and prints median and MAD of the time per iteration. The checks
+// matching the filter run first and compare optimized code against a reference; the exit code is 1 if one fails, and
+// --checks-only stops after them. --json writes the results including all samples; a file written that way can be
+// passed as --baseline to a later run, which then tests every benchmark against it and exits with 1 if one got
+// significantly slower (Mann-Whitney U test at --alpha, 0.01 by default, and a median change above --threshold
+// percent, 5 by default). Pin the benchmark thread with --cpu for runs that are compared.
+namespace
+{
+  void add_moving_average_benchmarks(zv::BenchmarkRunner& runner)
+  {
+    runner.add("MovingAverage::update, same window", [](u64 iteration_count)
+    {
+      zv::MovingAverage<f32, 50> average{ 1.0e30f };
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        average.update(1.0f, static_cast<f32>(i & 15));
+      }
+      zv::do_not_optimize(average);
+    });
+
+    // a negative sample rate closes the window on every update, the time does not need to advance
+    runner.add("MovingAverage::update, new window", [](u64 iteration_count)
+    {
+      zv::MovingAverage<f32, 50> average{ -1.0f };
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        average.update(1.0f, static_cast<f32>(i & 15));
+      }
+      zv::do_not_optimize(average.get_average());
+    });
+  }
+
+  void add_format_benchmarks(zv::BenchmarkRunner& runner)
+  {
+    runner.add("vformat, integers", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const u32 frame = static_cast<u32>(i);
+        const s32 offset = -static_cast<s32>(i & 1023);
+        const std::string text = zv::vformat("frame {} offset {} mask {:#x}", zv::make_format_args(frame, offset, frame));
+        zv::do_not_optimize(text);
+      }
+    });
+
+    runner.add("vformat, floats", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const f32 time_ms = static_cast<f32>(i & 1023) * 0.0625f;
+        const f64 ratio = 1.0 / static_cast<f64>(i + 1);
+        const std::string text = zv::vformat("{:.3f} ms, {:.2f} fps, {}", zv::make_format_args(time_ms, 1000.0f / (time_ms + 1.0f), ratio));
+        zv::do_not_optimize(text);
+      }
+    });
+
+    runner.add("vformat, strings", [](u64 iteration_count)
+    {
+      const std::string path = "Assets/Textures/DGLogo.png";
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const char* ptr_state = (i & 1) ? "resident" : "loading";
+        const std::string text = zv::vformat("Texture '{}' is {}.", zv::make_format_args(path, ptr_state));
+        zv::do_not_optimize(text);
+      }
+    });
+
+    // the same texts into a builder on the stack, which does not allocate
+    runner.add("StringBuilder, integers", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const u32 frame = static_cast<u32>(i);
+        const s32 offset = -static_cast<s32>(i & 1023);
+        zv::StringBuilder<128> text;
+        text.format("frame {} offset {} mask {:#x}", frame, offset, frame);
+        zv::do_not_optimize(text.get_view());
+      }
+    });
+
+    runner.add("StringBuilder, strings", [](u64 iteration_count)
+    {
+      const std::string path = "Assets/Textures/DGLogo.png";
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const char* ptr_state = (i & 1) ? "resident" : "loading";
+        zv::StringBuilder<128> text;
+        text.format("Texture '{}' is {}.", path, ptr_state);
+        zv::do_not_optimize(text.get_view());
+      }
+    });
+  }
+
+  // the text of the id made at this call site, so several threads can race for its first use
+  zv::StringId get_bench_string_id()
+  {
+    return ZV_STRING_ID("BENCH_STRING_ID");
+  }
+
+  void add_string_id_benchmarks(zv::BenchmarkRunner& runner)
+  {
+    // hash_bytes() against published FNV-1a test vectors, and strings hashed with their terminator as hash_string() does
+    runner.add_check("hash_string, FNV-1a values", []()
+    {
+      static_assert(zv::StringId("a").get_hash() == 0x089be207b544f1e4ull, "literals have to be hashed at compile time");
+      const bool bytes_ok = zv::hash_bytes("", 0) == 0xcbf29ce484222325ull && zv::hash_bytes("a", 1) == 0xaf63dc4c8601ec8cull &&
+                            zv::hash_bytes("foobar", 6) == 0x85944171f73967e8ull;
+      const std::string runtime = "g_Texture";
+      const bool string_ok = zv::hash_string("a") == 0x089be207b544f1e4ull && zv::hash_string(runtime.c_str()) == 0x2353fad0970d0f9eull &&
+                             zv::hash_string(std::string_view{ runtime }) == zv::hash_bytes(runtime.c_str(), runtime.size() + 1) &&
+                             zv::hash_string(static_cast<const char*>(nullptr)) == zv::hash_string("");
+      if (!bytes_ok || !string_ok)
+      {
+        std::printf("    bytes %s, strings %s, \"g_Texture\" hashes to %016llx\n", bytes_ok ? "ok" : "wrong", string_ok ? "ok" : "wrong",
+                    static_cast<unsigned long long>(zv::hash_string(runtime.c_str())));
+      }
+      return bytes_ok && string_ok;
+    });
+
+    // literals, interned runtime strings and ZV_STRING_ID of the same text are one id, and its text is stored once
+    runner.add_check("StringId::intern, identity", []()
+    {
+      const std::string runtime = std::string{ "BENCH_" } + "INTERNED";
+      const zv::StringId interned = zv::StringId::intern(runtime);
+      const zv::StringId again = zv::StringId::intern(std::string_view{ "BENCH_INTERNED_TAIL" }.substr(0, runtime.size()));
+      const bool same = interned == zv::StringId("BENCH_INTERNED") && again == interned;
+      const bool stored_once = interned.get_string() != nullptr && interned.get_string() == again.get_string() &&
+                               runtime == interned.get_string();
+      // a literal that was only hashed has no text, nor has the default id
+      const bool unresolved = zv::StringId("BENCH_NEVER_INTERNED").get_string() == nullptr && !zv::StringId().is_valid() &&
+                              zv::StringId().get_string() == nullptr;
+      const bool macro_ok = get_bench_string_id() == zv::StringId("BENCH_STRING_ID") && get_bench_string_id().get_string() != nullptr;
+      if (!same || !stored_once || !unresolved || !macro_ok)
+      {
+        std::printf("    same id %s, text stored once %s, unresolved ids %s, ZV_STRING_ID %s\n", same ? "yes" : "no",
+                    stored_once ? "yes" : "no", unresolved ? "ok" : "wrong", macro_ok ? "ok" : "wrong");
+      }
+      return same && stored_once && unresolved && macro_ok;
+    });
+
+    // workers intern their own strings while they all use the same ZV_STRING_ID call site
+    runner.add_check("StringId::intern, from all threads", []()
+    {
+      constexpr u32 k_string_count = 1000;
+      std::vector<zv::StringId> ids(k_string_count);
+      std::vector<u8> macro_ok(k_string_count, 0);
+      zv::Jobs::parallel_for(k_string_count, 1, [&](u32 begin, u32 end)
+      {
+        for (u32 i = begin; i < end; ++i)
+        {
+          ids[i] = zv::StringId::intern("Bench/Strings/" + std::to_string(i));
+          const zv::StringId macro_id = get_bench_string_id();
+          macro_ok[i] = macro_id == zv::StringId("BENCH_STRING_ID") && std::strcmp(macro_id.get_string(), "BENCH_STRING_ID") == 0;
+        }
+      });
+
+      u32 wrong_count = 0;
+      for (u32 i = 0; i < k_string_count; ++i)
+      {
+        const std::string expected = "Bench/Strings/" + std::to_string(i);
+        const char* ptr_text = ids[i].get_string();
+        wrong_count += ids[i] != zv::StringId::intern(expected) || ptr_text == nullptr || expected != ptr_text || !macro_ok[i];
+      }
+      if (wrong_count != 0)
+      {
+        std::printf("    %u of %u strings have a wrong id or text\n", wrong_count, k_string_count);
+      }
+      return wrong_count == 0;
+    });
+
+    runner.add("StringId::intern, known string", [](u64 iteration_count)
+    {
+      const std::string path = "Assets/Textures/DGLogo.png";
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        zv::do_not_optimize(zv::StringId::intern(path));
+      }
+    });
+
+    // after the first call only the function-local static is checked
+    runner.add("ZV_STRING_ID", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        zv::do_not_optimize(get_bench_string_id());
+      }
+    });
+  }
+
+  void add_logger_benchmarks(zv::BenchmarkRunner& runner)
+  {
+    // only tags with k_logflag_keep_in_history end up in the history, unformatted if they are not written anywhere
+    runner.add_check("Logger::get_history", []()
+    {
+      zv::Logger::set_tag_config("BENCH_HISTORY", zv::k_logflag_keep_in_history, zv::FormatColor::light_gray);
+      zv::Logger::log("BENCH_OFF", "Not kept {}.", zv::make_format_args(1), NULL, NULL, 0);
+      zv::Logger::log("BENCH_HISTORY", "Kept {}.", zv::make_format_args(2), NULL, NULL, 0);
+      zv::Logger::set_tag_config("BENCH_HISTORY", 0, zv::FormatColor::light_gray);
+
+      std::vector<zv::Logger::LogRecord> records;
+      zv::Logger::get_history(records);
+      const bool kept = !records.empty() && records.back().tag == "BENCH_HISTORY" && records.back().message == "Kept {}.";
+      const bool dropped = std::none_of(records.begin(), records.end(), [](const zv::Logger::LogRecord& record) { return record.message == "Not kept {}."; });
+      if (!kept || !dropped)
+      {
+        std::printf("    %zu records, history tag kept: %s, disabled tag dropped: %s\n", records.size(), kept ? "yes" : "no", dropped ? "yes" : "no");
+      }
+      return kept && dropped;
+    });
+
+    // a tag without flags is not registered, which is the cost of a log call that is switched off
+    // pipeline compiles and streaming log from workers; every message has to arrive whole
+    runner.add_check("Logger::log, from all threads", []()
+    {
+      constexpr u32 k_message_count = 200;
+      zv::Logger::set_tag_config("BENCH_THREADS", zv::k_logflag_write_to_log_file | zv::k_logflag_keep_in_history, zv::FormatColor::light_gray);
+      zv::Jobs::parallel_for(k_message_count, 1, [](u32 begin, u32 end)
+      {
+        for (u32 i = begin; i < end; ++i)
+        {
+          zv::Logger::log("BENCH_THREADS", "Message {} of a worker.", zv::make_format_args(i), NULL, NULL, 0);
+        }
+      });
+      zv::Logger::set_tag_config("BENCH_THREADS", 0, zv::FormatColor::light_gray);
+
+      std::vector<zv::Logger::LogRecord> records;
+      zv::Logger::get_history(records);
+      std::vector<u8> seen(k_message_count, 0);
+      for (const zv::Logger::LogRecord& record : records)
+      {
+        u32 index = 0;
+        if (record.tag == "BENCH_THREADS" && std::sscanf(record.message.c_str(), "[BENCH_THREADS][%*[^]]] Message %u of a worker.", &index) == 1 &&
+            index < k_message_count)
+        {
+          seen[index] = 1;
+        }
+      }
+      const u32 seen_count = static_cast<u32>(std::count(seen.begin(), seen.end(), 1));
+      if (seen_count != k_message_count)
+      {
+        std::printf("    %u of %u messages in the history\n", seen_count, k_message_count);
+      }
+      return seen_count == k_message_count;
+    });
+
+    runner.add("Logger::log, disabled tag", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const u64 frame = i;
+        zv::Logger::log("BENCH_OFF", "Frame {} took {:.3f} ms.", zv::make_format_args(frame, 16.6f), NULL, NULL, 0);
+      }
+    });
+
+    runner.add("Logger::log, log file", [](u64 iteration_count)
+    {
+      for (u64 i = 0; i < iteration_count; ++i)
+      {
+        const u64 frame = i;
+        zv::Logger::log("BENCH", "Frame {} took {:.3f} ms.", zv::make_format_args(frame, 16.6f), NULL, NULL, 0);
+      }
+    });
+  }
+
+  bool parse_f64(const char* arg, const char* prefix, f64& out_value)
+  {
+    const size_t length = std::strlen(prefix);
+    return std::strncmp(arg, prefix, length) == 0 && std::sscanf(arg + length, "%lf", &out_value) == 1;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  zv::BenchmarkRunner::Options options;
+  const char* ptr_json_path = nullptr;
+  const char* ptr_baseline_path = nullptr;
+  f64 alpha = 0.01;
+  f64 threshold_percent = 5.0;
+  bool checks_only = false;
+  for (s32 i = 1; i < argc; ++i)
+  {
+    const char* arg = argv[i];
+    if (std::strncmp(arg, "--filter=", 9) == 0)
+    {
+      options.ptr_filter = arg + 9;
+    }
+    else if (std::strncmp(arg, "--json=", 7) == 0)
+    {
+      ptr_json_path = arg + 7;
+    }
+    else if (std::strncmp(arg, "--baseline=", 11) == 0)
+    {
+      ptr_baseline_path = arg + 11;
+    }
+    else if (std::strcmp(arg, "--checks-only") == 0)
+    {
+      checks_only = true;
+    }
+    else if (std::sscanf(arg, "--samples=%u", &options.sample_count) == 1 || std::sscanf(arg, "--cpu=%d", &options.cpu) == 1 ||
+             parse_f64(arg, "--min-time-ms=", options.min_sample_time_ms) || parse_f64(arg, "--alpha=", alpha) ||
+             parse_f64(arg, "--threshold=", threshold_percent))
+    {
+    }
+    else
+    {
+      std::fprintf(stderr, "Usage: %s [--filter=<text>] [--samples=<count>] [--min-time-ms=<ms>] [--cpu=<index>] [--json=<file>] "
+                           "[--baseline=<file>] [--alpha=<p>] [--threshold=<percent>] [--checks-only]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // the log file goes to the temp directory, not next to the executable
+  const std::string log_base_path = (std::filesystem::temp_directory_path() / "zv_bench").string() + "/";
+  if (!zv::Logger::create(log_base_path.c_str()))
+  {
+    std::fprintf(stderr, "Failed to create the log in '%s'.\n", log_base_path.c_str());
+    return 1;
+  }
+  zv::Logger::set_tag_config("BENCH", zv::k_logflag_write_to_log_file, zv::FormatColor::light_gray);
+  // the workers sleep unless a benchmark splits its work across them
+  zv::Jobs::create();
+
+  zv::BenchmarkRunner runner;
+  add_moving_average_benchmarks(runner);
+  add_format_benchmarks(runner);
+  add_string_id_benchmarks(runner);
+  add_logger_benchmarks(runner);
+  zv::add_job_system_benchmarks(runner);
+  zv::add_frame_time_baseline_benchmarks(runner);
+  zv::add_resource_manager_benchmarks(runner);
+  zv::add_simd_benchmarks(runner);
+  zv::add_culling_benchmarks(runner);
+  zv::add_bvh_benchmarks(runner);
+  zv::add_transform_system_benchmarks(runner);
+  zv::add_instance_data_benchmarks(runner);
+  zv::add_draw_queue_benchmarks(runner);
+  zv::add_frame_graph_benchmarks(runner);
+
+  s32 exit_code = 0;
+  const u32 failed_check_count = runner.run_checks(options);
+  if (failed_check_count > 0)
+  {
+    std::fprintf(stderr, "%u checks failed.\n", failed_check_count);
+    exit_code = 1;
+  }
+  if (checks_only)
+  {
+    zv::Jobs::destroy();
+    zv::Logger::destroy();
+    return exit_code;
+  }
+
+  runner.run(options);
+  if (ptr_json_path && !runner.write_json(ptr_json_path))
+  {
+    std::fprintf(stderr, "Failed to write '%s'.\n", ptr_json_path);
+    exit_code = 1;
+  }
+
+  if (ptr_baseline_path)
+  {
+    zv::BenchmarkRunner::Comparison comparison;
+    if (!runner.compare(ptr_baseline_path, alpha, threshold_percent / 100.0, comparison))
+    {
+      std::fprintf(stderr, "Failed to read the baseline '%s'.\n", ptr_baseline_path);
+      exit_code = 1;
+    }
+    else
+    {
+      std::printf("%u compared, %u slower, %u faster\n", comparison.compared_count, comparison.regression_count, comparison.improvement_count);
+      exit_code = comparison.regression_count > 0 ? 1 : exit_code;
+    }
+  }
+
+  zv::Jobs::destroy();
+  zv::Logger::destroy();
+  return exit_code;
+}
@@ -0,0 +1,253 @@
+/*
+ * BenchCore.cpp - benchmarks and checks of the core modules
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/BenchSuites.h>
+#include <Core/JobSystem.h>
+#include <Core/ResourceManager.h>
+#include <FrameTimeBaseline.h>
+
+#include <ThirdParty/DiligentCore/Primitives/interface/Object.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  // each background job takes longer than a parallel_for may
+  constexpr u32 k_background_job_count = 12;
+  constexpr auto k_background_job_time = std::chrono::milliseconds(20);
+
+  f64 elapsed_ms(Clock::time_point start)
+  {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+  }
+
+  // Stands in for a device object, counts the live instances so the checks see when the manager drops them
+  class BenchObject final : public Diligent::IObject
+  {
+  public:
+    static inline std::atomic<s32> s_live_count{ 0 };
+
+    BenchObject() { s_live_count.fetch_add(1, std::memory_order_relaxed); }
+    ~BenchObject() { s_live_count.fetch_sub(1, std::memory_order_relaxed); }
+
+    void DILIGENT_CALL_TYPE QueryInterface(const Diligent::INTERFACE_ID&, Diligent::IObject** out_ptr_interface) override { *out_ptr_interface = nullptr; }
+    Diligent::ReferenceCounterValueType DILIGENT_CALL_TYPE AddRef() override { return ++m_ref_count; }
+    Diligent::ReferenceCounterValueType DILIGENT_CALL_TYPE Release() override
+    {
+      const Diligent::ReferenceCounterValueType ref_count = --m_ref_count;
+      if (ref_count == 0)
+      {
+        delete this;
+      }
+      return ref_count;
+    }
+    Diligent::IReferenceCounters* DILIGENT_CALL_TYPE GetReferenceCounters() const override { return nullptr; }
+
+  private:
+    std::atomic<Diligent::ReferenceCounterValueType> m_ref_count{ 0 };
+  };
+
+  // frames of 16.6 ms with normally distributed jitter of sigma_ms
+  zv::FrameTimeBaseline make_baseline(f32 sigma_ms)
+  {
+    std::mt19937 engine{ 1234 };
+    std::normal_distribution<f32> jitter{ 0.0f, sigma_ms };
+    zv::FrameTimeBaseline baseline;
+    for (u32 i = 0; i < zv::FrameTimeBaseline::k_frame_count; ++i)
+    {
+      baseline.add(16.6f + jitter(engine));
+    }
+    return baseline;
+  }
+}
+
+void zv::add_job_system_benchmarks(BenchmarkRunner& runner)
+{
+  // A frame's parallel_for must not wait for or run background jobs, however many are queued
+  runner.add_check("Jobs::parallel_for, background queued", []()
+  {
+    Jobs::Counter background_counter;
+    std::atomic<u32> background_done_count{ 0 };
+    for (u32 i = 0; i < k_background_job_count; ++i)
+    {
+      Jobs::submit_background([&background_done_count]()
+      {
+        std::this_thread::sleep_for(k_background_job_time);
+        background_done_count.fetch_add(1, std::memory_order_relaxed);
+      }, &background_counter);
+    }
+
+    const Clock::time_point start = Clock::now();
+    std::vector<u32> items(4096, 0);
+    Jobs::parallel_for(static_cast<u32>(items.size()), 64, [&items](u32 begin, u32 end)
+    {
+      for (u32 i = begin; i < end; ++i)
+      {
+        items[i] = i;
+      }
+    });
+    const f64 parallel_for_ms = elapsed_ms(start);
+
+    bool items_done = true;
+    for (u32 i = 0; i < items.size(); ++i)
+    {
+      items_done &= items[i] == i;
+    }
+
+    Jobs::wait(background_counter);
+    const bool background_done = background_done_count.load(std::memory_order_relaxed) == k_background_job_count;
+
+    // passing means parallel_for ran none of the background jobs
+    const bool fast = parallel_for_ms < 10.0;
+    if (!fast || !items_done || !background_done)
+    {
+      std::printf("    parallel_for took %.2f ms, items %s, %u of %u background jobs ran\n", parallel_for_ms, items_done ? "ok" : "wrong",
+                  background_done_count.load(std::memory_order_relaxed), k_background_job_count);
+    }
+    return fast && items_done && background_done;
+  });
+
+  runner.add("Jobs::parallel_for, 64 chunks", [](u64 iteration_count)
+  {
+    std::vector<u32> items(64 * 256, 0);
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      Jobs::parallel_for(static_cast<u32>(items.size()), 256, [&items](u32 begin, u32 end)
+      {
+        for (u32 k = begin; k < end; ++k)
+        {
+          ++items[k];
+        }
+      });
+    }
+    do_not_optimize(items.data());
+  });
+}
+
+void zv::add_frame_time_baseline_benchmarks(BenchmarkRunner& runner)
+{
+  // the scaled MAD of single frames estimates their jitter, so the threshold in MADs decides what is a spike
+  runner.add_check("FrameTimeBaseline, threshold_mads", []()
+  {
+    constexpr f32 k_sigma_ms = 1.0f;
+    constexpr f32 k_min_excess_ms = 2.0f;
+    const FrameTimeBaseline baseline = make_baseline(k_sigma_ms);
+    const f32 sigma_estimate_ms = 1.4826f * baseline.get_mad_ms();
+    const bool sigma_ok = baseline.is_ready() && sigma_estimate_ms > 0.8f * k_sigma_ms && sigma_estimate_ms < 1.2f * k_sigma_ms;
+
+    // five sigmas above the median are a spike at three MADs, but not at eight
+    const f32 spike_ms = baseline.get_median_ms() + 5.0f * k_sigma_ms;
+    const bool tight_detects = spike_ms > baseline.get_threshold_ms(3.0f, k_min_excess_ms);
+    const bool loose_ignores = spike_ms < baseline.get_threshold_ms(8.0f, k_min_excess_ms);
+    // without jitter only the minimum excess is left
+    const FrameTimeBaseline steady = make_baseline(0.0f);
+    const bool min_excess_ok = std::abs(steady.get_threshold_ms(8.0f, k_min_excess_ms) - (16.6f + k_min_excess_ms)) < 1e-4f;
+
+    if (!sigma_ok || !tight_detects || !loose_ignores || !min_excess_ok)
+    {
+      std::printf("    median %.3f ms, sigma estimate %.3f ms, thresholds %.3f ms at 3 MADs and %.3f ms at 8 MADs for a %.3f ms frame\n",
+                  baseline.get_median_ms(), sigma_estimate_ms, baseline.get_threshold_ms(3.0f, k_min_excess_ms),
+                  baseline.get_threshold_ms(8.0f, k_min_excess_ms), spike_ms);
+    }
+    return sigma_ok && tight_detects && loose_ignores && min_excess_ok;
+  });
+
+  runner.add("FrameTimeBaseline::add, full ring", [](u64 iteration_count)
+  {
+    FrameTimeBaseline baseline = make_baseline(1.0f);
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      baseline.add(16.6f + static_cast<f32>(i % 7) * 0.1f);
+    }
+    do_not_optimize(baseline.get_mad_ms());
+  });
+}
+
+void zv::add_resource_manager_benchmarks(BenchmarkRunner& runner)
+{
+  // Requests from several threads while the first load is still running share its job and its object
+  runner.add_check("ResourceManager::load, coalesced", []()
+  {
+    constexpr u32 k_request_count = 16;
+    constexpr u32 k_release_delay_frames = 2;
+    ResourceManager resources;
+    resources.create(ResourceManager::CreateParams{ 16, k_release_delay_frames });
+
+    std::atomic<u32> load_count{ 0 };
+    const ResourceManager::CreateFn load = [&load_count]()
+    {
+      load_count.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return RefCntAutoPtr<IObject>{ new BenchObject };
+    };
+
+    const ResourceId id = make_resource_id("Bench/Textures/shared.png");
+    std::vector<ResourceHandle> handles(k_request_count);
+    Jobs::parallel_for(k_request_count, 1, [&](u32 begin, u32 end)
+    {
+      for (u32 i = begin; i < end; ++i)
+      {
+        handles[i] = resources.load(id, "Bench/Textures/shared.png", load);
+      }
+    });
+    resources.wait_for_loads();
+
+    const bool shared = std::all_of(handles.begin(), handles.end(), [&handles](ResourceHandle handle) { return handle == handles[0]; });
+    const bool ready = resources.get_state(handles[0]) == eResourceState::Ready && resources.get(handles[0]) != nullptr;
+    const bool coalesced = load_count.load(std::memory_order_relaxed) == 1 && resources.get_stats().shared_requests == k_request_count - 1;
+
+    // the last release leaves the resource cached for the delay, then the sweep makes every handle of it stale
+    for (ResourceHandle handle : handles)
+    {
+      resources.release(handle);
+    }
+    resources.update();
+    const bool cached = resources.get(handles[0]) != nullptr;
+    for (u32 i = 0; i < k_release_delay_frames; ++i)
+    {
+      resources.update();
+    }
+    const bool stale = resources.get_state(handles[0]) == eResourceState::Invalid && resources.get(handles[0]) == nullptr;
+
+    // loading the id again reuses the slot under a new generation, the old handle stays stale
+    const ResourceHandle reloaded = resources.create(id, "Bench/Textures/shared.png", load);
+    const bool reload_ok = reloaded != handles[0] && resources.get(reloaded) != nullptr && resources.get(handles[0]) == nullptr;
+    resources.release(reloaded);
+    resources.destroy();
+    const bool dropped = BenchObject::s_live_count.load(std::memory_order_relaxed) == 0;
+
+    if (!shared || !ready || !coalesced || !cached || !stale || !reload_ok || !dropped)
+    {
+      std::printf("    %u loads for %u requests, shared %d, ready %d, cached %d, stale %d, reload %d, %d objects alive\n",
+                  load_count.load(std::memory_order_relaxed), k_request_count, shared, ready, cached, stale, reload_ok,
+                  BenchObject::s_live_count.load(std::memory_order_relaxed));
+    }
+    return shared && ready && coalesced && cached && stale && reload_ok && dropped;
+  });
+
+  runner.add("ResourceManager::get", [](u64 iteration_count)
+  {
+    ResourceManager resources;
+    resources.create(ResourceManager::CreateParams{});
+    const ResourceHandle handle = resources.create(make_resource_id("Bench/Buffers/get"), "Bench/Buffers/get", []()
+    {
+      return RefCntAutoPtr<IObject>{ new BenchObject };
+    });
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(resources.get(handle));
+    }
+    resources.release(handle);
+  });
+}
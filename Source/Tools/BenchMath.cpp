@@ -0,0 +1,397 @@
+/*
+ * BenchMath.cpp - benchmarks and checks of the SIMD math library
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/BenchSuites.h>
+#include <Math/Simd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+  constexpr u32 k_matrix_count = 256;
+  // not a multiple of eight, so the AVX2, SSE and scalar tail loops of the batch functions all run
+  constexpr u32 k_point_count = 4099;
+
+  // plain row-major matrices, the reference the SIMD results are compared against
+  template<typename T>
+  struct RefMat4
+  {
+    T m[4][4];
+  };
+
+  template<typename T>
+  RefMat4<T> to_ref(const zv::Matrix44& matrix)
+  {
+    RefMat4<T> out;
+    const f32* p = &matrix._11;
+    for (u32 i = 0; i < 16; ++i)
+    {
+      out.m[i / 4][i % 4] = static_cast<T>(p[i]);
+    }
+    return out;
+  }
+
+  template<typename T>
+  RefMat4<T> ref_mul(const RefMat4<T>& a, const RefMat4<T>& b)
+  {
+    RefMat4<T> out;
+    for (u32 row = 0; row < 4; ++row)
+    {
+      for (u32 col = 0; col < 4; ++col)
+      {
+        out.m[row][col] = a.m[row][0] * b.m[0][col] + a.m[row][1] * b.m[1][col] + a.m[row][2] * b.m[2][col] + a.m[row][3] * b.m[3][col];
+      }
+    }
+    return out;
+  }
+
+  // Gauss-Jordan elimination with partial pivoting
+  template<typename T>
+  RefMat4<T> ref_inverse(RefMat4<T> a)
+  {
+    RefMat4<T> out{};
+    for (u32 i = 0; i < 4; ++i)
+    {
+      out.m[i][i] = T(1);
+    }
+
+    for (u32 col = 0; col < 4; ++col)
+    {
+      u32 pivot = col;
+      for (u32 row = col + 1; row < 4; ++row)
+      {
+        pivot = std::abs(a.m[row][col]) > std::abs(a.m[pivot][col]) ? row : pivot;
+      }
+      std::swap(a.m[col], a.m[pivot]);
+      std::swap(out.m[col], out.m[pivot]);
+
+      const T rcp_pivot = T(1) / a.m[col][col];
+      for (u32 k = 0; k < 4; ++k)
+      {
+        a.m[col][k] *= rcp_pivot;
+        out.m[col][k] *= rcp_pivot;
+      }
+      for (u32 row = 0; row < 4; ++row)
+      {
+        const T factor = a.m[row][col];
+        if (row == col || factor == T(0))
+        {
+          continue;
+        }
+        for (u32 k = 0; k < 4; ++k)
+        {
+          a.m[row][k] -= factor * a.m[col][k];
+          out.m[row][k] -= factor * out.m[col][k];
+        }
+      }
+    }
+    return out;
+  }
+
+  // relative to the magnitude of the expected value, absolute below one
+  bool is_close(f32 value, f64 expected, f64 tolerance)
+  {
+    return std::abs(static_cast<f64>(value) - expected) <= tolerance * std::max(1.0, std::abs(expected));
+  }
+
+  bool compare_matrix(const char* name, u32 index, const zv::Matrix44& value, const RefMat4<f64>& expected, f64 tolerance)
+  {
+    const f32* p = &value._11;
+    for (u32 i = 0; i < 16; ++i)
+    {
+      if (!is_close(p[i], expected.m[i / 4][i % 4], tolerance))
+      {
+        std::printf("    %s of matrix %u: element %u is %.9g, expected %.9g\n", name, index, i, p[i], expected.m[i / 4][i % 4]);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Transforms as they occur in a scene: rotation, non-uniform scale and translation
+  zv::Matrix44 make_affine_matrix(std::mt19937& engine)
+  {
+    std::uniform_real_distribution<f32> unit{ -1.0f, 1.0f };
+    std::uniform_real_distribution<f32> scale{ 0.25f, 4.0f };
+    const zv::Vector3 axis{ unit(engine), unit(engine), unit(engine) + 2.0f };
+    const zv::simd::Quat rotation = zv::simd::quat_from_axis_angle(axis, unit(engine) * 3.14159265f);
+    const zv::simd::Vec4 translation = zv::simd::set(unit(engine) * 100.0f, unit(engine) * 100.0f, unit(engine) * 100.0f, 1.0f);
+    const zv::simd::Vec4 scales = zv::simd::set(scale(engine), scale(engine), scale(engine), 1.0f);
+    return zv::simd::to_matrix44(zv::simd::mat4_from_trs(translation, rotation, scales));
+  }
+
+  // Random matrices made diagonally dominant, so they are general but not close to singular
+  zv::Matrix44 make_general_matrix(std::mt19937& engine)
+  {
+    std::uniform_real_distribution<f32> unit{ -1.0f, 1.0f };
+    zv::Matrix44 matrix;
+    f32* p = &matrix._11;
+    for (u32 i = 0; i < 16; ++i)
+    {
+      p[i] = unit(engine) + ((i % 5 == 0) ? 4.0f : 0.0f);
+    }
+    return matrix;
+  }
+
+  struct MatrixSet
+  {
+    std::vector<zv::Matrix44> affine;
+    std::vector<zv::Matrix44> general;
+  };
+
+  const MatrixSet& get_matrices()
+  {
+    static const MatrixSet s_matrices = []()
+    {
+      MatrixSet matrices;
+      std::mt19937 engine{ 1234 };
+      for (u32 i = 0; i < k_matrix_count; ++i)
+      {
+        matrices.affine.push_back(make_affine_matrix(engine));
+        matrices.general.push_back(make_general_matrix(engine));
+      }
+      return matrices;
+    }();
+    return s_matrices;
+  }
+
+  struct PointSet
+  {
+    std::vector<f32> x, y, z;
+  };
+
+  const PointSet& get_points()
+  {
+    static const PointSet s_points = []()
+    {
+      PointSet points;
+      std::mt19937 engine{ 5678 };
+      std::uniform_real_distribution<f32> coordinate{ -50.0f, 50.0f };
+      for (u32 i = 0; i < k_point_count; ++i)
+      {
+        points.x.push_back(coordinate(engine));
+        points.y.push_back(coordinate(engine));
+        points.z.push_back(coordinate(engine));
+      }
+      return points;
+    }();
+    return s_points;
+  }
+
+  bool check_mul()
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u32 i = 0; i < k_matrix_count; ++i)
+    {
+      const zv::Matrix44& a = matrices.general[i];
+      const zv::Matrix44& b = matrices.affine[(i * 7 + 3) % k_matrix_count];
+      const zv::Matrix44 product = zv::simd::to_matrix44(zv::simd::mul(zv::simd::load(a), zv::simd::load(b)));
+      if (!compare_matrix("simd::mul", i, product, ref_mul(to_ref<f64>(a), to_ref<f64>(b)), 1.0e-5))
+      {
+        return false;
+      }
+    }
+
+    // the batch version against the same reference
+    std::vector<zv::Matrix44> products(k_matrix_count);
+    const zv::Matrix44& b = matrices.general[0];
+    zv::simd::mul_batch(matrices.affine.data(), zv::simd::load(b), products.data(), k_matrix_count);
+    for (u32 i = 0; i < k_matrix_count; ++i)
+    {
+      if (!compare_matrix("simd::mul_batch", i, products[i], ref_mul(to_ref<f64>(matrices.affine[i]), to_ref<f64>(b)), 1.0e-5))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_inverse()
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u32 i = 0; i < k_matrix_count; ++i)
+    {
+      const zv::Matrix44& general = matrices.general[i];
+      const zv::Matrix44 inverse = zv::simd::to_matrix44(zv::simd::inverse(zv::simd::load(general)));
+      if (!compare_matrix("simd::inverse", i, inverse, ref_inverse(to_ref<f64>(general)), 1.0e-4))
+      {
+        return false;
+      }
+
+      const zv::Matrix44& affine = matrices.affine[i];
+      const RefMat4<f64> expected = ref_inverse(to_ref<f64>(affine));
+      const zv::Matrix44 affine_inverse = zv::simd::to_matrix44(zv::simd::inverse(zv::simd::load(affine)));
+      const zv::Matrix44 affine_inverse_fast = zv::simd::to_matrix44(zv::simd::inverse_affine(zv::simd::load(affine)));
+      if (!compare_matrix("simd::inverse, affine", i, affine_inverse, expected, 1.0e-4) ||
+          !compare_matrix("simd::inverse_affine", i, affine_inverse_fast, expected, 1.0e-4))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_transform_points()
+  {
+    const PointSet& points = get_points();
+    const zv::Matrix44& matrix = get_matrices().affine[0];
+    const RefMat4<f64> ref = to_ref<f64>(matrix);
+
+    std::vector<f32> out_x(k_point_count), out_y(k_point_count), out_z(k_point_count);
+    zv::simd::transform_points_soa(zv::simd::load(matrix), points.x.data(), points.y.data(), points.z.data(), out_x.data(),
+                                   out_y.data(), out_z.data(), k_point_count);
+
+    std::vector<zv::Vector3> aos(k_point_count);
+    for (u32 i = 0; i < k_point_count; ++i)
+    {
+      aos[i] = zv::Vector3{ points.x[i], points.y[i], points.z[i] };
+    }
+    zv::simd::transform_points(zv::simd::load(matrix), aos.data(), aos.data(), k_point_count);
+
+    for (u32 i = 0; i < k_point_count; ++i)
+    {
+      const f64 x = points.x[i], y = points.y[i], z = points.z[i];
+      const f64 expected[3] = { x * ref.m[0][0] + y * ref.m[1][0] + z * ref.m[2][0] + ref.m[3][0],
+                                x * ref.m[0][1] + y * ref.m[1][1] + z * ref.m[2][1] + ref.m[3][1],
+                                x * ref.m[0][2] + y * ref.m[1][2] + z * ref.m[2][2] + ref.m[3][2] };
+      const f32 soa[3] = { out_x[i], out_y[i], out_z[i] };
+      const f32 transformed[3] = { aos[i].x, aos[i].y, aos[i].z };
+      for (u32 axis = 0; axis < 3; ++axis)
+      {
+        if (!is_close(soa[axis], expected[axis], 1.0e-5) || !is_close(transformed[axis], expected[axis], 1.0e-5))
+        {
+          std::printf("    point %u, axis %u: soa %.9g, aos %.9g, expected %.9g\n", i, axis, soa[axis], transformed[axis], expected[axis]);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // quat_to_mat4, quat_rotate and quat_mul have to describe the same rotations
+  bool check_quaternions()
+  {
+    std::mt19937 engine{ 91011 };
+    std::uniform_real_distribution<f32> unit{ -1.0f, 1.0f };
+    for (u32 i = 0; i < k_matrix_count; ++i)
+    {
+      const zv::simd::Quat a = zv::simd::quat_from_axis_angle(zv::Vector3{ unit(engine), unit(engine), 1.5f }, unit(engine) * 3.0f);
+      const zv::simd::Quat b = zv::simd::quat_from_axis_angle(zv::Vector3{ 1.5f, unit(engine), unit(engine) }, unit(engine) * 3.0f);
+      const zv::simd::Vec4 v = zv::simd::set(unit(engine), unit(engine), unit(engine), 0.0f);
+
+      const RefMat4<f64> ref = ref_mul(to_ref<f64>(zv::simd::to_matrix44(zv::simd::quat_to_mat4(a))),
+                                       to_ref<f64>(zv::simd::to_matrix44(zv::simd::quat_to_mat4(b))));
+      const zv::Vector4 rotated = zv::simd::to_vector4(zv::simd::quat_rotate(zv::simd::quat_mul(a, b), v));
+      const zv::Vector4 input = zv::simd::to_vector4(v);
+      const f32 result[3] = { rotated.x, rotated.y, rotated.z };
+      for (u32 axis = 0; axis < 3; ++axis)
+      {
+        const f64 expected = input.x * ref.m[0][axis] + input.y * ref.m[1][axis] + input.z * ref.m[2][axis];
+        if (!is_close(result[axis], expected, 1.0e-5))
+        {
+          std::printf("    rotation %u, axis %u: %.9g, expected %.9g\n", i, axis, result[axis], expected);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+void zv::add_simd_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("simd::mul, mul_batch", check_mul);
+  runner.add_check("simd::inverse, inverse_affine", check_inverse);
+  runner.add_check("simd::transform_points, soa", check_transform_points);
+  runner.add_check("simd::quat_mul, quat_rotate", check_quaternions);
+
+  // every iteration handles one matrix; the scalar references run in single precision, like the SIMD code
+  runner.add("simd::mul, mat4", [](u64 iteration_count)
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const simd::Mat4 result = simd::mul(simd::load(matrices.general[i % k_matrix_count]), simd::load(matrices.affine[i % k_matrix_count]));
+      do_not_optimize(result);
+    }
+  });
+
+  runner.add("simd::mul, reference", [](u64 iteration_count)
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const RefMat4<f32> result = ref_mul(to_ref<f32>(matrices.general[i % k_matrix_count]), to_ref<f32>(matrices.affine[i % k_matrix_count]));
+      do_not_optimize(result);
+    }
+  });
+
+  runner.add("simd::inverse, mat4", [](u64 iteration_count)
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const simd::Mat4 result = simd::inverse(simd::load(matrices.general[i % k_matrix_count]));
+      do_not_optimize(result);
+    }
+  });
+
+  runner.add("simd::inverse_affine, mat4", [](u64 iteration_count)
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const simd::Mat4 result = simd::inverse_affine(simd::load(matrices.affine[i % k_matrix_count]));
+      do_not_optimize(result);
+    }
+  });
+
+  runner.add("simd::inverse, reference", [](u64 iteration_count)
+  {
+    const MatrixSet& matrices = get_matrices();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const RefMat4<f32> result = ref_inverse(to_ref<f32>(matrices.general[i % k_matrix_count]));
+      do_not_optimize(result);
+    }
+  });
+
+  // every iteration transforms all points
+  runner.add("simd::transform_points_soa", [](u64 iteration_count)
+  {
+    const PointSet& points = get_points();
+    const simd::Mat4 matrix = simd::load(get_matrices().affine[0]);
+    std::vector<f32> out_x(k_point_count), out_y(k_point_count), out_z(k_point_count);
+    do_not_optimize(out_x.data()); do_not_optimize(out_y.data()); do_not_optimize(out_z.data());
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      simd::transform_points_soa(matrix, points.x.data(), points.y.data(), points.z.data(), out_x.data(), out_y.data(), out_z.data(), k_point_count);
+      clobber_memory();
+    }
+  });
+
+  runner.add("simd::transform_points_soa, reference", [](u64 iteration_count)
+  {
+    const PointSet& points = get_points();
+    const RefMat4<f32> m = to_ref<f32>(get_matrices().affine[0]);
+    std::vector<f32> out_x(k_point_count), out_y(k_point_count), out_z(k_point_count);
+    do_not_optimize(out_x.data()); do_not_optimize(out_y.data()); do_not_optimize(out_z.data());
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      for (u32 j = 0; j < k_point_count; ++j)
+      {
+        const f32 x = points.x[j], y = points.y[j], z = points.z[j];
+        out_x[j] = x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0];
+        out_y[j] = x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1];
+        out_z[j] = x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + m.m[3][2];
+      }
+      clobber_memory();
+    }
+  });
+}
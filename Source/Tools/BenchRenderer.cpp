@@ -0,0 +1,649 @@
+/*
+ * BenchRenderer.cpp - benchmarks and checks of the device-free parts of the renderer
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/BenchSuites.h>
+#include <Math/Half.h>
+#include <Renderer/DrawQueue.h>
+#include <Renderer/FrameGraph.h>
+#include <Renderer/InstanceData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <ThirdParty/DiligentCore/Graphics/GraphicsEngine/interface/GraphicsTypes.h>
+
+namespace
+{
+  constexpr u32 k_instance_count = 65536;
+
+  // every run of dirty flags, then neighbouring runs merged while at most max_gap clean entries lie between them
+  std::vector<zv::InstanceRange> build_dirty_ranges_reference(const std::vector<u8>& dirty, u32 begin, u32 end, u32 max_gap)
+  {
+    std::vector<zv::InstanceRange> ranges;
+    for (u32 i = begin; i < end; ++i)
+    {
+      if (!dirty[i])
+      {
+        continue;
+      }
+
+      if (!ranges.empty() && i - (ranges.back().begin + ranges.back().count) <= max_gap)
+      {
+        ranges.back().count = i + 1 - ranges.back().begin;
+      }
+      else
+      {
+        ranges.push_back(zv::InstanceRange{ i, 1 });
+      }
+    }
+    return ranges;
+  }
+
+  bool check_dirty_ranges(const char* name, const std::vector<u8>& dirty, u32 begin, u32 end, u32 max_gap)
+  {
+    std::vector<zv::InstanceRange> ranges;
+    zv::build_dirty_ranges(dirty.data(), begin, end, max_gap, ranges);
+    const std::vector<zv::InstanceRange> expected = build_dirty_ranges_reference(dirty, begin, end, max_gap);
+
+    bool equal = ranges.size() == expected.size();
+    for (size_t i = 0; equal && i < ranges.size(); ++i)
+    {
+      equal = ranges[i].begin == expected[i].begin && ranges[i].count == expected[i].count;
+    }
+    if (!equal)
+    {
+      std::printf("    %s: %zu ranges, expected %zu\n", name, ranges.size(), expected.size());
+    }
+    return equal;
+  }
+
+  bool check_build_dirty_ranges()
+  {
+    constexpr u32 max_gap = 8;
+    bool ok = true;
+
+    std::vector<u8> dirty(64, 0);
+    ok &= check_dirty_ranges("nothing dirty", dirty, 0, 64, max_gap);
+    ok &= check_dirty_ranges("empty range", dirty, 10, 10, max_gap);
+
+    // runs touching both ends of the range, and flags just outside of it that have to be ignored
+    dirty[0] = dirty[63] = 1;
+    ok &= check_dirty_ranges("first and last", dirty, 0, 64, max_gap);
+    ok &= check_dirty_ranges("outside the range", dirty, 1, 63, max_gap);
+    dirty[1] = dirty[62] = 1;
+    ok &= check_dirty_ranges("runs cut by the range", dirty, 1, 63, max_gap);
+
+    // gaps of exactly max_gap are bridged, one more splits
+    for (u32 gap = max_gap - 1; gap <= max_gap + 1; ++gap)
+    {
+      std::fill(dirty.begin(), dirty.end(), u8(0));
+      dirty[10] = dirty[11 + gap] = 1;
+      ok &= check_dirty_ranges("gap around max_gap", dirty, 0, 64, max_gap);
+      ok &= check_dirty_ranges("gap without merging", dirty, 0, 64, 0);
+      ok &= check_dirty_ranges("gap at the end", dirty, 10, 12 + gap, max_gap);
+    }
+
+    std::fill(dirty.begin(), dirty.end(), u8(1));
+    ok &= check_dirty_ranges("everything dirty", dirty, 0, 64, max_gap);
+
+    // random patterns from a few scattered instances to nearly all of them
+    std::mt19937 engine{ 42 };
+    dirty.resize(4096);
+    for (const f64 density : { 0.001, 0.02, 0.1, 0.5, 0.95 })
+    {
+      std::bernoulli_distribution is_dirty{ density };
+      for (u8& flag : dirty)
+      {
+        flag = is_dirty(engine) ? 1 : 0;
+      }
+      for (const u32 gap : { 0u, 1u, max_gap, 64u })
+      {
+        ok &= check_dirty_ranges("random", dirty, 0, 4096, gap);
+        ok &= check_dirty_ranges("random, partial", dirty, 17, 4000, gap);
+      }
+    }
+    return ok;
+  }
+
+  bool check_half_conversion()
+  {
+    struct Case
+    {
+      f32 value;
+      u16 bits;
+    };
+    // exact values, the largest half, rounding to nearest even, overflow and the smallest denormal
+    const Case cases[] = { { 0.0f, 0x0000 }, { -0.0f, 0x8000 }, { 1.0f, 0x3c00 }, { -2.0f, 0xc000 }, { 0.5f, 0x3800 },
+                           { 65504.0f, 0x7bff }, { 1.0f + 1.0f / 2048.0f, 0x3c00 }, { 1.0f + 3.0f / 2048.0f, 0x3c02 },
+                           { 70000.0f, 0x7c00 }, { -70000.0f, 0xfc00 }, { std::ldexp(1.0f, -24), 0x0001 } };
+    for (const Case& test : cases)
+    {
+      if (zv::f32_to_f16(test.value) != test.bits)
+      {
+        std::printf("    f32_to_f16(%g) = 0x%04x, expected 0x%04x\n", test.value, zv::f32_to_f16(test.value), test.bits);
+        return false;
+      }
+    }
+
+    // every half that is not NaN survives the round trip through f32
+    for (u32 bits = 0; bits <= 0xffff; ++bits)
+    {
+      const bool is_nan = (bits & 0x7c00) == 0x7c00 && (bits & 0x03ff) != 0;
+      const f32 value = zv::f16_to_f32(static_cast<u16>(bits));
+      if (is_nan ? !std::isnan(value) : zv::f32_to_f16(value) != bits)
+      {
+        std::printf("    0x%04x does not survive the round trip\n", bits);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_instance_packing()
+  {
+    std::mt19937 engine{ 7 };
+    std::uniform_real_distribution<f32> value{ -100.0f, 100.0f };
+    std::uniform_real_distribution<f32> color{ 0.0f, 4.0f };
+    for (u32 i = 0; i < 1000; ++i)
+    {
+      // affine, the last column is implied by the packing
+      zv::Matrix44 world = zv::Matrix44::Identity();
+      for (u32 row = 0; row < 4; ++row)
+      {
+        for (u32 column = 0; column < 3; ++column)
+        {
+          world.m[row][column] = value(engine);
+        }
+      }
+
+      zv::PackedInstance instance;
+      zv::pack_instance_transform(world, instance);
+      const zv::Matrix44 unpacked = zv::unpack_instance_transform(instance);
+      for (u32 row = 0; row < 4; ++row)
+      {
+        for (u32 column = 0; column < 4; ++column)
+        {
+          if (unpacked.m[row][column] != world.m[row][column])
+          {
+            std::printf("    the transform changed at [%u][%u]\n", row, column);
+            return false;
+          }
+        }
+      }
+
+      // HDR colours keep 11 significant bits
+      const zv::Vector4 rgba{ color(engine), color(engine), color(engine), color(engine) * 0.25f };
+      zv::pack_instance_color(rgba, instance);
+      const zv::Vector4 unpacked_rgba = zv::unpack_instance_color(instance);
+      const f32 channels[4][2] = { { rgba.x, unpacked_rgba.x }, { rgba.y, unpacked_rgba.y }, { rgba.z, unpacked_rgba.z }, { rgba.w, unpacked_rgba.w } };
+      for (const auto& channel : channels)
+      {
+        // half of the spacing between halves around the value, or of the denormal spacing below the normal range
+        const f32 tolerance = std::max(std::abs(channel[0]) * (1.0f / 2048.0f), std::ldexp(1.0f, -25));
+        if (std::abs(channel[1] - channel[0]) > tolerance)
+        {
+          std::printf("    the colour channel %g came back as %g\n", channel[0], channel[1]);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+namespace
+{
+  using zv::eFrameGraphAccess;
+
+  const zv::FrameGraphTextureDesc k_color_desc{ "Color", 1920, 1080, Diligent::TEX_FORMAT_RGBA8_UNORM };
+  const zv::FrameGraphTextureDesc k_shadow_desc{ "Shadow", 2048, 2048, Diligent::TEX_FORMAT_D32_FLOAT };
+
+  void execute_nothing(zv::IDeviceContext*) {}
+
+  bool expect(bool condition, const char* message)
+  {
+    if (!condition)
+    {
+      std::printf("    %s\n", message);
+    }
+    return condition;
+  }
+
+  bool has_barrier(const std::vector<zv::FrameGraph::Barrier>& barriers, zv::FrameGraphResourceId resource, eFrameGraphAccess before, eFrameGraphAccess after)
+  {
+    return std::any_of(barriers.begin(), barriers.end(), [&](const zv::FrameGraph::Barrier& barrier)
+    {
+      return barrier.resource == resource && barrier.before == before && barrier.after == after;
+    });
+  }
+
+  // a frame like the renderer's: upload, shadows, scene, UI, plus passes nobody needs
+  bool check_frame_graph_frame()
+  {
+    zv::FrameGraph graph;
+    const zv::FrameGraphResourceId back_buffer = graph.import_texture("Back buffer", eFrameGraphAccess::Present);
+    const zv::FrameGraphResourceId instances = graph.import_buffer("Instances");
+    const zv::FrameGraphResourceId shadow = graph.create_texture(k_shadow_desc);
+    const zv::FrameGraphResourceId debug = graph.create_texture(k_color_desc);
+
+    const zv::FrameGraphPassId upload = graph.add_pass("Upload", execute_nothing);
+    graph.write(upload, instances, eFrameGraphAccess::CopyDest);
+    const zv::FrameGraphPassId shadows = graph.add_pass("Shadows", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+    graph.write(shadows, shadow, eFrameGraphAccess::DepthWrite);
+    graph.set_clear_depth(shadows, shadow, 1.0f);
+    // writes a texture nobody reads
+    const zv::FrameGraphPassId debug_view = graph.add_pass("Debug view", execute_nothing);
+    graph.write(debug_view, debug, eFrameGraphAccess::RenderTarget);
+    // drawn over by the clear of the scene pass before anyone reads it
+    const zv::FrameGraphPassId overdrawn = graph.add_pass("Overdrawn", execute_nothing);
+    graph.write(overdrawn, back_buffer, eFrameGraphAccess::RenderTarget);
+    const zv::FrameGraphPassId scene = graph.add_pass("Scene", execute_nothing);
+    graph.read(scene, instances, eFrameGraphAccess::ShaderResource);
+    graph.read(scene, shadow, eFrameGraphAccess::ShaderResource);
+    graph.write(scene, back_buffer, eFrameGraphAccess::RenderTarget);
+    graph.set_clear_color(scene, back_buffer, zv::Vector4{ 0.0f, 0.0f, 0.0f, 1.0f });
+    const zv::FrameGraphPassId ui = graph.add_pass("UI", execute_nothing, zv::FrameGraph::k_pass_flag_side_effects);
+    graph.write(ui, back_buffer, eFrameGraphAccess::RenderTarget);
+
+    if (!expect(graph.compile(), "compile() failed"))
+    {
+      return false;
+    }
+
+    bool ok = true;
+    ok &= expect(!graph.is_pass_culled(upload) && !graph.is_pass_culled(shadows) && !graph.is_pass_culled(scene) && !graph.is_pass_culled(ui),
+                 "a needed pass was culled");
+    ok &= expect(graph.is_pass_culled(debug_view), "the pass writing an unused texture was kept");
+    ok &= expect(graph.is_pass_culled(overdrawn), "the pass overwritten by a clear was kept");
+
+    ok &= expect(graph.get_level_count() == 3 && graph.get_pass_level(upload) == 0 && graph.get_pass_level(shadows) == 0 &&
+                 graph.get_pass_level(scene) == 1 && graph.get_pass_level(ui) == 2, "wrong levels");
+
+    // the imported buffer comes back in its last state, the back buffer in its final one
+    ok &= expect(has_barrier(graph.get_pass_barriers(upload), instances, eFrameGraphAccess::ShaderResource, eFrameGraphAccess::CopyDest) &&
+                 graph.get_pass_barriers(upload).size() == 1, "wrong barriers in front of the upload");
+    ok &= expect(has_barrier(graph.get_pass_barriers(shadows), shadow, eFrameGraphAccess::Unknown, eFrameGraphAccess::DepthWrite) &&
+                 graph.get_pass_barriers(shadows).size() == 1, "wrong barriers in front of the shadows");
+    ok &= expect(has_barrier(graph.get_pass_barriers(scene), instances, eFrameGraphAccess::CopyDest, eFrameGraphAccess::ShaderResource) &&
+                 has_barrier(graph.get_pass_barriers(scene), shadow, eFrameGraphAccess::DepthWrite, eFrameGraphAccess::ShaderResource) &&
+                 has_barrier(graph.get_pass_barriers(scene), back_buffer, eFrameGraphAccess::Present, eFrameGraphAccess::RenderTarget) &&
+                 graph.get_pass_barriers(scene).size() == 3, "wrong barriers in front of the scene");
+    ok &= expect(graph.get_pass_barriers(ui).empty(), "the UI pass needs no barriers");
+    ok &= expect(has_barrier(graph.get_final_barriers(), back_buffer, eFrameGraphAccess::RenderTarget, eFrameGraphAccess::Present) &&
+                 graph.get_final_barriers().size() == 1, "wrong final barriers");
+
+    ok &= expect(graph.get_physical_index(debug) == zv::k_invalid_frame_graph_id && graph.get_physical_texture_count() == 1,
+                 "wrong physical textures");
+    return ok;
+  }
+
+  // A chain that aliases, and a graph where declaration order and execution order disagree: p3 and p4 are declared
+  // after p1 and p2 but run next to them, so T2 must not share the texture of T1
+  bool check_frame_graph_aliasing()
+  {
+    bool ok = true;
+    {
+      zv::FrameGraph graph;
+      const zv::FrameGraphResourceId output = graph.import_texture("Output", eFrameGraphAccess::ShaderResource);
+      zv::FrameGraphResourceId previous = zv::k_invalid_frame_graph_id;
+      zv::FrameGraphResourceId chain[3];
+      for (zv::FrameGraphResourceId& texture : chain)
+      {
+        texture = graph.create_texture(k_color_desc);
+        const zv::FrameGraphPassId pass = graph.add_pass("Chain", execute_nothing);
+        if (previous != zv::k_invalid_frame_graph_id)
+        {
+          graph.read(pass, previous, eFrameGraphAccess::ShaderResource);
+        }
+        graph.write(pass, texture, eFrameGraphAccess::RenderTarget);
+        previous = texture;
+      }
+      const zv::FrameGraphPassId resolve = graph.add_pass("Resolve", execute_nothing);
+      graph.read(resolve, previous, eFrameGraphAccess::ShaderResource);
+      graph.write(resolve, output, eFrameGraphAccess::RenderTarget);
+
+      ok &= expect(graph.compile() && graph.get_level_count() == 4, "the chain did not compile into four levels");
+      ok &= expect(graph.get_physical_texture_count() == 2 && graph.get_physical_index(chain[0]) == graph.get_physical_index(chain[2]) &&
+                   graph.get_physical_index(chain[0]) != graph.get_physical_index(chain[1]), "the chain was not aliased into two textures");
+    }
+
+    {
+      zv::FrameGraph graph;
+      const zv::FrameGraphResourceId output_1 = graph.import_texture("Output 1", eFrameGraphAccess::ShaderResource);
+      const zv::FrameGraphResourceId output_2 = graph.import_texture("Output 2", eFrameGraphAccess::ShaderResource);
+      const zv::FrameGraphResourceId a = graph.create_texture(k_color_desc);
+      const zv::FrameGraphResourceId t1 = graph.create_texture(k_color_desc);
+      const zv::FrameGraphResourceId t2 = graph.create_texture(k_color_desc);
+
+      const zv::FrameGraphPassId p0 = graph.add_pass("p0", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      graph.write(p0, a, eFrameGraphAccess::RenderTarget);
+      const zv::FrameGraphPassId p1 = graph.add_pass("p1", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      graph.read(p1, a, eFrameGraphAccess::ShaderResource);
+      graph.write(p1, t1, eFrameGraphAccess::RenderTarget);
+      const zv::FrameGraphPassId p2 = graph.add_pass("p2", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      graph.read(p2, t1, eFrameGraphAccess::ShaderResource);
+      graph.write(p2, output_1, eFrameGraphAccess::RenderTarget);
+      const zv::FrameGraphPassId p3 = graph.add_pass("p3", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      graph.write(p3, t2, eFrameGraphAccess::RenderTarget);
+      const zv::FrameGraphPassId p4 = graph.add_pass("p4", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      graph.read(p4, t2, eFrameGraphAccess::ShaderResource);
+      graph.write(p4, output_2, eFrameGraphAccess::RenderTarget);
+
+      ok &= expect(graph.compile(), "compile() failed");
+      ok &= expect(graph.get_pass_level(p0) == 0 && graph.get_pass_level(p1) == 1 && graph.get_pass_level(p2) == 2 &&
+                   graph.get_pass_level(p3) == 0 && graph.get_pass_level(p4) == 1, "wrong levels");
+      ok &= expect(graph.get_physical_index(t2) != graph.get_physical_index(t1) && graph.get_physical_index(t2) != graph.get_physical_index(a),
+                   "T2 shares a texture with a transient used in the same levels");
+      // a is dead after level 1, t1 is only written there
+      ok &= expect(graph.get_physical_index(t1) != graph.get_physical_index(a), "T1 shares the texture of A, which is read in the same level");
+    }
+    return ok;
+  }
+
+  struct RandomGraph
+  {
+    struct Use
+    {
+      zv::FrameGraphPassId pass;
+      zv::FrameGraphResourceId resource;
+      bool write;
+    };
+
+    zv::FrameGraph graph;
+    std::vector<zv::FrameGraphResourceId> transients;
+    std::vector<Use> uses;
+  };
+
+  // Passes read up to two textures written before and write a new one, a few write outputs; two texture sizes, so some
+  // transients can share textures and some cannot
+  void build_random_graph(u32 pass_count, u32 seed, RandomGraph& out_graph)
+  {
+    std::mt19937 engine{ seed };
+    zv::FrameGraph& graph = out_graph.graph;
+    graph.clear();
+    out_graph.transients.clear();
+    out_graph.uses.clear();
+
+    const zv::FrameGraphResourceId output = graph.import_texture("Output", eFrameGraphAccess::ShaderResource);
+    for (u32 p = 0; p < pass_count; ++p)
+    {
+      const zv::FrameGraphPassId pass = graph.add_pass("Random", execute_nothing, zv::FrameGraph::k_pass_flag_deferred);
+      const u32 read_count = out_graph.transients.empty() ? 0 : std::uniform_int_distribution<u32>{ 0, 2 }(engine);
+      for (u32 r = 0; r < read_count; ++r)
+      {
+        // mostly recent textures, so lifetimes stay short and aliasing has something to do
+        const u32 newest = static_cast<u32>(out_graph.transients.size()) - 1;
+        const u32 back = std::min(newest, std::uniform_int_distribution<u32>{ 0, 6 }(engine));
+        const zv::FrameGraphResourceId resource = out_graph.transients[newest - back];
+        if (std::none_of(out_graph.uses.begin(), out_graph.uses.end(), [&](const RandomGraph::Use& use) { return use.pass == pass && use.resource == resource; }))
+        {
+          graph.read(pass, resource, eFrameGraphAccess::ShaderResource);
+          out_graph.uses.push_back(RandomGraph::Use{ pass, resource, false });
+        }
+      }
+
+      if (p % 8 == 7 || p + 1 == pass_count)
+      {
+        graph.write(pass, output, eFrameGraphAccess::RenderTarget);
+        out_graph.uses.push_back(RandomGraph::Use{ pass, output, true });
+      }
+      else
+      {
+        const zv::FrameGraphResourceId texture = graph.create_texture(engine() % 3 == 0 ? k_shadow_desc : k_color_desc);
+        graph.write(pass, texture, eFrameGraphAccess::RenderTarget);
+        out_graph.uses.push_back(RandomGraph::Use{ pass, texture, true });
+        out_graph.transients.push_back(texture);
+      }
+    }
+  }
+
+  // Every pass runs after the passes it depends on, and transients in one texture are used in disjoint level ranges
+  bool check_frame_graph_random()
+  {
+    RandomGraph random;
+    for (u32 seed = 1; seed <= 50; ++seed)
+    {
+      build_random_graph(64, seed, random);
+      if (!expect(random.graph.compile(), "compile() failed"))
+      {
+        return false;
+      }
+
+      for (const RandomGraph::Use& a : random.uses)
+      {
+        for (const RandomGraph::Use& b : random.uses)
+        {
+          if (a.pass < b.pass && a.resource == b.resource && (a.write || b.write) && !random.graph.is_pass_culled(a.pass) &&
+              !random.graph.is_pass_culled(b.pass) && random.graph.get_pass_level(a.pass) >= random.graph.get_pass_level(b.pass))
+          {
+            std::printf("    seed %u: pass %u does not run after pass %u\n", seed, b.pass, a.pass);
+            return false;
+          }
+        }
+      }
+
+      std::vector<u32> first_level(random.transients.size(), ~0u), last_level(random.transients.size(), 0);
+      for (u32 i = 0; i < random.transients.size(); ++i)
+      {
+        for (const RandomGraph::Use& use : random.uses)
+        {
+          if (use.resource == random.transients[i] && !random.graph.is_pass_culled(use.pass))
+          {
+            first_level[i] = std::min(first_level[i], random.graph.get_pass_level(use.pass));
+            last_level[i] = std::max(last_level[i], random.graph.get_pass_level(use.pass));
+          }
+        }
+      }
+
+      for (u32 i = 0; i < random.transients.size(); ++i)
+      {
+        for (u32 j = i + 1; j < random.transients.size(); ++j)
+        {
+          const u32 physical = random.graph.get_physical_index(random.transients[i]);
+          if (physical != zv::k_invalid_frame_graph_id && physical == random.graph.get_physical_index(random.transients[j]) &&
+              first_level[i] <= last_level[j] && first_level[j] <= last_level[i])
+          {
+            std::printf("    seed %u: transients %u and %u share a texture in overlapping levels\n", seed, i, j);
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+}
+
+namespace
+{
+  constexpr u32 k_draw_packet_count = 100000;
+
+  // packets tagged with their index in first_instance, so the sorted order can be traced back
+  void fill_draw_queue(const std::vector<u64>& keys, zv::DrawQueue& out_queue)
+  {
+    out_queue.clear();
+    out_queue.reserve(static_cast<u32>(keys.size()));
+    for (u32 i = 0; i < keys.size(); ++i)
+    {
+      zv::DrawPacket packet;
+      packet.sort_key = keys[i];
+      packet.first_instance = i;
+      out_queue.add(packet);
+    }
+  }
+
+  // 100k keys drawn from 20k random ones, so equal keys are common and the order among them is checked
+  std::vector<u64> make_random_sort_keys()
+  {
+    std::mt19937_64 engine{ 77 };
+    std::vector<u64> pool(k_draw_packet_count / 5);
+    for (u64& key : pool)
+    {
+      key = engine();
+    }
+    std::uniform_int_distribution<u32> pick{ 0, static_cast<u32>(pool.size()) - 1 };
+    std::vector<u64> keys(k_draw_packet_count);
+    for (u64& key : keys)
+    {
+      key = pool[pick(engine)];
+    }
+    return keys;
+  }
+
+  // A typical frame: one layer, four pipelines, fewer than 256 materials and meshes and random depth. The top bytes of
+  // the layer and pipeline, material and mesh fields are the same for every key, so sort() skips their passes.
+  std::vector<u64> make_frame_sort_keys()
+  {
+    std::mt19937 engine{ 78 };
+    std::uniform_int_distribution<u32> pipeline{ 0, 3 };
+    std::uniform_int_distribution<u32> material{ 0, 199 };
+    std::uniform_int_distribution<u32> mesh{ 0, 49 };
+    std::uniform_int_distribution<u32> depth{ 0, (1u << zv::k_sort_key_depth_bits) - 1 };
+    std::vector<u64> keys(k_draw_packet_count);
+    for (u64& key : keys)
+    {
+      key = zv::make_draw_sort_key(0, pipeline(engine), material(engine), mesh(engine), depth(engine));
+    }
+    return keys;
+  }
+
+  // std::sort of (key, packet index) pairs gives the stable order the radix sort has to produce
+  bool check_draw_queue_sort(const char* name, const std::vector<u64>& keys)
+  {
+    zv::DrawQueue queue;
+    fill_draw_queue(keys, queue);
+    queue.sort();
+
+    std::vector<std::pair<u64, u32>> expected(keys.size());
+    for (u32 i = 0; i < keys.size(); ++i)
+    {
+      expected[i] = std::make_pair(keys[i], i);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    for (u32 i = 0; i < expected.size(); ++i)
+    {
+      const zv::DrawPacket& packet = queue.get_sorted(i);
+      if (packet.sort_key != expected[i].first || packet.first_instance != expected[i].second)
+      {
+        std::printf("    %s: position %u holds packet %u with key %016llx, expected packet %u with key %016llx\n", name, i,
+                    packet.first_instance, static_cast<unsigned long long>(packet.sort_key), expected[i].second,
+                    static_cast<unsigned long long>(expected[i].first));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_draw_queue()
+  {
+    return check_draw_queue_sort("random keys", make_random_sort_keys()) &&
+           check_draw_queue_sort("frame keys", make_frame_sort_keys()) &&
+           check_draw_queue_sort("equal keys", std::vector<u64>(1000, zv::make_draw_sort_key(2, 7, 300, 9, 1234))) &&
+           check_draw_queue_sort("no keys", std::vector<u64>{});
+  }
+}
+
+void zv::add_frame_graph_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("FrameGraph::compile, frame", check_frame_graph_frame);
+  runner.add_check("FrameGraph::compile, aliasing", check_frame_graph_aliasing);
+  runner.add_check("FrameGraph::compile, random graphs", check_frame_graph_random);
+
+  runner.add("FrameGraph::compile, 64 passes", [](u64 iteration_count)
+  {
+    static RandomGraph s_random;
+    if (s_random.transients.empty())
+    {
+      build_random_graph(64, 1, s_random);
+    }
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(s_random.graph.compile());
+    }
+  });
+}
+
+void zv::add_instance_data_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("build_dirty_ranges", check_build_dirty_ranges);
+  runner.add_check("f32_to_f16, f16_to_f32", check_half_conversion);
+  runner.add_check("pack_instance, unpack_instance", check_instance_packing);
+
+  // 2% of the instances changed, scattered
+  runner.add("build_dirty_ranges, 64k instances", [](u64 iteration_count)
+  {
+    static const std::vector<u8> s_dirty = []()
+    {
+      std::vector<u8> dirty(k_instance_count);
+      std::mt19937 engine{ 99 };
+      std::bernoulli_distribution is_dirty{ 0.02 };
+      for (u8& flag : dirty)
+      {
+        flag = is_dirty(engine) ? 1 : 0;
+      }
+      return dirty;
+    }();
+
+    std::vector<InstanceRange> ranges;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      build_dirty_ranges(s_dirty.data(), 0, k_instance_count, 8, ranges);
+      do_not_optimize(ranges.size());
+    }
+  });
+
+  // one instance per iteration
+  runner.add("pack_instance, transform and color", [](u64 iteration_count)
+  {
+    Matrix44 world = Matrix44::Identity();
+    world.m[3][0] = 1.0f;
+    const Vector4 color{ 0.25f, 0.5f, 0.75f, 1.0f };
+    PackedInstance instance;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(world);
+      pack_instance_transform(world, instance);
+      pack_instance_color(color, instance);
+      do_not_optimize(instance);
+    }
+  });
+}
+
+void zv::add_draw_queue_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("DrawQueue::sort, against std::sort", check_draw_queue);
+
+  runner.add("DrawQueue::sort, 100k packets, random keys", [](u64 iteration_count)
+  {
+    static DrawQueue s_queue;
+    if (s_queue.get_count() == 0)
+    {
+      fill_draw_queue(make_random_sort_keys(), s_queue);
+    }
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      s_queue.sort();
+      do_not_optimize(s_queue.get_sorted(0));
+    }
+  });
+
+  runner.add("DrawQueue::sort, 100k packets, frame keys", [](u64 iteration_count)
+  {
+    static DrawQueue s_queue;
+    if (s_queue.get_count() == 0)
+    {
+      fill_draw_queue(make_frame_sort_keys(), s_queue);
+    }
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      s_queue.sort();
+      do_not_optimize(s_queue.get_sorted(0));
+    }
+  });
+}
@@ -0,0 +1,794 @@
+/*
+ * BenchScene.cpp - benchmarks and checks of frustum culling, the BVH and the transform hierarchy
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/BenchSuites.h>
+#include <Renderer/Culling.h>
+#include <Scene/Bvh.h>
+#include <Scene/TransformSystem.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace
+{
+  constexpr u32 k_box_count = 1000000;
+  // Results of the optimized tests may differ from the scalar reference for volumes this close to a plane, where the
+  // rounding of the different evaluation orders decides
+  constexpr f64 k_plane_tolerance = 1.0e-3;
+
+  // 1M boxes of up to 4 units in a 1000 unit cube around the camera
+  const zv::AabbSoA& get_boxes()
+  {
+    static const zv::AabbSoA s_boxes = []()
+    {
+      zv::AabbSoA boxes;
+      std::mt19937 engine{ 1234 };
+      std::uniform_real_distribution<f32> position{ -500.0f, 500.0f };
+      std::uniform_real_distribution<f32> extent{ 0.1f, 2.0f };
+      for (u32 i = 0; i < k_box_count; ++i)
+      {
+        boxes.push_back(zv::Vector3{ position(engine), position(engine), position(engine) }, zv::Vector3{ extent(engine), extent(engine), extent(engine) });
+      }
+      return boxes;
+    }();
+    return s_boxes;
+  }
+
+  const zv::SphereSoA& get_spheres()
+  {
+    static const zv::SphereSoA s_spheres = []()
+    {
+      const zv::AabbSoA& boxes = get_boxes();
+      zv::SphereSoA spheres;
+      for (u32 i = 0; i < k_box_count; ++i)
+      {
+        spheres.push_back(zv::Vector3{ boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] }, boxes.extent_x[i]);
+      }
+      return spheres;
+    }();
+    return s_spheres;
+  }
+
+  // Camera at the origin looking down +z with a 60 degree field of view and a far plane at 400, in the row-vector,
+  // [0, 1] depth convention of the renderer; about a tenth of the boxes are visible
+  zv::Matrix44 make_view_proj()
+  {
+    const f32 near_z = 0.1f;
+    const f32 far_z = 400.0f;
+    const f32 y_scale = 1.0f / std::tan(3.14159265f / 6.0f);
+    zv::Matrix44 proj;
+    f32* p = &proj._11;
+    std::fill(p, p + 16, 0.0f);
+    proj._11 = y_scale / (16.0f / 9.0f);
+    proj._22 = y_scale;
+    proj._33 = far_z / (far_z - near_z);
+    proj._34 = 1.0f;
+    proj._43 = -near_z * far_z / (far_z - near_z);
+    return proj;
+  }
+
+  zv::Frustum make_frustum()
+  {
+    return zv::extract_frustum(make_view_proj());
+  }
+
+  // smallest signed distance of the volume to a plane, positive inside; computed in double precision
+  f64 get_box_margin(const zv::Frustum& frustum, const zv::AabbSoA& boxes, u32 i)
+  {
+    f64 margin = 1.0e30;
+    for (const zv::Vector4& plane : frustum.planes)
+    {
+      const f64 distance = static_cast<f64>(plane.x) * boxes.center_x[i] + static_cast<f64>(plane.y) * boxes.center_y[i] +
+                           static_cast<f64>(plane.z) * boxes.center_z[i] + plane.w;
+      const f64 radius = std::fabs(static_cast<f64>(plane.x)) * boxes.extent_x[i] + std::fabs(static_cast<f64>(plane.y)) * boxes.extent_y[i] +
+                         std::fabs(static_cast<f64>(plane.z)) * boxes.extent_z[i];
+      margin = std::min(margin, distance + radius);
+    }
+    return margin;
+  }
+
+  f64 get_sphere_margin(const zv::Frustum& frustum, const zv::SphereSoA& spheres, u32 i)
+  {
+    f64 margin = 1.0e30;
+    for (const zv::Vector4& plane : frustum.planes)
+    {
+      margin = std::min(margin, static_cast<f64>(plane.x) * spheres.center_x[i] + static_cast<f64>(plane.y) * spheres.center_y[i] +
+                                static_cast<f64>(plane.z) * spheres.center_z[i] + plane.w + spheres.radius[i]);
+    }
+    return margin;
+  }
+
+  // Both lists sorted; every index that is only in one of them has to be within the tolerance of a plane
+  template<typename MarginFn>
+  bool compare_visible(const char* name, std::vector<u32> visible, std::vector<u32> expected, const MarginFn& get_margin)
+  {
+    std::sort(visible.begin(), visible.end());
+    std::sort(expected.begin(), expected.end());
+    if (std::adjacent_find(visible.begin(), visible.end()) != visible.end())
+    {
+      std::printf("    %s returned an index twice\n", name);
+      return false;
+    }
+
+    std::vector<u32> difference;
+    std::set_symmetric_difference(visible.begin(), visible.end(), expected.begin(), expected.end(), std::back_inserter(difference));
+    for (u32 index : difference)
+    {
+      const f64 margin = get_margin(index);
+      if (std::abs(margin) > k_plane_tolerance)
+      {
+        std::printf("    %s: volume %u is %s, %.6f from the nearest plane\n", name, index,
+                    std::binary_search(expected.begin(), expected.end(), index) ? "missing" : "wrongly visible", margin);
+        return false;
+      }
+    }
+
+    if (expected.empty())
+    {
+      std::printf("    %s: nothing is visible, the check tests nothing\n", name);
+      return false;
+    }
+    return true;
+  }
+
+  std::vector<u32> cull_aabbs_reference(const zv::Frustum& frustum, const zv::AabbSoA& boxes)
+  {
+    std::vector<u32> visible;
+    for (u32 i = 0; i < boxes.size(); ++i)
+    {
+      if (zv::is_aabb_visible(frustum, zv::Vector3{ boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] },
+                                       zv::Vector3{ boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i] }))
+      {
+        visible.push_back(i);
+      }
+    }
+    return visible;
+  }
+
+  bool check_cull_aabbs()
+  {
+    const zv::Frustum frustum = make_frustum();
+    const zv::AabbSoA& boxes = get_boxes();
+    std::vector<u32> visible;
+    zv::cull_aabbs(frustum, boxes, visible);
+    if (!std::is_sorted(visible.begin(), visible.end()))
+    {
+      std::printf("    cull_aabbs: the visible indices are not in ascending order\n");
+      return false;
+    }
+    return compare_visible("cull_aabbs", visible, cull_aabbs_reference(frustum, boxes),
+                           [&](u32 i) { return get_box_margin(frustum, boxes, i); });
+  }
+
+  bool check_cull_spheres()
+  {
+    const zv::Frustum frustum = make_frustum();
+    const zv::SphereSoA& spheres = get_spheres();
+    std::vector<u32> visible;
+    zv::cull_spheres(frustum, spheres, visible);
+
+    std::vector<u32> expected;
+    for (u32 i = 0; i < spheres.size(); ++i)
+    {
+      if (zv::is_sphere_visible(frustum, zv::Vector3{ spheres.center_x[i], spheres.center_y[i], spheres.center_z[i] }, spheres.radius[i]))
+      {
+        expected.push_back(i);
+      }
+    }
+    return compare_visible("cull_spheres", visible, expected, [&](u32 i) { return get_sphere_margin(frustum, spheres, i); });
+  }
+
+  // the hierarchical test has to find the same boxes as testing all of them
+  bool check_bvh_query_frustum()
+  {
+    const zv::Frustum frustum = make_frustum();
+    const zv::AabbSoA& boxes = get_boxes();
+    zv::Bvh bvh;
+    bvh.build(boxes);
+    std::vector<u32> visible;
+    bvh.query_frustum(frustum, visible);
+    return compare_visible("Bvh::query_frustum", visible, cull_aabbs_reference(frustum, boxes),
+                           [&](u32 i) { return get_box_margin(frustum, boxes, i); });
+  }
+}
+
+namespace
+{
+  constexpr u32 k_query_count = 1024;
+
+  const zv::Bvh& get_bvh()
+  {
+    static const zv::Bvh s_bvh = []()
+    {
+      zv::Bvh bvh;
+      bvh.build(get_boxes());
+      return bvh;
+    }();
+    return s_bvh;
+  }
+
+  struct Ray
+  {
+    zv::Vector3 origin;
+    zv::Vector3 direction;
+  };
+
+  // query boxes and rays spread over the scene, fixed for all runs
+  const std::vector<Ray>& get_rays()
+  {
+    static const std::vector<Ray> s_rays = []()
+    {
+      std::vector<Ray> rays;
+      std::mt19937 engine{ 5678 };
+      std::uniform_real_distribution<f32> position{ -500.0f, 500.0f };
+      std::uniform_real_distribution<f32> direction{ 0.05f, 1.0f };
+      std::uniform_int_distribution<u32> sign{ 0, 1 };
+      for (u32 i = 0; i < k_query_count; ++i)
+      {
+        const zv::Vector3 origin{ position(engine), position(engine), position(engine) };
+        // no zero components, so the slab tests of the reference never divide zero by zero
+        const zv::Vector3 dir{ direction(engine) * (sign(engine) ? 1.0f : -1.0f), direction(engine) * (sign(engine) ? 1.0f : -1.0f),
+                               direction(engine) * (sign(engine) ? 1.0f : -1.0f) };
+        rays.push_back(Ray{ origin, dir });
+      }
+      return rays;
+    }();
+    return s_rays;
+  }
+
+  // Nearest hit of all boxes with the same slab test as the BVH; node boxes are unions of primitive boxes and the test
+  // is monotonic in the box bounds, so both have to agree exactly
+  bool raycast_reference(const zv::AabbSoA& boxes, const Ray& ray, f32 max_distance, zv::BvhRayHit& out_hit)
+  {
+    const f32 origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+    const f32 rcp_direction[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+    f32 closest = max_distance;
+    bool hit = false;
+    for (u32 i = 0; i < boxes.size(); ++i)
+    {
+      const f32 center[3] = { boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] };
+      const f32 extent[3] = { boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i] };
+      f32 t_min = 0.0f;
+      f32 t_max = closest;
+      for (u32 axis = 0; axis < 3; ++axis)
+      {
+        const f32 t0 = (center[axis] - extent[axis] - origin[axis]) * rcp_direction[axis];
+        const f32 t1 = (center[axis] + extent[axis] - origin[axis]) * rcp_direction[axis];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+      }
+      if (t_min <= t_max && t_min < closest)
+      {
+        closest = t_min;
+        out_hit = zv::BvhRayHit{ i, t_min };
+        hit = true;
+      }
+    }
+    return hit;
+  }
+
+  std::vector<u32> query_aabb_reference(const zv::AabbSoA& boxes, const zv::Vector3& center, const zv::Vector3& extent)
+  {
+    std::vector<u32> overlapping;
+    for (u32 i = 0; i < boxes.size(); ++i)
+    {
+      if (std::abs(boxes.center_x[i] - center.x) <= boxes.extent_x[i] + extent.x &&
+          std::abs(boxes.center_y[i] - center.y) <= boxes.extent_y[i] + extent.y &&
+          std::abs(boxes.center_z[i] - center.z) <= boxes.extent_z[i] + extent.z)
+      {
+        overlapping.push_back(i);
+      }
+    }
+    return overlapping;
+  }
+
+  bool check_bvh_raycast(const zv::Bvh& bvh, const zv::AabbSoA& boxes, u32 ray_count)
+  {
+    const std::vector<Ray>& rays = get_rays();
+    u32 hit_count = 0;
+    for (u32 i = 0; i < ray_count; ++i)
+    {
+      zv::BvhRayHit hit, expected;
+      const bool is_hit = bvh.raycast(rays[i].origin, rays[i].direction, 2000.0f, hit);
+      const bool is_expected = raycast_reference(boxes, rays[i], 2000.0f, expected);
+      // equally distant boxes may come back in either order
+      if (is_hit != is_expected || (is_hit && hit.distance != expected.distance))
+      {
+        std::printf("    ray %u: %s at %.6f, expected %s at %.6f\n", i, is_hit ? "hit" : "no hit", hit.distance,
+                    is_expected ? "hit" : "no hit", expected.distance);
+        return false;
+      }
+      hit_count += is_hit;
+    }
+
+    if (hit_count == 0)
+    {
+      std::printf("    no ray hit anything, the check tests nothing\n");
+      return false;
+    }
+    return true;
+  }
+
+  // query boxes of 20 units around the ray origins
+  bool check_bvh_query_aabb(const zv::Bvh& bvh, const zv::AabbSoA& boxes, u32 query_count)
+  {
+    const std::vector<Ray>& rays = get_rays();
+    const zv::Vector3 extent{ 10.0f, 10.0f, 10.0f };
+    std::vector<u32> overlapping;
+    for (u32 i = 0; i < query_count; ++i)
+    {
+      overlapping.clear();
+      bvh.query_aabb(rays[i].origin, extent, overlapping);
+      std::sort(overlapping.begin(), overlapping.end());
+      if (overlapping != query_aabb_reference(boxes, rays[i].origin, extent))
+      {
+        std::printf("    query %u found %zu boxes, expected %zu\n", i, overlapping.size(), query_aabb_reference(boxes, rays[i].origin, extent).size());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Boxes at distances growing by 3x: with two bins the split plane halves the centroid range, so every split peels off
+  // only the farthest box and the tree would be as deep as there are boxes. It has to stop at the maximum depth and the
+  // queries still have to reach both ends.
+  bool check_bvh_degenerate()
+  {
+    zv::AabbSoA boxes;
+    f32 x = 1.0f;
+    for (u32 i = 0; i < 72; ++i, x *= 3.0f)
+    {
+      boxes.push_back(zv::Vector3{ x, 0.0f, 0.0f }, zv::Vector3{ 0.25f, 0.25f, 0.25f });
+    }
+
+    zv::Bvh::BuildParams params;
+    params.bin_count = 2;
+    zv::Bvh bvh;
+    bvh.build(boxes, params);
+    if (bvh.get_depth() != 64)
+    {
+      std::printf("    the degenerate tree has depth %u\n", bvh.get_depth());
+      return false;
+    }
+
+    std::vector<u32> overlapping;
+    bvh.query_aabb(zv::Vector3{ 0.0f, 0.0f, 0.0f }, zv::Vector3{ 1.0e35f, 1.0f, 1.0f }, overlapping);
+    zv::BvhRayHit far_hit, near_hit;
+    const bool is_far_hit = bvh.raycast(zv::Vector3{ 1.0e35f, 0.1f, 0.1f }, zv::Vector3{ -1.0f, 1.0e-36f, 1.0e-36f }, 2.0e35f, far_hit);
+    const bool is_near_hit = bvh.raycast(zv::Vector3{ 0.0f, 0.1f, 0.1f }, zv::Vector3{ 1.0f, 0.001f, 0.001f }, 2.0e35f, near_hit);
+    if (overlapping.size() != boxes.size() || !is_far_hit || far_hit.prim_index != boxes.size() - 1 || !is_near_hit || near_hit.prim_index != 0)
+    {
+      std::printf("    the degenerate tree found %zu of %u boxes, the rays hit %u and %u\n", overlapping.size(), boxes.size(),
+                  far_hit.prim_index, near_hit.prim_index);
+      return false;
+    }
+    return true;
+  }
+}
+
+namespace
+{
+  constexpr u32 k_transform_count = 100000;
+  constexpr u32 k_root_transform_count = 1000;
+  constexpr u32 k_edit_count = 100;
+  // relative to the magnitude of the expected value; the float chains are a few dozen transforms deep
+  constexpr f64 k_matrix_tolerance = 1.0e-4;
+
+  // local transform and parent as the reference sees them, indexed by transform id
+  struct ReferenceTransform
+  {
+    zv::TransformId parent{ zv::k_invalid_transform };
+    zv::Vector3 position;
+    zv::Vector4 rotation;
+    zv::Vector3 scale;
+    bool alive{ false };
+  };
+
+  using ReferenceMatrix = std::array<f64, 16>;
+
+  ReferenceMatrix multiply(const ReferenceMatrix& a, const ReferenceMatrix& b)
+  {
+    ReferenceMatrix product{};
+    for (u32 row = 0; row < 4; ++row)
+    {
+      for (u32 column = 0; column < 4; ++column)
+      {
+        for (u32 k = 0; k < 4; ++k)
+        {
+          product[row * 4 + column] += a[row * 4 + k] * b[k * 4 + column];
+        }
+      }
+    }
+    return product;
+  }
+
+  // scale, then rotate, then translate, in the row-vector convention of the renderer
+  ReferenceMatrix get_reference_local(const ReferenceTransform& transform)
+  {
+    const f64 x = transform.rotation.x, y = transform.rotation.y, z = transform.rotation.z, w = transform.rotation.w;
+    const f64 sx = transform.scale.x, sy = transform.scale.y, sz = transform.scale.z;
+    return ReferenceMatrix{ (1.0 - 2.0 * (y * y + z * z)) * sx, 2.0 * (x * y + w * z) * sx, 2.0 * (x * z - w * y) * sx, 0.0,
+                            2.0 * (x * y - w * z) * sy, (1.0 - 2.0 * (x * x + z * z)) * sy, 2.0 * (y * z + w * x) * sy, 0.0,
+                            2.0 * (x * z + w * y) * sz, 2.0 * (y * z - w * x) * sz, (1.0 - 2.0 * (x * x + y * y)) * sz, 0.0,
+                            transform.position.x, transform.position.y, transform.position.z, 1.0 };
+  }
+
+  // world matrix by walking up to the root, in double precision and without any of the system's caching
+  ReferenceMatrix get_reference_world(const std::vector<ReferenceTransform>& transforms, zv::TransformId id)
+  {
+    ReferenceMatrix world = get_reference_local(transforms[id]);
+    for (zv::TransformId parent = transforms[id].parent; parent != zv::k_invalid_transform; parent = transforms[parent].parent)
+    {
+      world = multiply(world, get_reference_local(transforms[parent]));
+    }
+    return world;
+  }
+
+  ReferenceMatrix to_reference(const zv::Matrix44& matrix)
+  {
+    ReferenceMatrix reference;
+    const f32* elements = &matrix._11;
+    std::copy(elements, elements + 16, reference.begin());
+    return reference;
+  }
+
+  template<typename Engine>
+  void randomize(Engine& engine, ReferenceTransform& out_transform)
+  {
+    std::uniform_real_distribution<f32> position{ -10.0f, 10.0f };
+    std::normal_distribution<f32> rotation{ 0.0f, 1.0f };
+    std::uniform_real_distribution<f32> scale{ 0.8f, 1.25f };
+    out_transform.position = zv::Vector3{ position(engine), position(engine), position(engine) };
+    const zv::Vector4 q{ rotation(engine), rotation(engine), rotation(engine), rotation(engine) };
+    const f32 rcp_length = 1.0f / std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    out_transform.rotation = zv::Vector4{ q.x * rcp_length, q.y * rcp_length, q.z * rcp_length, q.w * rcp_length };
+    out_transform.scale = zv::Vector3{ scale(engine), scale(engine), scale(engine) };
+  }
+
+  void apply(zv::TransformSystem& transforms, zv::TransformId id, const ReferenceTransform& transform)
+  {
+    transforms.set_local_position(id, transform.position);
+    transforms.set_local_rotation(id, transform.rotation);
+    transforms.set_local_scale(id, transform.scale);
+  }
+
+  // 1000 roots, every further transform attached to a random earlier one; a new system hands out the ids in order
+  template<typename Engine>
+  void make_hierarchy(Engine& engine, zv::TransformSystem& transforms, std::vector<ReferenceTransform>& out_reference)
+  {
+    out_reference.assign(k_transform_count, ReferenceTransform{});
+    for (u32 i = 0; i < k_transform_count; ++i)
+    {
+      ReferenceTransform& transform = out_reference[i];
+      transform.parent = i < k_root_transform_count ? zv::k_invalid_transform : std::uniform_int_distribution<u32>{ 0, i - 1 }(engine);
+      transform.alive = true;
+      randomize(engine, transform);
+      apply(transforms, transforms.create(transform.parent), transform);
+    }
+  }
+
+  bool is_near(const ReferenceMatrix& actual, const ReferenceMatrix& expected)
+  {
+    for (u32 k = 0; k < 16; ++k)
+    {
+      if (std::abs(actual[k] - expected[k]) > k_matrix_tolerance * std::max(1.0, std::abs(expected[k])))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // every live transform has to match the reference, both the world and the world-view-projection matrix
+  bool compare_transforms(const char* step, const zv::TransformSystem& transforms, const std::vector<ReferenceTransform>& reference,
+                          const zv::Matrix44& view_proj)
+  {
+    const ReferenceMatrix reference_view_proj = to_reference(view_proj);
+    u32 alive_count = 0;
+    for (zv::TransformId id = 0; id < reference.size(); ++id)
+    {
+      if (!reference[id].alive)
+      {
+        continue;
+      }
+      ++alive_count;
+
+      const ReferenceMatrix world = get_reference_world(reference, id);
+      if (transforms.get_parent(id) != reference[id].parent || !is_near(to_reference(transforms.get_world_matrix(id)), world) ||
+          !is_near(to_reference(transforms.get_world_view_proj_matrix(id)), multiply(world, reference_view_proj)))
+      {
+        const zv::Matrix44& actual = transforms.get_world_matrix(id);
+        std::printf("    %s: transform %u has parent %u, translation (%.4f, %.4f, %.4f), expected parent %u, translation (%.4f, %.4f, %.4f)\n",
+                    step, id, transforms.get_parent(id), actual._41, actual._42, actual._43, reference[id].parent, world[12], world[13], world[14]);
+        return false;
+      }
+    }
+
+    if (transforms.get_count() != alive_count)
+    {
+      std::printf("    %s: %u transforms, expected %u\n", step, transforms.get_count(), alive_count);
+      return false;
+    }
+    return true;
+  }
+
+  bool check_transform_system()
+  {
+    std::mt19937 engine{ 4321 };
+    const zv::Matrix44 view_proj = make_view_proj();
+    zv::TransformSystem transforms;
+    std::vector<ReferenceTransform> reference;
+    make_hierarchy(engine, transforms, reference);
+    transforms.update(view_proj);
+    if (!compare_transforms("first update", transforms, reference, view_proj))
+    {
+      return false;
+    }
+
+    // nothing changed, nothing is recomputed
+    transforms.update(view_proj);
+    if (transforms.get_last_update_count() != 0)
+    {
+      std::printf("    an update without changes recomputed %u world matrices\n", transforms.get_last_update_count());
+      return false;
+    }
+
+    // moved transforms take their subtrees along
+    std::uniform_int_distribution<u32> any_id{ 0, k_transform_count - 1 };
+    for (u32 i = 0; i < k_edit_count; ++i)
+    {
+      const zv::TransformId id = any_id(engine);
+      randomize(engine, reference[id]);
+      apply(transforms, id, reference[id]);
+    }
+    transforms.update(view_proj);
+    if (!compare_transforms("moved", transforms, reference, view_proj))
+    {
+      return false;
+    }
+
+    // destroyed transforms hand their children to their parents, new ones reuse the ids
+    std::vector<zv::TransformId> created;
+    for (u32 i = 0; i < k_edit_count; ++i)
+    {
+      zv::TransformId id = any_id(engine);
+      while (!reference[id].alive)
+      {
+        id = any_id(engine);
+      }
+      transforms.destroy(id);
+      for (ReferenceTransform& transform : reference)
+      {
+        if (transform.alive && transform.parent == id)
+        {
+          transform.parent = reference[id].parent;
+        }
+      }
+      reference[id].alive = false;
+    }
+    for (u32 i = 0; i < k_edit_count; ++i)
+    {
+      zv::TransformId parent = any_id(engine);
+      while (!reference[parent].alive)
+      {
+        parent = any_id(engine);
+      }
+      const zv::TransformId id = transforms.create(parent);
+      reference[id].parent = parent;
+      reference[id].alive = true;
+      randomize(engine, reference[id]);
+      apply(transforms, id, reference[id]);
+      created.push_back(id);
+    }
+    transforms.update(view_proj);
+    if (!compare_transforms("destroyed and created", transforms, reference, view_proj))
+    {
+      return false;
+    }
+
+    // created transforms count as changed in the update after their creation
+    const zv::TransformId* ids = transforms.get_ids();
+    const u8* world_changed = transforms.get_world_changed_flags();
+    for (u32 i = 0; i < transforms.get_count(); ++i)
+    {
+      if (!world_changed[i] && std::find(created.begin(), created.end(), ids[i]) != created.end())
+      {
+        std::printf("    created transform %u is not marked as changed\n", ids[i]);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // the hierarchy of the update benchmarks, built on the first run only so the samples time the updates alone
+  zv::TransformSystem& get_bench_transforms()
+  {
+    static zv::TransformSystem s_transforms;
+    if (s_transforms.get_count() == 0)
+    {
+      std::mt19937 engine{ 4321 };
+      std::vector<ReferenceTransform> reference;
+      make_hierarchy(engine, s_transforms, reference);
+      s_transforms.update(make_view_proj());
+    }
+    return s_transforms;
+  }
+}
+
+void zv::add_culling_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("cull_aabbs, 1M boxes", check_cull_aabbs);
+  runner.add_check("cull_spheres, 1M spheres", check_cull_spheres);
+  runner.add_check("Bvh::query_frustum, 1M boxes", check_bvh_query_frustum);
+
+  // every iteration culls all volumes
+  runner.add("cull_aabbs, 1M boxes", [](u64 iteration_count)
+  {
+    const Frustum frustum = make_frustum();
+    const AabbSoA& boxes = get_boxes();
+    std::vector<u32> visible;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(cull_aabbs(frustum, boxes, visible));
+    }
+  });
+
+  runner.add("cull_aabbs, 1M boxes, one thread", [](u64 iteration_count)
+  {
+    const Frustum frustum = make_frustum();
+    const AabbSoA& boxes = get_boxes();
+    std::vector<u32> visible(boxes.size());
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(cull_aabbs(frustum, boxes, 0, boxes.size(), visible.data()));
+    }
+  });
+
+  runner.add("cull_aabbs, 1M boxes, scalar reference", [](u64 iteration_count)
+  {
+    const Frustum frustum = make_frustum();
+    const AabbSoA& boxes = get_boxes();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(cull_aabbs_reference(frustum, boxes));
+    }
+  });
+
+  runner.add("cull_spheres, 1M spheres", [](u64 iteration_count)
+  {
+    const Frustum frustum = make_frustum();
+    const SphereSoA& spheres = get_spheres();
+    std::vector<u32> visible;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      do_not_optimize(cull_spheres(frustum, spheres, visible));
+    }
+  });
+}
+
+void zv::add_bvh_benchmarks(BenchmarkRunner& runner)
+{
+  // brute force takes a millisecond per query on 1M boxes, a fraction of the queries is enough
+  runner.add_check("Bvh::raycast, 1M boxes", []() { return check_bvh_raycast(get_bvh(), get_boxes(), k_query_count / 8); });
+  runner.add_check("Bvh::query_aabb, 1M boxes", []() { return check_bvh_query_aabb(get_bvh(), get_boxes(), k_query_count / 8); });
+  runner.add_check("Bvh::refit, 1M boxes", []()
+  {
+    // moving every box and refitting has to give the same answers as a new tree
+    AabbSoA moved = get_boxes();
+    for (u32 i = 0; i < moved.size(); ++i)
+    {
+      moved.center_x[i] += (i % 3 == 0) ? 30.0f : -7.0f;
+      moved.center_y[i] *= 0.5f;
+    }
+    Bvh bvh;
+    bvh.build(get_boxes());
+    bvh.refit(moved);
+    return check_bvh_raycast(bvh, moved, k_query_count / 8) && check_bvh_query_aabb(bvh, moved, k_query_count / 8);
+  });
+  runner.add_check("Bvh, maximum depth", check_bvh_degenerate);
+
+  runner.add("Bvh::build, 1M boxes", [](u64 iteration_count)
+  {
+    Bvh bvh;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      bvh.build(get_boxes());
+      do_not_optimize(bvh.get_node_count());
+    }
+  });
+
+  runner.add("Bvh::refit, 1M boxes", [](u64 iteration_count)
+  {
+    // built on the first run only, so the samples time the refit alone
+    static Bvh s_bvh = get_bvh();
+    Bvh& bvh = s_bvh;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      bvh.refit(get_boxes());
+      do_not_optimize(bvh.get_nodes()[0]);
+    }
+  });
+
+  runner.add("Bvh::query_frustum, 1M boxes", [](u64 iteration_count)
+  {
+    const Frustum frustum = make_frustum();
+    const Bvh& bvh = get_bvh();
+    std::vector<u32> visible;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      visible.clear();
+      bvh.query_frustum(frustum, visible);
+      do_not_optimize(visible.size());
+    }
+  });
+
+  // one query per iteration
+  runner.add("Bvh::query_aabb, 1M boxes", [](u64 iteration_count)
+  {
+    const Bvh& bvh = get_bvh();
+    const std::vector<Ray>& rays = get_rays();
+    const Vector3 extent{ 10.0f, 10.0f, 10.0f };
+    std::vector<u32> overlapping;
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      overlapping.clear();
+      bvh.query_aabb(rays[i % k_query_count].origin, extent, overlapping);
+      do_not_optimize(overlapping.size());
+    }
+  });
+
+  runner.add("Bvh::raycast, 1M boxes", [](u64 iteration_count)
+  {
+    const Bvh& bvh = get_bvh();
+    const std::vector<Ray>& rays = get_rays();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      BvhRayHit hit;
+      const Ray& ray = rays[i % k_query_count];
+      do_not_optimize(bvh.raycast(ray.origin, ray.direction, 2000.0f, hit));
+      do_not_optimize(hit);
+    }
+  });
+}
+
+void zv::add_transform_system_benchmarks(BenchmarkRunner& runner)
+{
+  runner.add_check("TransformSystem::update, 100k transforms", check_transform_system);
+
+  // moving every root recomputes all world matrices; the frame budget for this is 1 ms
+  runner.add("TransformSystem::update, 100k, roots moved", [](u64 iteration_count)
+  {
+    TransformSystem& transforms = get_bench_transforms();
+    const Matrix44 view_proj = make_view_proj();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      const f32 offset = static_cast<f32>(i & 1);
+      for (TransformId id = 0; id < k_root_transform_count; ++id)
+      {
+        transforms.set_local_position(id, Vector3{ offset, 0.0f, 0.0f });
+      }
+      transforms.update(view_proj);
+      do_not_optimize(transforms.get_last_update_count());
+    }
+  });
+
+  // only the world-view-projection matrices are recomputed
+  runner.add("TransformSystem::update, 100k, camera moved", [](u64 iteration_count)
+  {
+    TransformSystem& transforms = get_bench_transforms();
+    Matrix44 view_proj = make_view_proj();
+    for (u64 i = 0; i < iteration_count; ++i)
+    {
+      view_proj._41 = static_cast<f32>(i & 1);
+      transforms.update(view_proj);
+      do_not_optimize(transforms.get_world_view_proj_matrices()[0]);
+    }
+  });
+}
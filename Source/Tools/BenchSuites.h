@@ -0,0 +1,32 @@
+/*
+ * BenchSuites.h - benchmarks and checks of the engine modules that zv_bench registers
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <Tools/Benchmark.h>
+
+namespace zv
+{
+  // parallel_for while background jobs are queued
+  void add_job_system_benchmarks(BenchmarkRunner& runner);
+  // the frame time baseline of the anomaly detector against known jitter
+  void add_frame_time_baseline_benchmarks(BenchmarkRunner& runner);
+  // coalesced loads, the release sweep and stale handles of the resource manager
+  void add_resource_manager_benchmarks(BenchmarkRunner& runner);
+  // Math/Simd against a scalar reference in double precision
+  void add_simd_benchmarks(BenchmarkRunner& runner);
+  // flat SIMD culling of 1M boxes and spheres against the scalar single volume tests
+  void add_culling_benchmarks(BenchmarkRunner& runner);
+  // BVH build, refit and queries on the same boxes against brute force
+  void add_bvh_benchmarks(BenchmarkRunner& runner);
+  // world matrices of a 100k transform hierarchy against a naive reference, and the cost of updating it
+  void add_transform_system_benchmarks(BenchmarkRunner& runner);
+  // dirty range merging and the packing of the instance buffer
+  void add_instance_data_benchmarks(BenchmarkRunner& runner);
+  // radix sort of the draw queue against std::sort, with and without skipped passes
+  void add_draw_queue_benchmarks(BenchmarkRunner& runner);
+  // FrameGraph::compile() without a device: culling, barriers, levels and aliasing
+  void add_frame_graph_benchmarks(BenchmarkRunner& runner);
+}
@@ -0,0 +1,352 @@
+/*
+ * Benchmark.cpp - micro-benchmark runner with robust statistics and baseline comparison
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Tools/Benchmark.h>
+#include <Core/Time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if OS_WINDOWS
+#include <windows.h>
+#elif OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+  struct Sample
+  {
+    f64 time_ns;
+    u64 ticks;
+  };
+
+  Sample measure(const zv::BenchmarkRunner::BenchmarkFn& fn, u64 iteration_count)
+  {
+    const u64 start_ticks = zv::Time::read_cycle_counter();
+    const u64 start = zv::Time::read_counter();
+    fn(iteration_count);
+    const u64 end = zv::Time::read_counter();
+    const u64 end_ticks = zv::Time::read_cycle_counter();
+    return Sample{ static_cast<f64>(end - start) * 1.0e9 / zv::Time::counter_frequency(), end_ticks - start_ticks };
+  }
+
+  // Benchmark names and the samples of each from a file written by write_json(); only that layout is understood
+  bool read_baseline(const char* path, std::vector<zv::BenchmarkResult>& out_results)
+  {
+    std::ifstream file{ path };
+    if (!file)
+    {
+      return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    const std::string json = stream.str();
+
+    size_t position = 0;
+    while ((position = json.find("\"name\":", position)) != std::string::npos)
+    {
+      const size_t name_begin = json.find('"', position + 7);
+      const size_t name_end = name_begin == std::string::npos ? name_begin : json.find('"', name_begin + 1);
+      const size_t samples = name_end == std::string::npos ? name_end : json.find("\"samples_ns\":", name_end);
+      const size_t samples_begin = samples == std::string::npos ? samples : json.find('[', samples);
+      if (samples_begin == std::string::npos)
+      {
+        return false;
+      }
+
+      zv::BenchmarkResult result;
+      result.name = json.substr(name_begin + 1, name_end - name_begin - 1);
+      const char* ptr_cursor = json.c_str() + samples_begin + 1;
+      for (;;)
+      {
+        while (*ptr_cursor == ' ' || *ptr_cursor == ',' || *ptr_cursor == '\n' || *ptr_cursor == '\r')
+        {
+          ++ptr_cursor;
+        }
+        if (*ptr_cursor == ']' || *ptr_cursor == '\0')
+        {
+          break;
+        }
+        char* ptr_end = nullptr;
+        const f64 value = std::strtod(ptr_cursor, &ptr_end);
+        if (ptr_end == ptr_cursor)
+        {
+          return false;
+        }
+        result.samples_ns.push_back(value);
+        ptr_cursor = ptr_end;
+      }
+
+      result.median_ns = zv::compute_median(result.samples_ns);
+      out_results.push_back(std::move(result));
+      position = static_cast<size_t>(ptr_cursor - json.c_str());
+    }
+
+    return true;
+  }
+}
+
+void zv::BenchmarkRunner::add(const char* name, BenchmarkFn fn)
+{
+  m_benchmarks.push_back(Benchmark{ name, std::move(fn) });
+}
+
+void zv::BenchmarkRunner::add_check(const char* name, CheckFn fn)
+{
+  m_checks.push_back(Check{ name, std::move(fn) });
+}
+
+u32 zv::BenchmarkRunner::run_checks(const Options& options) const
+{
+  u32 failed_count = 0;
+  for (const Check& check : m_checks)
+  {
+    if (options.ptr_filter && check.name.find(options.ptr_filter) == std::string::npos)
+    {
+      continue;
+    }
+
+    const bool passed = check.fn();
+    failed_count += !passed;
+    std::printf("  %-40s %s\n", check.name.c_str(), passed ? "ok" : "FAILED");
+  }
+  return failed_count;
+}
+
+void zv::BenchmarkRunner::run(const Options& options)
+{
+  if (options.cpu >= 0 && !pin_current_thread(static_cast<u32>(options.cpu)))
+  {
+    std::fprintf(stderr, "Failed to pin the benchmark thread to CPU %d.\n", options.cpu);
+  }
+
+  const f64 min_sample_time_ns = options.min_sample_time_ms * 1.0e6;
+  const f64 warmup_time_ns = options.warmup_time_ms * 1.0e6;
+  const u32 sample_count = std::max(options.sample_count, 3u);
+
+  m_results.clear();
+  std::printf("  %-40s %14s %12s %14s %12s\n", "benchmark", "median", "MAD", "ticks", "iterations");
+  for (const Benchmark& benchmark : m_benchmarks)
+  {
+    if (options.ptr_filter && benchmark.name.find(options.ptr_filter) == std::string::npos)
+    {
+      continue;
+    }
+
+    // Warmup and calibration in one: caches, branch predictors and the CPU clock settle while the iteration count
+    // grows to the minimum sample time
+    u64 iteration_count = 1;
+    f64 warmup_elapsed_ns = 0.0;
+    for (;;)
+    {
+      const f64 time_ns = measure(benchmark.fn, iteration_count).time_ns;
+      warmup_elapsed_ns += time_ns;
+      if (time_ns < min_sample_time_ns)
+      {
+        // grows quickly while far away, without overshooting much once close
+        const f64 factor = time_ns > 0.0 ? std::clamp(min_sample_time_ns / time_ns * 1.2, 1.5, 10.0) : 10.0;
+        iteration_count = static_cast<u64>(std::ceil(iteration_count * factor));
+      }
+      else if (warmup_elapsed_ns >= warmup_time_ns)
+      {
+        break;
+      }
+    }
+
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.iteration_count = iteration_count;
+    result.samples_ns.reserve(sample_count);
+    std::vector<f64> ticks;
+    ticks.reserve(sample_count);
+    for (u32 i = 0; i < sample_count; ++i)
+    {
+      const Sample sample = measure(benchmark.fn, iteration_count);
+      result.samples_ns.push_back(sample.time_ns / iteration_count);
+      ticks.push_back(static_cast<f64>(sample.ticks) / iteration_count);
+    }
+    result.median_ns = compute_median(result.samples_ns);
+    result.mad_ns = compute_median_absolute_deviation(result.samples_ns, result.median_ns);
+    result.median_ticks = compute_median(ticks);
+
+    std::printf("  %-40s %11.2f ns %9.2f ns %14.1f %12llu\n", result.name.c_str(), result.median_ns, result.mad_ns, result.median_ticks,
+                static_cast<unsigned long long>(result.iteration_count));
+    m_results.push_back(std::move(result));
+  }
+}
+
+bool zv::BenchmarkRunner::write_json(const char* path) const
+{
+  std::ofstream file{ path, std::ios::trunc };
+  if (!file)
+  {
+    return false;
+  }
+
+  char buffer[64];
+  file << "{\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < m_results.size(); ++i)
+  {
+    const BenchmarkResult& result = m_results[i];
+    file << "    {\n";
+    file << "      \"name\": \"" << result.name << "\",\n";
+    file << "      \"iterations\": " << result.iteration_count << ",\n";
+    std::snprintf(buffer, sizeof(buffer), "%.17g", result.median_ns);
+    file << "      \"median_ns\": " << buffer << ",\n";
+    std::snprintf(buffer, sizeof(buffer), "%.17g", result.mad_ns);
+    file << "      \"mad_ns\": " << buffer << ",\n";
+    std::snprintf(buffer, sizeof(buffer), "%.17g", result.median_ticks);
+    file << "      \"median_ticks\": " << buffer << ",\n";
+    file << "      \"samples_ns\": [";
+    for (size_t j = 0; j < result.samples_ns.size(); ++j)
+    {
+      std::snprintf(buffer, sizeof(buffer), "%.17g", result.samples_ns[j]);
+      file << (j > 0 ? ", " : "") << buffer;
+    }
+    file << "]\n    }" << (i + 1 < m_results.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n}\n";
+
+  return static_cast<bool>(file);
+}
+
+bool zv::BenchmarkRunner::compare(const char* baseline_path, f64 alpha, f64 min_change, Comparison& out_comparison) const
+{
+  std::vector<BenchmarkResult> baseline;
+  if (!read_baseline(baseline_path, baseline))
+  {
+    return false;
+  }
+
+  out_comparison = Comparison{};
+  std::printf("  %-40s %14s %14s %9s %10s\n", "benchmark", "baseline", "current", "change", "p");
+  for (const BenchmarkResult& result : m_results)
+  {
+    const auto it = std::find_if(baseline.begin(), baseline.end(), [&result](const BenchmarkResult& entry) { return entry.name == result.name; });
+    if (it == baseline.end() || it->samples_ns.empty() || it->median_ns <= 0.0)
+    {
+      std::printf("  %-40s %14s\n", result.name.c_str(), "new");
+      continue;
+    }
+
+    const f64 change = result.median_ns / it->median_ns - 1.0;
+    const f64 p_value = compute_mann_whitney_p_value(it->samples_ns, result.samples_ns);
+    const bool significant = p_value < alpha && std::abs(change) > min_change;
+    const char* ptr_verdict = !significant ? "" : change > 0.0 ? "  SLOWER" : "  faster";
+
+    ++out_comparison.compared_count;
+    out_comparison.regression_count += significant && change > 0.0;
+    out_comparison.improvement_count += significant && change < 0.0;
+    std::printf("  %-40s %11.2f ns %11.2f ns %+8.1f%% %10.2g%s\n", result.name.c_str(), it->median_ns, result.median_ns, change * 100.0, p_value, ptr_verdict);
+  }
+
+  return true;
+}
+
+bool zv::pin_current_thread(u32 cpu)
+{
+#if OS_WINDOWS
+  return cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << cpu) != 0;
+#elif OS_LINUX
+  if (cpu >= CPU_SETSIZE)
+  {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+  // macOS only has affinity hints
+  (void)cpu;
+  return false;
+#endif
+}
+
+f64 zv::compute_median(std::vector<f64> values)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+
+  const size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  const f64 upper = values[middle];
+  if (values.size() % 2 != 0)
+  {
+    return upper;
+  }
+  return (*std::max_element(values.begin(), values.begin() + middle) + upper) * 0.5;
+}
+
+f64 zv::compute_median_absolute_deviation(const std::vector<f64>& values, f64 median)
+{
+  std::vector<f64> deviations(values.size());
+  std::transform(values.begin(), values.end(), deviations.begin(), [median](f64 value) { return std::abs(value - median); });
+  return compute_median(std::move(deviations));
+}
+
+f64 zv::compute_mann_whitney_p_value(const std::vector<f64>& a, const std::vector<f64>& b)
+{
+  const size_t n_a = a.size();
+  const size_t n_b = b.size();
+  const size_t n = n_a + n_b;
+  if (n_a == 0 || n_b == 0)
+  {
+    return 1.0;
+  }
+
+  // ranks of the pooled samples, ties get the average of their ranks
+  std::vector<std::pair<f64, bool>> pooled;
+  pooled.reserve(n);
+  for (f64 value : a)
+  {
+    pooled.emplace_back(value, true);
+  }
+  for (f64 value : b)
+  {
+    pooled.emplace_back(value, false);
+  }
+  std::sort(pooled.begin(), pooled.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+  f64 rank_sum_a = 0.0;
+  f64 tie_sum = 0.0;
+  for (size_t i = 0; i < n;)
+  {
+    size_t j = i + 1;
+    while (j < n && pooled[j].first == pooled[i].first)
+    {
+      ++j;
+    }
+    const f64 rank = (static_cast<f64>(i + 1) + static_cast<f64>(j)) * 0.5;
+    for (size_t k = i; k < j; ++k)
+    {
+      rank_sum_a += pooled[k].second ? rank : 0.0;
+    }
+    const f64 tie_count = static_cast<f64>(j - i);
+    tie_sum += tie_count * tie_count * tie_count - tie_count;
+    i = j;
+  }
+
+  const f64 u = rank_sum_a - static_cast<f64>(n_a) * (n_a + 1) * 0.5;
+  const f64 mean = static_cast<f64>(n_a) * n_b * 0.5;
+  const f64 variance = static_cast<f64>(n_a) * n_b / 12.0 * ((n + 1) - tie_sum / (static_cast<f64>(n) * (n - 1)));
+  if (variance <= 0.0)
+  {
+    return 1.0;
+  }
+
+  // continuity correction
+  const f64 z = std::max(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+  return std::erfc(z / std::sqrt(2.0));
+}
@@ -0,0 +1,126 @@
+/*
+ * Benchmark.h - micro-benchmark runner with robust statistics and baseline comparison
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Core/PlatformContext.h>
+#include <Core/PrimitiveTypes.h>
+#include <Core/Utility.h>
+
+#if COMPILER_CL
+#include <intrin.h>
+#endif
+
+namespace zv
+{
+  // Keeps the compiler from removing a computation whose result is otherwise unused
+  template<typename T>
+  inline void do_not_optimize(const T& value)
+  {
+#if COMPILER_CL
+    static volatile const void* s_ptr_sink;
+    s_ptr_sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+  }
+
+  // Makes pending writes visible, so stores into benchmark data are not removed either
+  inline void clobber_memory()
+  {
+#if COMPILER_CL
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : : "memory");
+#endif
+  }
+
+  struct BenchmarkResult
+  {
+    std::string name;
+    // iterations timed together as one sample
+    u64 iteration_count{ 0 };
+    // time per iteration of every sample
+    std::vector<f64> samples_ns;
+    f64 median_ns{ 0.0 };
+    // median absolute deviation from the median, unscaled
+    f64 mad_ns{ 0.0 };
+    // Time::read_cycle_counter() ticks per iteration
+    f64 median_ticks{ 0.0 };
+  };
+
+  // A benchmark function runs its body iteration_count times. Each benchmark is warmed up, its iteration count is
+  // doubled until one sample takes at least the minimum sample time, and then sample_count samples are taken. Median
+  // and MAD are reported because they do not move with the occasional sample that got preempted.
+  // Checks compare the code that is benchmarked against a reference implementation; they run once, before any timing.
+  class BenchmarkRunner : public NonCopyable
+  {
+  public:
+    using BenchmarkFn = std::function<void(u64 iteration_count)>;
+    // returns false on a mismatch, after printing what did not match
+    using CheckFn = std::function<bool()>;
+
+    struct Options
+    {
+      u32 sample_count{ 30 };
+      f64 min_sample_time_ms{ 5.0 };
+      f64 warmup_time_ms{ 50.0 };
+      // pins the running thread to the CPU, -1 lets the scheduler move it
+      s32 cpu{ -1 };
+      // only benchmarks whose name contains the string run
+      const char* ptr_filter{ nullptr };
+    };
+
+    struct Comparison
+    {
+      u32 compared_count{ 0 };
+      u32 regression_count{ 0 };
+      u32 improvement_count{ 0 };
+    };
+
+  public:
+    void add(const char* name, BenchmarkFn fn);
+    void add_check(const char* name, CheckFn fn);
+
+    // returns the number of checks that failed
+    u32 run_checks(const Options& options) const;
+    void run(const Options& options);
+    const std::vector<BenchmarkResult>& get_results() const { return m_results; }
+
+    bool write_json(const char* path) const;
+    // A benchmark regressed if the Mann-Whitney U test rejects equal distributions at alpha and its median got slower
+    // by more than min_change, e.g. 0.05 for 5%; improvements are counted the same way
+    bool compare(const char* baseline_path, f64 alpha, f64 min_change, Comparison& out_comparison) const;
+
+  private:
+    struct Benchmark
+    {
+      std::string name;
+      BenchmarkFn fn;
+    };
+
+    struct Check
+    {
+      std::string name;
+      CheckFn fn;
+    };
+
+    std::vector<Benchmark> m_benchmarks;
+    std::vector<Check> m_checks;
+    std::vector<BenchmarkResult> m_results;
+  };
+
+  // false if the platform does not support it or the CPU does not exist
+  bool pin_current_thread(u32 cpu);
+
+  f64 compute_median(std::vector<f64> values);
+  f64 compute_median_absolute_deviation(const std::vector<f64>& values, f64 median);
+  // two-sided p-value of the Mann-Whitney U test, normal approximation with tie correction
+  f64 compute_mann_whitney_p_value(const std::vector<f64>& a, const std::vector<f64>& b);
+}
@@ -0,0 +1,268 @@
+/*
+ * EcsBench.cpp - headless benchmark of entity creation, queries and scheduled systems
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/JobSystem.h>
+#include <Scene/Ecs.h>
+#include <Scene/SystemScheduler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+
+// Usage: zv_ecs_bench [--entities=<count>] [--threads=<count>]
+//
+// Creates the entities (1M by default) with a mix of archetypes and reports the time per entity of creating them, of
+// iterating a two-component query on one thread and on the job system, compared to the same loop over an array of
+// structs, of moving entities between archetypes, and of a frame of scheduled systems that also spawn and destroy
+// entities through command buffers. The exit code is non-zero if the entity counts or positions do not add up.
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  struct Position { f32 x, y, z; };
+  struct Velocity { f32 x, y, z; };
+  struct Health { f32 value; };
+  struct Lifetime { f32 remaining; };
+
+  // array-of-structs reference with the same data
+  struct GameObject
+  {
+    Position position;
+    Velocity velocity;
+    Health health;
+    Lifetime lifetime;
+    bool has_health;
+    bool has_lifetime;
+  };
+
+  constexpr f32 k_delta_time = 1.0f / 60.0f;
+  constexpr u32 k_iterations = 20;
+
+  f64 elapsed_ms(Clock::time_point start)
+  {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+  }
+
+  void print_result(const char* name, f64 time_ms, u32 count)
+  {
+    std::printf("  %-34s %10.3f ms %8.2f ns/entity\n", name, time_ms, time_ms * 1.0e6 / count);
+  }
+
+  Velocity make_velocity(u32 i)
+  {
+    return Velocity{ static_cast<f32>(i % 7) - 3.0f, static_cast<f32>(i % 5) - 2.0f, static_cast<f32>(i % 3) - 1.0f };
+  }
+
+  void integrate(Position* ptr_positions, const Velocity* ptr_velocities, u32 count)
+  {
+    for (u32 i = 0; i < count; ++i)
+    {
+      ptr_positions[i].x += ptr_velocities[i].x * k_delta_time;
+      ptr_positions[i].y += ptr_velocities[i].y * k_delta_time;
+      ptr_positions[i].z += ptr_velocities[i].z * k_delta_time;
+    }
+  }
+
+  f64 sum_positions(zv::World& world)
+  {
+    zv::Query query = zv::make_query<Position>();
+    f64 sum = 0.0;
+    query.for_each<Position>(world, [&sum](zv::Entity, const Position& position) { sum += position.x + position.y + position.z; });
+    return sum;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  u32 entity_count = 1000000;
+  u32 thread_count = 0;
+  for (s32 i = 1; i < argc; ++i)
+  {
+    if (std::sscanf(argv[i], "--entities=%u", &entity_count) != 1 && std::sscanf(argv[i], "--threads=%u", &thread_count) != 1)
+    {
+      std::fprintf(stderr, "Usage: %s [--entities=<count>] [--threads=<count>]\n", argv[0]);
+      return 1;
+    }
+  }
+  entity_count = std::max(entity_count, 4u);
+
+  // one thread runs everything inline, 0 uses all hardware threads
+  if (thread_count != 1)
+  {
+    zv::Jobs::create(thread_count > 1 ? thread_count - 1 : 0);
+  }
+  std::printf("%u entities, %u threads\n", entity_count, zv::Jobs::get_thread_count());
+
+  bool valid = true;
+  zv::World world;
+
+  // every entity moves, every second one has health and every fourth a lifetime: four archetypes
+  Clock::time_point start = Clock::now();
+  for (u32 i = 0; i < entity_count; ++i)
+  {
+    const Position position{ static_cast<f32>(i % 1000), 0.0f, static_cast<f32>(i / 1000) };
+    if (i % 4 == 0)
+    {
+      world.create(position, make_velocity(i), Health{ 100.0f }, Lifetime{ 1.0f + static_cast<f32>(i % 64) * k_delta_time });
+    }
+    else if (i % 2 == 0)
+    {
+      world.create(position, make_velocity(i), Health{ 100.0f });
+    }
+    else
+    {
+      world.create(position, make_velocity(i));
+    }
+  }
+  print_result("create", elapsed_ms(start), entity_count);
+  std::printf("  %u archetypes\n", world.get_archetype_count());
+
+  zv::Query movers = zv::make_query<Position, Velocity>();
+  valid &= movers.get_entity_count(world) == entity_count;
+
+  // query iteration, serial, parallel and over an array of structs
+  const f64 sum_before = sum_positions(world);
+  start = Clock::now();
+  for (u32 iteration = 0; iteration < k_iterations; ++iteration)
+  {
+    movers.for_each_chunk(world, [](const zv::ChunkView& chunk)
+    {
+      integrate(chunk.get<Position>(), chunk.get<Velocity>(), chunk.get_count());
+    });
+  }
+  print_result("query, serial", elapsed_ms(start) / k_iterations, entity_count);
+
+  start = Clock::now();
+  for (u32 iteration = 0; iteration < k_iterations; ++iteration)
+  {
+    movers.parallel_for_each_chunk(world, [](const zv::ChunkView& chunk)
+    {
+      integrate(chunk.get<Position>(), chunk.get<Velocity>(), chunk.get_count());
+    });
+  }
+  print_result("query, parallel", elapsed_ms(start) / k_iterations, entity_count);
+
+  // both loops moved every entity by 2 * k_iterations steps; the velocity components sum to 0 over 105 entities, so
+  // only the remainder contributes
+  f64 expected_delta = 0.0;
+  for (u32 i = entity_count - entity_count % 105; i < entity_count; ++i)
+  {
+    const Velocity velocity = make_velocity(i);
+    expected_delta += (velocity.x + velocity.y + velocity.z) * k_delta_time * 2 * k_iterations;
+  }
+  const f64 delta = sum_positions(world) - sum_before;
+  valid &= std::abs(delta - expected_delta) <= 1.0e-3 * entity_count;
+
+  std::vector<GameObject> objects(entity_count);
+  for (u32 i = 0; i < entity_count; ++i)
+  {
+    objects[i] = GameObject{ Position{ static_cast<f32>(i % 1000), 0.0f, static_cast<f32>(i / 1000) }, make_velocity(i), Health{ 100.0f },
+                             Lifetime{ 1.0f }, i % 2 == 0, i % 4 == 0 };
+  }
+  start = Clock::now();
+  for (u32 iteration = 0; iteration < k_iterations; ++iteration)
+  {
+    for (GameObject& object : objects)
+    {
+      object.position.x += object.velocity.x * k_delta_time;
+      object.position.y += object.velocity.y * k_delta_time;
+      object.position.z += object.velocity.z * k_delta_time;
+    }
+  }
+  print_result("array of structs, serial", elapsed_ms(start) / k_iterations, entity_count);
+
+  // structural changes: every tenth entity loses its health and gets it back
+  std::vector<zv::Entity> changed;
+  zv::Query health_query = zv::make_query<Health>();
+  health_query.for_each<Health>(world, [&changed](zv::Entity entity, Health&)
+  {
+    if (entity.index % 10 == 0)
+    {
+      changed.push_back(entity);
+    }
+  });
+  start = Clock::now();
+  for (zv::Entity entity : changed)
+  {
+    world.remove<Health>(entity);
+  }
+  for (zv::Entity entity : changed)
+  {
+    world.add(entity, Health{ 50.0f });
+  }
+  print_result("remove and add component", elapsed_ms(start), static_cast<u32>(changed.size()) * 2);
+  valid &= world.get_entity_count() == entity_count;
+
+  // Scheduled frame: movement and aging are independent and run in parallel, damage reads the positions movement
+  // writes and runs after it. Entities whose lifetime ends are destroyed and each one spawns a replacement.
+  zv::SystemScheduler scheduler;
+  zv::Query aging_query = zv::make_query<Lifetime>();
+  zv::Query damage_query = zv::make_query<Position, Health>();
+  scheduler.add_system(zv::SystemDesc{ "movement", zv::make_component_mask<Velocity>(), zv::make_component_mask<Position>(),
+    [&movers](zv::World& world, zv::CommandBuffer&)
+    {
+      movers.parallel_for_each_chunk(world, [](const zv::ChunkView& chunk)
+      {
+        integrate(chunk.get<Position>(), chunk.get<Velocity>(), chunk.get_count());
+      });
+    } });
+  scheduler.add_system(zv::SystemDesc{ "aging", 0, zv::make_component_mask<Lifetime>(),
+    [&aging_query](zv::World& world, zv::CommandBuffer& commands)
+    {
+      aging_query.parallel_for_each_chunk(world, [&commands](const zv::ChunkView& chunk)
+      {
+        Lifetime* ptr_lifetimes = chunk.get<Lifetime>();
+        const zv::Entity* ptr_entities = chunk.get_entities();
+        for (u32 i = 0; i < chunk.get_count(); ++i)
+        {
+          ptr_lifetimes[i].remaining -= k_delta_time;
+          if (ptr_lifetimes[i].remaining <= 0.0f)
+          {
+            commands.destroy(ptr_entities[i]);
+            const zv::Entity spawned = commands.create();
+            commands.add(spawned, Position{ 0.0f, 0.0f, 0.0f });
+            commands.add(spawned, Velocity{ 1.0f, 0.0f, 0.0f });
+            commands.add(spawned, Lifetime{ 1.0f });
+          }
+        }
+      });
+    } });
+  scheduler.add_system(zv::SystemDesc{ "damage", zv::make_component_mask<Position>(), zv::make_component_mask<Health>(),
+    [&damage_query](zv::World& world, zv::CommandBuffer&)
+    {
+      damage_query.parallel_for_each_chunk(world, [](const zv::ChunkView& chunk)
+      {
+        const Position* ptr_positions = chunk.get<Position>();
+        Health* ptr_health = chunk.get<Health>();
+        for (u32 i = 0; i < chunk.get_count(); ++i)
+        {
+          ptr_health[i].value -= ptr_positions[i].y > 0.0f ? 0.1f : 0.0f;
+        }
+      });
+    } });
+
+  const u32 frame_count = 120;
+  start = Clock::now();
+  for (u32 frame = 0; frame < frame_count; ++frame)
+  {
+    scheduler.run(world);
+  }
+  print_result("scheduled frame", elapsed_ms(start) / frame_count, entity_count);
+  for (u32 i = 0; i < scheduler.get_system_count(); ++i)
+  {
+    std::printf("    %-10s level %u, %.3f ms\n", scheduler.get_system_name(i), scheduler.get_system_level(i), scheduler.get_system_time_ms(i));
+  }
+  valid &= scheduler.get_level_count() == 2;
+  valid &= world.get_entity_count() == entity_count;
+  valid &= movers.get_entity_count(world) == entity_count;
+
+  std::printf("  %u archetypes, consistent: %s\n", world.get_archetype_count(), valid ? "yes" : "NO");
+
+  zv::Jobs::destroy();
+  return valid ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/*
+ * MeshBench.cpp - benchmark of the mesh processing stages on generated meshes
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Renderer/Mesh.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+// Usage: zv_mesh_bench [--scale=<factor>]
+//
+// Meshes come in as unindexed triangle soups with shuffled vertices and triangles, the worst case of an importer that
+// does not optimize. Every stage reports the post-transform cache miss ratios (ACMR with 16 and 32 entry FIFOs, ATVR)
+// the vertex fetch overhead and the overdraw averaged over six axis views (analyze_overdraw()), followed by the vertex sizes of the float and quantized encodings and the LOD chain.
+// The exit code is non-zero if processing the same input twice gives different results.
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  void add_vertex(zv::MeshData& mesh, f32 x, f32 y, f32 z, f32 nx, f32 ny, f32 nz, f32 u, f32 v)
+  {
+    zv::MeshVertex vertex;
+    vertex.position = zv::Vector3{ x, y, z };
+    vertex.normal = zv::Vector3{ nx, ny, nz };
+    vertex.uv.x = u;
+    vertex.uv.y = v;
+    mesh.indices.push_back(static_cast<u32>(mesh.vertices.size()));
+    mesh.vertices.push_back(vertex);
+  }
+
+  // UV sphere, the seam and the poles keep vertices that only differ in their uvs
+  zv::MeshData generate_sphere(u32 segments, u32 rings)
+  {
+    zv::MeshData mesh;
+    auto add = [&mesh, segments, rings](u32 segment, u32 ring)
+    {
+      const f32 u = static_cast<f32>(segment) / segments;
+      const f32 v = static_cast<f32>(ring) / rings;
+      const f32 theta = u * 2.0f * 3.14159265f;
+      const f32 phi = v * 3.14159265f;
+      const f32 x = std::sin(phi) * std::cos(theta);
+      const f32 y = std::cos(phi);
+      const f32 z = std::sin(phi) * std::sin(theta);
+      add_vertex(mesh, x, y, z, x, y, z, u, v);
+    };
+
+    for (u32 ring = 0; ring < rings; ++ring)
+    {
+      for (u32 segment = 0; segment < segments; ++segment)
+      {
+        add(segment, ring);     add(segment + 1, ring + 1); add(segment + 1, ring);
+        add(segment, ring);     add(segment, ring + 1);     add(segment + 1, ring + 1);
+      }
+    }
+    return mesh;
+  }
+
+  // Concentric spheres, each hidden behind the next larger one; a convex mesh or a height field seen from above has no
+  // overdraw with back-face culling, this one does in every view
+  zv::MeshData generate_shells(u32 segments, u32 shell_count)
+  {
+    zv::MeshData mesh;
+    for (u32 shell = 0; shell < shell_count; ++shell)
+    {
+      const f32 radius = 1.0f - 0.15f * shell;
+      zv::MeshData sphere = generate_sphere(segments, std::max(segments / 2, 2u));
+      for (zv::MeshVertex& vertex : sphere.vertices)
+      {
+        vertex.position = zv::Vector3{ vertex.position.x * radius, vertex.position.y * radius, vertex.position.z * radius };
+      }
+      const u32 base = static_cast<u32>(mesh.vertices.size());
+      mesh.vertices.insert(mesh.vertices.end(), sphere.vertices.begin(), sphere.vertices.end());
+      for (u32 index : sphere.indices)
+      {
+        mesh.indices.push_back(base + index);
+      }
+    }
+    return mesh;
+  }
+
+  // height field with smooth normals
+  zv::MeshData generate_terrain(u32 size)
+  {
+    zv::MeshData mesh;
+    auto height = [](f32 x, f32 z) { return 0.1f * std::sin(x * 7.0f) * std::cos(z * 5.0f) + 0.05f * std::sin(x * 23.0f + z * 17.0f); };
+    auto add = [&mesh, &height, size](u32 ix, u32 iz)
+    {
+      const f32 x = static_cast<f32>(ix) / size;
+      const f32 z = static_cast<f32>(iz) / size;
+      const f32 e = 1.0f / size;
+      const f32 dx = (height(x + e, z) - height(x - e, z)) / (2.0f * e);
+      const f32 dz = (height(x, z + e) - height(x, z - e)) / (2.0f * e);
+      const f32 inv_length = 1.0f / std::sqrt(dx * dx + 1.0f + dz * dz);
+      add_vertex(mesh, x, height(x, z), z, -dx * inv_length, inv_length, -dz * inv_length, x, z);
+    };
+
+    for (u32 iz = 0; iz < size; ++iz)
+    {
+      for (u32 ix = 0; ix < size; ++ix)
+      {
+        add(ix, iz); add(ix, iz + 1);     add(ix + 1, iz + 1);
+        add(ix, iz); add(ix + 1, iz + 1); add(ix + 1, iz);
+      }
+    }
+    return mesh;
+  }
+
+  // Fisher-Yates over vertices and triangles with a fixed seed; written out because std::shuffle differs between
+  // standard libraries
+  void shuffle_mesh(zv::MeshData& mesh)
+  {
+    std::mt19937 engine{ 1234 };
+
+    const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+    std::vector<u32> remap(vertex_count);
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+      remap[i] = i;
+    }
+    for (u32 i = vertex_count - 1; i > 0; --i)
+    {
+      std::swap(remap[i], remap[engine() % (i + 1)]);
+    }
+
+    std::vector<zv::MeshVertex> vertices(vertex_count);
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+      vertices[remap[i]] = mesh.vertices[i];
+    }
+    mesh.vertices.swap(vertices);
+    for (u32& index : mesh.indices)
+    {
+      index = remap[index];
+    }
+
+    const u32 triangle_count = static_cast<u32>(mesh.indices.size() / 3);
+    for (u32 i = triangle_count - 1; i > 0; --i)
+    {
+      const u32 j = static_cast<u32>(engine() % (i + 1));
+      for (u32 k = 0; k < 3; ++k)
+      {
+        std::swap(mesh.indices[i * 3 + k], mesh.indices[j * 3 + k]);
+      }
+    }
+  }
+
+  void print_stage(const char* name, const zv::MeshData& mesh, f64 time_ms)
+  {
+    const u32 index_count = static_cast<u32>(mesh.indices.size());
+    const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+    const zv::VertexCacheStats cache16 = zv::analyze_vertex_cache(mesh.indices.data(), index_count, vertex_count, 16);
+    const zv::VertexCacheStats cache32 = zv::analyze_vertex_cache(mesh.indices.data(), index_count, vertex_count, 32);
+    const f32 overfetch = zv::analyze_vertex_fetch(mesh.indices.data(), index_count, vertex_count,
+                                                    zv::get_vertex_stride(zv::VERTEX_COMPONENT_FLAG_POS_NORM_UV, zv::eVertexEncoding::Float));
+    const f32 overdraw = zv::analyze_overdraw(mesh.indices.data(), index_count, mesh.vertices.data(), vertex_count);
+    std::printf("  %-14s %10u %10u %8.3f %8.3f %8.3f %9.3f %8.3f %10.2f\n", name, index_count / 3, vertex_count, cache16.acmr, cache32.acmr,
+                cache16.atvr, overfetch, overdraw, time_ms);
+  }
+
+  f64 elapsed_ms(Clock::time_point start)
+  {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+  }
+
+  bool bench_mesh(const char* name, zv::MeshData mesh)
+  {
+    shuffle_mesh(mesh);
+    const zv::MeshData input = mesh;
+
+    std::printf("%s\n", name);
+    std::printf("  %-14s %10s %10s %8s %8s %8s %9s %8s %10s\n", "stage", "triangles", "vertices", "acmr16", "acmr32", "atvr16", "overfetch",
+                "overdraw", "time ms");
+    print_stage("input", mesh, 0.0);
+
+    Clock::time_point start = Clock::now();
+    zv::deduplicate_vertices(mesh);
+    print_stage("deduplicate", mesh, elapsed_ms(start));
+
+    const u32 vertex_count = static_cast<u32>(mesh.vertices.size());
+    const u32 index_count = static_cast<u32>(mesh.indices.size());
+    start = Clock::now();
+    zv::optimize_vertex_cache(mesh.indices.data(), index_count, vertex_count);
+    print_stage("vertex cache", mesh, elapsed_ms(start));
+
+    start = Clock::now();
+    zv::optimize_overdraw(mesh.indices.data(), index_count, mesh.vertices.data(), vertex_count, 16, zv::MeshProcessParams{}.overdraw_threshold);
+    print_stage("overdraw", mesh, elapsed_ms(start));
+
+    start = Clock::now();
+    zv::optimize_vertex_fetch(mesh);
+    print_stage("vertex fetch", mesh, elapsed_ms(start));
+
+    start = Clock::now();
+    zv::QuantizedMesh quantized;
+    zv::quantize_mesh(mesh, zv::VERTEX_COMPONENT_FLAG_POS_NORM_UV, quantized);
+    const f64 quantize_ms = elapsed_ms(start);
+
+    f32 max_normal_error_deg = 0.0f;
+    for (const zv::MeshVertex& vertex : mesh.vertices)
+    {
+      s16 x, y;
+      zv::encode_octahedral_normal(vertex.normal, x, y);
+      const zv::Vector3 decoded = zv::decode_octahedral_normal(x, y);
+      const f32 cos_angle = decoded.x * vertex.normal.x + decoded.y * vertex.normal.y + decoded.z * vertex.normal.z;
+      max_normal_error_deg = std::max(max_normal_error_deg, std::acos(std::min(cos_angle, 1.0f)) * 57.2957795f);
+    }
+    std::printf("  bytes per vertex: %u float, %u quantized (%.2f ms), max normal error %.4f deg\n",
+                zv::get_vertex_stride(zv::VERTEX_COMPONENT_FLAG_POS_NORM_UV, zv::eVertexEncoding::Float), quantized.vertex_stride,
+                quantize_ms, max_normal_error_deg);
+
+    start = Clock::now();
+    std::vector<zv::MeshLod> lods;
+    zv::generate_lods(mesh, 4, 0.5f, lods);
+    std::printf("  lods (%.2f ms):", elapsed_ms(start));
+    for (const zv::MeshLod& lod : lods)
+    {
+      const zv::VertexCacheStats cache = zv::analyze_vertex_cache(lod.indices.data(), static_cast<u32>(lod.indices.size()), vertex_count, 16);
+      std::printf(" %zu tris (error %.4f, acmr %.3f)", lod.indices.size() / 3, lod.error, cache.acmr);
+    }
+    std::printf("\n");
+
+    // the whole pipeline twice on the same input has to give identical results
+    zv::MeshData first = input;
+    zv::MeshData second = input;
+    std::vector<zv::MeshLod> first_lods;
+    std::vector<zv::MeshLod> second_lods;
+    zv::process_mesh(first, zv::MeshProcessParams{}, first_lods);
+    zv::process_mesh(second, zv::MeshProcessParams{}, second_lods);
+    bool deterministic = first.indices == second.indices && first.vertices.size() == second.vertices.size() &&
+                         std::memcmp(first.vertices.data(), second.vertices.data(), first.vertices.size() * sizeof(zv::MeshVertex)) == 0 &&
+                         first_lods.size() == second_lods.size();
+    for (size_t i = 0; deterministic && i < first_lods.size(); ++i)
+    {
+      deterministic = first_lods[i].indices == second_lods[i].indices;
+    }
+    std::printf("  deterministic: %s\n\n", deterministic ? "yes" : "NO");
+    return deterministic;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  f32 scale = 1.0f;
+  for (s32 i = 1; i < argc; ++i)
+  {
+    if (std::sscanf(argv[i], "--scale=%f", &scale) != 1 || scale <= 0.0f)
+    {
+      std::fprintf(stderr, "Usage: %s [--scale=<factor>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const u32 sphere_segments = std::max(static_cast<u32>(256 * scale), 3u);
+  const u32 terrain_size = std::max(static_cast<u32>(256 * scale), 1u);
+
+  bool deterministic = bench_mesh("sphere", generate_sphere(sphere_segments, std::max(sphere_segments / 2, 2u)));
+  deterministic &= bench_mesh("terrain", generate_terrain(terrain_size));
+  deterministic &= bench_mesh("shells", generate_shells(std::max(sphere_segments / 2, 3u), 4));
+  return deterministic ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+/*
+ * TelemetryClient.cpp - command line client that tails or records the telemetry stream of a running game
+ * Copyright (c) 2024 Johannes Przybilla. All Rights Reserved.
+ */
+
+#include <Core/LocalSocket.h>
+#include <Core/Telemetry.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+// Usage: zv_telemetry <address>|--read=<file> [--record=<file>] [--count=<records>] [--quiet]
+//
+// Connects to the telemetry server of a game started with --telemetry=<address> and prints every record until the
+// game exits or --count records arrived. --record additionally writes the raw stream to a file, which --read prints
+// later instead of connecting; --quiet prints only the summary. The stream is checked while it is read: the client
+// exits with 1 if the hello does not match, a record uses a channel that was never named or the timestamps of a thread
+// go backwards.
+namespace
+{
+  struct StreamReader
+  {
+    std::vector<std::string> channel_names;
+    std::vector<u64> last_timestamps_ns;
+    u64 record_count{ 0 };
+    u64 dropped_count{ 0 };
+    u64 max_record_count{ ~0ull };
+    bool hello_read{ false };
+    bool quiet{ false };
+    bool failed{ false };
+
+    bool is_done() const { return failed || record_count >= max_record_count; }
+
+    bool fail(const char* message)
+    {
+      std::fprintf(stderr, "Invalid stream after %llu records: %s\n", static_cast<unsigned long long>(record_count), message);
+      failed = true;
+      return false;
+    }
+
+    const char* get_channel_name(u32 channel) const
+    {
+      return channel < channel_names.size() ? channel_names[channel].c_str() : "?";
+    }
+
+    void print(const zv::TelemetryRecord& record) const
+    {
+      if (quiet)
+      {
+        return;
+      }
+
+      const f64 time_s = static_cast<f64>(record.timestamp_ns) * 1.0e-9;
+      switch (record.type)
+      {
+      case zv::eTelemetryRecord::Channel:
+        std::printf("%12.6f [t%u] channel %u = %s\n", time_s, record.thread, record.channel, get_channel_name(record.channel));
+        break;
+      case zv::eTelemetryRecord::Counter:
+        std::printf("%12.6f [t%u] %s = %g\n", time_s, record.thread, get_channel_name(record.channel), record.value);
+        break;
+      case zv::eTelemetryRecord::Span:
+        std::printf("%12.6f [t%u] %s %.3f ms\n", time_s, record.thread, get_channel_name(record.channel), record.value * 1.0e-6);
+        break;
+      case zv::eTelemetryRecord::Dropped:
+        std::printf("%12.6f [t%u] dropped %.0f records\n", time_s, record.thread, record.value);
+        break;
+      }
+    }
+
+    // returns the bytes consumed, 0 if data does not hold a whole hello or record yet
+    u64 read(const u8* ptr_data, u64 size)
+    {
+      if (!hello_read)
+      {
+        zv::TelemetryHello hello;
+        if (size < sizeof(hello))
+        {
+          return 0;
+        }
+
+        std::memcpy(&hello, ptr_data, sizeof(hello));
+        if (hello.magic != zv::k_telemetry_magic || hello.version != zv::k_telemetry_version || hello.record_size != sizeof(zv::TelemetryRecord))
+        {
+          return fail("the hello does not match this client");
+        }
+        hello_read = true;
+        return sizeof(hello);
+      }
+
+      zv::TelemetryRecord record;
+      if (size < sizeof(record))
+      {
+        return 0;
+      }
+      std::memcpy(&record, ptr_data, sizeof(record));
+
+      u64 record_size = sizeof(record);
+      if (record.type == zv::eTelemetryRecord::Channel)
+      {
+        record_size += record.name_size;
+        if (size < record_size)
+        {
+          return 0;
+        }
+        if (record.channel != channel_names.size())
+        {
+          return fail("channels are not named in order");
+        }
+        channel_names.emplace_back(reinterpret_cast<const char*>(ptr_data + sizeof(record)), record.name_size);
+      }
+      else if (record.type == zv::eTelemetryRecord::Counter || record.type == zv::eTelemetryRecord::Span)
+      {
+        if (record.channel >= channel_names.size())
+        {
+          return fail("a record uses a channel that was not named");
+        }
+
+        // spans carry their start, which can precede a counter the thread published earlier; only counters are ordered
+        if (record.type == zv::eTelemetryRecord::Counter)
+        {
+          if (record.thread >= last_timestamps_ns.size())
+          {
+            last_timestamps_ns.resize(record.thread + 1, 0);
+          }
+          if (record.timestamp_ns < last_timestamps_ns[record.thread])
+          {
+            return fail("the timestamps of a thread go backwards");
+          }
+          last_timestamps_ns[record.thread] = record.timestamp_ns;
+        }
+      }
+      else if (record.type == zv::eTelemetryRecord::Dropped)
+      {
+        dropped_count += static_cast<u64>(record.value);
+      }
+      else
+      {
+        return fail("unknown record type");
+      }
+
+      print(record);
+      ++record_count;
+      return record_size;
+    }
+
+    // consumes all complete records at the front of buffer
+    void read_all(std::vector<u8>& buffer)
+    {
+      u64 offset = 0;
+      while (!is_done())
+      {
+        const u64 consumed = read(buffer.data() + offset, buffer.size() - offset);
+        if (consumed == 0)
+        {
+          break;
+        }
+        offset += consumed;
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + offset);
+    }
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  StreamReader reader;
+  const char* ptr_address = nullptr;
+  const char* ptr_read_path = nullptr;
+  const char* ptr_record_path = nullptr;
+  for (s32 i = 1; i < argc; ++i)
+  {
+    const char* arg = argv[i];
+    unsigned long long count = 0;
+    if (std::strncmp(arg, "--read=", 7) == 0)
+    {
+      ptr_read_path = arg + 7;
+    }
+    else if (std::strncmp(arg, "--record=", 9) == 0)
+    {
+      ptr_record_path = arg + 9;
+    }
+    else if (std::sscanf(arg, "--count=%llu", &count) == 1)
+    {
+      reader.max_record_count = count;
+    }
+    else if (std::strcmp(arg, "--quiet") == 0)
+    {
+      reader.quiet = true;
+    }
+    else if (arg[0] != '-' && ptr_address == nullptr)
+    {
+      ptr_address = arg;
+    }
+    else
+    {
+      ptr_address = nullptr;
+      break;
+    }
+  }
+
+  if ((ptr_address == nullptr) == (ptr_read_path == nullptr))
+  {
+    std::fprintf(stderr, "Usage: %s <address>|--read=<file> [--record=<file>] [--count=<records>] [--quiet]\n", argv[0]);
+    return 1;
+  }
+
+  zv::LocalSocket socket;
+  std::FILE* ptr_input = nullptr;
+  if (ptr_read_path)
+  {
+    ptr_input = std::fopen(ptr_read_path, "rb");
+    if (ptr_input == nullptr)
+    {
+      std::fprintf(stderr, "Failed to open '%s'.\n", ptr_read_path);
+      return 1;
+    }
+  }
+  else if (!socket.connect(ptr_address))
+  {
+    std::fprintf(stderr, "Failed to connect to '%s'.\n", ptr_address);
+    return 1;
+  }
+
+  std::FILE* ptr_record = nullptr;
+  if (ptr_record_path)
+  {
+    ptr_record = std::fopen(ptr_record_path, "wb");
+    if (ptr_record == nullptr)
+    {
+      std::fprintf(stderr, "Failed to create '%s'.\n", ptr_record_path);
+      return 1;
+    }
+  }
+
+  std::vector<u8> buffer;
+  u8 chunk[64 * 1024];
+  while (!reader.is_done())
+  {
+    // the socket blocks, it returns -1 once the game closed the connection
+    const s64 size = ptr_input ? static_cast<s64>(std::fread(chunk, 1, sizeof(chunk), ptr_input)) : socket.receive(chunk, sizeof(chunk));
+    if (size <= 0)
+    {
+      break;
+    }
+
+    if (ptr_record)
+    {
+      std::fwrite(chunk, 1, static_cast<size_t>(size), ptr_record);
+    }
+    buffer.insert(buffer.end(), chunk, chunk + size);
+    reader.read_all(buffer);
+    std::fflush(stdout);
+  }
+
+  if (ptr_input)
+  {
+    std::fclose(ptr_input);
+  }
+  if (ptr_record)
+  {
+    std::fclose(ptr_record);
+  }
+
+  std::printf("%llu records on %zu channels, %llu dropped by the game\n", static_cast<unsigned long long>(reader.record_count),
+              reader.channel_names.size(), static_cast<unsigned long long>(reader.dropped_count));
+  return reader.failed ? 1 : 0;
+}
@@ -26,7 +26,8 @@ bool zv::Window::create(const CreateParams &params)
 {
 	if (SDL_Init(SDL_INIT_VIDEO) < 0)
   {
-    return 1;
+    ZV_ERROR("SDL could not be initialized! SDL_Error: {}", SDL_GetError());
+    return false;
   }
 
   SDL_LogSetOutputFunction(sdl_log_callback, this);
@@ -65,11 +66,33 @@ zv::NativeWindowHandle zv::Window::get_native_window_handle() const
   SDL_SysWMinfo wm_info;
   SDL_VERSION(&wm_info.version);
   SDL_GetWindowWMInfo(m_ptr_sdl_window, &wm_info);
-  NativeWindowHandle handle;
 #if OS_WINDOWS
   return wm_info.info.win.window;
 #elif OS_MAC
   return wm_info.info.cocoa.window;
+#elif OS_LINUX
+  NativeWindowHandle handle;
+  switch (wm_info.subsystem)
+  {
+#if defined(SDL_VIDEO_DRIVER_X11)
+    case SDL_SYSWM_X11:
+      handle.subsystem = NativeWindowHandle::eSubsystem::X11;
+      handle.ptr_display = wm_info.info.x11.display;
+      handle.window_id = static_cast<u64>(wm_info.info.x11.window);
+      break;
+#endif
+#if defined(SDL_VIDEO_DRIVER_WAYLAND)
+    case SDL_SYSWM_WAYLAND:
+      handle.subsystem = NativeWindowHandle::eSubsystem::Wayland;
+      handle.ptr_display = wm_info.info.wl.display;
+      handle.ptr_surface = wm_info.info.wl.surface;
+      break;
+#endif
+    default:
+      ZV_ERROR("Unsupported window subsystem {}.", static_cast<s32>(wm_info.subsystem));
+      break;
+  }
+  return handle;
 #else
 # error "Other OS currently not supported."
 #endif
@@ -19,6 +19,17 @@ namespace zv
   typedef HWND NativeWindowHandle;
 #elif OS_MAC
   typedef NSWindow NativeWindowHandle;
+#elif OS_LINUX
+  struct NativeWindowHandle
+  {
+    enum class eSubsystem : u8 { Unknown, X11, Wayland };
+
+    eSubsystem subsystem{ eSubsystem::Unknown };
+    // X11: Display* and Window id; Wayland: wl_display* and wl_surface*
+    void* ptr_display{ nullptr };
+    u64 window_id{ 0 };
+    void* ptr_surface{ nullptr };
+  };
 #else
 # error "Other OS currently not supported."
 #endif
@@ -4,5 +4,5 @@
 int main(int argc, char* argv[])
 {
   zv::Application app{};
-  return app.run();
+  return app.run(argc, argv);
 }